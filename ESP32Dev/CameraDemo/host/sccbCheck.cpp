@@ -0,0 +1,129 @@
+// Checks the OV7670 register tables on MockI2C: for every mode, the writes
+// start with a register reset and a pause, all go to the camera's address,
+// and the registers that set the format, the scaling and the window end with
+// their expected values. A mode written after another leaves the same writes
+// as one written after power up, and a write that is not acknowledged is
+// counted. Person has the same OV7670Registers. From here:
+//
+//   g++ -std=c++11 -O2 -I../include sccbCheck.cpp ../src/OV7670Registers.cpp -o sccbCheck
+//   ./sccbCheck
+
+#include <MockI2C.h>
+#include <OV7670Registers.h>
+
+#include <stdio.h>
+#include <string.h>
+
+typedef OV7670Registers R;
+
+struct Expected
+{
+  int reg;
+  // -1: never written
+  int value;
+};
+
+// Written the same in every mode: RGB565 after the reset, colors() and saturation(0)
+const Expected common[] = {
+  {R::REG_CLKRC, 0x80},
+  {R::REG_COM11, 0x0a},
+  {R::REG_COM7, 0x04},
+  {R::REG_COM15, 0xd0},
+  {0xb0, 0x84},
+  {0x4f, 0x80}, {0x50, 0x80}, {0x51, 0x00}, {0x52, 0x22}, {0x53, 0x5e}, {0x54, 0x80}, {0x58, 0x9e},
+  {R::REG_COM8, 0xe7},
+  {0x6f, 0x9f},
+};
+
+struct ModeCheck
+{
+  R::Mode mode;
+  const char *name;
+  Expected registers[13];
+};
+
+// Scaling, then the window: hStart, hStop, vStart, vStop split over HSTART,
+// HSTOP, HREF and VSTART, VSTOP, VREF
+const ModeCheck modes[] = {
+  {R::VGA_RGB565, "VGA", {
+    {R::REG_COM3, 0x00}, {R::REG_COM14, 0x00}, {R::REG_SCALING_XSC, -1}, {R::REG_SCALING_YSC, -1},
+    {R::REG_SCALING_DCWCTR, -1}, {R::REG_SCALING_PCLK_DIV, -1}, {R::REG_SCALING_PCLK_DELAY, -1},
+    {R::REG_HSTART, 168 >> 3}, {R::REG_HSTOP, 24 >> 3}, {R::REG_HREF, 0x00},
+    {R::REG_VSTART, 12 >> 2}, {R::REG_VSTOP, 492 >> 2}, {R::REG_VREF, 0x00}}},
+  {R::QVGA_RGB565, "QVGA", {
+    {R::REG_COM3, 0x04}, {R::REG_COM14, 0x19}, {R::REG_SCALING_XSC, 0x3a}, {R::REG_SCALING_YSC, 0x35},
+    {R::REG_SCALING_DCWCTR, 0x11}, {R::REG_SCALING_PCLK_DIV, 0xf1}, {R::REG_SCALING_PCLK_DELAY, 0x02},
+    {R::REG_HSTART, 168 >> 3}, {R::REG_HSTOP, 24 >> 3}, {R::REG_HREF, 0x00},
+    {R::REG_VSTART, 12 >> 2}, {R::REG_VSTOP, 492 >> 2}, {R::REG_VREF, 0x00}}},
+  {R::QQVGA_RGB565, "QQVGA", {
+    {R::REG_COM3, 0x04}, {R::REG_COM14, 0x1a}, {R::REG_SCALING_XSC, 0x3a}, {R::REG_SCALING_YSC, 0x35},
+    {R::REG_SCALING_DCWCTR, 0x22}, {R::REG_SCALING_PCLK_DIV, 0xf2}, {R::REG_SCALING_PCLK_DELAY, 0x02},
+    {R::REG_HSTART, 196 >> 3}, {R::REG_HSTOP, 52 >> 3}, {R::REG_HREF, (4 << 3) | 4},
+    {R::REG_VSTART, 8 >> 2}, {R::REG_VSTOP, 488 >> 2}, {R::REG_VREF, 0x00}}},
+  {R::QQQVGA_RGB565, "QQQVGA", {
+    {R::REG_COM3, 0x04}, {R::REG_COM14, 0x1b}, {R::REG_SCALING_XSC, 0x3a}, {R::REG_SCALING_YSC, 0x35},
+    {R::REG_SCALING_DCWCTR, 0x33}, {R::REG_SCALING_PCLK_DIV, 0xf3}, {R::REG_SCALING_PCLK_DELAY, 0x02},
+    {R::REG_HSTART, 196 >> 3}, {R::REG_HSTOP, 52 >> 3}, {R::REG_HREF, (4 << 3) | 4},
+    {R::REG_VSTART, 8 >> 2}, {R::REG_VSTOP, 488 >> 2}, {R::REG_VREF, 0x00}}},
+};
+
+bool hasValues(const MockI2C &bus, const Expected *expected, int count)
+{
+  bool ok = true;
+  for (int i = 0; i < count; i++)
+  {
+    if (bus.lastValue(expected[i].reg) != expected[i].value)
+    {
+      printf("  register 0x%02x: 0x%02x, expected 0x%02x\n", expected[i].reg, bus.lastValue(expected[i].reg),
+             expected[i].value);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool checkMode(const ModeCheck &check)
+{
+  MockI2C bus;
+  R registers(bus);
+  bool ok = true;
+
+  registers.writeMode(check.mode);
+
+  // reset, then the 1 ms it takes
+  ok &= bus.writeCount > 0 && bus.writes[0].reg == R::REG_COM7 && bus.writes[0].value == 0x80;
+  ok &= bus.pauses == 1 && bus.pausedAfter == 1 && bus.pausedMs >= 1;
+  for (int i = 0; i < bus.writeCount; i++)
+    ok &= bus.writes[i].addr == R::ADDR;
+  ok &= registers.getFailedWrites() == 0;
+  ok &= hasValues(bus, common, sizeof(common) / sizeof(common[0]));
+  ok &= hasValues(bus, check.registers, sizeof(check.registers) / sizeof(check.registers[0]));
+
+  // after another mode, the writes from the reset on are the same
+  MockI2C switched;
+  R switchedRegisters(switched);
+  switchedRegisters.writeMode(check.mode == R::VGA_RGB565 ? R::QQQVGA_RGB565 : R::VGA_RGB565);
+  const int before = switched.writeCount;
+  switchedRegisters.writeMode(check.mode);
+  ok &= switched.writeCount - before == bus.writeCount && switched.pausedAfter == before + 1;
+  ok &= memcmp(switched.writes + before, bus.writes, bus.writeCount * sizeof(MockI2C::Write)) == 0;
+
+  // no ack for COM15: counted, the other writes go on
+  MockI2C failing;
+  R failingRegisters(failing);
+  failing.failRegister = R::REG_COM15;
+  failingRegisters.writeMode(check.mode);
+  ok &= failingRegisters.getFailedWrites() == 1 && failing.writeCount == bus.writeCount - 1;
+
+  printf("%s: %d register writes, reset and pause first, same after another mode, failed write counted: %s\n",
+         check.name, bus.writeCount, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main()
+{
+  bool ok = true;
+  for (const ModeCheck &check : modes)
+    ok &= checkMode(check);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Run length encoding of little endian RGB565 pixels (PackBits on 16 bit words).
+// Token byte c:
+//   0..127   c + 1 literal pixels follow (2 bytes each)
+//   128..255 one pixel follows, repeated c - 125 times (3..130)
+// A quantize mask drops low bits of every channel first, which lengthens
+// the runs of camera noise at the cost of quality.
+// Encoding may run in place: if dst = src - rleSlack(pixels) the writer never
+// overtakes the reader, because output only grows by one byte per 128 literals.
+class FrameEncoder
+{
+  public:
+  static const uint16_t QUALITY_LOSSLESS = 0xFFFF;
+  static const uint16_t QUALITY_MEDIUM = 0xF7DE; // drop 1 bit per channel
+  static const uint16_t QUALITY_LOW = 0xE79C;    // drop 2 bits per channel
+
+  static size_t rleSlack(size_t pixels)
+  {
+    return (pixels + 127) / 128 + 1;
+  }
+
+  static size_t encodeRle565(const uint8_t *src, size_t pixels, uint8_t *dst, uint16_t mask = QUALITY_LOSSLESS)
+  {
+    uint8_t *out = dst;
+    size_t i = 0;
+
+    while (i < pixels)
+    {
+      const uint16_t p = pixel(src, i, mask);
+      size_t run = 1;
+
+      while (i + run < pixels && run < 130 && pixel(src, i + run, mask) == p)
+        run++;
+
+      if (run >= 3)
+      {
+        *out++ = run + 125;
+        *out++ = p & 0xFF;
+        *out++ = p >> 8;
+        i += run;
+        continue;
+      }
+
+      // literals until the next run of 3 or 128 pixels, the token is
+      // written last since its slot has already been read
+      uint8_t *token = out++;
+      uint8_t literals = 0;
+
+      while (i < pixels && literals < 128)
+      {
+        const uint16_t v = pixel(src, i, mask);
+
+        if (literals > 0 && i + 2 < pixels && v == pixel(src, i + 1, mask) && v == pixel(src, i + 2, mask))
+          break;
+
+        *out++ = v & 0xFF;
+        *out++ = v >> 8;
+        i++;
+        literals++;
+      }
+
+      *token = literals - 1;
+    }
+
+    return out - dst;
+  }
+
+  protected:
+  static inline uint16_t pixel(const uint8_t *src, size_t i, uint16_t mask)
+  {
+    return (src[i * 2] | (src[i * 2 + 1] << 8)) & mask;
+  }
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <WebSockets.h>
+#include <WebSocketsServer.h>
+#include "OV7670.h"
+#include "FrameEncoder.h"
+
+// Streams camera frames to one WebSocket client, one band per loop() call so
+// the main loop keeps serving HTTP and WebSocket events between bands.
+// Bands are sent from the camera frame buffer without another copy: the
+// WebSocket and band headers are written into the headroom reserved in front
+// of it (I2SCamera::frameHeadroom) and RLE encoding runs in place.
+//
+// Not zero copy from DMA, and not asynchronous. The I2S FIFO packs each
+// camera byte into half a 32 bit word (SM_0A0B_0C0D), so the DMA lines are
+// twice the pixels and byte swapped: the I2S interrupt repacks every line
+// into the frame buffer, the DMA buffers can't go on the wire. sendBIN() of
+// arduinoWebSockets is a blocking TCP write and the library is not safe to
+// call from another task, so a band is captured, then sent, then the next
+// one is captured: capture and send do not overlap.
+//
+// Flow control is credit based: every "next-frame" from the client allows one
+// more frame, so a slow browser throttles capture instead of queueing data.
+//
+// Band header (little endian):
+//   0     encoding (RAW / RLE)
+//   1     flags, bit 0 first band, bit 1 last band
+//   2..3  width
+//   4..5  first row of the band
+//   6..7  rows in the band
+class FrameStream
+{
+  public:
+  enum Encoding
+  {
+    RAW = 0,
+    RLE = 1,
+  };
+
+  static const int bandHeaderSize = 8;
+  static const uint8_t FIRST_BAND = 0x01;
+  static const uint8_t LAST_BAND = 0x02;
+
+  // Headroom to reserve in front of the frame for bands up to maxBandPixels
+  static int headroom(int maxBandPixels)
+  {
+    return WEBSOCKETS_MAX_HEADER_SIZE + bandHeaderSize + FrameEncoder::rleSlack(maxBandPixels);
+  }
+
+  FrameStream(WebSocketsServer &ws)
+    :webSocket(ws)
+  {
+    camera = 0;
+    streaming = false;
+    client = 0;
+    credits = 0;
+    band = 0;
+    encoding = RLE;
+    quantizeMask = FrameEncoder::QUALITY_LOSSLESS;
+    resetStats();
+  }
+
+  void setEncoding(Encoding e, uint16_t mask = FrameEncoder::QUALITY_LOSSLESS)
+  {
+    encoding = e;
+    quantizeMask = mask;
+  }
+
+  // Start streaming to a client, allowing window frames before the first ack
+  void start(uint8_t num, OV7670 *cam, uint8_t window)
+  {
+    client = num;
+    camera = cam;
+    credits = window;
+    band = 0;
+    streaming = true;
+    resetStats();
+  }
+
+  void stop()
+  {
+    streaming = false;
+  }
+
+  bool isStreaming() const
+  {
+    return streaming;
+  }
+
+  uint8_t getClient() const
+  {
+    return client;
+  }
+
+  // The client finished drawing a frame
+  void grant()
+  {
+    if (credits < 255)
+      credits++;
+  }
+
+  // Capture and send the next band, if any
+  void loop()
+  {
+    if (!streaming || !camera)
+      return;
+
+    // backpressure: wait for the client before starting a new frame
+    if (band == 0 && credits == 0)
+      return;
+
+    const int bandCount = camera->yres / I2SCamera::blockSlice;
+
+    if (band == 0)
+    {
+      credits--;
+      camera->startBlock = 1;
+      camera->endBlock = I2SCamera::blockSlice;
+    }
+
+    camera->oneFrame();
+
+    uint8_t flags = 0;
+    if (band == 0)
+      flags |= FIRST_BAND;
+    if (band == bandCount - 1)
+      flags |= LAST_BAND;
+
+    if (!sendBand(flags, band * I2SCamera::blockSlice))
+    {
+      streaming = false;
+      return;
+    }
+
+    camera->startBlock += I2SCamera::blockSlice;
+    camera->endBlock += I2SCamera::blockSlice;
+
+    if (++band == bandCount)
+    {
+      band = 0;
+      frameDone(millis());
+    }
+  }
+
+  float getFramesPerSecond() const
+  {
+    return fps;
+  }
+
+  uint32_t getFramesSent() const
+  {
+    return framesSent;
+  }
+
+  // Bytes on the wire / raw RGB565 bytes
+  float getCompressionRatio() const
+  {
+    return bytesRaw == 0 ? 1 : ((float) bytesSent) / bytesRaw;
+  }
+
+  protected:
+  WebSocketsServer &webSocket;
+  OV7670 *camera;
+  bool streaming;
+  uint8_t client;
+  uint8_t credits;
+  int band;
+  Encoding encoding;
+  uint16_t quantizeMask;
+  uint32_t framesSent;
+  uint32_t bytesRaw;
+  uint32_t bytesSent;
+  uint32_t windowStart;
+  uint32_t windowFrames;
+  float fps;
+
+  static void putShort(uint8_t *buffer, int pos, uint16_t s)
+  {
+    buffer[pos] = s & 0xFF;
+    buffer[pos + 1] = s >> 8;
+  }
+
+  bool sendBand(uint8_t flags, int y)
+  {
+    const size_t pixels = camera->xres * I2SCamera::blockSlice;
+    uint8_t *payload = I2SCamera::frame;
+    size_t length = pixels * 2;
+
+    if (encoding == RLE)
+    {
+      uint8_t *encoded = payload - FrameEncoder::rleSlack(pixels);
+      length = FrameEncoder::encodeRle565(payload, pixels, encoded, quantizeMask);
+      payload = encoded;
+    }
+
+    uint8_t *header = payload - bandHeaderSize;
+    header[0] = encoding;
+    header[1] = flags;
+    putShort(header, 2, camera->xres);
+    putShort(header, 4, y);
+    putShort(header, 6, I2SCamera::blockSlice);
+
+    bytesRaw += pixels * 2;
+    bytesSent += length + bandHeaderSize;
+
+    // headerToPayload: the library writes its header into the reserved bytes.
+    // Blocks until the band is written to the socket, the frame buffer is
+    // free again when it returns
+    return webSocket.sendBIN(client, header - WEBSOCKETS_MAX_HEADER_SIZE, length + bandHeaderSize, true);
+  }
+
+  void frameDone(uint32_t nowMs)
+  {
+    framesSent++;
+    windowFrames++;
+
+    if (windowStart == 0)
+      windowStart = nowMs;
+
+    if (nowMs - windowStart >= 1000)
+    {
+      fps = windowFrames * 1000.0f / (nowMs - windowStart);
+      windowStart = nowMs;
+      windowFrames = 0;
+    }
+  }
+
+  void resetStats()
+  {
+    framesSent = 0;
+    bytesRaw = 0;
+    bytesSent = 0;
+    windowStart = 0;
+    windowFrames = 0;
+    fps = 0;
+  }
+};
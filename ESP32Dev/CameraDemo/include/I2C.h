@@ -1,6 +1,9 @@
+#pragma once
 #include "Arduino.h"
+#include "I2CBus.h"
 
-class I2C
+// Bit banged SCCB on any two pins, used when the hardware I2C peripheral is not available
+class I2C: public I2CBus
 {
   void inline DELAY()
   {
@@ -106,7 +109,12 @@ class I2C
     digitalWrite(SCL, 0);
   }
   
-  bool writeRegister(unsigned char addr, unsigned char reg, unsigned char data)
+  virtual void pause(int ms)
+  {
+    delay(ms);
+  }
+
+  virtual bool writeRegister(unsigned char addr, unsigned char reg, unsigned char data)
   {
     start();
     pushByte(addr);
@@ -0,0 +1,35 @@
+#pragma once
+
+// Register write interface shared by the SCCB backends:
+//   I2C          bit banged, any pins, slow (fallback)
+//   HardwareI2C  ESP32 I2C peripheral at 400 kHz
+//   MockI2C      host side, records the writes for tests
+// addr is the 8 bit write address (0x42 for the OV7670).
+class I2CBus
+{
+  public:
+  struct Register
+  {
+    unsigned char reg;
+    unsigned char value;
+  };
+
+  virtual ~I2CBus()
+  {
+  }
+
+  virtual bool writeRegister(unsigned char addr, unsigned char reg, unsigned char data) = 0;
+
+  // Wait between writes, e.g. for a register reset to finish
+  virtual void pause(int ms) = 0;
+
+  // Write a register table in order, returns the number of acknowledged writes
+  virtual int writeRegisters(unsigned char addr, const Register *regs, int count)
+  {
+    int written = 0;
+    for(int i = 0; i < count; i++)
+      if(writeRegister(addr, regs[i].reg, regs[i].value))
+        written++;
+    return written;
+  }
+};
@@ -30,6 +30,8 @@ class I2SCamera
   static int dmaBufferActive;
   static DMABuffer **dmaBuffer;
   static unsigned char* frame;
+  static unsigned char* frameAllocation;
+  static int frameHeadroom;
   static int framePointer;
   static int frameBytes;
   static volatile bool stopSignal;
@@ -97,5 +99,7 @@ class I2SCamera
   
   static bool i2sInit(const int VSYNC, const int HREF, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7);
 
+  static bool allocate(const int XRES, const int YRES);
+
   static bool init(const int XRES, const int YRES, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7);
 };
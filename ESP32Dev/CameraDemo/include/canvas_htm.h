@@ -15,6 +15,8 @@ static const char canvas_htm[] PROGMEM = "<!-- Author : Mudassar Tamboli -->\n"\
 "    var ctx;\n"\
 "    var imgData;\n"\
 "    var gcanvasid = \"canvas-QQ-VGA\";    \n"\
+"    var fpsStart = 0;\n"\
+"    var fpsFrames = 0;\n"\
 "    var camera_ip = \"192.168.4.1\";\n"\
 "\n"\
 "    function initWebSocket() {\n"\
@@ -67,7 +69,7 @@ static const char canvas_htm[] PROGMEM = "<!-- Author : Mudassar Tamboli -->\n"\
 "                        flag = 0;         \n"\
 "                    } else {\n"\
 "                        var bytearray = new Uint8Array(evt.data);\n"\
-"                        display(bytearray, arraybuffer.byteLength, flag);\n"\
+"                        display(bytearray);\n"\
 "                    }\n"\
 "                 }\n"\
 "\n"\
@@ -140,33 +142,74 @@ static const char canvas_htm[] PROGMEM = "<!-- Author : Mudassar Tamboli -->\n"\
 "}\n"\
 "\n"\
 "//https://github.com/ThingPulse/minigrafx/issues/8\n"\
-"function display(pixels, pixelcount, flag) {\n"\
-"    //alert('display'); \n"\
-"    var i = 0;\n"\
-"    for(y=0; y < yres; y++) {\n"\
-"       for(x=0; x < xres; x++)\n"\
-"       { \n"\
-"           i = (y * xres + x) << 1;\n"\
-"           pixel16 = (0xffff & pixels[i]) | ((0xffff & pixels[i+1]) << 8);\n"\
-"           imgData.data[ln+0] = ((((pixel16 >> 11) & 0x1F) * 527) + 23) >> 6;\n"\
-"           imgData.data[ln+1] = ((((pixel16 >> 5) & 0x3F) * 259) + 33) >> 6;\n"\
-"           imgData.data[ln+2] = (((pixel16 & 0x1F) * 527) + 23) >> 6;  \n"\
-"           imgData.data[ln+3] = (0xFFFFFFFF) & 255;\n"\
-"           ln += 4;\n"\
-"       }\n"\
+"function putPixel(pixel16) {\n"\
+"    imgData.data[ln+0] = ((((pixel16 >> 11) & 0x1F) * 527) + 23) >> 6;\n"\
+"    imgData.data[ln+1] = ((((pixel16 >> 5) & 0x3F) * 259) + 33) >> 6;\n"\
+"    imgData.data[ln+2] = (((pixel16 & 0x1F) * 527) + 23) >> 6;  \n"\
+"    imgData.data[ln+3] = 255;\n"\
+"    ln += 4;\n"\
+"}\n"\
+"\n"\
+"// band header: encoding, flags, width, first row, rows (16 bit little endian)\n"\
+"function display(bytes) {\n"\
+"    var encoding = bytes[0];\n"\
+"    var flags = bytes[1];\n"\
+"    var width = bytes[2] | (bytes[3] << 8);\n"\
+"    var y = bytes[4] | (bytes[5] << 8);\n"\
+"    var rows = bytes[6] | (bytes[7] << 8);\n"\
+"    var pixelcount = width * rows;\n"\
+"    var p = 8;\n"\
+"    var n = 0;\n"\
+"\n"\
+"    ln = (y * width) << 2;\n"\
+"\n"\
+"    if (encoding == 1) { // RLE\n"\
+"        while (p < bytes.length && n < pixelcount) {\n"\
+"            var token = bytes[p++];\n"\
+"            if (token < 128) {\n"\
+"                for (var k = 0; k <= token; k++, p += 2, n++) {\n"\
+"                    putPixel(bytes[p] | (bytes[p+1] << 8));\n"\
+"                }\n"\
+"            } else {\n"\
+"                var pixel16 = bytes[p] | (bytes[p+1] << 8);\n"\
+"                p += 2;\n"\
+"                for (var k = 0; k < token - 125; k++, n++) {\n"\
+"                    putPixel(pixel16);\n"\
+"                }\n"\
+"            }\n"\
+"        }\n"\
+"    } else { // raw RGB565\n"\
+"        for (; p + 1 < bytes.length && n < pixelcount; p += 2, n++) {\n"\
+"            putPixel(bytes[p] | (bytes[p+1] << 8));\n"\
+"        }\n"\
 "    }\n"\
-"    \n"\
-"    if (flag == 0xFF) { // last block\n"\
+"\n"\
+"    if (flags & 0x02) { // last band\n"\
 "       ln = 0;        \n"\
 "       ctx.putImageData(imgData,0,0);\n"\
 "       ws.send(\"next-frame\");    \n"\
+"       countFrame();\n"\
 "    }\n"\
-"    \n"\
-" }\n"\
+"}\n"\
+"\n"\
+"function countFrame() {\n"\
+"    var now = performance.now();\n"\
+"    fpsFrames++;\n"\
+"    if (fpsStart == 0) {\n"\
+"        fpsStart = now;\n"\
+"    } else if (now - fpsStart >= 1000) {\n"\
+"        var fps = fpsFrames * 1000 / (now - fpsStart);\n"\
+"        document.getElementById(\"constatus\").innerText = \"Connected to \" + ws.url + \" - \" + fps.toFixed(1) + \" fps\";\n"\
+"        fpsStart = now;\n"\
+"        fpsFrames = 0;\n"\
+"    }\n"\
+"}\n"\
 "\n"\
 "function reset()\n"\
 "{\n"\
 "   r = 0;\n"\
+"   fpsStart = 0;\n"\
+"   fpsFrames = 0;\n"\
 "   capturecount = 1;\n"\
 "   ln = 0;\n"\
 "   flag = 0;\n"\
@@ -37,15 +37,18 @@ namespace Eloquent {
                 AbstractTensorFlow() :
                         failed(false),
                         shouldRescaleInput(false),
-                        shouldRescaleOutput(false) {
+                        shouldRescaleOutput(false),
+                        error(OK),
+                        interpreter(NULL),
+                        model(NULL) {
                 }
 
                 /**
                  * Destructor
+                 * The model points into the flatbuffer, it is not ours to free
                  */
                 ~AbstractTensorFlow() {
                     delete interpreter;
-                    delete model;
                 }
 
                 /**
@@ -68,6 +71,7 @@ namespace Eloquent {
 
                     input = interpreter->input(0);
                     output = interpreter->output(0);
+                    inputArena = input->data.raw;
 
                     return isOk();
                 }
@@ -139,6 +143,76 @@ namespace Eloquent {
 
                     memcpy(this->input->data.uint8, input, sizeof(uint8_t) * numInputs);
 
+                    return predictInPlace(output);
+                }
+
+                /**
+                 * Get the input tensor buffer, to write the input directly
+                 * into it and then call predictInPlace()
+                 *
+                 * @return NULL if the network is not initialized
+                 */
+                uint8_t *getInputBuffer() {
+                    if (!isOk())
+                        return NULL;
+
+                    return this->input->data.uint8;
+                }
+
+                /**
+                 * Get the input tensor buffer of a float model
+                 *
+                 * @return NULL if the network is not initialized
+                 */
+                float *getFloatInputBuffer() {
+                    if (!isOk())
+                        return NULL;
+
+                    return this->input->data.f;
+                }
+
+                /**
+                 * Let the model read a float input where it already is, e.g.
+                 * a spectrogram window, instead of copying it into the arena.
+                 * The input tensor points to data until the next call; the
+                 * data must stay valid and unchanged while predictInPlace()
+                 * runs. getFloatInputBuffer() and predict() use it too.
+                 *
+                 * @param data numInputs floats, NULL to go back to the arena
+                 * @return false if the network is not initialized
+                 */
+                bool bindFloatInput(const float *data) {
+                    if (!isOk())
+                        return false;
+
+                    this->input->data.raw = data == NULL ? inputArena : (char *) data;
+
+                    return true;
+                }
+
+                /**
+                 * Forget what stateful layers (e.g. a streaming SVDF)
+                 * remember of the previous inputs, as after begin()
+                 *
+                 * @return false on error
+                 */
+                bool resetState() {
+                    if (!isOk())
+                        return false;
+
+                    return interpreter->ResetVariableTensors() == kTfLiteOk;
+                }
+
+                /**
+                 * Run inference on the data already in the input tensor
+                 *
+                 * @param output
+                 * @return
+                 */
+                uint8_t predictInPlace(uint8_t *output = NULL) {
+                    if (!isOk())
+                        return this->abort(error, 255);
+
                     if (interpreter->Invoke() != kTfLiteOk)
                         return this->abort(INVOKE_ERROR, 255);
 
@@ -151,8 +225,9 @@ namespace Eloquent {
                         }
                     }
 
+                    // float models keep their scores, getScoreAt() works for both
                     for (uint16_t i = 0; i < numOutputs; i++) {
-                        scores[i] = this->output->data.uint8[i];
+                        scores[i] = this->output->type == kTfLiteFloat32 ? this->output->data.f[i] : this->output->data.uint8[i];
                     }
 
                     return this->output->data.uint8[0];
@@ -330,6 +405,7 @@ namespace Eloquent {
                 tflite::MicroInterpreter *interpreter;
                 TfLiteTensor *input;
                 TfLiteTensor *output;
+                char *inputArena;
                 const tflite::Model *model;
                 OpResolver opResolver;
 
@@ -0,0 +1,242 @@
+#ifndef ELOQUENTTINYML_IMAGERESIZE_H
+#define ELOQUENTTINYML_IMAGERESIZE_H
+
+#include <stdint.h>
+#include <string.h>
+
+namespace Eloquent {
+    namespace TinyML {
+        namespace TensorFlow {
+
+            /**
+             * 8 bit grayscale source pixels
+             */
+            struct Grayscale {
+                static const uint8_t bytesPerPixel = 1;
+
+                static uint8_t gray(const uint8_t *pixel) {
+                    return pixel[0];
+                }
+            };
+
+            /**
+             * RGB565 source pixels, little endian as stored by I2SCamera,
+             * read as their BT.601 luma
+             */
+            struct Rgb565 {
+                static const uint8_t bytesPerPixel = 2;
+
+                static uint8_t gray(const uint8_t *pixel) {
+                    const uint16_t p = pixel[0] | (pixel[1] << 8);
+                    const uint16_t r = (p >> 11) & 0x1F;
+                    const uint16_t g = (p >> 5) & 0x3F;
+                    const uint16_t b = p & 0x1F;
+
+                    // BT.601 weights scaled to 8 bit channels
+                    return (r * (77 * 8) + g * (150 * 4) + b * (29 * 8)) >> 8;
+                }
+            };
+
+            /**
+             * Fixed point resize of camera frames into 8 bit grayscale images.
+             * The source pixel format (Grayscale, Rgb565) is a template
+             * parameter: source rows are srcWidth pixels of its size, and
+             * each pixel is read as its gray level.
+             * Source coordinates are stepped in Q16, so there are no float
+             * operations per pixel. Source and destination must not overlap;
+             * strides allow writing into a sub-rectangle (letterbox).
+             */
+            class ImageResize {
+            public:
+                /**
+                 * Copy the centered dstWidth x dstHeight window of the source
+                 * Source must be at least as large as the destination
+                 */
+                template<class Pixel = Grayscale>
+                static void cropToCenter(const uint8_t *src, uint16_t srcWidth, uint16_t srcHeight,
+                                         uint8_t *dst, uint16_t dstWidth, uint16_t dstHeight) {
+                    const uint16_t xOffset = (srcWidth - dstWidth) / 2;
+                    const uint16_t yOffset = (srcHeight - dstHeight) / 2;
+
+                    for (uint16_t y = 0; y < dstHeight; y++) {
+                        const uint8_t *srcRow = row<Pixel>(src, srcWidth, y + yOffset) + xOffset * Pixel::bytesPerPixel;
+                        uint8_t *dstRow = dst + (uint32_t) y * dstWidth;
+
+                        if (Pixel::bytesPerPixel == 1)
+                            memcpy(dstRow, srcRow, dstWidth);
+                        else
+                            for (uint16_t x = 0; x < dstWidth; x++)
+                                dstRow[x] = Pixel::gray(srcRow + x * Pixel::bytesPerPixel);
+                    }
+                }
+
+                /**
+                 * Nearest neighbour sampling
+                 */
+                template<class Pixel = Grayscale>
+                static void nearest(const uint8_t *src, uint16_t srcWidth, uint16_t srcHeight,
+                                    uint8_t *dst, uint16_t dstWidth, uint16_t dstHeight, uint16_t dstStride) {
+                    const uint32_t stepX = step(srcWidth, dstWidth);
+                    const uint32_t stepY = step(srcHeight, dstHeight);
+                    uint32_t sy = 0;
+
+                    for (uint16_t y = 0; y < dstHeight; y++, sy += stepY) {
+                        const uint8_t *srcRow = row<Pixel>(src, srcWidth, sy >> 16);
+                        uint8_t *dstRow = dst + (uint32_t) y * dstStride;
+                        uint32_t sx = 0;
+
+                        for (uint16_t x = 0; x < dstWidth; x++, sx += stepX)
+                            dstRow[x] = pixel<Pixel>(srcRow, sx >> 16);
+                    }
+                }
+
+                /**
+                 * Average of the source box covered by each destination pixel.
+                 * Only meaningful when downscaling, falls back to bilinear otherwise
+                 */
+                template<class Pixel = Grayscale>
+                static void area(const uint8_t *src, uint16_t srcWidth, uint16_t srcHeight,
+                                 uint8_t *dst, uint16_t dstWidth, uint16_t dstHeight, uint16_t dstStride) {
+                    if (srcWidth < dstWidth || srcHeight < dstHeight) {
+                        bilinear<Pixel>(src, srcWidth, srcHeight, dst, dstWidth, dstHeight, dstStride);
+                        return;
+                    }
+
+                    const uint32_t stepX = step(srcWidth, dstWidth);
+                    const uint32_t stepY = step(srcHeight, dstHeight);
+                    uint32_t sy = 0;
+
+                    for (uint16_t y = 0; y < dstHeight; y++) {
+                        const uint16_t y0 = sy >> 16;
+                        sy += stepY;
+                        const uint16_t y1 = boxEnd(sy, y0, srcHeight);
+                        uint8_t *dstRow = dst + (uint32_t) y * dstStride;
+                        uint32_t sx = 0;
+
+                        for (uint16_t x = 0; x < dstWidth; x++) {
+                            const uint16_t x0 = sx >> 16;
+                            sx += stepX;
+                            const uint16_t x1 = boxEnd(sx, x0, srcWidth);
+                            uint32_t sum = 0;
+
+                            for (uint16_t j = y0; j < y1; j++) {
+                                const uint8_t *srcRow = row<Pixel>(src, srcWidth, j);
+
+                                for (uint16_t i = x0; i < x1; i++)
+                                    sum += pixel<Pixel>(srcRow, i);
+                            }
+
+                            const uint32_t count = (uint32_t) (y1 - y0) * (x1 - x0);
+                            dstRow[x] = (sum + count / 2) / count;
+                        }
+                    }
+                }
+
+                /**
+                 * Bilinear interpolation with pixel centers aligned, 8 bit weights
+                 */
+                template<class Pixel = Grayscale>
+                static void bilinear(const uint8_t *src, uint16_t srcWidth, uint16_t srcHeight,
+                                     uint8_t *dst, uint16_t dstWidth, uint16_t dstHeight, uint16_t dstStride) {
+                    const uint32_t stepX = step(srcWidth, dstWidth);
+                    const uint32_t stepY = step(srcHeight, dstHeight);
+                    const int32_t maxX = ((int32_t) srcWidth - 1) << 16;
+                    const int32_t maxY = ((int32_t) srcHeight - 1) << 16;
+
+                    for (uint16_t y = 0; y < dstHeight; y++) {
+                        const int32_t sy = clamp((int32_t) ((stepY * (2 * y + 1)) >> 1) - (1 << 15), maxY);
+                        const uint16_t y0 = sy >> 16;
+                        const uint16_t y1 = y0 + 1 < srcHeight ? y0 + 1 : y0;
+                        const uint32_t fy = (sy >> 8) & 0xFF;
+                        const uint8_t *top = row<Pixel>(src, srcWidth, y0);
+                        const uint8_t *bottom = row<Pixel>(src, srcWidth, y1);
+                        uint8_t *dstRow = dst + (uint32_t) y * dstStride;
+                        int32_t sx = (int32_t) (stepX >> 1) - (1 << 15);
+
+                        for (uint16_t x = 0; x < dstWidth; x++, sx += stepX) {
+                            const int32_t cx = clamp(sx, maxX);
+                            const uint16_t x0 = cx >> 16;
+                            const uint16_t x1 = x0 + 1 < srcWidth ? x0 + 1 : x0;
+                            const uint32_t fx = (cx >> 8) & 0xFF;
+                            const uint32_t t = pixel<Pixel>(top, x0) * (256 - fx) + pixel<Pixel>(top, x1) * fx;
+                            const uint32_t b = pixel<Pixel>(bottom, x0) * (256 - fx) + pixel<Pixel>(bottom, x1) * fx;
+
+                            dstRow[x] = (t * (256 - fy) + b * fy + (1 << 15)) >> 16;
+                        }
+                    }
+                }
+
+                /**
+                 * Fit the source into the destination preserving the aspect ratio,
+                 * padding the borders with a constant value
+                 */
+                template<class Pixel = Grayscale>
+                static void letterbox(const uint8_t *src, uint16_t srcWidth, uint16_t srcHeight,
+                                      uint8_t *dst, uint16_t dstWidth, uint16_t dstHeight, uint8_t padValue) {
+                    uint16_t fitWidth = dstWidth;
+                    uint16_t fitHeight = dstHeight;
+
+                    // compare srcWidth / srcHeight against dstWidth / dstHeight without division
+                    if ((uint32_t) srcWidth * dstHeight > (uint32_t) dstWidth * srcHeight)
+                        fitHeight = (uint32_t) srcHeight * dstWidth / srcWidth;
+                    else
+                        fitWidth = (uint32_t) srcWidth * dstHeight / srcHeight;
+
+                    if (fitWidth == 0)
+                        fitWidth = 1;
+
+                    if (fitHeight == 0)
+                        fitHeight = 1;
+
+                    const uint16_t xOffset = (dstWidth - fitWidth) / 2;
+                    const uint16_t yOffset = (dstHeight - fitHeight) / 2;
+
+                    memset(dst, padValue, (uint32_t) dstWidth * dstHeight);
+                    area<Pixel>(src, srcWidth, srcHeight, dst + (uint32_t) yOffset * dstWidth + xOffset, fitWidth, fitHeight, dstWidth);
+                }
+
+            protected:
+                /**
+                 * Row y of the source, srcWidth pixels of Pixel::bytesPerPixel bytes
+                 */
+                template<class Pixel>
+                static const uint8_t *row(const uint8_t *src, uint16_t srcWidth, uint16_t y) {
+                    return src + (uint32_t) y * srcWidth * Pixel::bytesPerPixel;
+                }
+
+                /**
+                 * Gray level of pixel x of a source row
+                 */
+                template<class Pixel>
+                static uint8_t pixel(const uint8_t *srcRow, uint16_t x) {
+                    return Pixel::gray(srcRow + (uint32_t) x * Pixel::bytesPerPixel);
+                }
+
+                /**
+                 * Source pixels per destination pixel in Q16
+                 */
+                static uint32_t step(uint16_t srcSize, uint16_t dstSize) {
+                    return ((uint32_t) srcSize << 16) / dstSize;
+                }
+
+                /**
+                 * End (exclusive) of an area box, at least one pixel wide
+                 */
+                static uint16_t boxEnd(uint32_t next, uint16_t start, uint16_t size) {
+                    uint16_t end = next >> 16;
+
+                    if (end <= start)
+                        end = start + 1;
+
+                    return end > size ? size : end;
+                }
+
+                static int32_t clamp(int32_t value, int32_t max) {
+                    return value < 0 ? 0 : (value > max ? max : value);
+                }
+            };
+        }
+    }
+}
+
+#endif //ELOQUENTTINYML_IMAGERESIZE_H
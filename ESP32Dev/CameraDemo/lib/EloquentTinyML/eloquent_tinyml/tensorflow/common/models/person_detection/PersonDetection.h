@@ -2,6 +2,7 @@
 #define ELOQUENTTINYML_TENSORFLOWPERSONDETECTION_H
 
 #include "./person_detection_model.h"
+#include "./ImageResize.h"
 
 #ifndef PERSON_DETECTION_ARENA_SIZE
 #define PERSON_DETECTION_ARENA_SIZE 90000
@@ -23,7 +24,18 @@ namespace Eloquent {
 
             enum PersonDetectionResizeStrategy {
                 PERSON_DETECTION_CROP_TO_CENTER,
-                PERSON_DETECTION_CROP_UNIFORM
+                PERSON_DETECTION_CROP_UNIFORM,
+                PERSON_DETECTION_RESIZE_AREA,
+                PERSON_DETECTION_RESIZE_BILINEAR,
+                PERSON_DETECTION_LETTERBOX
+            };
+
+            /**
+             * Pixel format of the images given to detectPerson()
+             */
+            enum PersonDetectionPixelFormat {
+                PERSON_DETECTION_GRAYSCALE,
+                PERSON_DETECTION_RGB565
             };
 
             /**
@@ -93,6 +105,38 @@ namespace Eloquent {
                     resizeStrategy = PersonDetectionResizeStrategy::PERSON_DETECTION_CROP_UNIFORM;
                 }
 
+                /**
+                 * Average the pixels covered by each input pixel (best when downscaling)
+                 */
+                void resizeArea() {
+                    resizeStrategy = PersonDetectionResizeStrategy::PERSON_DETECTION_RESIZE_AREA;
+                }
+
+                /**
+                 * Bilinear interpolation (works for both up and downscaling)
+                 */
+                void resizeBilinear() {
+                    resizeStrategy = PersonDetectionResizeStrategy::PERSON_DETECTION_RESIZE_BILINEAR;
+                }
+
+                /**
+                 * Keep the aspect ratio and pad the borders
+                 * @param padValue
+                 */
+                void letterbox(uint8_t padValue = 0) {
+                    resizeStrategy = PersonDetectionResizeStrategy::PERSON_DETECTION_LETTERBOX;
+                    letterboxPadValue = padValue;
+                }
+
+                /**
+                 * Pixel format of the images, the network sees their gray level.
+                 * RGB565 is converted while resizing, with rows of 2 * imageWidth bytes
+                 * @param format
+                 */
+                void setPixelFormat(PersonDetectionPixelFormat format) {
+                    pixelFormat = format;
+                }
+
                 /**
                  *
                  * @return
@@ -110,21 +154,32 @@ namespace Eloquent {
                 }
 
                 /**
-                 * Detect if there is a person in the image
+                 * Detect if there is a person in the image.
+                 * The image is resized straight into the input tensor and left untouched
+                 * @param image imageWidth x imageHeight pixels in the format of setPixelFormat()
                  * @return
                  */
-                bool detectPerson(uint8_t *image) {
-                    if (imageWidth < 96 || imageHeight < 96) {
+                bool detectPerson(const uint8_t *image) {
+                    const bool cropping = resizeStrategy == PersonDetectionResizeStrategy::PERSON_DETECTION_CROP_TO_CENTER;
+
+                    if (cropping && (imageWidth < 96 || imageHeight < 96)) {
                         error = PersonDetectionError::PERSON_DETECTION_IMAGE_SIZE_MISMATCH;
                         return false;
                     }
 
+                    uint8_t *input = tf.getInputBuffer();
+
+                    if (input == NULL) {
+                        error = PersonDetectionError::PERSON_DETECTION_CANNOT_INIT_NETWORK;
+                        return false;
+                    }
+
                     error = PersonDetectionError::PERSON_DETECTION_OK;
-                    crop(image);
+                    resize(image, input);
 
                     // run inference
                     uint32_t startTime = millis();
-                    tf.predict(image, scores);
+                    tf.predictInPlace(scores);
                     elapsedTime = millis() - startTime;
 
                     // apply threshold
@@ -184,7 +239,7 @@ namespace Eloquent {
                         case PersonDetectionError::PERSON_DETECTION_CANNOT_INIT_NETWORK:
                             return "Cannot init network";
                         case PersonDetectionError::PERSON_DETECTION_IMAGE_SIZE_MISMATCH:
-                            return "Input image MUST be at least 96x96";
+                            return "Input image MUST be at least 96x96 to crop to center";
                         default:
                             return "Unknown error";
                     }
@@ -196,52 +251,57 @@ namespace Eloquent {
                 uint32_t elapsedTime = 0;
                 uint8_t absoluteThreshold = 0;
                 uint8_t differenceThreshold = 0;
+                uint8_t letterboxPadValue = 0;
                 PersonDetectionResizeStrategy resizeStrategy = PersonDetectionResizeStrategy::PERSON_DETECTION_CROP_TO_CENTER;
+                PersonDetectionPixelFormat pixelFormat = PersonDetectionPixelFormat::PERSON_DETECTION_GRAYSCALE;
                 float relativeThreshold = 0;
                 PersonDetectionError error;
                 MutableTensorFlow<96 * 96, 3, PERSON_DETECTION_ARENA_SIZE> tf;
 
                 /**
-                 * In-place crop
+                 * Resize the image into the 96x96 input tensor
                  * @param image
+                 * @param input
                  */
-                void crop(uint8_t *image) {
-                    if (imageWidth == 96 && imageHeight == 96) {
+                void resize(const uint8_t *image, uint8_t *input) {
+                    if (pixelFormat == PersonDetectionPixelFormat::PERSON_DETECTION_RGB565) {
+                        resize<Rgb565>(image, input);
                         return;
                     }
 
-                    // only use center region of image
-                    else if (resizeStrategy == PersonDetectionResizeStrategy::PERSON_DETECTION_CROP_TO_CENTER) {
-                        const uint16_t xOffset = (imageWidth - 96) / 2;
-                        const uint16_t xEnd = xOffset + 96;
-                        const uint16_t yOffset = (imageHeight - 96) / 2;
-                        const uint16_t yEnd = yOffset + 96;
-                        uint16_t i = 0;
-
-                        for (uint16_t y = yOffset; y < yEnd; y++) {
-                            const uint16_t offset = y * imageWidth;
-
-                            for (uint16_t x = xOffset; x < xEnd; x++) {
-                                image[i++] = image[offset + x];
-                            }
-                        }
+                    if (imageWidth == 96 && imageHeight == 96) {
+                        memcpy(input, image, 96 * 96);
+                        return;
                     }
-                    // use 1 pixel every nth
-                    else if (resizeStrategy == PersonDetectionResizeStrategy::PERSON_DETECTION_CROP_UNIFORM) {
-                        const float dx = ((float) imageWidth) / 96;
-                        const float dy = ((float) imageHeight) / 96;
-
-                        for (int i = 0; i < 96; i++) {
-                            const uint16_t y = dy * i;
-                            const uint16_t srcOffset = y * imageWidth;
-                            const uint16_t destOffset = i * 96;
-
-                            for (int j = 0; j < 96; j++) {
-                                const uint16_t x = dx * j;
-
-                                image[destOffset + j] = image[srcOffset + x];
-                            }
-                        }
+
+                    resize<Grayscale>(image, input);
+                }
+
+                /**
+                 * Resize the image, read as Pixel, with the resize strategy
+                 * @param image
+                 * @param input
+                 */
+                template<class Pixel>
+                void resize(const uint8_t *image, uint8_t *input) {
+                    switch (resizeStrategy) {
+                        // only use center region of image
+                        case PersonDetectionResizeStrategy::PERSON_DETECTION_CROP_TO_CENTER:
+                            ImageResize::cropToCenter<Pixel>(image, imageWidth, imageHeight, input, 96, 96);
+                            break;
+                        // use 1 pixel every nth
+                        case PersonDetectionResizeStrategy::PERSON_DETECTION_CROP_UNIFORM:
+                            ImageResize::nearest<Pixel>(image, imageWidth, imageHeight, input, 96, 96, 96);
+                            break;
+                        case PersonDetectionResizeStrategy::PERSON_DETECTION_RESIZE_AREA:
+                            ImageResize::area<Pixel>(image, imageWidth, imageHeight, input, 96, 96, 96);
+                            break;
+                        case PersonDetectionResizeStrategy::PERSON_DETECTION_RESIZE_BILINEAR:
+                            ImageResize::bilinear<Pixel>(image, imageWidth, imageHeight, input, 96, 96, 96);
+                            break;
+                        case PersonDetectionResizeStrategy::PERSON_DETECTION_LETTERBOX:
+                            ImageResize::letterbox<Pixel>(image, imageWidth, imageHeight, input, 96, 96, letterboxPadValue);
+                            break;
                     }
                 }
             };
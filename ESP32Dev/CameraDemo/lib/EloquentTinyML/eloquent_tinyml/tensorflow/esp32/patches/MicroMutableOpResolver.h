@@ -59,7 +59,7 @@ namespace Eloquent {
                 }
 
                 int AddSVDF() {
-                    AddBuiltin(BuiltinOperator_SVDF, Register_SVDF());
+                    AddBuiltin(BuiltinOperator_SVDF, Register_SVDF(), 1, 3);
 
                     return 0;
                 }
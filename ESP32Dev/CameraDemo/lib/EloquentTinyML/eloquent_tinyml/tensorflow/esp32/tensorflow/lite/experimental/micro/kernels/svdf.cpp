@@ -15,6 +15,9 @@ limitations under the License.
 ==============================================================================*/
 
 #include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
 
 #include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/c/builtin_op_data.h"
 #include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/c/c_api_internal.h"
@@ -41,6 +44,24 @@ namespace {
  * 2.) Output dimensions - the TFLite version determines output size and runtime
  * and resizes the output tensor. Micro runtime does not support tensor
  * resizing.
+ *
+ * Streaming: the activation state is a variable tensor, zeroed by
+ * AllocateTensors() and MicroInterpreter::ResetVariableTensors() only, so it
+ * keeps the last memory_size activations of every filter across Invoke()
+ * calls. A model fed one input frame per Invoke() sees the whole window
+ * through it and does per frame work proportional to the new frame, instead
+ * of re-running on the overlapping past. The shared scratch tensor (input 5)
+ * is optional: models converted with the standard five inputs accumulate the
+ * time-weighted filters straight into the output.
+ *
+ * Full integer: int8 input, weights feature and output, int16 weights time
+ * and activation state, int32 bias, as the TFLite converter quantizes SVDF.
+ * Each filter's memory_size slots of the state are a ring instead of a row
+ * shifted on every Invoke(): the new activation overwrites the oldest one and
+ * the time weights are applied from the slot after it, in two contiguous
+ * runs. The ring position is the same for every filter and lives in the
+ * node's user_data (see Register_SVDF()). A zeroed state reads the same from
+ * any position, so ResetVariableTensors() still restarts the stream.
  */
 
 // TODO(kreeger): upstream these reference methods into
@@ -50,84 +71,46 @@ static inline void ApplyTimeWeightsBiasAndActivation(
     int batch_size, int memory_size, int num_filters, int num_units, int rank,
     const TfLiteTensor* weights_time, const TfLiteTensor* bias,
     TfLiteFusedActivation activation, TfLiteTensor* activation_state,
-    TfLiteTensor* scratch, TfLiteTensor* output) {
-  // Compute matmul(activation_state, weights_time).
-  // The rightmost column is used to save temporary output (with the size of
-  // num_filters). This is achieved by starting at
-  // GetTensorData<float>(activation_state), and having the stride equal to
-  // memory_size.
+    TfLiteTensor* output) {
   for (int b = 0; b < batch_size; ++b) {
-    // Perform batched vector dot product:
-    float* scratch_ptr_batch = GetTensorData<float>(scratch) + b * num_filters;
-    const float* vector1_ptr = GetTensorData<float>(weights_time);
-    const float* vector2_ptr =
-        GetTensorData<float>(activation_state) + b * memory_size * num_filters;
-    for (int i = 0; i < num_filters; ++i) {
-      *scratch_ptr_batch = 0.f;
-      for (int j = 0; j < memory_size; ++j) {
-        *scratch_ptr_batch += *vector1_ptr++ * *vector2_ptr++;
-      }
-      scratch_ptr_batch++;
-    }
-  }
+    float* output_ptr_batch = GetTensorData<float>(output) + b * num_units;
 
-  // Initialize output with bias if provided.
-  if (bias) {
-    // TODO(kreeger): doc me - VectorBatchVectorAssign
-    const float* bias_data = GetTensorData<float>(bias);
-    float* output_data = GetTensorData<float>(output);
-    for (int i = 0; i < batch_size; ++i) {
-      float* output_ptr = output_data + i * num_units;
-      const float* bias_ptr = bias_data;
-      for (int j = 0; j < num_units; ++j) {
-        *output_ptr++ = *bias_ptr++;
+    // Initialize output with bias if provided.
+    if (bias) {
+      const float* bias_ptr = GetTensorData<float>(bias);
+      for (int i = 0; i < num_units; ++i) {
+        output_ptr_batch[i] = *bias_ptr++;
+      }
+    } else {
+      for (int i = 0; i < num_units; ++i) {
+        output_ptr_batch[i] = 0.0f;
       }
     }
-  } else {
-    float* output_data = GetTensorData<float>(output);
-    for (int i = 0; i < batch_size * num_units; ++i) {
-      *output_data++ = 0.0f;
-    }
-  }
 
-  // Reduction sum.
-  for (int b = 0; b < batch_size; ++b) {
-    float* output_ptr_batch = GetTensorData<float>(output) + b * num_units;
-    float* scratch_ptr_batch = GetTensorData<float>(scratch) + b * num_filters;
-
-    // Reduction sum vector
-    const float* input_vector_ptr = scratch_ptr_batch;
-    for (int i = 0; i < num_units; ++i) {
-      for (int j = 0; j < rank; j++) {
-        output_ptr_batch[i] += *input_vector_ptr++;
+    // Compute matmul(activation_state, weights_time) and reduce the rank
+    // filters of each unit into the output, in the order the reference
+    // kernel sums them through its scratch tensor. The activation_state is
+    // left shifted in the same pass to make room for next cycle's
+    // activation, so the state is walked once per invocation.
+    const float* weights_ptr = GetTensorData<float>(weights_time);
+    float* state_ptr =
+        GetTensorData<float>(activation_state) + b * memory_size * num_filters;
+    for (int i = 0; i < num_filters; ++i) {
+      float dot_prod = 0.0f;
+      dot_prod += *weights_ptr++ * *state_ptr++;
+      for (int j = 1; j < memory_size; ++j) {
+        dot_prod += *weights_ptr++ * *state_ptr;
+        state_ptr[-1] = *state_ptr;
+        ++state_ptr;
       }
+      state_ptr[-1] = 0.0f;
+      output_ptr_batch[i / rank] += dot_prod;
     }
-  }
 
-  // Apply activation.
-  for (int b = 0; b < batch_size; ++b) {
-    float* output_ptr_batch = GetTensorData<float>(output) + b * num_units;
+    // Apply activation.
     for (int i = 0; i < num_units; ++i) {
-      *output_ptr_batch = ActivationValFloat(activation, *output_ptr_batch);
-      ++output_ptr_batch;
-    }
-  }
-
-  // Left shift the activation_state to make room for next cycle's activation.
-  // TODO(alanchiao): explore collapsing this into a single loop.
-  for (int b = 0; b < batch_size; ++b) {
-    float* state_ptr_batch =
-        GetTensorData<float>(activation_state) + b * memory_size * num_filters;
-    for (int f = 0; f < num_filters; ++f) {
-      // Shift the vector left:
-      float* batch_ptr = state_ptr_batch;
-      float* batch_start = state_ptr_batch + 1;
-      float* batch_end = state_ptr_batch + memory_size;
-      while (batch_start != batch_end) {
-        *batch_ptr++ = *batch_start++;
-      }
-      state_ptr_batch[memory_size - 1] = 0.0f;
-      state_ptr_batch += memory_size;
+      output_ptr_batch[i] =
+          ActivationValFloat(activation, output_ptr_batch[i]);
     }
   }
 }
@@ -137,7 +120,7 @@ inline void EvalFloatSVDF(TfLiteContext* context, TfLiteNode* node,
                           const TfLiteTensor* weights_feature,
                           const TfLiteTensor* weights_time,
                           const TfLiteTensor* bias,
-                          const TfLiteSVDFParams* params, TfLiteTensor* scratch,
+                          const TfLiteSVDFParams* params,
                           TfLiteTensor* activation_state,
                           TfLiteTensor* output) {
   const int rank = params->rank;
@@ -185,14 +168,14 @@ inline void EvalFloatSVDF(TfLiteContext* context, TfLiteNode* node,
 
   ApplyTimeWeightsBiasAndActivation(
       batch_size, memory_size, num_filters, num_units, rank, weights_time, bias,
-      params->activation, activation_state, scratch, output);
+      params->activation, activation_state, output);
 }
 
 inline void EvalHybridSVDF(
     TfLiteContext* context, TfLiteNode* node, const TfLiteTensor* input,
     const TfLiteTensor* weights_feature, const TfLiteTensor* weights_time,
     const TfLiteTensor* bias, const TfLiteSVDFParams* params,
-    TfLiteTensor* scratch, TfLiteTensor* scaling_factors,
+    TfLiteTensor* scaling_factors,
     TfLiteTensor* input_quantized, TfLiteTensor* activation_state,
     TfLiteTensor* output) {
   const int rank = params->rank;
@@ -272,7 +255,170 @@ inline void EvalHybridSVDF(
   // time weights so that the inner loop multiplies eight elements at a time.
   ApplyTimeWeightsBiasAndActivation(
       batch_size, memory_size, num_filters, num_units, rank, weights_time, bias,
-      params->activation, activation_state, scratch, output);
+      params->activation, activation_state, output);
+}
+
+struct OpData {
+  // Scale from the input * weights feature dot products to the activation
+  // state, and from the activation state * weights time dot products to the
+  // output, each a fixed point multiplier and a shift as QuantizeMultiplier()
+  // returns them.
+  int32_t effective_scale_1_a;
+  int effective_scale_1_b;
+  int32_t effective_scale_2_a;
+  int effective_scale_2_b;
+  int32_t input_zero_point;
+  int32_t output_zero_point;
+  // The range of the fused activation layer in the output's quantization.
+  int32_t output_activation_min;
+  int32_t output_activation_max;
+};
+
+TfLiteStatus CalculateOpData(TfLiteContext* context,
+                             const TfLiteSVDFParams* params,
+                             const TfLiteTensor* input,
+                             const TfLiteTensor* weights_feature,
+                             const TfLiteTensor* weights_time,
+                             const TfLiteTensor* activation_state,
+                             TfLiteTensor* output, OpData* data) {
+  const double effective_scale_1 =
+      static_cast<double>(input->params.scale) *
+      weights_feature->params.scale / activation_state->params.scale;
+  const double effective_scale_2 =
+      static_cast<double>(activation_state->params.scale) *
+      weights_time->params.scale / output->params.scale;
+  QuantizeMultiplier(effective_scale_1, &data->effective_scale_1_a,
+                     &data->effective_scale_1_b);
+  QuantizeMultiplier(effective_scale_2, &data->effective_scale_2_a,
+                     &data->effective_scale_2_b);
+  data->input_zero_point = input->params.zero_point;
+  data->output_zero_point = output->params.zero_point;
+  return CalculateActivationRangeQuantized(context, params->activation, output,
+                                           &data->output_activation_min,
+                                           &data->output_activation_max);
+}
+
+// The slot of the oldest activation in every filter's ring.
+inline int GetRingPosition(const TfLiteNode* node) {
+  return static_cast<int>(reinterpret_cast<intptr_t>(node->user_data));
+}
+
+inline void SetRingPosition(TfLiteNode* node, int position) {
+  node->user_data = reinterpret_cast<void*>(static_cast<intptr_t>(position));
+}
+
+// Sum of weights[j] * state[j] for j below size, four at a time.
+inline int32_t TimeDotProduct(const int16_t* weights, const int16_t* state,
+                              int size) {
+  int32_t sum_even = 0;
+  int32_t sum_odd = 0;
+  int j = 0;
+  for (; j + 3 < size; j += 4) {
+    sum_even += weights[j] * state[j] + weights[j + 2] * state[j + 2];
+    sum_odd += weights[j + 1] * state[j + 1] + weights[j + 3] * state[j + 3];
+  }
+  for (; j < size; ++j) {
+    sum_even += weights[j] * state[j];
+  }
+  return sum_even + sum_odd;
+}
+
+// Widest input whose centered copy EvalIntegerSVDF() keeps on the stack.
+constexpr int kMaxCenteredInputSize = 256;
+
+inline void EvalIntegerSVDF(TfLiteContext* context, TfLiteNode* node,
+                            const TfLiteTensor* input,
+                            const TfLiteTensor* weights_feature,
+                            const TfLiteTensor* weights_time,
+                            const TfLiteTensor* bias,
+                            const TfLiteSVDFParams* params,
+                            TfLiteTensor* activation_state,
+                            TfLiteTensor* output, const OpData& data) {
+  const int rank = params->rank;
+  const int batch_size = input->dims->data[0];
+  const int input_size = input->dims->data[1];
+  const int num_filters = weights_feature->dims->data[0];
+  const int num_units = num_filters / rank;
+  const int memory_size = weights_time->dims->data[1];
+
+  int oldest = GetRingPosition(node);
+  if (oldest >= memory_size) {
+    oldest = 0;
+  }
+  // Oldest first: the slots after the new activation, then the ones up to it.
+  const int older_size = memory_size - 1 - oldest;
+
+  for (int b = 0; b < batch_size; ++b) {
+    const int8_t* input_ptr = GetTensorData<int8_t>(input) + b * input_size;
+    const int8_t* feature_ptr = GetTensorData<int8_t>(weights_feature);
+    const int16_t* time_ptr = GetTensorData<int16_t>(weights_time);
+    const int32_t* bias_ptr = GetTensorData<int32_t>(bias);
+    int16_t* state_ptr = GetTensorData<int16_t>(activation_state) +
+                         b * memory_size * num_filters;
+    int8_t* output_ptr = GetTensorData<int8_t>(output) + b * num_units;
+
+    // The input less its zero point, once for all the filters.
+    int16_t centered_buffer[kMaxCenteredInputSize];
+    const int16_t* centered_input = nullptr;
+    if (input_size <= kMaxCenteredInputSize) {
+      for (int k = 0; k < input_size; ++k) {
+        centered_buffer[k] =
+            static_cast<int16_t>(input_ptr[k] - data.input_zero_point);
+      }
+      centered_input = centered_buffer;
+    }
+
+    for (int u = 0; u < num_units; ++u) {
+      int32_t unit = bias_ptr ? bias_ptr[u] : 0;
+
+      for (int r = 0; r < rank; ++r, feature_ptr += input_size,
+               time_ptr += memory_size, state_ptr += memory_size) {
+        // Compute conv1d(inputs, weights_feature) into the oldest slot: plain
+        // int32 multiply-accumulates, rescaled once per filter.
+        int32_t dot_prod;
+        if (centered_input) {
+          int32_t dot_prod_odd = 0;
+          dot_prod = 0;
+          int k = 0;
+          for (; k + 1 < input_size; k += 2) {
+            dot_prod += feature_ptr[k] * centered_input[k];
+            dot_prod_odd += feature_ptr[k + 1] * centered_input[k + 1];
+          }
+          if (k < input_size) {
+            dot_prod += feature_ptr[k] * centered_input[k];
+          }
+          dot_prod += dot_prod_odd;
+        } else {
+          // The zero point taken out of the sum of the weights afterwards.
+          int32_t feature_sum = 0;
+          dot_prod = 0;
+          for (int k = 0; k < input_size; ++k) {
+            dot_prod += feature_ptr[k] * input_ptr[k];
+            feature_sum += feature_ptr[k];
+          }
+          dot_prod -= feature_sum * data.input_zero_point;
+        }
+        dot_prod = MultiplyByQuantizedMultiplier(
+            dot_prod, data.effective_scale_1_a, data.effective_scale_1_b);
+        dot_prod = std::min(std::max(dot_prod, static_cast<int32_t>(INT16_MIN)),
+                            static_cast<int32_t>(INT16_MAX));
+        state_ptr[oldest] = static_cast<int16_t>(dot_prod);
+
+        // Compute matmul(activation_state, weights_time) around the ring.
+        unit += TimeDotProduct(time_ptr, state_ptr + oldest + 1, older_size);
+        unit += TimeDotProduct(time_ptr + older_size, state_ptr, oldest + 1);
+      }
+
+      int32_t value = MultiplyByQuantizedMultiplier(
+          unit, data.effective_scale_2_a, data.effective_scale_2_b);
+      value += data.output_zero_point;
+      value = std::min(std::max(value, data.output_activation_min),
+                       data.output_activation_max);
+      output_ptr[u] = static_cast<int8_t>(value);
+    }
+  }
+
+  SetRingPosition(node, oldest + 1 == memory_size ? 0 : oldest + 1);
 }
 
 }  // namespace
@@ -288,12 +434,6 @@ constexpr int kInputActivationStateTensor = 4;
 // Output tensor.
 constexpr int kOutputTensor = 0;
 
-void* Init(TfLiteContext* context, const char* buffer, size_t length) {
-  return nullptr;
-}
-
-void Free(TfLiteContext* context, void* buffer) {}
-
 TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   const auto* params = reinterpret_cast<TfLiteSVDFParams*>(node->builtin_data);
 
@@ -304,10 +444,11 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   // [3] = Bias (optional), {1, num_units}
   // [4] = Activation State (variable),
   //         {2, batch_size, memory_size * num_filters}
+  // [5] = Scratch (optional), see below
   // TODO(kreeger): Use input tensor as variable until scratch tensor allocation
   // has been implemented (cl/263032056)
-  // TF_LITE_ENSURE_EQ(context, node->inputs->size, 5);
-  TF_LITE_ENSURE_EQ(context, node->inputs->size, 6);
+  TF_LITE_ENSURE(context,
+                 node->inputs->size == 5 || node->inputs->size == 6);
   const TfLiteTensor* input = GetInput(context, node, kInputTensor);
   const TfLiteTensor* weights_feature =
       GetInput(context, node, kWeightsFeatureTensor);
@@ -327,7 +468,8 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   const int memory_size = weights_time->dims->data[1];
 
   // Validate Input Tensor:
-  TF_LITE_ENSURE_EQ(context, input->type, kTfLiteFloat32);
+  const bool is_integer_op = input->type == kTfLiteInt8;
+  TF_LITE_ENSURE(context, input->type == kTfLiteFloat32 || is_integer_op);
   TF_LITE_ENSURE_EQ(context, NumDimensions(input), 2);
 
   // Validate Weights Feature Input Tensor:
@@ -342,34 +484,46 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   // Validate Optional Bias Input Tensor:
   if (bias) {
     TF_LITE_ENSURE_EQ(context, bias->dims->data[0], num_units);
-    TF_LITE_ENSURE_EQ(context, bias->type, kTfLiteFloat32);
+    TF_LITE_ENSURE_EQ(context, bias->type,
+                      is_integer_op ? kTfLiteInt32 : kTfLiteFloat32);
   }
 
   // Validate Activation State Input Tensor:
-  TF_LITE_ENSURE_EQ(context, activation_state->type, kTfLiteFloat32);
+  TF_LITE_ENSURE_EQ(context, activation_state->type,
+                    is_integer_op ? kTfLiteInt16 : kTfLiteFloat32);
   TF_LITE_ENSURE_EQ(context, NumDimensions(activation_state), 2);
   TF_LITE_ENSURE_EQ(context, activation_state->dims->data[0], batch_size);
   TF_LITE_ENSURE_EQ(context, activation_state->dims->data[1],
                     memory_size * num_filters);
 
   // Validate shared Scratch Tensor (same for full float and hybrid):
-  // [0] = Holds dot-product of time-forward calculations in
-  //       ApplyTimeWeightsBiasAndActivation():
+  // [0] = Held the dot-product of time-forward calculations, which
+  //       ApplyTimeWeightsBiasAndActivation() now reduces into the output
+  //       directly. Still accepted from models that carry it:
   //         float, {2, batch_size, num_filters}
   // TODO(kreeger): Use input tensor as variable until scratch tensor allocation
   // has been implemented (cl/263032056)
   // TfLiteTensor* scratch_tensor = GetTemporary(context, node, 0);
-  TfLiteTensor* scratch_tensor = &context->tensors[node->inputs->data[5]];
+  if (node->inputs->size == 6) {
+    TfLiteTensor* scratch_tensor = &context->tensors[node->inputs->data[5]];
 
-  TF_LITE_ENSURE_EQ(context, scratch_tensor->type, kTfLiteFloat32);
-  TF_LITE_ENSURE_EQ(context, NumDimensions(scratch_tensor), 2);
-  TF_LITE_ENSURE_EQ(context, scratch_tensor->dims->data[0], batch_size);
-  TF_LITE_ENSURE_EQ(context, scratch_tensor->dims->data[1], num_filters);
+    TF_LITE_ENSURE_EQ(context, scratch_tensor->type, kTfLiteFloat32);
+    TF_LITE_ENSURE_EQ(context, NumDimensions(scratch_tensor), 2);
+    TF_LITE_ENSURE_EQ(context, scratch_tensor->dims->data[0], batch_size);
+    TF_LITE_ENSURE_EQ(context, scratch_tensor->dims->data[1], num_filters);
+  }
 
   // The weights are of consistent type, so it suffices to check one.
   const bool is_hybrid_op = IsHybridOp(input, weights_feature);
-  // TODO(kreeger): Handle full quant svdf b/139435798
-  if (is_hybrid_op) {
+  if (is_integer_op) {
+    // Validate Input Tensor dtypes:
+    TF_LITE_ENSURE_EQ(context, weights_feature->type, kTfLiteInt8);
+    TF_LITE_ENSURE_EQ(context, weights_time->type, kTfLiteInt16);
+
+    // Full integer SVDF needs no scratch tensor, the activation state holds
+    // the feature dot products and the time ones go straight to the output.
+    TF_LITE_ENSURE_EQ(context, node->inputs->size, 5);
+  } else if (is_hybrid_op) {
     // Validate Input Tensor dtypes:
     TF_LITE_ENSURE(context, weights_feature->type == kTfLiteUInt8 ||
                                 weights_feature->type == kTfLiteInt8);
@@ -423,18 +577,17 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
     TF_LITE_ENSURE_EQ(context, weights_feature->type, kTfLiteFloat32);
     TF_LITE_ENSURE_EQ(context, weights_time->type, kTfLiteFloat32);
 
-    // Full-float SVDF only uses the one shared scratch tensor (see above for
-    // usage).
+    // Full-float SVDF needs no scratch tensor (see above).
     // TODO(kreeger): Use input tensor as variable until scratch tensor
     // allocation has been implemented (cl/263032056)
     // TF_LITE_ENSURE_EQ(context, node->temporaries->size, 1);
   }
 
   // Validate Tensor Output:
-  // [0] = float, {2, batch_size, num_units}
+  // [0] = float or int8 as the input, {2, batch_size, num_units}
   TF_LITE_ENSURE_EQ(context, node->outputs->size, 1);
   TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
-  TF_LITE_ENSURE_EQ(context, output->type, kTfLiteFloat32);
+  TF_LITE_ENSURE_EQ(context, output->type, input->type);
   TF_LITE_ENSURE_EQ(context, NumDimensions(output), 2);
   TF_LITE_ENSURE_EQ(context, output->dims->data[0], batch_size);
   TF_LITE_ENSURE_EQ(context, output->dims->data[1], num_units);
@@ -452,19 +605,25 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       GetInput(context, node, kWeightsTimeTensor);
   const TfLiteTensor* bias = GetOptionalInputTensor(context, node, kBiasTensor);
 
-  // TODO(kreeger): Use input tensor as variable until scratch tensor allocation
-  // has been implemented (cl/263032056)
-  // TfLiteTensor* scratch = GetTemporary(context, node, /*index=*/0);
-  TfLiteTensor* scratch = &context->tensors[node->inputs->data[5]];
-
   TfLiteTensor* activation_state =
       &context->tensors[node->inputs->data[kInputActivationStateTensor]];
   TfLiteTensor* output = GetOutput(context, node, kOutputTensor);
 
+  if (input->type == kTfLiteInt8) {
+    OpData local_data_object;
+    OpData* data = &local_data_object;
+    TF_LITE_ENSURE_STATUS(CalculateOpData(context, params, input,
+                                          weights_feature, weights_time,
+                                          activation_state, output, data));
+    EvalIntegerSVDF(context, node, input, weights_feature, weights_time, bias,
+                    params, activation_state, output, *data);
+    return kTfLiteOk;
+  }
+
   switch (weights_feature->type) {
     case kTfLiteFloat32: {
       EvalFloatSVDF(context, node, input, weights_feature, weights_time, bias,
-                    params, scratch, activation_state, output);
+                    params, activation_state, output);
       return kTfLiteOk;
       break;
     }
@@ -475,7 +634,7 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
       TfLiteTensor* scratch_scaling_factors = GetTemporary(context, node, 2);
       TfLiteTensor* scratch_float_weights_time = GetTemporary(context, node, 3);
       EvalHybridSVDF(context, node, input, weights_feature,
-                     scratch_float_weights_time, bias, params, scratch,
+                     scratch_float_weights_time, bias, params,
                      scratch_scaling_factors, scratch_input_quantized,
                      activation_state, output);
       return kTfLiteOk;
@@ -493,9 +652,11 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
 
 }  // namespace svdf
 
+// No init or free: MicroInterpreter::Invoke() runs both around every Eval()
+// and would reset the node's user_data, which keeps the full integer SVDF's
+// ring position from one Invoke() to the next. The allocator starts it at 0.
 TfLiteRegistration* Register_SVDF() {
-  static TfLiteRegistration r = {svdf::Init, svdf::Free, svdf::Prepare,
-                                 svdf::Eval};
+  static TfLiteRegistration r = {nullptr, nullptr, svdf::Prepare, svdf::Eval};
   return &r;
 }
 
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/c/c_api_internal.h"
 #include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/core/api/flatbuffer_conversions.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/core/api/tensor_utils.h"
 #include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/compatibility.h"
 
 namespace tflite {
@@ -247,6 +248,19 @@ TfLiteTensor* MicroInterpreter::output(size_t index) {
   return &(context_.tensors[outputs->Get(index)]);
 }
 
+TfLiteStatus MicroInterpreter::ResetVariableTensors() {
+  if (!tensors_allocated_) {
+    error_reporter_->Report("Tensors are not allocated");
+    return kTfLiteError;
+  }
+  for (size_t i = 0; i < context_.tensors_size; ++i) {
+    if (context_.tensors[i].is_variable) {
+      TF_LITE_ENSURE_STATUS(ResetVariableTensor(&context_.tensors[i]));
+    }
+  }
+  return kTfLiteOk;
+}
+
 TfLiteTensor* MicroInterpreter::tensor(size_t index) {
   const size_t length = tensors_size();
   if ((index < 0) || (index >= tensors_size())) {
@@ -57,6 +57,11 @@ class MicroInterpreter {
 
   TfLiteStatus Invoke();
 
+  // Zero the variable tensors, as AllocateTensors() leaves them. Stateful ops
+  // such as a streaming SVDF keep their history in them between Invoke()
+  // calls; this restarts the stream, e.g. after a gap in the input.
+  TfLiteStatus ResetVariableTensors();
+
   size_t tensors_size() const { return context_.tensors_size; }
   TfLiteTensor* tensor(size_t tensor_index);
 
@@ -17,10 +17,386 @@ limitations under the License.
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/fft_tables.h"
+
 #define FIXED_POINT 16
 #include "eloquent_tinyml/tensorflow/esp32/third_party/kissfft/kiss_fft.h"
 #include "eloquent_tinyml/tensorflow/esp32/third_party/kissfft/tools/kiss_fftr.h"
 
+namespace {
+
+// Radix-4 real FFT of FFT_FAST_MIN_SIZE to FFT_FAST_MAX_SIZE points. It runs
+// the butterflies kiss_fftr() runs for these sizes, with the same fixed
+// point rounding, so the output is bit for bit the one of kissfft. What goes
+// is the work around them: the recursion, its strided copy of the input (the
+// innermost stage reads the input in digit reversed order), the switch on
+// the radix and the inverse flag tested in every butterfly, twiddles
+// computed at init (they are const tables, in DRAM on the board, loaded once
+// per stage and index), the pass between the radix-2 stage of 128 points and
+// the radix-4 one after it, and the multiplications by the unit twiddle,
+// which are exact identities after the stage scaling.
+
+// kissfft's sround(smul(a, b)): Q15 product, rounded.
+inline int16_t MulQ15(int32_t a, int32_t b) {
+  return static_cast<int16_t>((a * b + (1 << 14)) >> 15);
+}
+
+// A point in 32 bit lanes. kissfft's int16 additions and subtractions wrap,
+// so their sums are the same modulo 2^16 whether they are truncated after
+// every operation or only when stored: the butterflies work in registers and
+// truncate once, at the store. What goes into a product is in 16 bits
+// already (FixDiv() of a 16 bit point), what goes into a shift is truncated
+// first.
+struct Wide {
+  int32_t real;
+  int32_t imag;
+};
+
+// kissfft's C_FIXDIV(c, div), the scaling that keeps each stage in 16 bits.
+template <int32_t div>
+inline Wide FixDiv(const complex_int16_t& c) {
+  Wide d;
+  d.real = MulQ15(c.real, 32767 / div);
+  d.imag = MulQ15(c.imag, 32767 / div);
+  return d;
+}
+
+// kissfft's C_MUL(m, a, b).
+inline Wide MulComplex(const Wide& a, const complex_int16_t& b) {
+  Wide m;
+  m.real = (a.real * b.real - a.imag * b.imag + (1 << 14)) >> 15;
+  m.imag = (a.real * b.imag + a.imag * b.real + (1 << 14)) >> 15;
+  return m;
+}
+
+inline void Store(complex_int16_t* out, int32_t real, int32_t imag) {
+  out->real = static_cast<int16_t>(real);
+  out->imag = static_cast<int16_t>(imag);
+}
+
+// kf_bfly4(), forward, on a point and its three partners already scaled and
+// twiddled: out[0], out[m], out[2 * m], out[3 * m] get the four outputs.
+inline void Butterfly4(const Wide& a, const Wide& s0, const Wide& s1,
+                       const Wide& s2, complex_int16_t* out, size_t m) {
+  const int32_t s5_real = a.real - s1.real;
+  const int32_t s5_imag = a.imag - s1.imag;
+  const int32_t a_real = a.real + s1.real;
+  const int32_t a_imag = a.imag + s1.imag;
+  const int32_t s3_real = s0.real + s2.real;
+  const int32_t s3_imag = s0.imag + s2.imag;
+  const int32_t s4_real = s0.real - s2.real;
+  const int32_t s4_imag = s0.imag - s2.imag;
+  Store(out, a_real + s3_real, a_imag + s3_imag);
+  Store(out + m, s5_real + s4_imag, s5_imag - s4_real);
+  Store(out + 2 * m, a_real - s3_real, a_imag - s3_imag);
+  Store(out + 3 * m, s5_real - s4_imag, s5_imag + s4_real);
+}
+
+#if !defined(__SSE2__)
+// Innermost stage of 256 points, radix 4 on inputs 64 apart.
+void FirstStage4(const complex_int16_t* input, complex_int16_t* out) {
+  for (size_t g = 0; g < 64; ++g, out += 4) {
+    const complex_int16_t* x = input + kFftFirstStageInput[g];
+    Butterfly4(FixDiv<4>(x[0]), FixDiv<4>(x[64]), FixDiv<4>(x[128]),
+               FixDiv<4>(x[192]), out, 1);
+  }
+}
+#endif
+
+// The two innermost stages of 128 points in one pass: kf_bfly2() on inputs
+// 64 apart, then the radix-4 stage of m = 2 on the eight points of four of
+// them, which stay in registers. Its twiddles are the same for every group.
+void FirstStages2And4(const complex_int16_t* input, complex_int16_t* out,
+                      size_t stride) {
+  const complex_int16_t w1 = kFftTwiddles[stride];
+  const complex_int16_t w2 = kFftTwiddles[2 * stride];
+  const complex_int16_t w3 = kFftTwiddles[3 * stride];
+
+  for (size_t g = 0; g < 64; g += 4, out += 8) {
+    // kf_bfly2()'s outputs, in 16 bits as it stores them
+    complex_int16_t sum[4];
+    complex_int16_t difference[4];
+    for (size_t i = 0; i < 4; ++i) {
+      const complex_int16_t* x = input + kFftFirstStageInput[g + i];
+      const Wide a = FixDiv<2>(x[0]);
+      const Wide t = FixDiv<2>(x[64]);
+      Store(sum + i, a.real + t.real, a.imag + t.imag);
+      Store(difference + i, a.real - t.real, a.imag - t.imag);
+    }
+
+    Butterfly4(FixDiv<4>(sum[0]), FixDiv<4>(sum[1]), FixDiv<4>(sum[2]),
+               FixDiv<4>(sum[3]), out, 2);
+    Butterfly4(FixDiv<4>(difference[0]),
+               MulComplex(FixDiv<4>(difference[1]), w1),
+               MulComplex(FixDiv<4>(difference[2]), w2),
+               MulComplex(FixDiv<4>(difference[3]), w3), out + 1, 2);
+  }
+}
+
+// An outer radix-4 stage: groups of 4 * m points, whose k-th butterfly takes
+// twiddles k, 2 * k and 3 * k times stride (kFftTwiddles indices).
+void Radix4Stage(complex_int16_t* data, size_t count, size_t m,
+                 size_t stride) {
+  const complex_int16_t* end = data + count;
+
+  for (complex_int16_t* out = data; out < end; out += 4 * m) {
+    Butterfly4(FixDiv<4>(out[0]), FixDiv<4>(out[m]), FixDiv<4>(out[2 * m]),
+               FixDiv<4>(out[3 * m]), out, m);
+  }
+
+  for (size_t k = 1; k < m; ++k) {
+    const complex_int16_t w1 = kFftTwiddles[k * stride];
+    const complex_int16_t w2 = kFftTwiddles[2 * k * stride];
+    const complex_int16_t w3 = kFftTwiddles[3 * k * stride];
+
+    for (complex_int16_t* out = data + k; out < end; out += 4 * m) {
+      Butterfly4(FixDiv<4>(out[0]), MulComplex(FixDiv<4>(out[m]), w1),
+                 MulComplex(FixDiv<4>(out[2 * m]), w2),
+                 MulComplex(FixDiv<4>(out[3 * m]), w3), out, m);
+    }
+  }
+}
+
+#if defined(__SSE2__)
+// Host builds: the same arithmetic, four complex points per register. Q15
+// products are exact 32 bit sums (madd) rounded as sround() and truncated to
+// 16 bits as kissfft's stores, adds and subtractions wrap as its int16 ones.
+
+// Low 16 bits of each 32 bit lane, sign extended, so that packing does not
+// saturate.
+inline __m128i Truncate16(__m128i x) {
+  return _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+}
+
+template <int32_t div>
+inline __m128i FixDivX4(__m128i x) {
+  const __m128i factor = _mm_set1_epi32((1 << 14 << 16) | (32767 / div));
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(x, one), factor);
+  const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(x, one), factor);
+  return _mm_packs_epi32(Truncate16(_mm_srai_epi32(lo, 15)),
+                         Truncate16(_mm_srai_epi32(hi, 15)));
+}
+
+// Imaginary parts negated.
+inline __m128i ConjugateX4(__m128i x) {
+  const __m128i imag = _mm_set1_epi32(0xffff0000);
+  return _mm_sub_epi16(_mm_xor_si128(x, imag), imag);
+}
+
+// Real and imaginary parts swapped.
+inline __m128i SwapX4(__m128i x) {
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xb1), 0xb1);
+}
+
+inline __m128i MulComplexX4(__m128i a, __m128i w) {
+  const __m128i round = _mm_set1_epi32(1 << 14);
+  const __m128i real = _mm_srai_epi32(
+      _mm_add_epi32(_mm_madd_epi16(a, ConjugateX4(w)), round), 15);
+  const __m128i imag =
+      _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(a, SwapX4(w)), round), 15);
+  return _mm_packs_epi32(Truncate16(_mm_unpacklo_epi32(real, imag)),
+                         Truncate16(_mm_unpackhi_epi32(real, imag)));
+}
+
+inline __m128i LoadTwiddlesX4(const complex_int16_t* table, size_t stride) {
+  int32_t w[4];
+  for (size_t i = 0; i < 4; ++i) {
+    memcpy(&w[i], &table[i * stride], sizeof(w[i]));
+  }
+  return _mm_set_epi32(w[3], w[2], w[1], w[0]);
+}
+
+// Butterfly4() on four butterflies.
+inline void Butterfly4X4(__m128i a, __m128i s0, __m128i s1, __m128i s2,
+                         __m128i* y) {
+  const __m128i s5 = _mm_sub_epi16(a, s1);
+  a = _mm_add_epi16(a, s1);
+  const __m128i s3 = _mm_add_epi16(s0, s2);
+  // {s4.imag, -s4.real}
+  const __m128i s4 = ConjugateX4(SwapX4(_mm_sub_epi16(s0, s2)));
+  y[0] = _mm_add_epi16(a, s3);
+  y[1] = _mm_add_epi16(s5, s4);
+  y[2] = _mm_sub_epi16(a, s3);
+  y[3] = _mm_sub_epi16(s5, s4);
+}
+
+// FirstStage4() four groups at a time: the groups reading inputs b to b + 3,
+// their outputs transposed into place.
+void FirstStage4X4(const complex_int16_t* input, complex_int16_t* out) {
+  for (size_t b = 0; b < 64; b += 4) {
+    const __m128i* x = reinterpret_cast<const __m128i*>(input + b);
+    __m128i y[4];
+    Butterfly4X4(FixDivX4<4>(_mm_loadu_si128(x)),
+                 FixDivX4<4>(_mm_loadu_si128(x + 16)),
+                 FixDivX4<4>(_mm_loadu_si128(x + 32)),
+                 FixDivX4<4>(_mm_loadu_si128(x + 48)), y);
+
+    const __m128i t0 = _mm_unpacklo_epi32(y[0], y[1]);
+    const __m128i t1 = _mm_unpacklo_epi32(y[2], y[3]);
+    const __m128i t2 = _mm_unpackhi_epi32(y[0], y[1]);
+    const __m128i t3 = _mm_unpackhi_epi32(y[2], y[3]);
+    // The digit reversal is its own inverse: group g reads input g' and
+    // input g goes to group g'.
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out + 4 * kFftFirstStageInput[b]),
+        _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out + 4 * kFftFirstStageInput[b + 1]),
+        _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out + 4 * kFftFirstStageInput[b + 2]),
+        _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(out + 4 * kFftFirstStageInput[b + 3]),
+        _mm_unpackhi_epi64(t2, t3));
+  }
+}
+
+// Radix4Stage() four butterflies at a time, m a multiple of 4. The unit
+// twiddle of the first butterfly is multiplied too: an identity, as above.
+void Radix4StageX4(complex_int16_t* data, size_t count, size_t m,
+                   size_t stride) {
+  for (size_t k = 0; k < m; k += 4) {
+    const __m128i w1 = LoadTwiddlesX4(kFftTwiddles + k * stride, stride);
+    const __m128i w2 =
+        LoadTwiddlesX4(kFftTwiddles + 2 * k * stride, 2 * stride);
+    const __m128i w3 =
+        LoadTwiddlesX4(kFftTwiddles + 3 * k * stride, 3 * stride);
+
+    for (complex_int16_t* out = data + k; out < data + count; out += 4 * m) {
+      __m128i* x0 = reinterpret_cast<__m128i*>(out);
+      __m128i* x1 = reinterpret_cast<__m128i*>(out + m);
+      __m128i* x2 = reinterpret_cast<__m128i*>(out + 2 * m);
+      __m128i* x3 = reinterpret_cast<__m128i*>(out + 3 * m);
+      __m128i y[4];
+      Butterfly4X4(FixDivX4<4>(_mm_loadu_si128(x0)),
+                   MulComplexX4(FixDivX4<4>(_mm_loadu_si128(x1)), w1),
+                   MulComplexX4(FixDivX4<4>(_mm_loadu_si128(x2)), w2),
+                   MulComplexX4(FixDivX4<4>(_mm_loadu_si128(x3)), w3), y);
+      _mm_storeu_si128(x0, y[0]);
+      _mm_storeu_si128(x1, y[1]);
+      _mm_storeu_si128(x2, y[2]);
+      _mm_storeu_si128(x3, y[3]);
+    }
+  }
+}
+
+// (a + b) >> 1 and (a - b) >> 1 of the 32 bit sums, without them.
+inline __m128i HalfAddX4(__m128i a, __m128i b) {
+  const __m128i carry =
+      _mm_and_si128(_mm_and_si128(a, b), _mm_set1_epi16(1));
+  return _mm_add_epi16(
+      _mm_add_epi16(_mm_srai_epi16(a, 1), _mm_srai_epi16(b, 1)), carry);
+}
+
+inline __m128i HalfSubX4(__m128i a, __m128i b) {
+  const __m128i borrow =
+      _mm_and_si128(_mm_andnot_si128(a, b), _mm_set1_epi16(1));
+  return _mm_sub_epi16(
+      _mm_sub_epi16(_mm_srai_epi16(a, 1), _mm_srai_epi16(b, 1)), borrow);
+}
+
+// The loop of SplitReal() on bins k to k + 3 and their mirrors.
+void SplitRealX4(complex_int16_t* data, size_t count, size_t k,
+                 size_t table_step) {
+  __m128i* low = reinterpret_cast<__m128i*>(data + k);
+  __m128i* high = reinterpret_cast<__m128i*>(data + count - k - 3);
+  const __m128i reverse_high = _mm_shuffle_epi32(_mm_loadu_si128(high), 0x1b);
+
+  const __m128i fpk = FixDivX4<2>(_mm_loadu_si128(low));
+  const __m128i fpnk = FixDivX4<2>(ConjugateX4(reverse_high));
+  const __m128i f1k = _mm_add_epi16(fpk, fpnk);
+  const __m128i f2k = _mm_sub_epi16(fpk, fpnk);
+  const __m128i tw = MulComplexX4(
+      f2k, LoadTwiddlesX4(kFftSuperTwiddles + k * table_step - 1, table_step));
+
+  // {(f1k.real - tw.real) >> 1, (tw.imag - f1k.imag) >> 1}
+  const __m128i imag = _mm_set1_epi32(0xffff0000);
+  const __m128i mirror =
+      _mm_or_si128(_mm_andnot_si128(imag, HalfSubX4(f1k, tw)),
+                   _mm_and_si128(imag, HalfSubX4(tw, f1k)));
+
+  // kiss_fftr() writes bin count - k last when it is k too
+  _mm_storeu_si128(low, HalfAddX4(f1k, tw));
+  _mm_storeu_si128(high, _mm_shuffle_epi32(mirror, 0x1b));
+}
+#endif  // defined(__SSE2__)
+
+void FftComputeFast(struct FftState* state) {
+  // Complex FFT of the even (real) and odd (imaginary) samples, worked out
+  // in the output buffer.
+  const size_t count = state->fft_size / 2;
+  const size_t table_step = FFT_FAST_MAX_SIZE / state->fft_size;
+  const complex_int16_t* input =
+      reinterpret_cast<const complex_int16_t*>(state->input);
+  complex_int16_t* data = state->output;
+
+  // Innermost factor first, as kf_work() unwinds.
+  size_t m;
+  if (count == 256) {
+#if defined(__SSE2__)
+    FirstStage4X4(input, data);
+#else
+    FirstStage4(input, data);
+#endif
+    m = 4;
+  } else {
+    FirstStages2And4(input, data, count / 8 * table_step);
+    m = 8;
+  }
+  for (; m < count; m *= 4) {
+    const size_t stride = count / (4 * m) * table_step;
+#if defined(__SSE2__)
+    if (m % 4 == 0) {
+      Radix4StageX4(data, count, m, stride);
+      continue;
+    }
+#endif
+    Radix4Stage(data, count, m, stride);
+  }
+
+  // Split into the spectrum of the real input, as kiss_fftr(), in place:
+  // bins k and count - k only depend on points k and count - k.
+  const Wide dc = FixDiv<2>(data[0]);
+  Store(data, dc.real + dc.imag, 0);
+  Store(data + count, dc.real - dc.imag, 0);
+
+  size_t k = 1;
+#if defined(__SSE2__)
+  for (; k + 3 <= count / 2; k += 4) {
+    SplitRealX4(data, count, k, table_step);
+  }
+#endif
+  for (; k <= count / 2; ++k) {
+    const Wide fpk = FixDiv<2>(data[k]);
+    complex_int16_t fpnk = data[count - k];
+    fpnk.imag = -fpnk.imag;
+    const Wide fpnk_scaled = FixDiv<2>(fpnk);
+
+    Wide f1k, f2k;
+    f1k.real = fpk.real + fpnk_scaled.real;
+    f1k.imag = fpk.imag + fpnk_scaled.imag;
+    f2k.real = fpk.real - fpnk_scaled.real;
+    f2k.imag = fpk.imag - fpnk_scaled.imag;
+    // tw goes into a shift: truncated as kissfft stores it
+    const Wide product =
+        MulComplex(f2k, kFftSuperTwiddles[k * table_step - 1]);
+    const int32_t tw_real = static_cast<int16_t>(product.real);
+    const int32_t tw_imag = static_cast<int16_t>(product.imag);
+
+    Store(data + k, (f1k.real + tw_real) >> 1, (f1k.imag + tw_imag) >> 1);
+    Store(data + count - k, (f1k.real - tw_real) >> 1,
+          (tw_imag - f1k.imag) >> 1);
+  }
+}
+
+}  // namespace
+
 void FftCompute(struct FftState* state, const int16_t* input,
                 int input_scale_shift) {
   const size_t input_size = state->input_size;
@@ -37,7 +413,12 @@ void FftCompute(struct FftState* state, const int16_t* input,
     *fft_input++ = 0;
   }
 
-  // Apply the FFT.
+  // Apply the FFT. FftPopulateState() leaves kissfft out for the sizes of
+  // the radix-4 path.
+  if (state->scratch == nullptr) {
+    FftComputeFast(state);
+    return;
+  }
   kiss_fftr(
       reinterpret_cast<const kiss_fftr_cfg>(state->scratch),
       state->input,
@@ -23,6 +23,10 @@ limitations under the License.
 extern "C" {
 #endif
 
+// Real FFT sizes FftCompute() runs on its radix-4 path instead of kissfft.
+#define FFT_FAST_MIN_SIZE 256
+#define FFT_FAST_MAX_SIZE 512
+
 struct complex_int16_t {
   int16_t real;
   int16_t imag;
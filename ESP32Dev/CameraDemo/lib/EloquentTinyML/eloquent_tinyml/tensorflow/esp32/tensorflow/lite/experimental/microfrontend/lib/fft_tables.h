@@ -0,0 +1,125 @@
+#if defined(ESP32)
+#ifndef TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_FFT_TABLES_H_
+#define TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_FFT_TABLES_H_
+
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/fft.h"
+
+#if defined(__XTENSA__)
+#include "esp_attr.h"
+#define FFT_TABLE_ATTR DRAM_ATTR
+#else
+#define FFT_TABLE_ATTR
+#endif
+
+// Constant tables of the radix-4 real FFT in fft.cpp. On the board they are
+// kept in DRAM (1.3 KB): in flash, a twiddle load could wait on a flash cache
+// miss. The values are the ones kiss_fftr_alloc() computes for a 512 point
+// real FFT with FIXED_POINT 16, floor(.5 + 32767 * cos/sin(phase)), so
+// FftCompute() gives the same bits as kissfft; the 256 point FFT takes every
+// other one.
+
+// exp(-2 * pi * i * k / 256), the twiddles of the 256 point complex FFT,
+// as far as a radix-4 butterfly reaches (3 / 4 of them).
+static const struct complex_int16_t kFftTwiddles[192] FFT_TABLE_ATTR = {
+    {32767, 0}, {32757, -804}, {32728, -1608}, {32678, -2410}, {32609, -3212},
+    {32521, -4011}, {32412, -4808}, {32285, -5602}, {32137, -6393},
+    {31971, -7179}, {31785, -7962}, {31580, -8739}, {31356, -9512},
+    {31113, -10278}, {30852, -11039}, {30571, -11793}, {30273, -12539},
+    {29956, -13279}, {29621, -14010}, {29268, -14732}, {28898, -15446},
+    {28510, -16151}, {28105, -16846}, {27683, -17530}, {27245, -18204},
+    {26790, -18868}, {26319, -19519}, {25832, -20159}, {25329, -20787},
+    {24811, -21403}, {24279, -22005}, {23731, -22594}, {23170, -23170},
+    {22594, -23731}, {22005, -24279}, {21403, -24811}, {20787, -25329},
+    {20159, -25832}, {19519, -26319}, {18868, -26790}, {18204, -27245},
+    {17530, -27683}, {16846, -28105}, {16151, -28510}, {15446, -28898},
+    {14732, -29268}, {14010, -29621}, {13279, -29956}, {12539, -30273},
+    {11793, -30571}, {11039, -30852}, {10278, -31113}, {9512, -31356},
+    {8739, -31580}, {7962, -31785}, {7179, -31971}, {6393, -32137},
+    {5602, -32285}, {4808, -32412}, {4011, -32521}, {3212, -32609},
+    {2410, -32678}, {1608, -32728}, {804, -32757}, {0, -32767}, {-804, -32757},
+    {-1608, -32728}, {-2410, -32678}, {-3212, -32609}, {-4011, -32521},
+    {-4808, -32412}, {-5602, -32285}, {-6393, -32137}, {-7179, -31971},
+    {-7962, -31785}, {-8739, -31580}, {-9512, -31356}, {-10278, -31113},
+    {-11039, -30852}, {-11793, -30571}, {-12539, -30273}, {-13279, -29956},
+    {-14010, -29621}, {-14732, -29268}, {-15446, -28898}, {-16151, -28510},
+    {-16846, -28105}, {-17530, -27683}, {-18204, -27245}, {-18868, -26790},
+    {-19519, -26319}, {-20159, -25832}, {-20787, -25329}, {-21403, -24811},
+    {-22005, -24279}, {-22594, -23731}, {-23170, -23170}, {-23731, -22594},
+    {-24279, -22005}, {-24811, -21403}, {-25329, -20787}, {-25832, -20159},
+    {-26319, -19519}, {-26790, -18868}, {-27245, -18204}, {-27683, -17530},
+    {-28105, -16846}, {-28510, -16151}, {-28898, -15446}, {-29268, -14732},
+    {-29621, -14010}, {-29956, -13279}, {-30273, -12539}, {-30571, -11793},
+    {-30852, -11039}, {-31113, -10278}, {-31356, -9512}, {-31580, -8739},
+    {-31785, -7962}, {-31971, -7179}, {-32137, -6393}, {-32285, -5602},
+    {-32412, -4808}, {-32521, -4011}, {-32609, -3212}, {-32678, -2410},
+    {-32728, -1608}, {-32757, -804}, {-32767, 0}, {-32757, 804}, {-32728, 1608},
+    {-32678, 2410}, {-32609, 3212}, {-32521, 4011}, {-32412, 4808},
+    {-32285, 5602}, {-32137, 6393}, {-31971, 7179}, {-31785, 7962},
+    {-31580, 8739}, {-31356, 9512}, {-31113, 10278}, {-30852, 11039},
+    {-30571, 11793}, {-30273, 12539}, {-29956, 13279}, {-29621, 14010},
+    {-29268, 14732}, {-28898, 15446}, {-28510, 16151}, {-28105, 16846},
+    {-27683, 17530}, {-27245, 18204}, {-26790, 18868}, {-26319, 19519},
+    {-25832, 20159}, {-25329, 20787}, {-24811, 21403}, {-24279, 22005},
+    {-23731, 22594}, {-23170, 23170}, {-22594, 23731}, {-22005, 24279},
+    {-21403, 24811}, {-20787, 25329}, {-20159, 25832}, {-19519, 26319},
+    {-18868, 26790}, {-18204, 27245}, {-17530, 27683}, {-16846, 28105},
+    {-16151, 28510}, {-15446, 28898}, {-14732, 29268}, {-14010, 29621},
+    {-13279, 29956}, {-12539, 30273}, {-11793, 30571}, {-11039, 30852},
+    {-10278, 31113}, {-9512, 31356}, {-8739, 31580}, {-7962, 31785},
+    {-7179, 31971}, {-6393, 32137}, {-5602, 32285}, {-4808, 32412},
+    {-4011, 32521}, {-3212, 32609}, {-2410, 32678}, {-1608, 32728},
+    {-804, 32757},
+};
+
+// exp(-pi * i * ((k + 1) / 256 + 1 / 2)), the twiddles that split the
+// complex FFT of the even and odd samples into the real spectrum.
+static const struct complex_int16_t kFftSuperTwiddles[128] FFT_TABLE_ATTR = {
+    {-402, -32765}, {-804, -32757}, {-1206, -32745}, {-1608, -32728},
+    {-2009, -32705}, {-2410, -32678}, {-2811, -32646}, {-3212, -32609},
+    {-3612, -32567}, {-4011, -32521}, {-4410, -32469}, {-4808, -32412},
+    {-5205, -32351}, {-5602, -32285}, {-5998, -32213}, {-6393, -32137},
+    {-6786, -32057}, {-7179, -31971}, {-7571, -31880}, {-7962, -31785},
+    {-8351, -31685}, {-8739, -31580}, {-9126, -31470}, {-9512, -31356},
+    {-9896, -31237}, {-10278, -31113}, {-10659, -30985}, {-11039, -30852},
+    {-11417, -30714}, {-11793, -30571}, {-12167, -30424}, {-12539, -30273},
+    {-12910, -30117}, {-13279, -29956}, {-13645, -29791}, {-14010, -29621},
+    {-14372, -29447}, {-14732, -29268}, {-15090, -29085}, {-15446, -28898},
+    {-15800, -28706}, {-16151, -28510}, {-16499, -28310}, {-16846, -28105},
+    {-17189, -27896}, {-17530, -27683}, {-17869, -27466}, {-18204, -27245},
+    {-18537, -27019}, {-18868, -26790}, {-19195, -26556}, {-19519, -26319},
+    {-19841, -26077}, {-20159, -25832}, {-20475, -25582}, {-20787, -25329},
+    {-21096, -25072}, {-21403, -24811}, {-21705, -24547}, {-22005, -24279},
+    {-22301, -24007}, {-22594, -23731}, {-22884, -23452}, {-23170, -23170},
+    {-23452, -22884}, {-23731, -22594}, {-24007, -22301}, {-24279, -22005},
+    {-24547, -21705}, {-24811, -21403}, {-25072, -21096}, {-25329, -20787},
+    {-25582, -20475}, {-25832, -20159}, {-26077, -19841}, {-26319, -19519},
+    {-26556, -19195}, {-26790, -18868}, {-27019, -18537}, {-27245, -18204},
+    {-27466, -17869}, {-27683, -17530}, {-27896, -17189}, {-28105, -16846},
+    {-28310, -16499}, {-28510, -16151}, {-28706, -15800}, {-28898, -15446},
+    {-29085, -15090}, {-29268, -14732}, {-29447, -14372}, {-29621, -14010},
+    {-29791, -13645}, {-29956, -13279}, {-30117, -12910}, {-30273, -12539},
+    {-30424, -12167}, {-30571, -11793}, {-30714, -11417}, {-30852, -11039},
+    {-30985, -10659}, {-31113, -10278}, {-31237, -9896}, {-31356, -9512},
+    {-31470, -9126}, {-31580, -8739}, {-31685, -8351}, {-31785, -7962},
+    {-31880, -7571}, {-31971, -7179}, {-32057, -6786}, {-32137, -6393},
+    {-32213, -5998}, {-32285, -5602}, {-32351, -5205}, {-32412, -4808},
+    {-32469, -4410}, {-32521, -4011}, {-32567, -3612}, {-32609, -3212},
+    {-32646, -2811}, {-32678, -2410}, {-32705, -2009}, {-32728, -1608},
+    {-32745, -1206}, {-32757, -804}, {-32765, -402}, {-32767, 0},
+};
+
+// Input of the first butterfly of each group of the innermost stage, the
+// digit reversal of kissfft's factors: 4, 4, 4, 4 for 256 points (512 real),
+// 4, 4, 4, 2 for 128 points (256 real). Both reverse the three outer base 4
+// digits the same way, and the other points of a group follow 64 inputs
+// apart.
+static const uint8_t kFftFirstStageInput[64] FFT_TABLE_ATTR = {
+    0, 16, 32, 48, 4, 20, 36, 52, 8, 24, 40, 56, 12, 28, 44, 60, 1, 17, 33, 49,
+    5, 21, 37, 53, 9, 25, 41, 57, 13, 29, 45, 61, 2, 18, 34, 50, 6, 22, 38, 54,
+    10, 26, 42, 58, 14, 30, 46, 62, 3, 19, 35, 51, 7, 23, 39, 55, 11, 27, 43,
+    59, 15, 31, 47, 63,
+};
+
+#endif  // TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_FFT_TABLES_H_
+
+#endif // end of #if defined(ESP32)
@@ -42,6 +42,14 @@ int FftPopulateState(struct FftState* state, size_t input_size) {
     return 0;
   }
 
+  // The radix-4 path of FftCompute() needs no scratch.
+  state->scratch = nullptr;
+  state->scratch_size = 0;
+  if (state->fft_size >= FFT_FAST_MIN_SIZE &&
+      state->fft_size <= FFT_FAST_MAX_SIZE) {
+    return 1;
+  }
+
   // Ask kissfft how much memory it wants.
   size_t scratch_size = 0;
   kiss_fftr_cfg kfft_cfg = kiss_fftr_alloc(
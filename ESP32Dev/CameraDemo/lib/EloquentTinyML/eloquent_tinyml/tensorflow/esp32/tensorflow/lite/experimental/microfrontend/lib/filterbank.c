@@ -17,101 +17,201 @@ limitations under the License.
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/sqrt_lut.h"
 
 void FilterbankConvertFftComplexToEnergy(struct FilterbankState* state,
                                          struct complex_int16_t* fft_output,
                                          int32_t* energy) {
   const int end_index = state->end_index;
-  int i;
-  energy += state->start_index;
-  fft_output += state->start_index;
-  for (i = state->start_index; i < end_index; ++i) {
+  int i = state->start_index;
+  energy += i;
+  fft_output += i;
+#if defined(__SSE2__)
+  // Four bins at a time, madd sums the squares in 32 bits: it wraps as the
+  // sum below when both parts are -32768.
+  for (; i + 4 <= end_index; i += 4) {
+    const __m128i bins = _mm_loadu_si128((const __m128i*)fft_output);
+    _mm_storeu_si128((__m128i*)energy, _mm_madd_epi16(bins, bins));
+    fft_output += 4;
+    energy += 4;
+  }
+#else
+  for (; i + 2 <= end_index; i += 2) {
+    const int32_t real0 = fft_output[0].real;
+    const int32_t imag0 = fft_output[0].imag;
+    const int32_t real1 = fft_output[1].real;
+    const int32_t imag1 = fft_output[1].imag;
+    fft_output += 2;
+    energy[0] = (uint32_t)(real0 * real0) + (uint32_t)(imag0 * imag0);
+    energy[1] = (uint32_t)(real1 * real1) + (uint32_t)(imag1 * imag1);
+    energy += 2;
+  }
+#endif
+  for (; i < end_index; ++i) {
     const int32_t real = fft_output->real;
     const int32_t imag = fft_output->imag;
     fft_output++;
-    const uint32_t mag_squared = (real * real) + (imag * imag);
+    const uint32_t mag_squared =
+        (uint32_t)(real * real) + (uint32_t)(imag * imag);
     *energy++ = mag_squared;
   }
 }
 
+#if defined(__SSE2__)
+// Weighted and plain sums of four bins, in two 64 bit lanes each. The
+// products are unsigned, the ones of negative magnitudes are corrected.
+static void AccumulateBins4(const int16_t* weights, const int32_t* magnitudes,
+                            __m128i* weight_accumulator,
+                            __m128i* energy_accumulator) {
+  const __m128i high = _mm_set_epi32(-1, 0, -1, 0);
+  const __m128i energy = _mm_loadu_si128((const __m128i*)magnitudes);
+  const __m128i sign = _mm_srai_epi32(energy, 31);
+  const __m128i weight = _mm_unpacklo_epi16(
+      _mm_loadl_epi64((const __m128i*)weights), _mm_setzero_si128());
+  const __m128i even = _mm_mul_epu32(energy, weight);
+  const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(energy, 32),
+                                    _mm_srli_epi64(weight, 32));
+  const __m128i negative = _mm_and_si128(sign, weight);
+  const __m128i correction = _mm_add_epi64(_mm_slli_epi64(negative, 32),
+                                           _mm_and_si128(negative, high));
+  *weight_accumulator = _mm_add_epi64(
+      *weight_accumulator,
+      _mm_sub_epi64(_mm_add_epi64(even, odd), correction));
+  *energy_accumulator = _mm_add_epi64(
+      *energy_accumulator,
+      _mm_add_epi64(_mm_unpacklo_epi32(energy, sign),
+                    _mm_unpackhi_epi32(energy, sign)));
+}
+
+static int64_t SumLanes(__m128i x) {
+  int64_t lanes[2];
+  _mm_storeu_si128((__m128i*)lanes, x);
+  return lanes[0] + lanes[1];
+}
+#endif
+
 void FilterbankAccumulateChannels(struct FilterbankState* state,
                                   const int32_t* energy) {
   uint64_t* work = state->work;
-  uint64_t weight_accumulator = 0;
   uint64_t unweight_accumulator = 0;
 
-  const int16_t* channel_frequency_starts = state->channel_frequency_starts;
-  const int16_t* channel_weight_starts = state->channel_weight_starts;
-  const int16_t* channel_widths = state->channel_widths;
+  const int16_t* channel_ends = state->channel_ends;
+  const int16_t* weights = state->weights;
+  const int32_t* magnitudes = energy + state->start_index;
 
+  // Magnitudes are signed, as they always were here: one is negative only
+  // when 2^31 wrapped, and the sums wrap modulo 2^64 like the products did.
   int num_channels_plus_1 = state->num_channels + 1;
   int i;
+  int j = 0;
   for (i = 0; i < num_channels_plus_1; ++i) {
-    const int32_t* magnitudes = energy + *channel_frequency_starts++;
-    const int16_t* weights = state->weights + *channel_weight_starts;
-    const int16_t* unweights = state->unweights + *channel_weight_starts++;
-    const int width = *channel_widths++;
-    int j;
-    for (j = 0; j < width; ++j) {
-      weight_accumulator += *weights++ * ((uint64_t)*magnitudes);
-      unweight_accumulator += *unweights++ * ((uint64_t)*magnitudes);
-      ++magnitudes;
+    const int end = *channel_ends++;
+    int64_t weight_accumulator = 0;
+    int64_t energy_accumulator = 0;
+#if defined(__SSE2__)
+    if (j + 4 <= end) {
+      __m128i weight_lanes = _mm_setzero_si128();
+      __m128i energy_lanes = _mm_setzero_si128();
+      for (; j + 4 <= end; j += 4) {
+        AccumulateBins4(weights + j, magnitudes + j, &weight_lanes,
+                        &energy_lanes);
+      }
+      weight_accumulator = SumLanes(weight_lanes);
+      energy_accumulator = SumLanes(energy_lanes);
+    }
+#else
+    int64_t weight_accumulator1 = 0;
+    int64_t energy_accumulator1 = 0;
+    for (; j + 2 <= end; j += 2) {
+      weight_accumulator += (int64_t)weights[j] * magnitudes[j];
+      energy_accumulator += magnitudes[j];
+      weight_accumulator1 += (int64_t)weights[j + 1] * magnitudes[j + 1];
+      energy_accumulator1 += magnitudes[j + 1];
     }
-    *work++ = weight_accumulator;
-    weight_accumulator = unweight_accumulator;
-    unweight_accumulator = 0;
+    weight_accumulator += weight_accumulator1;
+    energy_accumulator += energy_accumulator1;
+#endif
+    for (; j < end; ++j) {
+      weight_accumulator += (int64_t)weights[j] * magnitudes[j];
+      energy_accumulator += magnitudes[j];
+    }
+    *work++ = unweight_accumulator + (uint64_t)weight_accumulator;
+    unweight_accumulator = ((uint64_t)energy_accumulator << kFilterbankBits) -
+                           (uint64_t)weight_accumulator;
+  }
+
+  const struct FilterbankUnweightFix* fix = state->unweight_fixes;
+  for (i = 0; i < state->num_unweight_fixes; ++i, ++fix) {
+    state->work[fix->channel] +=
+        (uint64_t)((int64_t)fix->delta * magnitudes[fix->bin]);
   }
 }
 
+// Floor of the square root of num > 0, its remainder num - root^2 in
+// *remainder. The root is interpolated from the square roots of num's
+// mantissa (kSqrtLut) to within one, then fixed with 32 bit products.
+static uint32_t FloorSqrt32(uint32_t num, uint32_t* remainder) {
+  const int half_shift = CountLeadingZeros32(num) >> 1;
+  const uint32_t mantissa = num << (2 * half_shift);
+  const uint32_t index = (mantissa >> 24) - kSqrtLutFirst;
+  const uint32_t position = (mantissa >> 8) & 0xFFFF;
+  const uint32_t c0 = kSqrtLut[index];
+  const uint32_t c1 = kSqrtLut[index + 1];
+  const uint32_t scaled = c0 + (((c1 - c0) * position) >> kSqrtLutBits);
+  uint32_t root = scaled >> (kSqrtLutBits - 12 + half_shift);
+  if (root * root > num) {
+    --root;
+  } else if (root < 0xFFFF && (root + 1) * (root + 1) <= num) {
+    ++root;
+  }
+  *remainder = num - root * root;
+  return root;
+}
+
 static uint16_t Sqrt32(uint32_t num) {
   if (num == 0) {
     return 0;
   }
-  uint32_t res = 0;
-  int max_bit_number = 32 - MostSignificantBit32(num);
-  max_bit_number |= 1;
-  uint32_t bit = 1U << (31 - max_bit_number);
-  int iterations = (31 - max_bit_number) / 2 + 1;
-  while (iterations--) {
-    if (num >= res + bit) {
-      num -= res + bit;
-      res = (res >> 1U) + bit;
-    } else {
-      res >>= 1U;
-    }
-    bit >>= 2U;
-  }
+  uint32_t remainder;
+  uint32_t res = FloorSqrt32(num, &remainder);
   // Do rounding - if we have the bits.
-  if (num > res && res != 0xFFFF) {
+  if (remainder > res && res != 0xFFFF) {
     ++res;
   }
   return res;
 }
 
-static uint32_t Sqrt64(uint64_t num) {
+uint32_t FilterbankRoundedSqrt(uint64_t num) {
   // Take a shortcut and just use 32 bit operations if the upper word is all
   // clear. This will cause a slight off by one issue for numbers close to 2^32,
   // but it probably isn't going to matter (and gives us a big performance win).
   if ((num >> 32) == 0) {
     return Sqrt32((uint32_t)num);
   }
-  uint64_t res = 0;
-  int max_bit_number = 64 - MostSignificantBit64(num);
-  max_bit_number |= 1;
-  uint64_t bit = 1ULL << (63 - max_bit_number);
-  int iterations = (63 - max_bit_number) / 2 + 1;
-  while (iterations--) {
-    if (num >= res + bit) {
-      num -= res + bit;
-      res = (res >> 1U) + bit;
+  // The root of the top 32 bits (from an even bit), then two bits of num more
+  // per bit of root, digit by digit: shifts and adds, no 64 bit products.
+  int shift = (MostSignificantBit64(num) - 31) & ~1;
+  uint32_t top_remainder;
+  uint32_t res = FloorSqrt32((uint32_t)(num >> shift), &top_remainder);
+  uint64_t remainder = top_remainder;
+  while (shift > 0) {
+    shift -= 2;
+    remainder = (remainder << 2) | ((num >> shift) & 3);
+    const uint64_t trial = ((uint64_t)res << 2) | 1;
+    if (remainder >= trial) {
+      remainder -= trial;
+      res = (res << 1) | 1;
     } else {
-      res >>= 1U;
+      res <<= 1;
     }
-    bit >>= 2U;
   }
   // Do rounding - if we have the bits.
-  if (num > res && res != 0xFFFFFFFFLL) {
+  if (remainder > res && res != 0xFFFFFFFF) {
     ++res;
   }
   return res;
@@ -119,13 +219,13 @@ static uint32_t Sqrt64(uint64_t num) {
 
 uint32_t* FilterbankSqrt(struct FilterbankState* state, int scale_down_shift) {
   const int num_channels = state->num_channels;
-  const int64_t* work = state->work + 1;
+  const uint64_t* work = state->work + 1;
   // Reuse the work buffer since we're fine clobbering it at this point to hold
   // the output.
   uint32_t* output = (uint32_t*)state->work;
   int i;
   for (i = 0; i < num_channels; ++i) {
-    *output++ = Sqrt64(*work++) >> scale_down_shift;
+    *output++ = FilterbankRoundedSqrt(*work++) >> scale_down_shift;
   }
   return (uint32_t*)state->work;
 }
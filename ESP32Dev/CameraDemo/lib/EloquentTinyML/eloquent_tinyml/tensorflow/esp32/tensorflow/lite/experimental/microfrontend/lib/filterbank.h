@@ -27,15 +27,27 @@ limitations under the License.
 extern "C" {
 #endif
 
+// A bin whose unweight is not (1 << kFilterbankBits) - weight, rounding made
+// it one off.
+struct FilterbankUnweightFix {
+  int16_t bin;      // counted from start_index
+  int16_t channel;  // that the unweight goes to
+  int16_t delta;    // unweight - ((1 << kFilterbankBits) - weight)
+};
+
+// The bins from start_index to end_index go to the channels in order, with
+// no padding: channel i takes the bins up to channel_ends[i] (counted from
+// start_index) times their weights, and the previous channel's bins times
+// their unweights. That sum is the total energy of those bins, shifted by
+// kFilterbankBits, minus their weighted sum, so only the weights are stored.
 struct FilterbankState {
   int num_channels;
   int start_index;
   int end_index;
-  int16_t* channel_frequency_starts;
-  int16_t* channel_weight_starts;
-  int16_t* channel_widths;
+  int16_t* channel_ends;
   int16_t* weights;
-  int16_t* unweights;
+  int num_unweight_fixes;
+  struct FilterbankUnweightFix* unweight_fixes;
   uint64_t* work;
 };
 
@@ -55,6 +67,9 @@ void FilterbankAccumulateChannels(struct FilterbankState* state,
 // next time FilterbankAccumulateChannels is called.
 uint32_t* FilterbankSqrt(struct FilterbankState* state, int scale_down_shift);
 
+// The rounded square root FilterbankSqrt takes of each channel's value.
+uint32_t FilterbankRoundedSqrt(uint64_t num);
+
 void FilterbankReset(struct FilterbankState* state);
 
 #ifdef __cplusplus
@@ -15,8 +15,48 @@ limitations under the License.
 ==============================================================================*/
 #include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/frontend.h"
 
+#include <string.h>
+
 #include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/bits.h"
 
+#if defined(FRONTEND_PROFILE) && !defined(__XTENSA__)
+#include <time.h>
+#endif
+
+const char* const kFrontendStageNames[kFrontendStageCount] = {
+    "window", "fft",   "energy", "filterbank",
+    "sqrt",   "noise", "pcan",   "log"};
+
+#if defined(FRONTEND_PROFILE)
+static uint32_t ProfileClock(void) {
+#if defined(__XTENSA__)
+  uint32_t ccount;
+  __asm__ __volatile__("rsr %0, ccount" : "=r"(ccount));
+  return ccount;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)now.tv_sec * 1000000000u + (uint32_t)now.tv_nsec;
+#endif
+}
+
+// Charges the time since *start to stage, the next stage starts now.
+static void ProfileStage(struct FrontendState* state, enum FrontendStage stage,
+                         uint32_t* start) {
+  const uint32_t now = ProfileClock();
+  state->profile.cycles[stage] += now - *start;
+  *start = now;
+}
+
+#define PROFILE_BEGIN() uint32_t profile_start = ProfileClock()
+#define PROFILE_STAGE(stage) ProfileStage(state, stage, &profile_start)
+#define PROFILE_FRAME() ++state->profile.frames
+#else
+#define PROFILE_BEGIN()
+#define PROFILE_STAGE(stage)
+#define PROFILE_FRAME()
+#endif
+
 struct FrontendOutput FrontendProcessSamples(struct FrontendState* state,
                                              const int16_t* samples,
                                              size_t num_samples,
@@ -24,34 +64,44 @@ struct FrontendOutput FrontendProcessSamples(struct FrontendState* state,
   struct FrontendOutput output;
   output.values = NULL;
   output.size = 0;
+  PROFILE_BEGIN();
 
   // Try to apply the window - if it fails, return and wait for more data.
-  if (!WindowProcessSamples(&state->window, samples, num_samples,
-                            num_samples_read)) {
+  const int windowed = WindowProcessSamples(&state->window, samples,
+                                            num_samples, num_samples_read);
+  PROFILE_STAGE(kFrontendStageWindow);
+  if (!windowed) {
     return output;
   }
+  PROFILE_FRAME();
 
   // Apply the FFT to the window's output (and scale it so that the fixed point
   // FFT can have as much resolution as possible).
   int input_shift =
       15 - MostSignificantBit32(state->window.max_abs_output_value);
   FftCompute(&state->fft, state->window.output, input_shift);
+  PROFILE_STAGE(kFrontendStageFft);
 
   // We can re-ruse the fft's output buffer to hold the energy.
   int32_t* energy = (int32_t*)state->fft.output;
 
   FilterbankConvertFftComplexToEnergy(&state->filterbank, state->fft.output,
                                       energy);
+  PROFILE_STAGE(kFrontendStageEnergy);
 
   FilterbankAccumulateChannels(&state->filterbank, energy);
+  PROFILE_STAGE(kFrontendStageFilterbank);
   uint32_t* scaled_filterbank = FilterbankSqrt(&state->filterbank, input_shift);
+  PROFILE_STAGE(kFrontendStageSqrt);
 
   // Apply noise reduction.
   NoiseReductionApply(&state->noise_reduction, scaled_filterbank);
+  PROFILE_STAGE(kFrontendStageNoiseReduction);
 
   if (state->pcan_gain_control.enable_pcan) {
     PcanGainControlApply(&state->pcan_gain_control, scaled_filterbank);
   }
+  PROFILE_STAGE(kFrontendStagePcan);
 
   // Apply the log and scale.
   int correction_bits =
@@ -59,6 +109,7 @@ struct FrontendOutput FrontendProcessSamples(struct FrontendState* state,
   uint16_t* logged_filterbank =
       LogScaleApply(&state->log_scale, scaled_filterbank,
                     state->filterbank.num_channels, correction_bits);
+  PROFILE_STAGE(kFrontendStageLog);
 
   output.size = state->filterbank.num_channels;
   output.values = logged_filterbank;
@@ -72,4 +123,8 @@ void FrontendReset(struct FrontendState* state) {
   NoiseReductionReset(&state->noise_reduction);
 }
 
+void FrontendResetProfile(struct FrontendState* state) {
+  memset(&state->profile, 0, sizeof(state->profile));
+}
+
 #endif // end of #if defined(ESP32)
\ No newline at end of file
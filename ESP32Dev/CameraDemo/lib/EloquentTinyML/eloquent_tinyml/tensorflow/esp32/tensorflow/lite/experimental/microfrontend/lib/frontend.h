@@ -30,6 +30,30 @@ limitations under the License.
 extern "C" {
 #endif
 
+// The stages of FrontendProcessSamples(), in order.
+enum FrontendStage {
+  kFrontendStageWindow = 0,
+  kFrontendStageFft,
+  kFrontendStageEnergy,
+  kFrontendStageFilterbank,
+  kFrontendStageSqrt,
+  kFrontendStageNoiseReduction,
+  kFrontendStagePcan,
+  kFrontendStageLog,
+  kFrontendStageCount
+};
+
+extern const char* const kFrontendStageNames[kFrontendStageCount];
+
+// Time spent in each stage since the last FrontendResetProfile(), only
+// counted in builds with FRONTEND_PROFILE defined: CPU cycles on the Xtensa
+// cores (CCOUNT), nanoseconds elsewhere. Calls that leave the window
+// incomplete count towards kFrontendStageWindow, not towards frames.
+struct FrontendProfile {
+  uint32_t frames;
+  uint64_t cycles[kFrontendStageCount];
+};
+
 struct FrontendState {
   struct WindowState window;
   struct FftState fft;
@@ -37,6 +61,7 @@ struct FrontendState {
   struct NoiseReductionState noise_reduction;
   struct PcanGainControlState pcan_gain_control;
   struct LogScaleState log_scale;
+  struct FrontendProfile profile;
 };
 
 struct FrontendOutput {
@@ -58,6 +83,8 @@ struct FrontendOutput FrontendProcessSamples(struct FrontendState* state,
 
 void FrontendReset(struct FrontendState* state);
 
+void FrontendResetProfile(struct FrontendState* state);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -29,7 +29,7 @@ limitations under the License.
 
 static uint32_t Log2FractionPart(const uint32_t x, const uint32_t log2x) {
   // Part 1
-  int32_t frac = x - (1LL << log2x);
+  int32_t frac = x - (1U << log2x);
   if (log2x < kLogScaleLog2) {
     frac <<= kLogScaleLog2 - log2x;
   } else {
@@ -47,12 +47,14 @@ static uint32_t Log2FractionPart(const uint32_t x, const uint32_t log2x) {
   return frac + c0 + rel_pos;
 }
 
-static uint32_t Log(const uint32_t x, const uint32_t scale_shift) {
+uint32_t LogScaleLog(const uint32_t x, const uint32_t scale_shift) {
   const uint32_t integer = MostSignificantBit32(x) - 1;
   const uint32_t fraction = Log2FractionPart(x, integer);
-  const uint32_t log2 = (integer << kLogScaleLog2) + fraction;
   const uint32_t round = kLogScale / 2;
-  const uint32_t loge = (((uint64_t)kLogCoeff) * log2 + round) >> kLogScaleLog2;
+  // kLogCoeff * ((integer << kLogScaleLog2) + fraction), rounded and shifted
+  // back, without a 64 bit product: the integer part goes through exactly.
+  const uint32_t loge =
+      kLogCoeff * integer + ((kLogCoeff * fraction + round) >> kLogScaleLog2);
   // Finally scale to our output scale
   const uint32_t loge_scaled = ((loge << scale_shift) + round) >> kLogScaleLog2;
   return loge_scaled;
@@ -64,19 +66,21 @@ uint16_t* LogScaleApply(struct LogScaleState* state, uint32_t* signal,
   uint16_t* output = (uint16_t*)signal;
   uint16_t* ret = output;
   int i;
+  if (!state->enable_log) {
+    for (i = 0; i < signal_size; ++i) {
+      const uint32_t value = *signal++;
+      *output++ = (value < kuint16max) ? value : kuint16max;
+    }
+    return ret;
+  }
+  const int right_shift = correction_bits < 0 ? -correction_bits : 0;
+  const int left_shift = correction_bits < 0 ? 0 : correction_bits;
   for (i = 0; i < signal_size; ++i) {
-    uint32_t value = *signal++;
-    if (state->enable_log) {
-      if (correction_bits < 0) {
-        value >>= -correction_bits;
-      } else {
-        value <<= correction_bits;
-      }
-      if (value > 1) {
-        value = Log(value, scale_shift);
-      } else {
-        value = 0;
-      }
+    uint32_t value = (*signal++ >> right_shift) << left_shift;
+    if (value > 1) {
+      value = LogScaleLog(value, scale_shift);
+    } else {
+      value = 0;
     }
     *output++ = (value < kuint16max) ? value : kuint16max;
   }
@@ -33,6 +33,10 @@ struct LogScaleState {
 uint16_t* LogScaleApply(struct LogScaleState* state, uint32_t* signal,
                         int signal_size, int correction_bits);
 
+// The fixed point natural logarithm of x > 1 LogScaleApply takes, scaled by
+// 2^scale_shift, in 32 bit arithmetic.
+uint32_t LogScaleLog(uint32_t x, uint32_t scale_shift);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -0,0 +1,40 @@
+#if defined(ESP32)
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_SQRT_LUT_H_
+#define TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_SQRT_LUT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Square roots of the normalised mantissas of an integer: the top 8 bits of
+// it shifted by an even count into [2^30, 2^32), so from 64 to 255. Entry i
+// is sqrt(kSqrtLutFirst + i) in 16 bit fixed point, the table has one more
+// entry (256) to interpolate the last segment.
+#define kSqrtLutFirst 64
+#define kSqrtLutBits 16
+
+extern const uint32_t kSqrtLut[];
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // TENSORFLOW_LITE_EXPERIMENTAL_MICROFRONTEND_LIB_SQRT_LUT_H_
+
+#endif // end of #if defined(ESP32)
\ No newline at end of file
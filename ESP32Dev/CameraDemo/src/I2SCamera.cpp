@@ -25,6 +25,8 @@ int I2SCamera::dmaBufferCount = 0;
 int I2SCamera::dmaBufferActive = 0;
 DMABuffer **I2SCamera::dmaBuffer = 0;
 unsigned char* I2SCamera::frame = 0;
+unsigned char* I2SCamera::frameAllocation = 0;
+int I2SCamera::frameHeadroom = 0;
 int I2SCamera::framePointer = 0;
 int I2SCamera::frameBytes = 0;
 volatile bool I2SCamera::stopSignal = false;
@@ -126,25 +128,39 @@ void I2SCamera::deinitVSync()
   esp_intr_disable(vSyncInterruptHandle);
 }
 
-bool I2SCamera::init(const int XRES, const int YRES, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7)
+//frame and DMA buffers for a resolution, the previous ones are freed, so a
+//camera can change mode without being initialized again
+bool I2SCamera::allocate(const int XRES, const int YRES)
 {
   xres = XRES;
   yres = YRES;
   frameBytes = XRES * blockSlice * 2;
 
-  if (frame) {
-    free (frame);
+  if (frameAllocation) {
+    free (frameAllocation);
+    frameAllocation = 0;
+    frame = 0;
     Serial.printf("frame memory freed\n");
   }
   
-  frame = (unsigned char*)malloc(frameBytes);
-  if(!frame)
+  //frameHeadroom bytes are reserved in front of the frame, so senders can
+  //prepend their headers without copying the pixels
+  frameAllocation = (unsigned char*)malloc(frameHeadroom + frameBytes);
+  if(!frameAllocation)
   {
     DEBUG_PRINTLN("Not enough memory for frame buffer!");
     return false;
   }
-  i2sInit(VSYNC, HREF, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
+  frame = frameAllocation + frameHeadroom;
   dmaBufferInit(xres * 2 * 2);  //two bytes per dword packing, two bytes per pixel
+  return true;
+}
+
+bool I2SCamera::init(const int XRES, const int YRES, const int VSYNC, const int HREF, const int XCLK, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7)
+{
+  if (!allocate(XRES, YRES))
+    return false;
+  i2sInit(VSYNC, HREF, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
   initVSync(VSYNC);
   return true;
 }
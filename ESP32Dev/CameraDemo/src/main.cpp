@@ -1,4 +1,5 @@
 #include "OV7670.h"
+#include "FrameStream.h"
 
 #include <WebSockets.h>
 #include <WebSocketsClient.h>
@@ -33,7 +34,8 @@ const int D5 = 13;
 const int D6 = 12;
 const int D7 = 4;
 
-OV7670 *camera;
+OV7670 *camera = 0;
+OV7670::Mode cameraMode;
 
 WiFiMulti wifiMulti;
 WiFiServer server(80);
@@ -42,84 +44,99 @@ unsigned char pix = 0;
 
 //unsigned char bmpHeader[BMP::headerSize];
 
-unsigned char start_flag = 0xAA;
-unsigned char end_flag = 0xFF;
 unsigned char ip_flag = 0x11;
 
 WebSocketsServer webSocket(81);    // create a websocket server on port 81
 
+// Streaming: encoding, quality and frames sent ahead of the client acks
+
+#define STREAM_ENCODING FrameStream::RLE
+#define STREAM_QUALITY FrameEncoder::QUALITY_MEDIUM
+#define STREAM_WINDOW 2
+#define STREAM_MAX_BAND_PIXELS (640 * 60)
+#define STATS_INTERVAL 5000
+
+FrameStream stream(webSocket);
+unsigned long lastStats = 0;
+
+// Switch the camera mode only when it changes: the camera is created once,
+// later modes reconfigure it and reallocate its buffers
+
+bool setMode(OV7670::Mode mode)
+{
+  if (camera && cameraMode == mode && I2SCamera::frame)
+    return true;
+
+  cameraMode = mode;
+  if (!camera)
+    camera = new OV7670(mode, SIOD, SIOC, VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
+  else
+    camera->setMode(mode);
+
+  return I2SCamera::frame != 0;
+}
+
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t payloadlength) { // When a WebSocket message is received
  
-  int blk_count = 0;
-
   char canvas_VGA[] = "canvas-VGA";
   char canvas_Q_VGA[] = "canvas-Q-VGA";
   char canvas_QQ_VGA[] = "canvas-QQ-VGA";
   char canvas_QQQ_VGA[] = "canvas-QQQ-VGA";
+  char next_frame[] = "next-frame";
   char ipaddr[26] ;
   IPAddress localip;
   
   switch (type) {
     case WStype_DISCONNECTED:             // if the websocket is disconnected
       Serial.printf("[%u] Disconnected!\n", num);
+      if (stream.isStreaming() && stream.getClient() == num) {
+        stream.stop();
+      }
       break;
     case WStype_CONNECTED: {              // if a new websocket connection is established
         IPAddress ip = webSocket.remoteIP(num);
         Serial.printf("[%u] Connected from %d.%d.%d.%d url: %s\n", num, ip[0], ip[1], ip[2], ip[3], payload);
-           webSocket.sendBIN(0, &ip_flag, 1);
+           webSocket.sendBIN(num, &ip_flag, 1);
            localip = WiFi.localIP();
            sprintf(ipaddr, "%d.%d.%d.%d", localip[0], localip[1], localip[2], localip[3]);
-           webSocket.sendTXT(0, (const char *)ipaddr);
+           webSocket.sendTXT(num, (const char *)ipaddr);
            
       }
       break;
-    case WStype_TEXT:                     // if new text data is received
-      if (payloadlength == sizeof(canvas_QQQ_VGA)-1) {
-        if (memcmp(canvas_QQQ_VGA, payload, payloadlength) == 0) {
-              Serial.printf("canvas_QQQ_VGA");
-              webSocket.sendBIN(0, &end_flag, 1);
-              camera = new OV7670(OV7670::Mode::QQQVGA_RGB565, SIOD, SIOC, VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
-        }
-      } else if (payloadlength == sizeof(canvas_QQ_VGA)-1) {
-        if (memcmp(canvas_QQ_VGA, payload, payloadlength) == 0) {
-              Serial.printf("canvas_QQ_VGA");
-              webSocket.sendBIN(0, &end_flag, 1);
-              camera = new OV7670(OV7670::Mode::QQVGA_RGB565, SIOD, SIOC, VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
-        }
-      } else if (payloadlength == sizeof(canvas_Q_VGA)-1) {
-        if (memcmp(canvas_Q_VGA, payload, payloadlength) == 0) {
-              Serial.printf("canvas_Q_VGA");
-              webSocket.sendBIN(0, &end_flag, 1);
-              camera = new OV7670(OV7670::Mode::QVGA_RGB565, SIOD, SIOC, VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
-        }
-      } else if (payloadlength == sizeof(canvas_VGA)-1) {
-        if (memcmp(canvas_VGA, payload, payloadlength) == 0) {
-              Serial.printf("canvas_VGA");
-              webSocket.sendBIN(0, &end_flag, 1);
-              camera = new OV7670(OV7670::Mode::VGA_RGB565, SIOD, SIOC, VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
-        }
-      } 
+    case WStype_TEXT: {                   // if new text data is received
+      OV7670::Mode mode;
 
-      
-      blk_count = camera->yres/I2SCamera::blockSlice;//30, 60, 120
-      for (int i=0; i<blk_count; i++) {
+      if (payloadlength == sizeof(next_frame)-1 && memcmp(next_frame, payload, payloadlength) == 0) {
+        // the client drew a frame, allow one more
+        stream.grant();
+        break;
+      }
 
-          if (i == 0) {
-              camera->startBlock = 1;
-              camera->endBlock = I2SCamera::blockSlice;
-              webSocket.sendBIN(0, &start_flag, 1);
-          }
+      if (payloadlength == sizeof(canvas_QQQ_VGA)-1 && memcmp(canvas_QQQ_VGA, payload, payloadlength) == 0) {
+        Serial.printf("canvas_QQQ_VGA");
+        mode = OV7670::Mode::QQQVGA_RGB565;
+      } else if (payloadlength == sizeof(canvas_QQ_VGA)-1 && memcmp(canvas_QQ_VGA, payload, payloadlength) == 0) {
+        Serial.printf("canvas_QQ_VGA");
+        mode = OV7670::Mode::QQVGA_RGB565;
+      } else if (payloadlength == sizeof(canvas_Q_VGA)-1 && memcmp(canvas_Q_VGA, payload, payloadlength) == 0) {
+        Serial.printf("canvas_Q_VGA");
+        mode = OV7670::Mode::QVGA_RGB565;
+      } else if (payloadlength == sizeof(canvas_VGA)-1 && memcmp(canvas_VGA, payload, payloadlength) == 0) {
+        Serial.printf("canvas_VGA");
+        mode = OV7670::Mode::VGA_RGB565;
+      } else {
+        break;
+      }
 
-          if (i == blk_count-1) {
-              webSocket.sendBIN(0, &end_flag, 1);
-          }
-        
-          camera->oneFrame();
-          webSocket.sendBIN(0, camera->frame, camera->xres * I2SCamera::blockSlice * 2);
-          camera->startBlock += I2SCamera::blockSlice;
-          camera->endBlock   += I2SCamera::blockSlice;
+      if (!setMode(mode)) {
+        Serial.printf("Not enough memory for the frame buffer\n");
+        stream.stop();
+        break;
+      }
+
+      // frames are sent band by band from loop()
+      stream.start(num, camera, STREAM_WINDOW);
       }
-      
       break;
     case WStype_ERROR:                     // if new text data is received
       Serial.printf("Error \n");
@@ -210,6 +227,8 @@ void initWifiAP() {
 
 void setup() {
   Serial.begin(9600);
+  I2SCamera::frameHeadroom = FrameStream::headroom(STREAM_MAX_BAND_PIXELS);
+  stream.setEncoding(STREAM_ENCODING, STREAM_QUALITY);
   //initWifiMulti();
   initWifiAP();
   startWebSocket();
@@ -219,5 +238,11 @@ void setup() {
 void loop()
 {
   webSocket.loop();
+  stream.loop();
   serve();
+
+  if (stream.isStreaming() && millis() - lastStats >= STATS_INTERVAL) {
+    lastStats = millis();
+    Serial.printf("Streaming %.1f fps, %u frames, %.2f bytes per raw byte\n", stream.getFramesPerSecond(), stream.getFramesSent(), stream.getCompressionRatio());
+  }
 }
\ No newline at end of file
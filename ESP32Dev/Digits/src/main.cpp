@@ -1,13 +1,46 @@
 #include <WiFi.h>
-#include <EloquentTinyML.h>
+#include <ModelRuntime.h>
+#include <Telemetry.h>
+#include <TelemetryBatch.h>
+#include <HeapStats.h>
+#include <Benchmark.h>
+#include <LatencyHistogram.h>
+#include <LogQueue.h>
+#include <FlashRing.h>
+#include <FileFlash.h>
+#include <TelemetryBacklog.h>
+#include <SPIFFS.h>
+#include <ModelStore.h>
+#include <ModelUpdate.h>
+#include <PartitionFlash.h>
+#include <Preferences.h>
 #include "digits_model.h"
-#include "esp_timer.h"
 
 #define NUMBER_OF_INPUTS 64
 #define NUMBER_OF_OUTPUTS 10
 #define TENSOR_ARENA_SIZE 8 * 1024
 
-Eloquent::TinyML::TfLite<NUMBER_OF_INPUTS, NUMBER_OF_OUTPUTS, TENSOR_ARENA_SIZE> tf;
+uint8_t tensorArena[TENSOR_ARENA_SIZE];
+ModelRuntime tf(tensorArena, TENSOR_ARENA_SIZE, NUMBER_OF_INPUTS, NUMBER_OF_OUTPUTS);
+
+// Model slots: a model with the same inputs and outputs, packed with
+// Models/pack_model.py, replaces the compiled-in one without rebuilding the
+// firmware. It is mapped through the flash cache, so the interpreter reads it
+// in place. Updates sent with modelPublisher.py are written to the slot not
+// in use and swapped in between two benchmark runs
+
+#define MODEL_SLOT_0 "model0"
+#define MODEL_SLOT_1 "model1"
+#define NO_SLOT 0xFF
+#define MODEL_STATUS_BUFFER_SIZE 192
+
+ModelStore modelStores[] = {MODEL_SLOT_0, MODEL_SLOT_1};
+PartitionFlash modelPartitions[] = {MODEL_SLOT_0, MODEL_SLOT_1};
+ModelUpdate modelUpdate;
+Preferences modelPreferences;
+uint8_t activeSlot = NO_SLOT;
+uint16_t reportedUpdate = 0;
+char modelStatusBuffer[MODEL_STATUS_BUFFER_SIZE];
 
 // FreeRTOS timers
 
@@ -39,6 +72,60 @@ TimerHandle_t wifiReconnectTimer;
 
 int currentIteration = 0;
 
+// Benchmark: untimed warm-up runs, timed runs per loop and whether
+// interrupts are masked while an inference is timed
+
+#define BENCHMARK_WARMUP 3
+#define BENCHMARK_RUNS 10
+#define BENCHMARK_MASK_INTERRUPTS 0
+
+Benchmark<BENCHMARK_RUNS> benchmark(BENCHMARK_WARMUP, BENCHMARK_MASK_INTERRUPTS);
+
+// Histogram of every timed inference, published as a summary every
+// STATS_INTERVAL ms. With REPORT_SAMPLES 0 single inferences are neither
+// printed nor sent, so with LOOP_DELAY 0 the benchmark runs back to back
+
+#define STATS_INTERVAL 60000
+#define STATS_BUFFER_SIZE 256
+#define REPORT_SAMPLES 1
+#define LOOP_DELAY 5000
+
+LatencyHistogram<> histogram;
+char statsBuffer[STATS_BUFFER_SIZE];
+// modelUpdate's flash operations when the window started
+uint32_t windowFlashOperations = 0;
+
+// Telemetry: records per binary batch and the longest time a record waits
+// before its batch is flushed. With 0 every inference is published as JSON,
+// serialized into a static buffer instead of String temporaries
+
+#define TELEMETRY_BATCH_SIZE 50
+#define TELEMETRY_FLUSH_INTERVAL 60000
+
+#if TELEMETRY_BATCH_SIZE > 0
+TelemetryBatch<TELEMETRY_BATCH_SIZE> telemetryBatch("esp32dev", "digits");
+#else
+#define TELEMETRY_BUFFER_SIZE 128
+
+TelemetryRecord<> telemetry("esp32dev", "digits");
+char telemetryBuffer[TELEMETRY_BUFFER_SIZE];
+#endif
+
+// Batches kept in a flash ring while MQTT is down (0 sectors disables it)
+// and how many stored batches are sent per loop once it is back
+
+#define TELEMETRY_STORE_SECTORS 16
+#define TELEMETRY_DRAIN_BATCHES 5
+// how long a stored batch waits for its PUBACK before the loop goes on
+#define TELEMETRY_ACK_TIMEOUT 500
+#define TELEMETRY_STORE (TELEMETRY_BATCH_SIZE > 0 && TELEMETRY_STORE_SECTORS > 0)
+
+#if TELEMETRY_STORE
+FileFlash telemetryFile(SPIFFS, "/telemetry.bin", TELEMETRY_STORE_SECTORS);
+FlashRing telemetryRing(telemetryFile);
+TelemetryBacklog telemetryStore(telemetryRing);
+#endif
+
 // Elements for evaluation
 
 float x_test[64] = {0., 0., 0.625, 0.875, 0.5, 0.0625, 0., 0.,
@@ -96,6 +183,7 @@ void onMqttConnect(bool sessionPresent)
   Serial.println("Connected to MQTT.");
   Serial.print("Session present: ");
   Serial.println(sessionPresent);
+  mqttClient.subscribe("iotdemo.esp32dev.model", 1);
 }
 
 // Callback for mqtt disconnection
@@ -104,12 +192,41 @@ void onMqttDisconnect(AsyncMqttClientDisconnectReason reason)
 {
   Serial.println("Disconnected from MQTT.");
 
+#if TELEMETRY_STORE
+  telemetryStore.disconnected();
+#endif
+
   if (WiFi.isConnected())
   {
     xTimerStart(mqttReconnectTimer, 0);
   }
 }
 
+// Callback for a PUBACK, an acknowledged stored batch leaves the store on
+// the next drain
+
+#if TELEMETRY_STORE
+void onMqttPublish(uint16_t packetId)
+{
+  telemetryStore.acknowledged(packetId);
+}
+#endif
+
+// Callback for mqtt messages, only model updates are subscribed. It runs in
+// the MQTT task: chunks go straight to flash, the swap waits for loop()
+
+void onMqttMessage(char *topic, char *payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total)
+{
+  modelUpdate.onMessage((const uint8_t *)payload, len, index, total);
+}
+
+// Slot the next update is written to, never the one mapped
+
+uint8_t targetSlot()
+{
+  return activeSlot == 0 ? 1 : 0;
+}
+
 // Setup method
 
 void setup()
@@ -119,7 +236,30 @@ void setup()
 
   // TensorFlow initialization
 
-  tf.begin(digits_model);
+  modelPreferences.begin("model", false);
+  modelPartitions[0].begin();
+  modelPartitions[1].begin();
+
+  // the slot swapped in last, if its image is still valid
+  const uint8_t slot = modelPreferences.getUChar("slot", 0) % 2;
+
+  if (modelStores[slot].open() && tf.begin(modelStores[slot].model()))
+  {
+    activeSlot = slot;
+    Serial.print("Model version ");
+    Serial.print(modelStores[slot].version());
+    Serial.print(" from slot ");
+    Serial.println(slot);
+  }
+  else
+  {
+    Serial.print("Built-in model: ");
+    Serial.println(modelStores[slot].isOpen() ? tf.errorMessage() : modelStores[slot].errorMessage());
+    modelStores[slot].close();
+    tf.begin(digits_model);
+  }
+
+  modelUpdate.setTarget(modelPartitions[targetSlot()]);
 
   // check if model loaded fine
   if (!tf.initialized())
@@ -136,69 +276,262 @@ void setup()
 
   mqttClient.onConnect(onMqttConnect);
   mqttClient.onDisconnect(onMqttDisconnect);
+#if TELEMETRY_STORE
+  mqttClient.onPublish(onMqttPublish);
+#endif
+  mqttClient.onMessage(onMqttMessage);
   mqttClient.setServer(MQTT_HOST, MQTT_PORT);
 
+#if TELEMETRY_BATCH_SIZE > 0
+  telemetryBatch.setFlush(TELEMETRY_BATCH_SIZE, TELEMETRY_FLUSH_INTERVAL);
+#endif
+
+#if TELEMETRY_STORE
+  if (SPIFFS.begin(true) && telemetryFile.begin() && telemetryStore.begin())
+  {
+    Serial.print("Telemetry backlog: ");
+    Serial.print(telemetryStore.pending());
+    Serial.println(" batches");
+  }
+  else
+    Serial.println("Telemetry store not available.");
+#endif
+
   connectToWifi();
 }
 
+// Publish the pending records as one binary batch, retain is off since the
+// reader tells batches apart by their sequence number
+
+#if TELEMETRY_BATCH_SIZE > 0
+void publishBatch()
+{
+  size_t length;
+  const uint8_t *frame = telemetryBatch.encode(millis(), length);
+
+  if (frame == NULL)
+    return;
+
+#if TELEMETRY_STORE
+  // behind the backlog while it drains, so batches reach the reader in order
+  if (!mqttClient.connected() || telemetryStore.pending() > 0)
+  {
+    if (!telemetryStore.store(frame, length))
+      LOG_ERROR("Telemetry store write failed.");
+    LOG_INFO("Batch stored, backlog: %u batches, dropped: %u", telemetryStore.pending(), telemetryStore.dropped());
+    return;
+  }
+#endif
+
+  uint32_t publishStart = micros();
+  uint16_t packetId = mqttClient.publish("iotdemo.esp32dev.batch", 1, false, (const char *)frame, length);
+  uint32_t publishTime = micros() - publishStart;
+  LOG_INFO("Batch sent with packetId: %u, %u bytes", packetId, length);
+  LOG_INFO("Publish time: %u microseconds", publishTime);
+  HeapStats::read().log();
+}
+#endif
+
+// Send stored batches oldest first, a few per loop so the broker and the radio
+// are not flooded after a long outage. A batch leaves the store on its PUBACK,
+// one is in flight at a time and the loop waits a little for each.
+
+#if TELEMETRY_STORE
+void drainBacklog()
+{
+  static uint8_t frame[TelemetryBatch<TELEMETRY_BATCH_SIZE>::maxFrameSize];
+
+  for (uint8_t i = 0; i < TELEMETRY_DRAIN_BATCHES && mqttClient.connected(); i++)
+  {
+    uint16_t length = telemetryStore.next(frame, sizeof(frame), millis());
+
+    if (length == 0)
+      return;
+
+    uint16_t packetId = mqttClient.publish("iotdemo.esp32dev.batch", 1, false, (const char *)frame, length);
+    if (packetId == 0)
+      return;
+
+    telemetryStore.sent(packetId);
+    for (uint32_t start = millis(); telemetryStore.waiting() && mqttClient.connected() && millis() - start < TELEMETRY_ACK_TIMEOUT;)
+      delay(1);
+  }
+
+  LOG_INFO("Telemetry backlog: %u batches", telemetryStore.pending());
+}
+#endif
+
+// Start a new latency window
+
+void resetStats(uint32_t now)
+{
+  histogram.reset(now);
+  windowFlashOperations = modelUpdate.getFlashOperations();
+}
+
+// Publish the latency summary once per window, retained so a late subscriber
+// gets the last one. While offline the window keeps growing
+
+void publishStats()
+{
+  uint32_t now = millis();
+
+  if (histogram.count() == 0 || now - histogram.getWindowStart() < STATS_INTERVAL || !mqttClient.connected())
+    return;
+
+  // an update erased or wrote the flash during the window, stalling the
+  // inferences: its latencies are not the model's
+  if (modelUpdate.getFlashOperations() != windowFlashOperations)
+  {
+    LOG_INFO("Latency window dropped, a model update wrote the flash");
+    resetStats(now);
+    return;
+  }
+
+  if (histogram.toJson(statsBuffer, sizeof(statsBuffer), "esp32dev", "digits", now) == 0)
+    return;
+
+  mqttClient.publish("iotdemo.esp32dev.stats", 1, true, statsBuffer);
+  LOG_INFO("%s", statsBuffer);
+  resetStats(now);
+}
+
+// Swap in a model received over MQTT. Called between two benchmark runs, so
+// no inference is in flight; the previous model stays mapped until the new one
+// runs, and keeps running if the new one is refused
+
+void swapModel()
+{
+  if (modelUpdate.getState() != ModelUpdate::READY)
+    return;
+
+  const uint8_t slot = targetSlot();
+
+  if (!modelStores[slot].open() || !tf.load(modelStores[slot].model()))
+  {
+    LOG_ERROR("Model update refused: %s", modelStores[slot].isOpen() ? tf.errorMessage() : modelStores[slot].errorMessage());
+    modelStores[slot].close();
+    modelUpdate.activate(false);
+    return;
+  }
+
+  if (activeSlot != NO_SLOT)
+    modelStores[activeSlot].close();
+
+  activeSlot = slot;
+  modelPreferences.putUChar("slot", slot);
+  modelUpdate.setTarget(modelPartitions[targetSlot()]);
+  modelUpdate.activate(true);
+
+  // latencies of two models don't share a window
+  resetStats(millis());
+
+  LOG_INFO("Model version %u active from slot %u", modelStores[slot].version(), slot);
+}
+
+// Publish the update state when it changes, retained so a late subscriber
+// sees the last outcome
+
+void publishModelStatus()
+{
+  uint16_t changes = modelUpdate.getChanges();
+
+  if (changes == reportedUpdate || !mqttClient.connected())
+    return;
+
+  if (modelUpdate.toJson(modelStatusBuffer, sizeof(modelStatusBuffer), "esp32dev", "digits") == 0)
+    return;
+
+  mqttClient.publish("iotdemo.esp32dev.model.status", 1, true, modelStatusBuffer);
+  LOG_INFO("%s", modelStatusBuffer);
+  reportedUpdate = changes;
+}
+
 // Loop method
 
 void loop()
 {
-  if (WiFi.isConnected() && mqttClient.connected())
-  {
-    // Runs a loop of 10 iterations, at every one it sends the result (if enabled)
+  // between two benchmark runs, no inference is in flight
+  swapModel();
+  publishModelStatus();
 
-    for (uint8_t i = 0; i < 10; i++)
-    {
+  bool online = WiFi.isConnected() && mqttClient.connected();
 
-      currentIteration += 1; // To keep track of iterations between loops
+#if TELEMETRY_STORE
+  // stored batches go first, new ones queue behind them
+  if (online)
+    drainBacklog();
+#endif
+
+  // with the flash store evaluation keeps running while offline
+  if (online || TELEMETRY_STORE)
+  {
+    // Runs BENCHMARK_RUNS timed iterations, then reports every one (if enabled)
 
-      Serial.print("Started evaluating");
+    // Warm-up and timed runs first, only the inference is inside the timed region
 
-      int start = esp_timer_get_time(); // Evaluation start time
+    benchmark.run([](uint16_t i) {
       tf.predict(x_test, y_pred);
-      int end = esp_timer_get_time() - start; // Evaluation end time
+    });
 
-      Serial.print("Test output is: ");
-      Serial.println(y_test);
-      Serial.print("Predicted probabilities are: ");
+    for (uint8_t i = 0; i < BENCHMARK_RUNS; i++)
+    {
 
-      for (int i = 0; i < 10; i++)
-      {
-        Serial.print(y_pred[i]);
-        Serial.print(i == 9 ? '\n' : ',');
-      }
+      currentIteration += 1; // To keep track of iterations between loops
 
-      Serial.print("Predicted class is: ");
-      uint8_t prediction = tf.probaToClass(y_pred);
-      Serial.println(prediction);
-      Serial.print("Sanity check: ");
-      Serial.println(tf.predictClass(x_test));
-      Serial.println("Evaluation time: " + String(end) + " microseconds");
+      histogram.record(benchmark.getMicroseconds(i));
 
-      //{"board": "esp32dev", "model": "digits", "result": 1, "iteration": 1, "microseconds": 120}
+#if REPORT_SAMPLES
+      uint32_t end = benchmark.getMicroseconds(i); // Evaluation time
 
-      String startPar = "{";
-      String board = "\"board\":\"esp32dev\",";
-      String model = "\"model\":\"digits\",";
-      String result = "\"result\":" + String(prediction) + ",";
-      String iteration = "\"iteration\":" + String(int(currentIteration)) + ",";
-      String time = "\"microseconds\":" + String(int(end));
-      String endPar = "}";
+      uint8_t prediction = tf.probaToClass(y_pred);
+      LOG_DEBUG("Sample #%u: predicted %u vs %d actual, %u microseconds", i + 1, prediction, y_test, end);
 
-      String resultString = startPar + board + model + result + iteration + time + endPar;
+      //{"board": "esp32dev", "model": "digits", "result": 1, "iteration": 1, "microseconds": 120}
 
-      uint16_t packetId = mqttClient.publish("iotdemo.esp32dev", 1, true, (char *)resultString.c_str());
-      Serial.print("Message sent with packetId: ");
-      Serial.println(packetId);
+#if TELEMETRY_BATCH_SIZE > 0
+      telemetryBatch.add(prediction, currentIteration, end, millis());
+#else
+      telemetry.setResult(prediction);
+      telemetry.setIteration(currentIteration);
+      telemetry.setMicroseconds(end);
+
+      uint32_t publishStart = micros();
+      if (telemetry.toJson(telemetryBuffer, sizeof(telemetryBuffer)) == 0)
+        LOG_ERROR("Telemetry record larger than %u bytes, not sent", sizeof(telemetryBuffer));
+      else
+      {
+        uint16_t packetId = mqttClient.publish("iotdemo.esp32dev", 1, true, telemetryBuffer);
+        uint32_t publishTime = micros() - publishStart;
+        LOG_INFO("Message sent with packetId: %u", packetId);
+        LOG_INFO("Publish time: %u microseconds", publishTime);
+      }
+      HeapStats::read().log();
       delay(100);
+#endif
+#endif
     }
+
+#if REPORT_SAMPLES
+    LOG_DEBUG("Predicted probabilities are: %f,%f,%f,%f,%f,%f,%f,%f,%f,%f", y_pred[0], y_pred[1], y_pred[2], y_pred[3], y_pred[4],
+              y_pred[5], y_pred[6], y_pred[7], y_pred[8], y_pred[9]);
+    benchmark.stats().log();
+#endif
+
+#if TELEMETRY_BATCH_SIZE > 0
+    if (telemetryBatch.shouldFlush(millis()))
+      publishBatch();
+#endif
+
+    publishStats();
   }
   else
   {
-    Serial.println("WiFi or MQTT not connected, waiting before running evaluation.");
+    LOG_INFO("WiFi or MQTT not connected, waiting before running evaluation.");
   }
 
-  delay(5000);
+  // print what the loop logged while nothing is measured
+  LOG_DRAIN(Serial);
+
+  delay(LOOP_DELAY);
 }
\ No newline at end of file
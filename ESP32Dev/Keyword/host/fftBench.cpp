@@ -0,0 +1,222 @@
+// Checks the radix-4 path of the microfrontend's FftCompute() against the
+// kissfft one it replaces, bit for bit, and times both: synthetic frames
+// (noise at every level, tones, impulses, full scale) and, given a WAV file
+// (16 bit mono), its windows as the frontend cuts them. Builds like
+// keywordHost, from here:
+//
+//   L=../../CameraDemo/lib/EloquentTinyML
+//   for f in $(find $L/eloquent_tinyml/tensorflow/esp32 -name '*.c'); do gcc -O2 -DESP32 -I$L -c $f; done
+//   M=$L/eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib
+//   g++ -std=c++11 -O2 -DESP32 -I../include -I$L fftBench.cpp $M/fft.cpp $M/fft_util.cpp *.o -o fftBench
+//   ./fftBench [recording.wav]
+//
+// Host builds run the SSE2 butterflies. The scalar ones the ESP32 runs build
+// with -U__SSE2__ added (-o fftBenchScalar); their times here are only a hint
+// of the board's, where the firmware built with -DFRONTEND_PROFILE
+// (env:profile) logs the FFT's cycles per row.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/fft.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/fft_util.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/window.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/window_util.h"
+#include "eloquent_tinyml/tensorflow/esp32/third_party/kissfft/tools/kiss_fftr.h"
+#include "WavSource.h"
+
+#define SAMPLE_RATE 16000
+#define REPEAT 400
+#define PASSES 5
+
+struct Frame
+{
+  std::vector<int16_t> samples;
+  int shift;
+};
+
+// The frontend's scaling of a window before its FFT
+int inputShift(const std::vector<int16_t> &samples)
+{
+  int16_t maxAbs = 0;
+
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    const int16_t value = samples[i] < 0 ? -samples[i] : samples[i];
+    if (value > maxAbs)
+      maxAbs = value;
+  }
+  return 15 - MostSignificantBit32(maxAbs);
+}
+
+void addFrame(std::vector<Frame> &frames, const std::vector<int16_t> &samples)
+{
+  Frame frame;
+
+  frame.samples = samples;
+  frame.shift = inputShift(samples);
+  frames.push_back(frame);
+}
+
+void syntheticFrames(std::vector<Frame> &frames, size_t size)
+{
+  std::vector<int16_t> samples(size);
+
+  srand(42);
+  for (int level = 0; level <= 15; level++)
+  {
+    for (int n = 0; n < 20; n++)
+    {
+      for (size_t i = 0; i < size; i++)
+        samples[i] = (rand() % 65536 - 32768) >> level;
+      addFrame(frames, samples);
+    }
+  }
+
+  for (int bin = 1; bin < 200; bin += 7)
+  {
+    for (size_t i = 0; i < size; i++)
+      samples[i] = 32767 * sin(2 * M_PI * bin * i / size);
+    addFrame(frames, samples);
+  }
+
+  for (size_t at = 0; at < size; at += size / 8)
+  {
+    std::fill(samples.begin(), samples.end(), 0);
+    samples[at] = 32767;
+    addFrame(frames, samples);
+    samples[at] = -32768;
+    addFrame(frames, samples);
+  }
+
+  std::fill(samples.begin(), samples.end(), 32767);
+  addFrame(frames, samples);
+  std::fill(samples.begin(), samples.end(), -32768);
+  addFrame(frames, samples);
+  for (size_t i = 0; i < size; i++)
+    samples[i] = i & 1 ? -32768 : 32767;
+  addFrame(frames, samples);
+}
+
+// Windows of the recording as WindowProcessSamples() hands them to the FFT
+void recordedFrames(std::vector<Frame> &frames, const char *path, int windowMs, int strideMs)
+{
+  WavSource wav;
+  WindowConfig config;
+  WindowState window;
+  int16_t buffer[512];
+  uint32_t capturedUs;
+
+  if (!wav.open(path) || wav.getSampleRate() != SAMPLE_RATE)
+  {
+    fprintf(stderr, "%s is not a 16 bit mono WAV file at %u Hz\n", path, SAMPLE_RATE);
+    exit(1);
+  }
+
+  config.size_ms = windowMs;
+  config.step_size_ms = strideMs;
+  WindowPopulateState(&config, &window, SAMPLE_RATE);
+
+  size_t count;
+  while ((count = wav.read(buffer, 512, capturedUs)) > 0)
+  {
+    const int16_t *next = buffer;
+
+    while (count > 0)
+    {
+      size_t used;
+
+      if (WindowProcessSamples(&window, next, count, &used))
+        addFrame(frames, std::vector<int16_t>(window.output, window.output + window.size));
+      next += used;
+      count -= used;
+    }
+  }
+  WindowFreeStateContents(&window);
+}
+
+// Best of PASSES, the slower ones were interrupted
+double nanosPerFft(FftState &state, const std::vector<Frame> &frames)
+{
+  double best = 0;
+
+  for (int p = 0; p < PASSES; p++)
+  {
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int r = 0; r < REPEAT; r++)
+      for (size_t f = 0; f < frames.size(); f++)
+        FftCompute(&state, frames[f].samples.data(), frames[f].shift);
+
+    const double ns =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / REPEAT / frames.size();
+    if (p == 0 || ns < best)
+      best = ns;
+  }
+  return best;
+}
+
+// Run one window size through both paths, false if any bit differs
+bool bench(const char *path, int windowMs, int strideMs)
+{
+  const size_t windowSize = SAMPLE_RATE * windowMs / 1000;
+  std::vector<Frame> frames;
+  FftState fast, kiss;
+
+  syntheticFrames(frames, windowSize);
+  const size_t synthetic = frames.size();
+  if (path != NULL)
+    recordedFrames(frames, path, windowMs, strideMs);
+
+  // kiss takes the FftCompute() path it had before, with its scratch
+  if (!FftPopulateState(&fast, windowSize) || !FftPopulateState(&kiss, windowSize) || fast.scratch != NULL)
+  {
+    fprintf(stderr, "No radix-4 FFT for %u samples\n", (unsigned) windowSize);
+    return false;
+  }
+  size_t scratchSize = 0;
+  kiss_fftr_alloc(kiss.fft_size, 0, NULL, &scratchSize);
+  kiss.scratch = malloc(scratchSize);
+  if (kiss_fftr_alloc(kiss.fft_size, 0, kiss.scratch, &scratchSize) != kiss.scratch)
+  {
+    fprintf(stderr, "Cannot allocate kissfft\n");
+    return false;
+  }
+
+  const size_t bins = fast.fft_size / 2 + 1;
+  size_t different = 0;
+  for (size_t f = 0; f < frames.size(); f++)
+  {
+    FftCompute(&fast, frames[f].samples.data(), frames[f].shift);
+    FftCompute(&kiss, frames[f].samples.data(), frames[f].shift);
+    if (memcmp(fast.output, kiss.output, bins * sizeof(*fast.output)) != 0)
+      different++;
+  }
+
+  const double kissNs = nanosPerFft(kiss, frames);
+  const double fastNs = nanosPerFft(fast, frames);
+
+  printf("%u point FFT (%u ms window): %u synthetic + %u recorded frames, %u differ; kissfft %.0f ns, radix-4 %.0f "
+         "ns, x%.2f\n",
+         (unsigned) fast.fft_size, windowMs, (unsigned) synthetic, (unsigned) (frames.size() - synthetic),
+         (unsigned) different, kissNs, fastNs, kissNs / fastNs);
+
+  FftFreeStateContents(&fast);
+  FftFreeStateContents(&kiss);
+  return different == 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = argc > 1 ? argv[1] : NULL;
+
+  // 512 points for the keyword frontend's 30 ms windows, 256 for 16 ms ones
+  const bool same = bench(path, 30, 10) & bench(path, 16, 8);
+
+  return same ? 0 : 1;
+}
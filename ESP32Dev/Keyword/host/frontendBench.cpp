@@ -0,0 +1,163 @@
+// Times the keyword microfrontend per 10 ms frame on a laptop: the whole of
+// FrontendProcessSamples() and, built with -DFRONTEND_PROFILE (sources and
+// objects alike), each of its stages. The checksum of every output lets two
+// builds be compared: a change of speed must not change it (frontendCheck
+// holds the reference ones). Runs a WAV file (16 bit mono, 16 kHz) or,
+// without one, ten seconds of synthetic audio. Builds like keywordHost, from
+// here:
+//
+//   L=../../CameraDemo/lib/EloquentTinyML
+//   for f in $(find $L/eloquent_tinyml/tensorflow/esp32 -name '*.c'); do gcc -O2 -DESP32 -DFRONTEND_PROFILE -I$L -c $f; done
+//   M=$L/eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib
+//   g++ -std=c++11 -O2 -DESP32 -DFRONTEND_PROFILE -I../include -I$L frontendBench.cpp $M/fft.cpp $M/fft_util.cpp *.o -o frontendBench
+//   ./frontendBench [recording.wav]
+//
+// Stage times are nanoseconds here, each with a clock read in it. The Keyword
+// firmware built with -DFRONTEND_PROFILE (env:profile) logs them in cycles on
+// the board.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
+#include "KeywordConfig.h"
+#include "WavSource.h"
+
+#define PASSES 5
+
+typedef std::chrono::steady_clock Clock;
+
+// Tones gliding through the band under bursts of noise, in and out of silence
+void syntheticAudio(std::vector<int16_t> &audio)
+{
+  audio.resize(10 * SAMPLE_RATE);
+  srand(42);
+  for (size_t i = 0; i < audio.size(); i++)
+  {
+    const double t = (double) i / SAMPLE_RATE;
+    const double envelope = 0.5 + 0.5 * sin(2 * M_PI * 0.7 * t);
+    const double tone = sin(2 * M_PI * (300 + 3000 * fmod(t, 1.0)) * t) + 0.5 * sin(2 * M_PI * 1200 * t);
+    const double noise = (rand() % 2001 - 1000) / 1000.0 * (fmod(t, 2.0) < 0.3 ? 0.8 : 0.05);
+
+    audio[i] = 12000 * envelope * tone + 8000 * noise;
+  }
+}
+
+void recordedAudio(std::vector<int16_t> &audio, const char *path)
+{
+  WavSource wav;
+  int16_t buffer[512];
+  uint32_t capturedUs;
+  size_t count;
+
+  if (!wav.open(path) || wav.getSampleRate() != SAMPLE_RATE)
+  {
+    fprintf(stderr, "%s is not a 16 bit mono WAV file at %u Hz\n", path, SAMPLE_RATE);
+    exit(1);
+  }
+  while ((count = wav.read(buffer, 512, capturedUs)) > 0)
+    audio.insert(audio.end(), buffer, buffer + count);
+}
+
+bool populate(FrontendState &state)
+{
+  FrontendConfig config;
+
+  // as KeywordPipeline::begin()
+  FrontendFillConfigWithDefaults(&config);
+  config.window.size_ms = WINDOW_MS;
+  config.window.step_size_ms = STRIDE_MS;
+  config.filterbank.num_channels = KWS_CHANNELS;
+  config.pcan_gain_control.enable_pcan = 1;
+  return FrontendPopulateState(&config, &state, SAMPLE_RATE);
+}
+
+// Run the audio through, returns the frames, the FNV-1a hash of their values
+// in checksum
+size_t runFrontend(FrontendState &state, const std::vector<int16_t> &audio, uint32_t &checksum)
+{
+  const int16_t *next = audio.data();
+  size_t left = audio.size();
+  size_t frames = 0;
+
+  checksum = 2166136261u;
+  FrontendReset(&state);
+  FrontendResetProfile(&state);
+  while (left > 0)
+  {
+    size_t used;
+    const FrontendOutput output = FrontendProcessSamples(&state, next, left, &used);
+
+    for (size_t c = 0; c < output.size; c++)
+    {
+      checksum = (checksum ^ (output.values[c] & 0xff)) * 16777619u;
+      checksum = (checksum ^ (output.values[c] >> 8)) * 16777619u;
+    }
+    frames += output.values != NULL;
+    next += used;
+    left -= used;
+  }
+  return frames;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<int16_t> audio;
+  FrontendState state;
+
+  if (argc > 1)
+    recordedAudio(audio, argv[1]);
+  else
+    syntheticAudio(audio);
+
+  if (!populate(state))
+  {
+    fprintf(stderr, "Cannot allocate the microfrontend\n");
+    return 1;
+  }
+
+  // Best of PASSES, the slower ones were interrupted
+  double frameNs = 0;
+  uint32_t checksum = 0;
+  size_t frames = 0;
+  FrontendProfile profile;
+  for (int p = 0; p < PASSES; p++)
+  {
+    const Clock::time_point start = Clock::now();
+    frames = runFrontend(state, audio, checksum);
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / frames;
+
+    if (p == 0 || ns < frameNs)
+    {
+      frameNs = ns;
+      profile = state.profile;
+    }
+  }
+
+  printf("%u frames of %u channels, checksum %08x\n", (unsigned) frames, (unsigned) state.filterbank.num_channels,
+         checksum);
+  printf("Frontend %.0f ns per frame\n", frameNs);
+
+  if (profile.frames == 0)
+  {
+    printf("Build with -DFRONTEND_PROFILE for the stages\n");
+  }
+  else
+  {
+    uint64_t total = 0;
+    for (int s = 0; s < kFrontendStageCount; s++)
+      total += profile.cycles[s];
+
+    for (int s = 0; s < kFrontendStageCount; s++)
+      printf("  %-10s %6.0f ns %5.1f%%\n", kFrontendStageNames[s], (double) profile.cycles[s] / profile.frames,
+             100.0 * profile.cycles[s] / total);
+  }
+
+  FrontendFreeStateContents(&state);
+  return 0;
+}
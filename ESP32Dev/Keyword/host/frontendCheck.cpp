@@ -0,0 +1,249 @@
+// Regression check of the microfrontend: a fixed corpus of synthetic clips,
+// plus any WAV files given (16 bit mono, 16 kHz), runs through a few frontend
+// configurations and the checksum of every output must match the one in
+// frontendGolden.txt. Optimizations of the frontend must keep its features
+// bit exact, the model was trained on the TensorFlow op's. Builds like
+// keywordHost, from here:
+//
+//   L=../../CameraDemo/lib/EloquentTinyML
+//   for f in $(find $L/eloquent_tinyml/tensorflow/esp32 -name '*.c'); do gcc -O2 -DESP32 -I$L -c $f; done
+//   M=$L/eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib
+//   g++ -std=c++11 -O2 -DESP32 -I../include -I$L frontendCheck.cpp $M/fft.cpp $M/fft_util.cpp *.o -o frontendCheck
+//   ./frontendCheck [recording.wav...]
+//
+// --update writes the current checksums to frontendGolden.txt instead: only
+// with the code the goldens come from, before the change to check.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
+#include "KeywordConfig.h"
+#include "WavSource.h"
+
+#define GOLDEN_PATH "frontendGolden.txt"
+#define CLIP_SECONDS 2
+
+struct Clip
+{
+  std::string name;
+  std::vector<int16_t> samples;
+};
+
+struct Setup
+{
+  const char *name;
+  int windowMs;
+  int strideMs;
+  int channels;
+  int pcan;
+};
+
+// The keyword frontend, the op's defaults (25 ms, 32 channels, no PCAN) and
+// a 256 point FFT
+const Setup setups[] = {
+    {"keyword", WINDOW_MS, STRIDE_MS, KWS_CHANNELS, 1},
+    {"default", 0, 0, 0, 0},
+    {"short", 16, 8, 20, 1},
+};
+
+void addClip(std::vector<Clip> &clips, const char *name, double (*signal)(double t, size_t i))
+{
+  Clip clip;
+
+  clip.name = name;
+  clip.samples.resize(CLIP_SECONDS * SAMPLE_RATE);
+  for (size_t i = 0; i < clip.samples.size(); i++)
+  {
+    const double value = signal((double) i / SAMPLE_RATE, i);
+    clip.samples[i] = value > 32767 ? 32767 : value < -32768 ? -32768 : (int16_t) lrint(value);
+  }
+  clips.push_back(clip);
+}
+
+// Deterministic on every platform, unlike rand()
+double noise(size_t i)
+{
+  uint32_t x = (uint32_t) i * 2654435761u + 12345;
+
+  x ^= x >> 15;
+  x *= 2246822519u;
+  x ^= x >> 13;
+  return (x & 0xffff) / 32768.0 - 1;
+}
+
+void syntheticClips(std::vector<Clip> &clips)
+{
+  addClip(clips, "silence", [](double t, size_t i) { return 0.0; });
+  addClip(clips, "hiss", [](double t, size_t i) { return 40 * noise(i); });
+  addClip(clips, "noise", [](double t, size_t i) { return 20000 * noise(i); });
+  addClip(clips, "chirp", [](double t, size_t i) { return 16000 * sin(2 * M_PI * (100 + 1950 * t) * t); });
+  // tones in syllables over a noise floor, as speech in a room
+  addClip(clips, "syllables", [](double t, size_t i) {
+    const double envelope = fmod(t, 0.4) < 0.25 ? sin(M_PI * fmod(t, 0.4) / 0.25) : 0;
+    return envelope * (9000 * sin(2 * M_PI * 220 * t) + 5000 * sin(2 * M_PI * 1800 * t)) + 300 * noise(i);
+  });
+  addClip(clips, "clipped", [](double t, size_t i) { return 60000 * sin(2 * M_PI * 440 * t); });
+  addClip(clips, "clicks", [](double t, size_t i) { return i % 1000 == 0 ? -32768.0 : 0.0; });
+  addClip(clips, "offset", [](double t, size_t i) { return 12000 + 2000 * sin(2 * M_PI * 60 * t); });
+}
+
+void recordedClip(std::vector<Clip> &clips, const char *path)
+{
+  WavSource wav;
+  int16_t buffer[512];
+  uint32_t capturedUs;
+  size_t count;
+  Clip clip;
+
+  if (!wav.open(path) || wav.getSampleRate() != SAMPLE_RATE)
+  {
+    fprintf(stderr, "%s is not a 16 bit mono WAV file at %u Hz\n", path, SAMPLE_RATE);
+    exit(2);
+  }
+  while ((count = wav.read(buffer, 512, capturedUs)) > 0)
+    clip.samples.insert(clip.samples.end(), buffer, buffer + count);
+
+  const char *slash = strrchr(path, '/');
+  clip.name = slash != NULL ? slash + 1 : path;
+  clips.push_back(clip);
+}
+
+// FNV-1a of every output value, the number of frames in frames
+uint32_t checksum(const Setup &setup, const Clip &clip, size_t &frames)
+{
+  FrontendConfig config;
+  FrontendState state;
+
+  FrontendFillConfigWithDefaults(&config);
+  if (setup.windowMs > 0)
+  {
+    config.window.size_ms = setup.windowMs;
+    config.window.step_size_ms = setup.strideMs;
+    config.filterbank.num_channels = setup.channels;
+    config.pcan_gain_control.enable_pcan = setup.pcan;
+  }
+  if (!FrontendPopulateState(&config, &state, SAMPLE_RATE))
+  {
+    fprintf(stderr, "Cannot allocate the %s frontend\n", setup.name);
+    exit(2);
+  }
+
+  // odd reads, the window must not care how the samples arrive
+  const int16_t *next = clip.samples.data();
+  size_t left = clip.samples.size();
+  uint32_t hash = 2166136261u;
+  size_t read = 1;
+
+  frames = 0;
+  while (left > 0)
+  {
+    size_t used;
+    const FrontendOutput output = FrontendProcessSamples(&state, next, read < left ? read : left, &used);
+
+    for (size_t c = 0; c < output.size; c++)
+    {
+      hash = (hash ^ (output.values[c] & 0xff)) * 16777619u;
+      hash = (hash ^ (output.values[c] >> 8)) * 16777619u;
+    }
+    frames += output.values != NULL;
+    next += used;
+    left -= used;
+    read = read % 701 + 97;
+  }
+
+  FrontendFreeStateContents(&state);
+  return hash;
+}
+
+std::map<std::string, std::string> readGolden()
+{
+  std::map<std::string, std::string> golden;
+  FILE *file = fopen(GOLDEN_PATH, "r");
+  char key[256], value[64];
+
+  if (file == NULL)
+    return golden;
+  while (fscanf(file, "%255s %63[^\n]", key, value) == 2)
+  {
+    if (key[0] != '#')
+      golden[key] = value;
+  }
+  fclose(file);
+  return golden;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<Clip> clips;
+  bool update = false;
+
+  syntheticClips(clips);
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--update") == 0)
+      update = true;
+    else
+      recordedClip(clips, argv[i]);
+  }
+
+  const std::map<std::string, std::string> golden = readGolden();
+  FILE *out = update ? fopen(GOLDEN_PATH, "w") : NULL;
+  size_t checked = 0, different = 0, missing = 0;
+
+  if (update && out == NULL)
+  {
+    fprintf(stderr, "Cannot write %s\n", GOLDEN_PATH);
+    return 2;
+  }
+  if (out != NULL)
+    fprintf(out, "# setup/clip frames checksum, written by frontendCheck --update\n");
+
+  for (const Setup &setup : setups)
+  {
+    for (const Clip &clip : clips)
+    {
+      size_t frames;
+      const uint32_t hash = checksum(setup, clip, frames);
+      const std::string key = std::string(setup.name) + "/" + clip.name;
+      char value[64];
+
+      snprintf(value, sizeof(value), "%u %08x", (unsigned) frames, hash);
+      if (out != NULL)
+      {
+        fprintf(out, "%s %s\n", key.c_str(), value);
+        continue;
+      }
+
+      const auto expected = golden.find(key);
+      checked++;
+      if (expected == golden.end())
+      {
+        printf("%-24s %s, no golden\n", key.c_str(), value);
+        missing++;
+      }
+      else if (expected->second != value)
+      {
+        printf("%-24s %s, golden %s: DIFFERENT\n", key.c_str(), value, expected->second.c_str());
+        different++;
+      }
+    }
+  }
+
+  if (out != NULL)
+  {
+    fclose(out);
+    printf("Wrote %s\n", GOLDEN_PATH);
+    return 0;
+  }
+
+  printf("%u outputs checked, %u different, %u without golden\n", (unsigned) checked, (unsigned) different,
+         (unsigned) missing);
+  return different > 0 || missing > 0 ? 1 : 0;
+}
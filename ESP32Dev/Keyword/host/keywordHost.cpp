@@ -0,0 +1,112 @@
+// Runs the keyword pipeline of the board on a WAV recording (16 bit mono,
+// 16 kHz) in place of the microphone: same frontend, model and recognizer,
+// to check detections on known audio and what a stride costs on a laptop.
+// Builds with the ESP32 TensorFlow Lite sources of CameraDemo, from here:
+//
+//   L=../../CameraDemo/lib/EloquentTinyML
+//   for f in $(find $L/eloquent_tinyml/tensorflow/esp32 -name '*.c'); do gcc -O2 -DESP32 -I$L -c $f; done
+//   S=$(find $L/eloquent_tinyml/tensorflow/esp32 -name '*.cpp' ! -name micro_optional_debug_tools.cpp)
+//   g++ -std=c++11 -O2 -DESP32 -I../include -I$L -I../../../lib/Telemetry -I../../../Models keywordHost.cpp $S *.o -o keywordHost
+//   ./keywordHost recording.wav [--realtime] [--no-gate]
+//
+// --realtime plays the file at its sample rate, so the latencies are the ones
+// a microphone would see; without it the file runs as fast as it can.
+// --no-gate runs the frontend and model on every stride, to compare the
+// detections with the voice gate's.
+// Add -DKEYWORD_PLACEHOLDER_MODEL to build on the placeholder keyword_model.h,
+// which detects nothing.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/version.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/schema/schema_generated.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/micro_error_reporter.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/kernels/micro_ops.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/kernels/all_ops_resolver.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/micro_interpreter.h"
+#include "eloquent_tinyml/tensorflow/esp32/patches/AllOpsResolver.h"
+#include "eloquent_tinyml/tensorflow/common/AbstractTensorFlow.h"
+#include "eloquent_tinyml/tensorflow/common/AllOpsTensorFlow.h"
+
+#include "keyword_model.h"
+#include "KeywordConfig.h"
+#include "KeywordPipeline.h"
+#include "WavSource.h"
+
+typedef Eloquent::TinyML::TensorFlow::TensorFlow<KWS_FRAMES * KWS_CHANNELS, KWS_LABELS, ARENA_SIZE> KeywordModel;
+
+KeywordModel keywordModel;
+KeywordPipeline<KeywordModel, KWS_FRAMES, KWS_CHANNELS, KWS_LABELS, VAD_HISTORY_MS * SAMPLE_RATE / 1000>
+    pipeline(keywordModel, INFERENCE_STRIDE);
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: keywordHost recording.wav [--realtime] [--no-gate]\n");
+    return 2;
+  }
+
+  WavSource wav;
+  if (!wav.open(argv[1]))
+  {
+    fprintf(stderr, "%s is not a 16 bit mono WAV file\n", argv[1]);
+    return 1;
+  }
+  if (wav.getSampleRate() != SAMPLE_RATE)
+  {
+    fprintf(stderr, "%s is sampled at %u Hz, the model takes %u Hz\n", argv[1], wav.getSampleRate(), SAMPLE_RATE);
+    return 1;
+  }
+
+  bool realtime = false;
+  bool gate = true;
+  for (int i = 2; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--realtime") == 0)
+      realtime = true;
+    else if (strcmp(argv[i], "--no-gate") == 0)
+      gate = false;
+  }
+  wav.setRealtime(realtime);
+
+  if (!keywordModel.begin(keyword_model))
+  {
+    fprintf(stderr, "Model init error: %s\n", keywordModel.getErrorMessage());
+    return 1;
+  }
+  if (!pipeline.begin(SAMPLE_RATE, WINDOW_MS, STRIDE_MS))
+  {
+    fprintf(stderr, "Cannot allocate the microfrontend\n");
+    return 1;
+  }
+  pipeline.getVoiceDetector().setHangover(VAD_HANGOVER_MS / STRIDE_MS);
+  pipeline.setVoiceGate(gate);
+
+  while (!wav.finished())
+  {
+    if (!pipeline.process(wav))
+    {
+      usleep(1000);
+      continue;
+    }
+
+    if (pipeline.getDetection() >= 0)
+    {
+      printf("%7.2f s  heard \"%s\", score %.2f, %u us after the audio\n", wav.getSeconds(), labels[pipeline.getDetection()],
+             pipeline.getDetectionScore(), pipeline.getDetectionLatency());
+    }
+  }
+
+  const LatencyHistogram<> &latency = pipeline.getLatency();
+  printf("%.2f s of audio, %u rows, %u inferences, %u detections, %u errors\n", wav.getSeconds(), pipeline.getRows(),
+         pipeline.getInferences(), pipeline.getDetections(), pipeline.getErrors());
+  printf("Audio to decision: p50 %u us, p99 %u us, max %u us\n", latency.percentile(50), latency.percentile(99), latency.max());
+  printf("Frontend %.1f us per row, model %.1f us per inference, load %.2f%% of real time, voice %.1f%% of strides\n",
+         pipeline.getRowMicros(), pipeline.getInferenceMicros(), pipeline.getLoad() * 100,
+         pipeline.getActiveRatio() * 100);
+  return 0;
+}
@@ -0,0 +1,254 @@
+// Checks the microfrontend's square root (FilterbankRoundedSqrt()) and
+// logarithm (LogScaleLog()) against the bit by bit root and the 64 bit
+// product log they replace, copied below: every 32 bit input of both, and 64
+// bit roots around each square and at random. The bound is no difference at
+// all, a feature one off is not the feature the model was trained on. Times
+// both too, on inputs spread as the channels' are. Builds like keywordHost,
+// from here:
+//
+//   L=../../CameraDemo/lib/EloquentTinyML
+//   for f in $(find $L/eloquent_tinyml/tensorflow/esp32 -name '*.c'); do gcc -O2 -DESP32 -I$L -c $f; done
+//   g++ -std=c++11 -O2 -DESP32 -I$L sqrtLogCheck.cpp filterbank.o log_scale.o log_lut.o sqrt_lut.o -o sqrtLogCheck
+//   ./sqrtLogCheck
+//
+// The full range takes a few minutes, --quick checks one input in 97.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/filterbank.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/log_lut.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/log_scale.h"
+
+#define PASSES 5
+#define TIMED_INPUTS 100000
+
+typedef std::chrono::steady_clock Clock;
+
+// The root FilterbankSqrt() had
+uint16_t referenceSqrt32(uint32_t num)
+{
+  if (num == 0)
+    return 0;
+  uint32_t res = 0;
+  int max_bit_number = 32 - MostSignificantBit32(num);
+  max_bit_number |= 1;
+  uint32_t bit = 1U << (31 - max_bit_number);
+  int iterations = (31 - max_bit_number) / 2 + 1;
+  while (iterations--)
+  {
+    if (num >= res + bit)
+    {
+      num -= res + bit;
+      res = (res >> 1U) + bit;
+    }
+    else
+      res >>= 1U;
+    bit >>= 2U;
+  }
+  if (num > res && res != 0xFFFF)
+    ++res;
+  return res;
+}
+
+uint32_t referenceSqrt64(uint64_t num)
+{
+  if ((num >> 32) == 0)
+    return referenceSqrt32((uint32_t) num);
+  uint64_t res = 0;
+  int max_bit_number = 64 - MostSignificantBit64(num);
+  max_bit_number |= 1;
+  uint64_t bit = 1ULL << (63 - max_bit_number);
+  int iterations = (63 - max_bit_number) / 2 + 1;
+  while (iterations--)
+  {
+    if (num >= res + bit)
+    {
+      num -= res + bit;
+      res = (res >> 1U) + bit;
+    }
+    else
+      res >>= 1U;
+    bit >>= 2U;
+  }
+  if (num > res && res != 0xFFFFFFFFLL)
+    ++res;
+  return res;
+}
+
+// The log LogScaleApply() had
+uint32_t referenceLog2FractionPart(const uint32_t x, const uint32_t log2x)
+{
+  int32_t frac = x - (1LL << log2x);
+  if (log2x < kLogScaleLog2)
+    frac <<= kLogScaleLog2 - log2x;
+  else
+    frac >>= log2x - kLogScaleLog2;
+  const uint32_t base_seg = frac >> (kLogScaleLog2 - kLogSegmentsLog2);
+  const uint32_t seg_unit = (((uint32_t) 1) << kLogScaleLog2) >> kLogSegmentsLog2;
+
+  const int32_t c0 = kLogLut[base_seg];
+  const int32_t c1 = kLogLut[base_seg + 1];
+  const int32_t seg_base = seg_unit * base_seg;
+  const int32_t rel_pos = ((c1 - c0) * (frac - seg_base)) >> kLogScaleLog2;
+  return frac + c0 + rel_pos;
+}
+
+uint32_t referenceLog(const uint32_t x, const uint32_t scale_shift)
+{
+  const uint32_t integer = MostSignificantBit32(x) - 1;
+  const uint32_t fraction = referenceLog2FractionPart(x, integer);
+  const uint32_t log2 = (integer << kLogScaleLog2) + fraction;
+  const uint32_t round = kLogScale / 2;
+  const uint32_t loge = (((uint64_t) kLogCoeff) * log2 + round) >> kLogScaleLog2;
+  return ((loge << scale_shift) + round) >> kLogScaleLog2;
+}
+
+struct Check
+{
+  const char *name;
+  uint64_t inputs;
+  uint64_t different;
+  uint64_t firstDifferent;
+};
+
+void compareSqrt(Check &check, uint64_t num)
+{
+  check.inputs++;
+  if (FilterbankRoundedSqrt(num) != referenceSqrt64(num) && check.different++ == 0)
+    check.firstDifferent = num;
+}
+
+void report(const Check &check)
+{
+  printf("%-22s %12llu inputs, %llu different", check.name, (unsigned long long) check.inputs,
+         (unsigned long long) check.different);
+  if (check.different > 0)
+    printf(", first %llu", (unsigned long long) check.firstDifferent);
+  printf("\n");
+}
+
+// 64 bit values around every square root of each magnitude, and at random
+uint64_t random64()
+{
+  return ((uint64_t) rand() << 62) ^ ((uint64_t) rand() << 31) ^ (uint64_t) rand();
+}
+
+void checkSqrt64(Check &check)
+{
+  srand(42);
+  for (int bits = 33; bits <= 64; bits++)
+  {
+    for (int n = 0; n < 100000; n++)
+    {
+      const uint64_t num = random64() >> (64 - bits) | (1ULL << (bits - 1));
+      const uint64_t root = referenceSqrt64(num);
+
+      compareSqrt(check, num);
+      for (uint64_t r = root > 2 ? root - 2 : 0; r <= root + 2 && r <= 0xFFFFFFFFULL; r++)
+      {
+        const uint64_t square = r * r;
+        compareSqrt(check, square);
+        compareSqrt(check, square - 1);
+        compareSqrt(check, square + r);
+        compareSqrt(check, square + r + 1);
+      }
+    }
+  }
+  compareSqrt(check, 0xFFFFFFFFFFFFFFFFULL);
+  compareSqrt(check, 0xFFFFFFFE00000001ULL);
+  compareSqrt(check, 0xFFFFFFFF00000000ULL);
+}
+
+// Best of PASSES, the slower ones were interrupted
+template<typename T> double nanosPerCall(const std::vector<T> &inputs, uint32_t (*function)(T))
+{
+  double best = 0;
+  volatile uint32_t sink = 0;
+
+  for (int p = 0; p < PASSES; p++)
+  {
+    uint32_t sum = 0;
+    const Clock::time_point start = Clock::now();
+
+    for (size_t i = 0; i < inputs.size(); i++)
+      sum += function(inputs[i]);
+
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / inputs.size();
+    sink = sink + sum;
+    if (p == 0 || ns < best)
+      best = ns;
+  }
+  return best;
+}
+
+uint32_t newSqrt(uint64_t num)
+{
+  return FilterbankRoundedSqrt(num);
+}
+
+uint32_t newLog(uint32_t x)
+{
+  return LogScaleLog(x, 6);
+}
+
+uint32_t oldLog(uint32_t x)
+{
+  return referenceLog(x, 6);
+}
+
+int main(int argc, char **argv)
+{
+  const uint32_t stride = argc > 1 && strcmp(argv[1], "--quick") == 0 ? 97 : 1;
+  Check sqrt32 = {"sqrt, 32 bit inputs"}, sqrt64 = {"sqrt, 64 bit inputs"};
+  Check logs[] = {{"log, scale shift 6"}, {"log, other shifts"}};
+
+  for (uint64_t x = 0; x <= 0xFFFFFFFFULL; x += stride)
+    compareSqrt(sqrt32, x);
+  report(sqrt32);
+
+  checkSqrt64(sqrt64);
+  report(sqrt64);
+
+  // 6 is the frontend's, the others on a sample
+  for (uint64_t x = 2; x <= 0xFFFFFFFFULL; x += stride)
+  {
+    logs[0].inputs++;
+    if (LogScaleLog(x, 6) != referenceLog(x, 6) && logs[0].different++ == 0)
+      logs[0].firstDifferent = x;
+  }
+  for (uint64_t x = 2; x <= 0xFFFFFFFFULL; x += 4099)
+  {
+    for (uint32_t shift = 0; shift <= 10; shift++)
+    {
+      logs[1].inputs++;
+      if (LogScaleLog(x, shift) != referenceLog(x, shift) && logs[1].different++ == 0)
+        logs[1].firstDifferent = x;
+    }
+  }
+  report(logs[0]);
+  report(logs[1]);
+
+  // Spread as the channels are: energies from 2^8 to 2^40, logs of their roots
+  std::vector<uint64_t> energies(TIMED_INPUTS);
+  std::vector<uint32_t> roots(TIMED_INPUTS);
+  srand(7);
+  for (size_t i = 0; i < energies.size(); i++)
+  {
+    energies[i] = (random64() >> (64 - 8 - rand() % 33)) | 1;
+    roots[i] = (FilterbankRoundedSqrt(energies[i]) << 2) | 2;
+  }
+  const double oldSqrtNs = nanosPerCall<uint64_t>(energies, referenceSqrt64);
+  const double newSqrtNs = nanosPerCall<uint64_t>(energies, newSqrt);
+  const double oldLogNs = nanosPerCall<uint32_t>(roots, oldLog);
+  const double newLogNs = nanosPerCall<uint32_t>(roots, newLog);
+  printf("sqrt: bit by bit %.1f ns, table %.1f ns, x%.2f\n", oldSqrtNs, newSqrtNs, oldSqrtNs / newSqrtNs);
+  printf("log: 64 bit product %.1f ns, 32 bit %.1f ns, x%.2f\n", oldLogNs, newLogNs, oldLogNs / newLogNs);
+
+  const bool same = sqrt32.different == 0 && sqrt64.different == 0 && logs[0].different == 0 && logs[1].different == 0;
+  return same ? 0 : 1;
+}
@@ -0,0 +1,499 @@
+// Checks the full integer SVDF kernel (int8 activations, int16 state, the
+// ring buffer of the vendored svdf.cpp) against the integer reference it
+// replaces, copied below: the state shifted left by one activation every
+// step, as upstream TFLM does. Small single-op SVDF models are built here
+// with flatbuffers, int8 ones at op version 3, the version the converter
+// gives full integer SVDF, and float twins of the same weights at version 1.
+// 1000 steps each, with the state reset in the middle; the bound is no
+// difference at all. Times the int8 and the float model per step too.
+//
+// Then the streaming float SVDF as the keyword pipeline runs it: rows pushed
+// into a Spectrogram, whose ring the model reads in place through
+// TensorFlow::bindFloatInput(), predictInPlace() and resetState(). Models
+// with the standard five inputs and with the sixth scratch one, against a
+// float reference in the kernel's order over 500 rows, bit for bit too.
+// Builds like keywordHost, from here:
+//
+//   L=../../CameraDemo/lib/EloquentTinyML
+//   for f in $(find $L/eloquent_tinyml/tensorflow/esp32 -name '*.c'); do gcc -O2 -DESP32 -I$L -c $f; done
+//   S=$(find $L/eloquent_tinyml/tensorflow/esp32 -name '*.cpp' ! -name micro_optional_debug_tools.cpp)
+//   g++ -std=c++11 -O2 -DESP32 -I../include -I$L svdfCheck.cpp $S *.o -o svdfCheck
+//   ./svdfCheck
+//
+// On the board, pio run -e svdf -t upload prints the same lines on the serial
+// port, with the ESP32's timings.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/version.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/schema/schema_generated.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/kernels/internal/common.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/kernels/internal/quantization_util.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/micro_error_reporter.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/micro_interpreter.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/kernels/micro_ops.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/micro/kernels/all_ops_resolver.h"
+#include "eloquent_tinyml/tensorflow/esp32/patches/AllOpsResolver.h"
+#include "eloquent_tinyml/tensorflow/common/AbstractTensorFlow.h"
+#include "eloquent_tinyml/tensorflow/common/AllOpsTensorFlow.h"
+
+#include "Spectrogram.h"
+
+#define STEPS 1000
+#define RESET_STEP 377
+#define ARENA_SIZE (48 * 1024)
+#define STREAM_ROWS 500
+#define STREAM_RESET_ROW 300
+
+typedef std::chrono::steady_clock Clock;
+
+// The quantization of every tensor, the bias at the scale of state x time weights
+#define INPUT_SCALE 0.05f
+#define INPUT_ZERO_POINT -7
+#define FEATURE_WEIGHTS_SCALE 0.004f
+#define TIME_WEIGHTS_SCALE 0.00003f
+#define STATE_SCALE 0.02f
+#define OUTPUT_SCALE 0.02f
+#define OUTPUT_ZERO_POINT 5
+#define BIAS_SCALE (STATE_SCALE * TIME_WEIGHTS_SCALE)
+
+struct Shape
+{
+  int inputs;
+  int filters;
+  int rank;
+  int memory;
+  bool relu;
+
+  int units() const
+  {
+    return filters / rank;
+  }
+};
+
+// The keyword model's layer first, then odd sizes: a rank of 3, one input
+// and one step of memory, more filters than inputs
+const Shape shapes[] = {
+  {40, 16, 2, 98, true},
+  {40, 16, 2, 98, false},
+  {13, 9, 3, 7, true},
+  {1, 4, 1, 1, false},
+  {33, 64, 4, 33, true},
+};
+
+struct Weights
+{
+  std::vector<int8_t> feature;
+  std::vector<int16_t> time;
+  std::vector<int32_t> bias;
+  // the same, dequantized for the float model
+  std::vector<float> featureFloat;
+  std::vector<float> timeFloat;
+  std::vector<float> biasFloat;
+};
+
+void randomWeights(const Shape &shape, Weights &weights)
+{
+  weights.feature.resize(shape.filters * shape.inputs);
+  weights.time.resize(shape.filters * shape.memory);
+  weights.bias.resize(shape.units());
+  weights.featureFloat.resize(weights.feature.size());
+  weights.timeFloat.resize(weights.time.size());
+  weights.biasFloat.resize(weights.bias.size());
+
+  for (size_t i = 0; i < weights.feature.size(); i++)
+  {
+    weights.feature[i] = rand() % 255 - 127;
+    weights.featureFloat[i] = weights.feature[i] * FEATURE_WEIGHTS_SCALE;
+  }
+  for (size_t i = 0; i < weights.time.size(); i++)
+  {
+    weights.time[i] = rand() % 2049 - 1024;
+    weights.timeFloat[i] = weights.time[i] * TIME_WEIGHTS_SCALE;
+  }
+  for (size_t i = 0; i < weights.bias.size(); i++)
+  {
+    weights.bias[i] = rand() % 200001 - 100000;
+    weights.biasFloat[i] = weights.bias[i] * BIAS_SCALE;
+  }
+}
+
+flatbuffers::Offset<tflite::QuantizationParameters> quantization(flatbuffers::FlatBufferBuilder &builder, float scale,
+                                                                 int zeroPoint)
+{
+  return tflite::CreateQuantizationParameters(builder, 0, 0, builder.CreateVector<float>({scale}),
+                                              builder.CreateVector<int64_t>({zeroPoint}));
+}
+
+template<typename T>
+flatbuffers::Offset<tflite::Buffer> constant(flatbuffers::FlatBufferBuilder &builder, const std::vector<T> &values)
+{
+  return tflite::CreateBuffer(builder,
+                              builder.CreateVector((const uint8_t *) values.data(), values.size() * sizeof(T)));
+}
+
+// A model of one SVDF op: input, feature weights, time weights, bias, state in,
+// output out, and a float one may have the scratch tensor as a sixth input
+std::vector<uint8_t> buildModel(const Shape &shape, const Weights &weights, bool integer, bool scratch = false)
+{
+  using namespace tflite;
+  flatbuffers::FlatBufferBuilder builder;
+  std::vector<flatbuffers::Offset<Buffer>> buffers;
+  std::vector<flatbuffers::Offset<Tensor>> tensors;
+
+  buffers.push_back(CreateBuffer(builder, builder.CreateVector<uint8_t>({})));
+  if (integer)
+  {
+    buffers.push_back(constant(builder, weights.feature));
+    buffers.push_back(constant(builder, weights.time));
+    buffers.push_back(constant(builder, weights.bias));
+  }
+  else
+  {
+    buffers.push_back(constant(builder, weights.featureFloat));
+    buffers.push_back(constant(builder, weights.timeFloat));
+    buffers.push_back(constant(builder, weights.biasFloat));
+  }
+
+  const auto tensor = [&](std::vector<int> dims, TensorType type, int buffer, const char *name, float scale,
+                          int zeroPoint, bool variable) {
+    tensors.push_back(CreateTensor(builder, builder.CreateVector(dims), integer ? type : TensorType_FLOAT32, buffer,
+                                   builder.CreateString(name),
+                                   integer ? quantization(builder, scale, zeroPoint) : 0, variable));
+  };
+  tensor({1, shape.inputs}, TensorType_INT8, 0, "input", INPUT_SCALE, INPUT_ZERO_POINT, false);
+  tensor({shape.filters, shape.inputs}, TensorType_INT8, 1, "feature_weights", FEATURE_WEIGHTS_SCALE, 0, false);
+  tensor({shape.filters, shape.memory}, TensorType_INT16, 2, "time_weights", TIME_WEIGHTS_SCALE, 0, false);
+  tensor({shape.units()}, TensorType_INT32, 3, "bias", BIAS_SCALE, 0, false);
+  tensor({1, shape.memory * shape.filters}, TensorType_INT16, 0, "state", STATE_SCALE, 0, true);
+  tensor({1, shape.units()}, TensorType_INT8, 0, "output", OUTPUT_SCALE, OUTPUT_ZERO_POINT, false);
+
+  std::vector<int> inputs = {0, 1, 2, 3, 4};
+  if (scratch && !integer)
+  {
+    tensor({1, shape.filters}, TensorType_FLOAT32, 0, "scratch", 0, 0, false);
+    inputs.push_back(6);
+  }
+
+  const ActivationFunctionType activation = shape.relu ? ActivationFunctionType_RELU : ActivationFunctionType_NONE;
+  std::vector<flatbuffers::Offset<Operator>> operators = {
+    CreateOperator(builder, 0, builder.CreateVector(inputs), builder.CreateVector<int>({5}),
+                   BuiltinOptions_SVDFOptions, CreateSVDFOptions(builder, shape.rank, activation).Union())};
+  const auto subgraph =
+    CreateSubGraph(builder, builder.CreateVector(tensors), builder.CreateVector<int>({0}),
+                   builder.CreateVector<int>({5}), builder.CreateVector(operators), builder.CreateString("main"));
+
+  std::vector<flatbuffers::Offset<OperatorCode>> codes = {
+    CreateOperatorCode(builder, BuiltinOperator_SVDF, 0, integer ? 3 : 1)};
+  std::vector<flatbuffers::Offset<SubGraph>> subgraphs = {subgraph};
+  const auto model = CreateModel(builder, TFLITE_SCHEMA_VERSION, builder.CreateVector(codes),
+                                 builder.CreateVector(subgraphs), builder.CreateString("svdfCheck"),
+                                 builder.CreateVector(buffers));
+  FinishModelBuffer(builder, model);
+  return std::vector<uint8_t>(builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
+}
+
+// The integer SVDF before the ring buffer: every filter's history shifted
+// left, the new activation at the end, the time weights from the oldest
+class Reference
+{
+  public:
+  Reference(const Shape &shape, const Weights &weights) :
+    shape(shape),
+    weights(weights),
+    history(shape.filters * shape.memory, 0),
+    sums(shape.filters)
+  {
+    tflite::QuantizeMultiplier((double) INPUT_SCALE * FEATURE_WEIGHTS_SCALE / STATE_SCALE, &featureMultiplier,
+                               &featureShift);
+    tflite::QuantizeMultiplier((double) STATE_SCALE * TIME_WEIGHTS_SCALE / OUTPUT_SCALE, &outputMultiplier,
+                               &outputShift);
+  }
+
+  void reset()
+  {
+    std::fill(history.begin(), history.end(), 0);
+  }
+
+  void step(const int8_t *input, int8_t *output)
+  {
+    const int memory = shape.memory;
+
+    for (int f = 0; f < shape.filters; f++)
+    {
+      int16_t *filter = &history[f * memory];
+      int32_t dot = 0;
+
+      for (int i = 0; i < memory - 1; i++)
+        filter[i] = filter[i + 1];
+      for (int k = 0; k < shape.inputs; k++)
+        dot += weights.feature[f * shape.inputs + k] * (input[k] - INPUT_ZERO_POINT);
+      dot = tflite::MultiplyByQuantizedMultiplier(dot, featureMultiplier, featureShift);
+      filter[memory - 1] = std::min(std::max(dot, (int32_t) -32768), (int32_t) 32767);
+    }
+
+    for (int f = 0; f < shape.filters; f++)
+    {
+      sums[f] = 0;
+      for (int i = 0; i < memory; i++)
+        sums[f] += weights.time[f * memory + i] * history[f * memory + i];
+    }
+
+    const int32_t lowest = shape.relu ? OUTPUT_ZERO_POINT : -128;
+    for (int u = 0; u < shape.units(); u++)
+    {
+      int32_t value = weights.bias[u];
+
+      for (int r = 0; r < shape.rank; r++)
+        value += sums[u * shape.rank + r];
+      value = tflite::MultiplyByQuantizedMultiplier(value, outputMultiplier, outputShift) + OUTPUT_ZERO_POINT;
+      output[u] = std::min(std::max(value, lowest), (int32_t) 127);
+    }
+  }
+
+  protected:
+  const Shape &shape;
+  const Weights &weights;
+  std::vector<int16_t> history;
+  std::vector<int32_t> sums;
+  int32_t featureMultiplier;
+  int featureShift;
+  int32_t outputMultiplier;
+  int outputShift;
+};
+
+// The float SVDF in the order of the kernel's float path: the same history,
+// each sum from the oldest activation, the bias first
+class FloatReference
+{
+  public:
+  FloatReference(const Shape &shape, const Weights &weights) :
+    shape(shape),
+    weights(weights),
+    history(shape.filters * shape.memory, 0),
+    sums(shape.filters)
+  {
+  }
+
+  void reset()
+  {
+    std::fill(history.begin(), history.end(), 0.0f);
+  }
+
+  void step(const float *input, float *output)
+  {
+    const int memory = shape.memory;
+
+    for (int f = 0; f < shape.filters; f++)
+    {
+      float *filter = &history[f * memory];
+      float dot = 0;
+
+      for (int i = 0; i < memory - 1; i++)
+        filter[i] = filter[i + 1];
+      for (int k = 0; k < shape.inputs; k++)
+        dot += weights.featureFloat[f * shape.inputs + k] * input[k];
+      filter[memory - 1] = dot;
+    }
+
+    for (int f = 0; f < shape.filters; f++)
+    {
+      sums[f] = 0;
+      for (int i = 0; i < memory; i++)
+        sums[f] += weights.timeFloat[f * memory + i] * history[f * memory + i];
+    }
+
+    for (int u = 0; u < shape.units(); u++)
+    {
+      output[u] = weights.biasFloat[u];
+      for (int r = 0; r < shape.rank; r++)
+        output[u] += sums[u * shape.rank + r];
+      if (shape.relu && output[u] < 0)
+        output[u] = 0;
+    }
+  }
+
+  protected:
+  const Shape &shape;
+  const Weights &weights;
+  std::vector<float> history;
+  std::vector<float> sums;
+};
+
+uint8_t arena[ARENA_SIZE];
+tflite::MicroErrorReporter reporter;
+tflite::ops::micro::AllOpsResolver resolver;
+
+// Steps the model of a shape on random int8 inputs (dequantized for the float
+// one), the int8 outputs against the reference's
+// @return the microseconds per step, or a negative value if it would not run
+double runModel(const Shape &shape, const Weights &weights, bool integer, uint32_t &different)
+{
+  const std::vector<uint8_t> flatbuffer = buildModel(shape, weights, integer);
+  tflite::MicroInterpreter interpreter(tflite::GetModel(flatbuffer.data()), resolver, arena, sizeof(arena),
+                                       &reporter);
+  Reference reference(shape, weights);
+  std::vector<int8_t> expected(shape.units());
+  double us = 0;
+
+  if (interpreter.AllocateTensors() != kTfLiteOk)
+    return -1;
+
+  TfLiteTensor *input = interpreter.input(0);
+  TfLiteTensor *output = interpreter.output(0);
+  for (int step = 0; step < STEPS; step++)
+  {
+    if (step == RESET_STEP)
+    {
+      interpreter.ResetVariableTensors();
+      reference.reset();
+    }
+
+    for (int k = 0; k < shape.inputs; k++)
+    {
+      const int8_t value = rand() % 256 - 128;
+
+      if (integer)
+        input->data.int8[k] = value;
+      else
+        input->data.f[k] = (value - INPUT_ZERO_POINT) * INPUT_SCALE;
+    }
+
+    const Clock::time_point start = Clock::now();
+    if (interpreter.Invoke() != kTfLiteOk)
+      return -1;
+    us += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    if (integer)
+    {
+      reference.step(input->data.int8, expected.data());
+      for (int u = 0; u < shape.units(); u++)
+        different += output->data.int8[u] != expected[u];
+    }
+  }
+  return us / STEPS;
+}
+
+bool checkShape(const Shape &shape)
+{
+  Weights weights;
+  uint32_t different = 0;
+
+  randomWeights(shape, weights);
+  const double integerUs = runModel(shape, weights, true, different);
+  const double floatUs = runModel(shape, weights, false, different);
+  if (integerUs < 0 || floatUs < 0)
+  {
+    printf("%d inputs, %d filters: the model does not run\n", shape.inputs, shape.filters);
+    return false;
+  }
+
+  printf("%2d inputs, %2d filters of rank %d, memory %2d%s: %u different outputs in %d steps, int8 %.2f us, "
+         "float %.2f us per step\n",
+         shape.inputs, shape.filters, shape.rank, shape.memory, shape.relu ? ", relu" : "", different, STEPS,
+         integerUs, floatUs);
+  return different == 0;
+}
+
+// A float model on a window of frames rows of channels, through the
+// pipeline's calls: every row pushed, the window bound in place (it moves
+// along the ring at every push), the state reset part way
+template<uint16_t frames, uint16_t channels>
+bool checkStreaming(bool scratch)
+{
+  const Shape shape = {frames * channels, 16, 2, 98, true};
+  typedef Eloquent::TinyML::TensorFlow::AllOpsTensorFlow<frames * channels, 8, 32 * 1024> Model;
+  Weights weights;
+
+  randomWeights(shape, weights);
+  const std::vector<uint8_t> flatbuffer = buildModel(shape, weights, false, scratch);
+  Spectrogram<frames, channels> *spectrogram = new Spectrogram<frames, channels>();
+  Model *model = new Model();
+  FloatReference reference(shape, weights);
+  float expected[8];
+  uint32_t different = 0;
+  double us = 0;
+  bool ran = model->begin(flatbuffer.data());
+
+  for (int row = 0; ran && row < STREAM_ROWS; row++)
+  {
+    uint16_t values[channels];
+
+    if (row == STREAM_RESET_ROW)
+    {
+      ran &= model->resetState();
+      reference.reset();
+    }
+
+    for (uint16_t c = 0; c < channels; c++)
+      values[c] = rand() % 1024;
+    spectrogram->push(values);
+
+    ran &= model->bindFloatInput(spectrogram->window());
+    const Clock::time_point start = Clock::now();
+    model->predictInPlace();
+    us += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    ran &= model->isOk();
+
+    reference.step(spectrogram->window(), expected);
+    for (int u = 0; u < shape.units(); u++)
+      different += model->getScoreAt(u) != expected[u];
+  }
+
+  if (ran)
+    printf("%u row%s of %2u channels in place, %d inputs: %u different outputs in %d rows, %.2f us per row\n", frames,
+           frames > 1 ? "s" : "", channels, scratch ? 6 : 5, different, STREAM_ROWS, us / STREAM_ROWS);
+  else
+    printf("%u rows of %u channels, %d inputs: the model does not run\n", frames, channels, scratch ? 6 : 5);
+  delete model;
+  delete spectrogram;
+  return ran && different == 0;
+}
+
+bool checkAll()
+{
+  bool ok = true;
+
+  srand(1);
+  for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++)
+    ok &= checkShape(shapes[i]);
+
+  // a row per step (KWS_FRAMES 1), then windows of a few rows
+  ok &= checkStreaming<1, 40>(false);
+  ok &= checkStreaming<1, 40>(true);
+  ok &= checkStreaming<3, 13>(false);
+  ok &= checkStreaming<3, 13>(true);
+  printf(ok ? "OK\n" : "DIFFERENT\n");
+  return ok;
+}
+
+#ifdef ARDUINO
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println();
+  checkAll();
+}
+
+void loop()
+{
+}
+
+#else
+
+int main()
+{
+  return checkAll() ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "AudioSource.h"
+
+// Lock-free single producer / single consumer ring of samples. The capture
+// task writes every DMA block as it completes, the frontend task reads it
+// stride by stride. With each block the producer stamps the capture time of
+// its newest sample, so the consumer can date any sample it reads. When the
+// consumer falls behind, the newest samples are dropped and counted.
+template<uint32_t capacity, uint32_t sampleRate = 16000>
+class AudioRing: public AudioSource
+{
+  static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+  public:
+  AudioRing() :
+    writeIndex(0),
+    readIndex(0),
+    stampVersion(0),
+    stampEnd(0),
+    stampTime(0),
+    dropped(0)
+  {
+  }
+
+  /**
+   * Producer: append captured samples
+   * @param capturedUs time the last of them was captured
+   * @return samples stored, the rest did not fit
+   */
+  size_t write(const int16_t *input, size_t count, uint32_t capturedUs)
+  {
+    const uint32_t w = writeIndex.load(std::memory_order_relaxed);
+    const uint32_t space = capacity - (w - readIndex.load(std::memory_order_acquire));
+    const uint32_t stored = count < space ? count : space;
+
+    store(w, input, stored);
+
+    if (stored < count)
+    {
+      dropped += count - stored;
+      // the last stored sample came before the dropped ones
+      capturedUs -= (uint64_t) (count - stored) * 1000000 / sampleRate;
+    }
+
+    // stamp before publishing, a reader never sees samples newer than the stamp
+    const uint32_t version = stampVersion.load(std::memory_order_relaxed);
+    stampVersion.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    stampEnd.store(w + stored, std::memory_order_relaxed);
+    stampTime.store(capturedUs, std::memory_order_relaxed);
+    stampVersion.store(version + 2, std::memory_order_release);
+
+    writeIndex.store(w + stored, std::memory_order_release);
+    return stored;
+  }
+
+  /**
+   * Consumer: take the oldest samples
+   */
+  size_t read(int16_t *output, size_t count, uint32_t &capturedUs)
+  {
+    const uint32_t r = readIndex.load(std::memory_order_relaxed);
+    const uint32_t available = writeIndex.load(std::memory_order_acquire) - r;
+    const uint32_t taken = count < available ? count : available;
+
+    if (taken == 0)
+      return 0;
+
+    load(r, output, taken);
+    readIndex.store(r + taken, std::memory_order_release);
+    capturedUs = captureTime(r + taken - 1);
+    return taken;
+  }
+
+  /**
+   * When the sample at a ring index was captured, from the newest stamp
+   */
+  uint32_t captureTime(uint32_t index) const
+  {
+    uint32_t version;
+    uint32_t end;
+    uint32_t time;
+
+    do
+    {
+      version = stampVersion.load(std::memory_order_acquire);
+      end = stampEnd.load(std::memory_order_relaxed);
+      time = stampTime.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((version & 1) || version != stampVersion.load(std::memory_order_relaxed));
+
+    return time - (uint64_t) (end - 1 - index) * 1000000 / sampleRate;
+  }
+
+  uint32_t getSampleRate() const
+  {
+    return sampleRate;
+  }
+
+  /**
+   * Samples waiting for the consumer
+   */
+  uint32_t getAvailable() const
+  {
+    return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Samples the producer could not store since boot
+   */
+  uint32_t getDropped() const
+  {
+    return dropped;
+  }
+
+  protected:
+  int16_t samples[capacity];
+  std::atomic<uint32_t> writeIndex;
+  std::atomic<uint32_t> readIndex;
+  std::atomic<uint32_t> stampVersion;
+  std::atomic<uint32_t> stampEnd;
+  std::atomic<uint32_t> stampTime;
+  volatile uint32_t dropped;
+
+  // copy in and out of the ring, across its end
+  void store(uint32_t index, const int16_t *input, uint32_t count)
+  {
+    const uint32_t offset = index & (capacity - 1);
+    const uint32_t first = count < capacity - offset ? count : capacity - offset;
+
+    memcpy(samples + offset, input, first * sizeof(int16_t));
+    memcpy(samples, input + first, (count - first) * sizeof(int16_t));
+  }
+
+  void load(uint32_t index, int16_t *output, uint32_t count) const
+  {
+    const uint32_t offset = index & (capacity - 1);
+    const uint32_t first = count < capacity - offset ? count : capacity - offset;
+
+    memcpy(output, samples + offset, first * sizeof(int16_t));
+    memcpy(output + first, samples, (count - first) * sizeof(int16_t));
+  }
+};
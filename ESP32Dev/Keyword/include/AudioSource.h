@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+/**
+ * Microseconds on the clock audio is stamped with: micros() on the board,
+ * a monotonic clock on a host
+ */
+inline uint32_t audioMicros()
+{
+#ifdef ARDUINO
+  return micros();
+#else
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Source of 16 bit mono samples at the frontend sample rate: the I2S
+// microphone through an AudioRing on the board, a WavSource on a host.
+class AudioSource
+{
+  public:
+  virtual ~AudioSource() {}
+
+  /**
+   * Copy the samples available, up to count, without waiting
+   * @param capturedUs set to the time the last copied sample was captured
+   * @return samples copied, 0 if none arrived yet
+   */
+  virtual size_t read(int16_t *samples, size_t count, uint32_t &capturedUs) = 0;
+
+  /**
+   * No sample will ever come again
+   */
+  virtual bool finished() const
+  {
+    return false;
+  }
+
+  virtual uint32_t getSampleRate() const = 0;
+};
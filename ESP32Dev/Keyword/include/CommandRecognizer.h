@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+
+// Turns the scores of successive inferences into detections, as the
+// micro_speech example does: scores are averaged over the last averageMs,
+// a keyword is reported when its average passes the threshold and not again
+// before suppressionMs, so a word heard in several windows counts once.
+// Labels below firstKeyword (silence, unknown) are never reported.
+template<uint8_t labels, uint8_t history = 64>
+class CommandRecognizer
+{
+  public:
+  CommandRecognizer(uint8_t firstKeywordLabel = 2, float scoreThreshold = 0.8f, uint16_t averageWindowMs = 1000,
+                    uint16_t suppression = 1500, uint8_t minimumResults = 3) :
+    firstKeyword(firstKeywordLabel),
+    threshold(scoreThreshold),
+    averageMs(averageWindowMs),
+    suppressionMs(suppression),
+    minimumCount(minimumResults)
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    head = 0;
+    count = 0;
+    lastDetectionMs = 0;
+    detected = false;
+    score = 0;
+  }
+
+  /**
+   * Add the scores of one inference
+   * @return label of a new detection, -1 if none
+   */
+  int8_t process(const float *scores, uint32_t nowMs)
+  {
+    times[head] = nowMs;
+    for (uint8_t i = 0; i < labels; i++)
+      results[head][i] = scores[i];
+    head = (head + 1) % history;
+    if (count < history)
+      count++;
+
+    // average what falls in the window, newest first
+    float average[labels] = {0};
+    uint8_t used = 0;
+    for (; used < count; used++)
+    {
+      const uint8_t slot = (head + history - 1 - used) % history;
+      if (nowMs - times[slot] > averageMs)
+        break;
+      for (uint8_t i = 0; i < labels; i++)
+        average[i] += results[slot][i];
+    }
+
+    if (used < minimumCount)
+      return -1;
+
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < labels; i++)
+    {
+      if (average[i] > average[best])
+        best = i;
+    }
+
+    score = average[best] / used;
+    if (best < firstKeyword || score < threshold)
+      return -1;
+
+    if (detected && nowMs - lastDetectionMs < suppressionMs)
+      return -1;
+
+    detected = true;
+    lastDetectionMs = nowMs;
+    return best;
+  }
+
+  /**
+   * Average score of the best label at the last process()
+   */
+  float getScore() const
+  {
+    return score;
+  }
+
+  protected:
+  uint8_t firstKeyword;
+  float threshold;
+  uint16_t averageMs;
+  uint16_t suppressionMs;
+  uint8_t minimumCount;
+  uint32_t times[history];
+  float results[history][labels];
+  uint8_t head;
+  uint8_t count;
+  uint32_t lastDetectionMs;
+  bool detected;
+  float score;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <Arduino.h>
+#include "driver/i2s.h"
+
+// I2S MEMS microphone (INMP441, SPH0645 and the like) read through the I2S
+// driver: the DMA fills dmaBufferCount buffers of blockSamples samples in the
+// background and capture() hands the oldest complete one over to a ring. The
+// microphones send 24 bit samples left aligned in 32 bit slots, shift picks
+// the 16 bits kept: 16 keeps the top ones, less adds gain for quiet rooms.
+class I2SMicrophone
+{
+  public:
+  static const uint16_t blockSamples = 256;
+
+  I2SMicrophone(uint8_t bck, uint8_t ws, uint8_t data, i2s_port_t i2sPort = I2S_NUM_0, uint8_t sampleShift = 14) :
+    bckPin(bck),
+    wsPin(ws),
+    dataPin(data),
+    port(i2sPort),
+    shift(sampleShift),
+    blocks(0),
+    clipped(0)
+  {
+  }
+
+  /**
+   * Install the driver and start the DMA
+   * @return false if the driver refused the configuration
+   */
+  bool begin(uint32_t sampleRate, uint8_t dmaBufferCount = 4)
+  {
+    i2s_config_t config = {};
+    config.mode = (i2s_mode_t) (I2S_MODE_MASTER | I2S_MODE_RX);
+    config.sample_rate = sampleRate;
+    config.bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT;
+    config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+    config.communication_format = (i2s_comm_format_t) (I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_MSB);
+    config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+    config.dma_buf_count = dmaBufferCount;
+    config.dma_buf_len = blockSamples;
+    config.use_apll = false;
+
+    if (i2s_driver_install(port, &config, 0, NULL) != ESP_OK)
+      return false;
+
+    i2s_pin_config_t pins = {};
+    pins.bck_io_num = bckPin;
+    pins.ws_io_num = wsPin;
+    pins.data_out_num = I2S_PIN_NO_CHANGE;
+    pins.data_in_num = dataPin;
+
+    return i2s_set_pin(port, &pins) == ESP_OK;
+  }
+
+  /**
+   * Wait for the next DMA block and append it to a ring
+   * @return samples appended, 0 on a driver error
+   */
+  template<class Ring>
+  size_t capture(Ring &ring)
+  {
+    size_t bytesRead = 0;
+
+    if (i2s_read(port, raw, sizeof(raw), &bytesRead, portMAX_DELAY) != ESP_OK)
+      return 0;
+
+    // the block completed just now, its last sample is the newest
+    const uint32_t capturedUs = micros();
+    const size_t count = bytesRead / sizeof(raw[0]);
+
+    for (size_t i = 0; i < count; i++)
+    {
+      int32_t sample = raw[i] >> shift;
+
+      if (sample > INT16_MAX || sample < INT16_MIN)
+      {
+        sample = sample > 0 ? INT16_MAX : INT16_MIN;
+        clipped++;
+      }
+
+      samples[i] = sample;
+    }
+
+    blocks++;
+    return ring.write(samples, count, capturedUs);
+  }
+
+  uint32_t getBlocks() const
+  {
+    return blocks;
+  }
+
+  /**
+   * Samples saturated by the shift since boot, lower the gain if it grows
+   */
+  uint32_t getClipped() const
+  {
+    return clipped;
+  }
+
+  protected:
+  uint8_t bckPin;
+  uint8_t wsPin;
+  uint8_t dataPin;
+  i2s_port_t port;
+  uint8_t shift;
+  volatile uint32_t blocks;
+  volatile uint32_t clipped;
+  int32_t raw[blockSamples];
+  int16_t samples[blockSamples];
+};
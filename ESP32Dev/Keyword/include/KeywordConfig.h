@@ -0,0 +1,30 @@
+#pragma once
+
+// Audio, features and model shared by the board and the host runner, they
+// must match the training in Models/keyword_model.py
+
+#define SAMPLE_RATE 16000
+#define WINDOW_MS 30
+#define STRIDE_MS 10
+#define KWS_CHANNELS 40
+#define KWS_FRAMES 98
+#define KWS_LABELS 4
+#define ARENA_SIZE 64 * 1024
+
+// Rows between two inferences, a keyword lasts about 50 of them
+
+#define INFERENCE_STRIDE 3
+
+// Voice gate: strides without voice skip the frontend and the model, the
+// last VAD_HISTORY_MS of them are replayed when voice starts. The gate stays
+// open VAD_HANGOVER_MS after voice stops, so a keyword leaves the model's
+// window before it closes
+
+#define VAD_HISTORY_MS 300
+#define VAD_HANGOVER_MS 1000
+
+// A streaming model, whose SVDF layers keep the last second between
+// invocations, takes only the newest row at every row: KWS_FRAMES 1 and
+// INFERENCE_STRIDE 1
+
+const char *const labels[KWS_LABELS] = {"silence", "unknown", "yes", "no"};
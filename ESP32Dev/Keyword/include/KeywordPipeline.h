@@ -0,0 +1,409 @@
+#pragma once
+
+#include <stdint.h>
+#include <LatencyHistogram.h>
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+#include "eloquent_tinyml/tensorflow/esp32/tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
+#include "AudioSource.h"
+#include "Spectrogram.h"
+#include "CommandRecognizer.h"
+#include "VoiceDetector.h"
+
+// Body of the frontend task: reads one stride of audio at a time, turns each
+// window into a microfrontend row, runs the keyword model every
+// inferenceStride rows once the spectrogram is full, and keeps the numbers
+// that say whether it keeps up: audio to decision latency (capture of the
+// newest sample in the spectrogram to the recognizer's verdict), time per
+// row and per inference, and the load, time spent over audio processed.
+// The model reads the spectrogram window in place, nothing is copied per
+// inference. With frames = 1 and one inference per row it is a streaming
+// model, whose SVDF layers remember the past between invocations: each row
+// then costs the frontend and one model step, whatever the window it hears.
+// With the voice gate on, strides the VoiceDetector hears no voice in skip
+// the frontend and the model: the last historySamples of them are kept and
+// replayed through the frontend when voice starts, so the spectrogram holds
+// the audio just before the onset, which the detector may have missed the
+// start of. Rows older than that are the ones the gate closed on, silence
+// after its hangover, as the model would have heard. Replayed rows only run
+// a streaming model (frames = 1), whose memory needs every row; a windowed
+// one sees them in its next window.
+// Model is an EloquentTinyML TensorFlow instance of a float model, or
+// anything with bindFloatInput(), predictInPlace(), resetState(), isOk()
+// and getScoreAt().
+template<class Model, uint16_t frames, uint16_t channels, uint8_t labels, uint32_t historySamples = 0>
+class KeywordPipeline
+{
+  public:
+  static const uint16_t maxStrideSamples = 512;
+
+  KeywordPipeline(Model &kwsModel, uint8_t rowsPerInference) :
+    model(kwsModel),
+    inferenceStride(rowsPerInference),
+    sampleRate(0),
+    strideSamples(0),
+    rowsSinceInference(0),
+    streamSamples(0),
+    started(false),
+    gated(false),
+    historyHead(0),
+    historyCount(0),
+    historyCapturedUs(0),
+    historyGap(false)
+  {
+    detection = -1;
+    detectionScore = 0;
+    detectionLatency = 0;
+    resetStats(0);
+  }
+
+  ~KeywordPipeline()
+  {
+    if (started)
+      FrontendFreeStateContents(&frontend);
+  }
+
+  /**
+   * Allocate the frontend for windowMs windows every strideMs
+   * @return false if out of memory or the stride is too long
+   */
+  bool begin(uint32_t rate, uint16_t windowMs, uint16_t strideMs)
+  {
+    FrontendConfig config;
+
+    FrontendFillConfigWithDefaults(&config);
+    config.window.size_ms = windowMs;
+    config.window.step_size_ms = strideMs;
+    config.filterbank.num_channels = channels;
+    // as the TensorFlow op the model was trained with
+    config.pcan_gain_control.enable_pcan = 1;
+
+    sampleRate = rate;
+    strideSamples = rate * strideMs / 1000;
+    if (strideSamples == 0 || strideSamples > maxStrideSamples)
+      return false;
+
+    // the window and a streaming model's memory start from silence
+    spectrogram.reset();
+    model.resetState();
+    voice.reset();
+    historyCount = 0;
+    historyGap = false;
+
+    started = FrontendPopulateState(&config, &frontend, rate);
+    return started;
+  }
+
+  /**
+   * Process the audio available, up to one stride
+   * @return false if the source had nothing
+   */
+  bool process(AudioSource &source)
+  {
+    uint32_t capturedUs;
+    const size_t count = source.read(buffer, strideSamples, capturedUs);
+
+    detection = -1;
+    if (count == 0)
+      return false;
+
+    const uint32_t startUs = audioMicros();
+
+    streamSamples += count;
+    samples += count;
+
+    if (gated && !voice.update(buffer, count))
+    {
+      keep(buffer, count, capturedUs);
+    }
+    else
+    {
+      if (historyCount > 0)
+        replay(count);
+      feed(buffer, count, capturedUs, streamSamples, true);
+    }
+
+    busyUs += audioMicros() - startUs;
+    return true;
+  }
+
+  /**
+   * Turn the voice gate on or off, it needs historySamples > 0
+   */
+  void setVoiceGate(bool enable)
+  {
+    gated = enable && historySamples > 0;
+    voice.reset();
+  }
+
+  VoiceDetector &getVoiceDetector()
+  {
+    return voice;
+  }
+
+  /**
+   * Fraction of the strides the frontend and model ran on since resetStats(),
+   * 1 without the voice gate
+   */
+  float getActiveRatio() const
+  {
+    return gated ? voice.getActiveRatio() : 1;
+  }
+
+  /**
+   * Label detected by the last process(), -1 if none
+   */
+  int8_t getDetection() const
+  {
+    return detection;
+  }
+
+  float getDetectionScore() const
+  {
+    return detectionScore;
+  }
+
+  /**
+   * Audio to decision latency of the last detection, microseconds
+   */
+  uint32_t getDetectionLatency() const
+  {
+    return detectionLatency;
+  }
+
+  /**
+   * Audio to decision latency of every inference since resetStats(), microseconds
+   */
+  const LatencyHistogram<> &getLatency() const
+  {
+    return latency;
+  }
+
+  /**
+   * Mean frontend time per spectrogram row, microseconds
+   */
+  float getRowMicros() const
+  {
+    return rows == 0 ? 0 : (float) frontendUs / rows;
+  }
+
+  /**
+   * Mean model time per inference, microseconds
+   */
+  float getInferenceMicros() const
+  {
+    return inferences == 0 ? 0 : (float) modelUs / inferences;
+  }
+
+  /**
+   * Processing time over the duration of the audio processed: 0.25 leaves
+   * 75% of the task's core to spare, above 1 the pipeline falls behind
+   */
+  float getLoad() const
+  {
+    return samples == 0 ? 0 : busyUs * (float) sampleRate / 1000000.0f / samples;
+  }
+
+  /**
+   * Mean cycles per row spent in one stage of the frontend since
+   * resetStats(), 0 unless built with FRONTEND_PROFILE
+   */
+  uint32_t getStageCycles(FrontendStage stage) const
+  {
+    const FrontendProfile &profile = frontend.profile;
+    return profile.frames == 0 ? 0 : profile.cycles[stage] / profile.frames;
+  }
+
+  uint32_t getRows() const
+  {
+    return rows;
+  }
+
+  uint32_t getInferences() const
+  {
+    return inferences;
+  }
+
+  uint32_t getDetections() const
+  {
+    return detections;
+  }
+
+  uint32_t getErrors() const
+  {
+    return errors;
+  }
+
+  /**
+   * Start a new statistics window at nowMs
+   */
+  void resetStats(uint32_t nowMs)
+  {
+    latency.reset(nowMs);
+    samples = 0;
+    rows = 0;
+    inferences = 0;
+    detections = 0;
+    errors = 0;
+    frontendUs = 0;
+    modelUs = 0;
+    busyUs = 0;
+    voice.resetStats();
+    FrontendResetProfile(&frontend);
+  }
+
+  CommandRecognizer<labels> &getRecognizer()
+  {
+    return recognizer;
+  }
+
+  protected:
+  Model &model;
+  uint8_t inferenceStride;
+  uint32_t sampleRate;
+  uint16_t strideSamples;
+  uint8_t rowsSinceInference;
+  uint64_t streamSamples;
+  bool started;
+  bool gated;
+  VoiceDetector voice;
+  // audio the gate held back, a ring of the newest historySamples
+  int16_t history[historySamples > 0 ? historySamples : 1];
+  uint32_t historyHead;
+  uint32_t historyCount;
+  uint32_t historyCapturedUs;
+  // samples older than the history were dropped
+  bool historyGap;
+  FrontendState frontend;
+  Spectrogram<frames, channels> spectrogram;
+  CommandRecognizer<labels> recognizer;
+  int16_t buffer[maxStrideSamples];
+  int8_t detection;
+  float detectionScore;
+  uint32_t detectionLatency;
+  LatencyHistogram<> latency;
+  uint32_t samples;
+  uint32_t rows;
+  uint32_t inferences;
+  uint32_t detections;
+  uint32_t errors;
+  uint32_t frontendUs;
+  uint32_t modelUs;
+  uint32_t busyUs;
+
+  // Run count samples through the frontend into the spectrogram, inferring
+  // when due if inferring: capturedUs is the capture time of the last sample,
+  // endSample its position in the stream, plus one
+  void feed(const int16_t *samples, size_t count, uint32_t capturedUs, uint64_t endSample, bool inferring)
+  {
+    const int16_t *next = samples;
+    size_t left = count;
+
+    while (left > 0)
+    {
+      size_t used = 0;
+      const uint32_t rowStartUs = audioMicros();
+      const FrontendOutput output = FrontendProcessSamples(&frontend, next, left, &used);
+
+      next += used;
+      left -= used;
+      frontendUs += audioMicros() - rowStartUs;
+
+      if (output.size == 0)
+      {
+        if (used == 0)
+          break;
+        continue;
+      }
+
+      spectrogram.push(output.values);
+      rows++;
+
+      // the row ends with the last sample consumed, the ones left are newer
+      if (++rowsSinceInference >= inferenceStride && spectrogram.full() && inferring)
+        infer(capturedUs - (uint64_t) left * 1000000 / sampleRate, (endSample - left) * 1000 / sampleRate);
+    }
+  }
+
+  // Hold back a stride the gate closed on, the oldest samples make room
+  void keep(const int16_t *samples, size_t count, uint32_t capturedUs)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      history[historyHead] = samples[i];
+      if (++historyHead == historySamples)
+        historyHead = 0;
+    }
+
+    if (historyCount + count > historySamples)
+    {
+      historyGap = true;
+      historyCount = historySamples;
+    }
+    else
+      historyCount += count;
+    historyCapturedUs = capturedUs;
+  }
+
+  // Run the held back audio through the frontend, oldest first, before the
+  // newer samples of the stride that opened the gate
+  void replay(size_t newer)
+  {
+    // the frontend's window holds the audio before the gap, start a new one
+    if (historyGap)
+      WindowReset(&frontend.window);
+
+    const uint32_t oldest = (historyHead + historySamples - historyCount) % historySamples;
+    const uint32_t first = historyCount < historySamples - oldest ? historyCount : historySamples - oldest;
+    const uint32_t second = historyCount - first;
+    const uint64_t endSample = streamSamples - newer;
+    const bool inferring = frames == 1;
+
+    feed(history + oldest, first, historyCapturedUs - (uint64_t) second * 1000000 / sampleRate, endSample - second,
+         inferring);
+    feed(history, second, historyCapturedUs, endSample, inferring);
+
+    historyCount = 0;
+    historyGap = false;
+  }
+
+  // rowCapturedUs: capture time of the newest sample in the spectrogram,
+  // streamMs: its position in the stream, the recognizer's clock so a file
+  // played faster than real time is recognized the same
+  void infer(uint32_t rowCapturedUs, uint32_t streamMs)
+  {
+    rowsSinceInference = 0;
+    if (!model.bindFloatInput(spectrogram.window()))
+    {
+      errors++;
+      return;
+    }
+
+    const uint32_t startUs = audioMicros();
+    model.predictInPlace();
+    modelUs += audioMicros() - startUs;
+    inferences++;
+
+    if (!model.isOk())
+    {
+      errors++;
+      return;
+    }
+
+    float scores[labels];
+    for (uint8_t i = 0; i < labels; i++)
+      scores[i] = model.getScoreAt(i);
+
+    const uint32_t nowUs = audioMicros();
+    const int8_t label = recognizer.process(scores, streamMs);
+
+    latency.record(nowUs - rowCapturedUs);
+
+    if (label >= 0)
+    {
+      detection = label;
+      detectionScore = recognizer.getScore();
+      detectionLatency = nowUs - rowCapturedUs;
+      detections++;
+    }
+  }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// Sliding window over the last frames rows of the microfrontend, oldest row
+// first, as the keyword model takes them. Rows are scaled the way the model
+// was trained (Models/keyword_model.py): frontend output * 10 / 256.
+// The rows live in a ring written twice, at slot and slot + frames, so the
+// window is always frames contiguous rows starting at the oldest one: a row
+// costs two row writes instead of moving the whole window, and the model can
+// read window() in place (TensorFlow::bindFloatInput()).
+template<uint16_t frames, uint16_t channels>
+class Spectrogram
+{
+  public:
+  static const uint32_t size = (uint32_t) frames * channels;
+
+  Spectrogram()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    memset(rows, 0, sizeof(rows));
+    head = 0;
+    filled = 0;
+  }
+
+  /**
+   * Append one frontend output, the oldest row falls out
+   */
+  void push(const uint16_t *values)
+  {
+    float *row = rows + (uint32_t) head * channels;
+    for (uint16_t c = 0; c < channels; c++)
+      row[c] = values[c] * featureScale;
+    memcpy(row + size, row, channels * sizeof(float));
+
+    if (++head == frames)
+      head = 0;
+
+    if (filled < frames)
+      filled++;
+  }
+
+  /**
+   * Every row holds audio, the model can run
+   */
+  bool full() const
+  {
+    return filled == frames;
+  }
+
+  /**
+   * The window, size values oldest row first, valid until the next push()
+   */
+  const float *window() const
+  {
+    return rows + (uint32_t) head * channels;
+  }
+
+  /**
+   * Copy the window into a model input, oldest row first
+   */
+  void copyTo(float *input) const
+  {
+    memcpy(input, window(), size * sizeof(float));
+  }
+
+  protected:
+  static constexpr float featureScale = 10.0f / 256.0f;
+
+  float rows[2 * size];
+  uint16_t head;
+  uint16_t filled;
+};
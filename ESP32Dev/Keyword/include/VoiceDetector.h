@@ -0,0 +1,254 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Cheap voice activity detector to run before the microfrontend.
+// Each stride of raw audio is reduced to its power (around its mean, so a
+// microphone's DC offset does not count) and its zero crossings, and the
+// power is compared against a running noise floor: well above it is voice,
+// a little above it with many crossings is a fricative ("s", "f") too quiet
+// to pass on power alone. The floor falls quickly and rises slowly, so a
+// word does not become the floor but a fan switched on does, after a while.
+// Once voice stops the detector stays active for a hangover, so a word's
+// tail and the silence after it still reach the model.
+class VoiceDetector
+{
+  public:
+  VoiceDetector() :
+    speechShift(2),
+    fricativeShift(1),
+    fricativeCrossings(64),
+    riseShift(9),
+    fallShift(2),
+    minFloor(16),
+    hangoverStrides(0),
+    hasFloor(false),
+    active(false),
+    quietStrides(0),
+    floor(0),
+    power(0),
+    crossings(0),
+    stridesSeen(0),
+    stridesActive(0)
+  {
+  }
+
+  /**
+   * Power over the floor for voice, as a power of two
+   * @param shift 0-8, 2 is 6 dB
+   */
+  void setSpeechShift(uint8_t shift)
+  {
+    speechShift = shift > 8 ? 8 : shift;
+  }
+
+  /**
+   * Power over the floor for a fricative, with the crossings below
+   * @param shift 0-8, below the speech shift
+   * @param crossingsPer256 zero crossings per 256 samples, 64 is 2 kHz at 16 kHz
+   */
+  void setFricative(uint8_t shift, uint8_t crossingsPer256)
+  {
+    fricativeShift = shift > 8 ? 8 : shift;
+    fricativeCrossings = crossingsPer256;
+  }
+
+  /**
+   * Floor adaptation speed: every stride moves it by 1 / 2^shift of the
+   * difference, rising and falling
+   * @param rise 0-16
+   * @param fall 0-16
+   */
+  void setFloorShifts(uint8_t rise, uint8_t fall)
+  {
+    riseShift = rise > 16 ? 16 : rise;
+    fallShift = fall > 16 ? 16 : fall;
+  }
+
+  /**
+   * Lowest floor, the power of the quietest noise worth comparing with:
+   * digital silence would make any click voice
+   * @param minimumPower mean square of the samples
+   */
+  void setMinFloor(uint32_t minimumPower)
+  {
+    minFloor = minimumPower;
+  }
+
+  /**
+   * Strides to stay active after the last one with voice
+   * @param strides
+   */
+  void setHangover(uint16_t strides)
+  {
+    hangoverStrides = strides;
+  }
+
+  /**
+   * Forget the floor, the next stride will be reported as voice
+   */
+  void reset()
+  {
+    hasFloor = false;
+    active = false;
+    quietStrides = 0;
+  }
+
+  /**
+   * Feed a stride of audio
+   * @return true if the frontend and model should run on it
+   */
+  bool update(const int16_t *samples, size_t count)
+  {
+    if (count == 0)
+      return active;
+
+    stridesSeen++;
+    measure(samples, count);
+
+    if (!hasFloor)
+    {
+      floor = (uint64_t) power << 16;
+      hasFloor = true;
+      setActive();
+      stridesActive++;
+      return true;
+    }
+
+    uint64_t reference = floor >> 16;
+    if (reference < minFloor)
+      reference = minFloor;
+
+    const bool hissing = crossings * 256 >= (uint32_t) fricativeCrossings * count;
+    const bool voice = power > reference << speechShift || (hissing && power > reference << fricativeShift);
+
+    adaptFloor();
+
+    if (voice)
+      setActive();
+    else if (active && ++quietStrides > hangoverStrides)
+      active = false;
+
+    if (active)
+      stridesActive++;
+    return active;
+  }
+
+  bool isActive() const
+  {
+    return active;
+  }
+
+  /**
+   * Power of the last stride, mean square around its mean
+   */
+  uint32_t getPower() const
+  {
+    return power;
+  }
+
+  /**
+   * Noise floor, in the units of getPower()
+   */
+  uint32_t getFloor() const
+  {
+    return floor >> 16;
+  }
+
+  /**
+   * Zero crossings of the last stride
+   */
+  uint32_t getCrossings() const
+  {
+    return crossings;
+  }
+
+  uint32_t getStridesSeen() const
+  {
+    return stridesSeen;
+  }
+
+  uint32_t getStridesActive() const
+  {
+    return stridesActive;
+  }
+
+  /**
+   * Fraction of the strides the frontend and model ran on
+   */
+  float getActiveRatio() const
+  {
+    return stridesSeen == 0 ? 1 : ((float) stridesActive) / stridesSeen;
+  }
+
+  void resetStats()
+  {
+    stridesSeen = 0;
+    stridesActive = 0;
+  }
+
+  protected:
+  uint8_t speechShift;
+  uint8_t fricativeShift;
+  uint8_t fricativeCrossings;
+  uint8_t riseShift;
+  uint8_t fallShift;
+  uint32_t minFloor;
+  uint16_t hangoverStrides;
+  bool hasFloor;
+  bool active;
+  uint16_t quietStrides;
+  // floor in Q16 so that slow adaptation of a quiet floor does not round to zero
+  uint64_t floor;
+  uint32_t power;
+  uint32_t crossings;
+  uint32_t stridesSeen;
+  uint32_t stridesActive;
+
+  void setActive()
+  {
+    active = true;
+    quietStrides = 0;
+  }
+
+  void measure(const int16_t *samples, size_t count)
+  {
+    int32_t sum = 0;
+    uint64_t squares = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      sum += samples[i];
+      squares += (int32_t) samples[i] * samples[i];
+    }
+
+    const int32_t mean = sum / (int32_t) count;
+    const uint32_t meanSquare = squares / count;
+    const uint32_t squaredMean = (uint32_t) (mean * mean);
+
+    power = meanSquare > squaredMean ? meanSquare - squaredMean : 0;
+
+    // sign changes around the mean
+    uint32_t changes = 0;
+    bool above = samples[0] >= mean;
+    for (size_t i = 1; i < count; i++)
+    {
+      const bool sampleAbove = samples[i] >= mean;
+
+      changes += sampleAbove != above;
+      above = sampleAbove;
+    }
+    crossings = changes;
+  }
+
+  void adaptFloor()
+  {
+    const uint64_t target = (uint64_t) power << 16;
+
+    if (target > floor)
+      floor += (target - floor) >> riseShift;
+    else
+      floor -= (floor - target) >> fallShift;
+  }
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include "AudioSource.h"
+
+// Plays a 16 bit mono PCM WAV file in place of the microphone, to run the
+// pipeline on a host or on a known recording. As fast as the reader asks,
+// with every sample stamped when it is read, or paced at the sample rate
+// like the microphone, with every sample stamped when it would have been
+// captured.
+class WavSource: public AudioSource
+{
+  public:
+  WavSource() :
+    file(NULL),
+    sampleRate(0),
+    remaining(0),
+    played(0),
+    startUs(0),
+    realtime(false)
+  {
+  }
+
+  ~WavSource()
+  {
+    close();
+  }
+
+  /**
+   * @return false if the file is missing or not 16 bit mono PCM
+   */
+  bool open(const char *path)
+  {
+    uint8_t header[12];
+
+    close();
+    file = fopen(path, "rb");
+    if (file == NULL)
+      return false;
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, "RIFF", 4) != 0 ||
+        memcmp(header + 8, "WAVE", 4) != 0)
+      return fail();
+
+    // walk the chunks up to the samples, "fmt " comes first
+    bool formatOk = false;
+    while (true)
+    {
+      uint8_t chunk[8];
+      if (fread(chunk, 1, sizeof(chunk), file) != sizeof(chunk))
+        return fail();
+
+      const uint32_t size = readUint32(chunk + 4);
+
+      if (memcmp(chunk, "data", 4) == 0)
+      {
+        if (!formatOk)
+          return fail();
+        remaining = size / sizeof(int16_t);
+        played = 0;
+        startUs = 0;
+        return true;
+      }
+
+      if (memcmp(chunk, "fmt ", 4) == 0)
+      {
+        uint8_t format[16];
+        if (size < sizeof(format) || fread(format, 1, sizeof(format), file) != sizeof(format))
+          return fail();
+
+        // PCM, one channel, 16 bits
+        formatOk = readUint16(format) == 1 && readUint16(format + 2) == 1 && readUint16(format + 14) == 16;
+        sampleRate = readUint32(format + 4);
+        if (!formatOk || fseek(file, size - sizeof(format) + (size & 1), SEEK_CUR) != 0)
+          return fail();
+        continue;
+      }
+
+      // chunks are padded to an even size
+      if (fseek(file, size + (size & 1), SEEK_CUR) != 0)
+        return fail();
+    }
+  }
+
+  void close()
+  {
+    if (file != NULL)
+      fclose(file);
+    file = NULL;
+    remaining = 0;
+  }
+
+  /**
+   * Hand samples over no faster than the microphone would
+   */
+  void setRealtime(bool on)
+  {
+    realtime = on;
+  }
+
+  size_t read(int16_t *samples, size_t count, uint32_t &capturedUs)
+  {
+    if (remaining == 0)
+      return 0;
+
+    const uint32_t nowUs = audioMicros();
+
+    if (startUs == 0)
+      startUs = nowUs;
+
+    if (realtime)
+    {
+      // only the samples the microphone would have delivered by now
+      const uint64_t due = (uint64_t) (nowUs - startUs) * sampleRate / 1000000;
+      if (due <= played)
+        return 0;
+      if (count > due - played)
+        count = due - played;
+    }
+
+    if (count > remaining)
+      count = remaining;
+
+    const size_t got = fread(samples, sizeof(int16_t), count, file);
+    if (got < count)
+      remaining = 0;
+    else
+      remaining -= got;
+
+    // WAV is little endian, like the board and the hosts it runs on
+    played += got;
+    capturedUs = realtime ? startUs + (uint32_t) ((played - 1) * 1000000 / sampleRate) : nowUs;
+    return got;
+  }
+
+  bool finished() const
+  {
+    return remaining == 0;
+  }
+
+  uint32_t getSampleRate() const
+  {
+    return sampleRate;
+  }
+
+  /**
+   * Seconds of audio handed over so far
+   */
+  float getSeconds() const
+  {
+    return sampleRate == 0 ? 0 : (float) played / sampleRate;
+  }
+
+  protected:
+  FILE *file;
+  uint32_t sampleRate;
+  uint32_t remaining;
+  uint64_t played;
+  uint32_t startUs;
+  bool realtime;
+
+  bool fail()
+  {
+    close();
+    return false;
+  }
+
+  static uint16_t readUint16(const uint8_t *data)
+  {
+    return data[0] | data[1] << 8;
+  }
+
+  static uint32_t readUint32(const uint8_t *data)
+  {
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t) data[3] << 24;
+  }
+};
@@ -0,0 +1,159 @@
+#include <Arduino.h>
+#include "EloquentTinyML.h"
+#include "eloquent_tinyml/tensorflow.h"
+#include "keyword_model.h"
+#include "AudioRing.h"
+#include "I2SMicrophone.h"
+#include "KeywordConfig.h"
+#include "KeywordPipeline.h"
+#include <LogQueue.h>
+
+// Keyword spotting on an I2S microphone: the microfrontend turns 30 ms windows
+// every 10 ms into 40 channel rows, the model listens to the last second of
+// them. keyword_model.h comes from Models/keyword_model.py
+
+// I2S microphone pins (INMP441: SCK, WS, SD, L/R to GND for the left slot)
+
+const uint8_t MIC_BCK = 26;
+const uint8_t MIC_WS = 25;
+const uint8_t MIC_DATA = 33;
+
+// Half a second of audio waits in the ring if the frontend task is late
+
+#define AUDIO_RING_SAMPLES 8192
+
+// Two tasks as in Person: capture on core 0 moves every DMA block into the
+// ring, the frontend task on core 1 turns it into rows and decisions
+
+#define CAPTURE_CORE 0
+#define FRONTEND_CORE 1
+#define CAPTURE_STACK_SIZE 4096
+#define FRONTEND_STACK_SIZE 8192
+#define STATS_INTERVAL 5000
+
+Eloquent::TinyML::TensorFlow::TensorFlow<KWS_FRAMES * KWS_CHANNELS, KWS_LABELS, ARENA_SIZE> keywordModel;
+I2SMicrophone microphone(MIC_BCK, MIC_WS, MIC_DATA);
+AudioRing<AUDIO_RING_SAMPLES, SAMPLE_RATE> audioRing;
+KeywordPipeline<decltype(keywordModel), KWS_FRAMES, KWS_CHANNELS, KWS_LABELS, VAD_HISTORY_MS * SAMPLE_RATE / 1000>
+    pipeline(keywordModel, INFERENCE_STRIDE);
+
+TaskHandle_t captureTaskHandle;
+TaskHandle_t frontendTaskHandle;
+
+// Capture task, pinned to CAPTURE_CORE: blocks on the I2S driver until a DMA
+// buffer completes
+
+void captureTask(void *parameters)
+{
+    while (true)
+    {
+        if (microphone.capture(audioRing) == 0)
+            vTaskDelay(1);
+    }
+}
+
+// Log what the last STATS_INTERVAL looked like, from the frontend task so
+// the counters are only touched by one task
+
+void logStats()
+{
+    const LatencyHistogram<> &latency = pipeline.getLatency();
+
+    LOG_INFO("Audio to decision: p50 %u us, p99 %u us, max %u us over %u inferences", latency.percentile(50),
+             latency.percentile(99), latency.max(), latency.count());
+
+    LOG_INFO("Frontend %.0f us per row, model %.0f us per inference, load %.1f%%, headroom %.1f%%, voice %.1f%%",
+             pipeline.getRowMicros(), pipeline.getInferenceMicros(), pipeline.getLoad() * 100,
+             (1 - pipeline.getLoad()) * 100, pipeline.getActiveRatio() * 100);
+
+#ifdef FRONTEND_PROFILE
+    LOG_DEBUG("Frontend cycles per row: window %u, fft %u, energy %u, filterbank %u, sqrt %u, noise %u, pcan %u, log %u",
+              pipeline.getStageCycles(kFrontendStageWindow), pipeline.getStageCycles(kFrontendStageFft),
+              pipeline.getStageCycles(kFrontendStageEnergy), pipeline.getStageCycles(kFrontendStageFilterbank),
+              pipeline.getStageCycles(kFrontendStageSqrt), pipeline.getStageCycles(kFrontendStageNoiseReduction),
+              pipeline.getStageCycles(kFrontendStagePcan), pipeline.getStageCycles(kFrontendStageLog));
+#endif
+
+    LOG_DEBUG("%u rows, %u detections, %u errors, %u samples waiting, %u dropped, %u clipped", pipeline.getRows(),
+              pipeline.getDetections(), pipeline.getErrors(), audioRing.getAvailable(), audioRing.getDropped(),
+              microphone.getClipped());
+
+    pipeline.resetStats(millis());
+}
+
+// Frontend task, pinned to FRONTEND_CORE
+
+void frontendTask(void *parameters)
+{
+    uint32_t lastStats = millis();
+
+    while (true)
+    {
+        // Nothing captured since the last stride
+        if (!pipeline.process(audioRing))
+        {
+            vTaskDelay(1);
+            continue;
+        }
+
+        if (pipeline.getDetection() >= 0)
+        {
+            LOG_INFO("Heard \"%s\", score %.2f, %u us after the audio", labels[pipeline.getDetection()],
+                     pipeline.getDetectionScore(), pipeline.getDetectionLatency());
+        }
+
+        if (millis() - lastStats >= STATS_INTERVAL)
+        {
+            logStats();
+            lastStats = millis();
+        }
+    }
+}
+
+// Setup method
+
+void setup()
+{
+    Serial.begin(9600);
+    Serial.println();
+
+    // TensorFlow initialization
+
+    keywordModel.begin(keyword_model);
+
+    // abort if an error occurred on the model
+    while (!keywordModel.isOk())
+    {
+        Serial.print("Model init error: ");
+        Serial.println(keywordModel.getErrorMessage());
+        delay(1000);
+    }
+
+    while (!pipeline.begin(SAMPLE_RATE, WINDOW_MS, STRIDE_MS))
+    {
+        Serial.println("Not enough memory for the microfrontend");
+        delay(1000);
+    }
+
+    pipeline.getVoiceDetector().setHangover(VAD_HANGOVER_MS / STRIDE_MS);
+    pipeline.setVoiceGate(true);
+
+    while (!microphone.begin(SAMPLE_RATE))
+    {
+        Serial.println("Cannot start the I2S microphone");
+        delay(1000);
+    }
+
+    xTaskCreatePinnedToCore(captureTask, "capture", CAPTURE_STACK_SIZE, NULL, 2, &captureTaskHandle, CAPTURE_CORE);
+    xTaskCreatePinnedToCore(frontendTask, "frontend", FRONTEND_STACK_SIZE, NULL, 1, &frontendTaskHandle, FRONTEND_CORE);
+}
+
+// Loop method, the work is done by the audio tasks
+
+void loop()
+{
+    // the Arduino task is the low priority one, it prints for both audio tasks
+    LOG_DRAIN(Serial);
+
+    delay(100);
+}
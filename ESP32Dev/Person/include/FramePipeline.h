@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+
+// Lock-free single producer / single consumer queue of frame buffers.
+// The capture task acquires a free slot, fills it and commits it; the
+// inference task acquires the oldest committed slot, processes it and
+// releases it. Slots are handed over by index, frames are never copied.
+// Only one task may call the write methods and only one the read methods.
+template<uint32_t frameBytes, uint8_t slotCount = 2>
+class FramePipeline
+{
+  public:
+  FramePipeline() :
+    writeIndex(0),
+    readIndex(0),
+    framesProduced(0),
+    framesConsumed(0),
+    windowStart(0),
+    windowFrames(0),
+    fps(0)
+  {
+    for (uint8_t i = 0; i < slotCount; i++)
+      slots[i] = 0;
+  }
+
+  ~FramePipeline()
+  {
+    for (uint8_t i = 0; i < slotCount; i++)
+      free(slots[i]);
+  }
+
+  /**
+   * Allocate the frame buffers on the heap (too large for .bss next to the arena)
+   * @return false if out of memory
+   */
+  bool begin()
+  {
+    for (uint8_t i = 0; i < slotCount; i++)
+    {
+      if (!slots[i])
+        slots[i] = (uint8_t *) malloc(frameBytes);
+
+      if (!slots[i])
+        return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Producer: get a free slot to fill
+   * @return NULL if all slots are in use by the consumer
+   */
+  uint8_t *acquireWrite()
+  {
+    const uint32_t w = writeIndex.load(std::memory_order_relaxed);
+
+    if (w - readIndex.load(std::memory_order_acquire) >= slotCount)
+      return 0;
+
+    return slots[w % slotCount];
+  }
+
+  /**
+   * Producer: publish the slot returned by acquireWrite()
+   */
+  void commitWrite()
+  {
+    writeIndex.store(writeIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    framesProduced++;
+  }
+
+  /**
+   * Consumer: get the oldest committed frame
+   * @return NULL if the queue is empty
+   */
+  uint8_t *acquireRead()
+  {
+    const uint32_t r = readIndex.load(std::memory_order_relaxed);
+
+    if (r == writeIndex.load(std::memory_order_acquire))
+      return 0;
+
+    return slots[r % slotCount];
+  }
+
+  /**
+   * Consumer: give the slot returned by acquireRead() back to the producer
+   * @param nowMs current time in milliseconds, used for the frame rate
+   */
+  void releaseRead(uint32_t nowMs)
+  {
+    readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    framesConsumed++;
+    windowFrames++;
+
+    if (windowStart == 0)
+      windowStart = nowMs;
+
+    // refresh the rate once per second so it follows load changes
+    if (nowMs - windowStart >= 1000)
+    {
+      fps = windowFrames * 1000.0f / (nowMs - windowStart);
+      windowStart = nowMs;
+      windowFrames = 0;
+    }
+  }
+
+  /**
+   * Frames per second through the consumer stage over the last window
+   */
+  float getFramesPerSecond() const
+  {
+    return fps;
+  }
+
+  uint32_t getFramesProduced() const
+  {
+    return framesProduced;
+  }
+
+  uint32_t getFramesConsumed() const
+  {
+    return framesConsumed;
+  }
+
+  protected:
+  uint8_t *slots[slotCount];
+  std::atomic<uint32_t> writeIndex;
+  std::atomic<uint32_t> readIndex;
+  volatile uint32_t framesProduced;
+  volatile uint32_t framesConsumed;
+  uint32_t windowStart;
+  uint32_t windowFrames;
+  volatile float fps;
+};
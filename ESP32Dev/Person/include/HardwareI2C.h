@@ -0,0 +1,64 @@
+#pragma once
+#include "Arduino.h"
+#include "driver/i2c.h"
+#include "I2CBus.h"
+
+// SCCB through the ESP32 I2C peripheral. The bus is clocked by hardware at
+// 400 kHz instead of toggling pin modes, so a full mode table is written in a
+// few milliseconds. Port 1 is used by default to leave port 0 to Wire.
+class HardwareI2C: public I2CBus
+{
+  public:
+  static const int FREQUENCY = 400000;
+  static const int TIMEOUT_MS = 10;
+
+  HardwareI2C(const int data, const int clock, i2c_port_t p = I2C_NUM_1, int frequency = FREQUENCY)
+  {
+    port = p;
+
+    i2c_config_t conf;
+    memset(&conf, 0, sizeof(conf));
+    conf.mode = I2C_MODE_MASTER;
+    conf.sda_io_num = (gpio_num_t)data;
+    conf.scl_io_num = (gpio_num_t)clock;
+    conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
+    conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
+    conf.master.clk_speed = frequency;
+    i2c_param_config(port, &conf);
+
+    // the camera can be re-created on mode changes, the driver stays installed
+    if(!installed(port))
+      installed(port) = i2c_driver_install(port, I2C_MODE_MASTER, 0, 0, 0) == ESP_OK;
+  }
+
+  virtual void pause(int ms)
+  {
+    delay(ms);
+  }
+
+  virtual bool writeRegister(unsigned char addr, unsigned char reg, unsigned char data)
+  {
+    if(!installed(port))
+      return false;
+
+    // SCCB needs a stop after every register, so each write is its own transaction
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, addr, true);
+    i2c_master_write_byte(cmd, reg, true);
+    i2c_master_write_byte(cmd, data, true);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(port, cmd, TIMEOUT_MS / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+    return err == ESP_OK;
+  }
+
+  protected:
+  i2c_port_t port;
+
+  static bool &installed(i2c_port_t p)
+  {
+    static bool drivers[I2C_NUM_MAX] = {false};
+    return drivers[p];
+  }
+};
@@ -13,6 +13,8 @@
 #include "driver/gpio.h"
 #include "driver/periph_ctrl.h"
 #include "rom/lldesc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "XClk.h"
 #include "DMABuffer.h"
 
@@ -30,9 +32,14 @@ class I2SCamera
   static int dmaBufferActive;
   static DMABuffer **dmaBuffer;
   static unsigned char* frame;
+  static unsigned char* frameAllocation;
+  static int frameHeadroom;
   static int framePointer;
   static int frameBytes;
   static volatile bool stopSignal;
+  static TaskHandle_t stopWaiter;
+  // longest wait for the end of a frame in stop()
+  static const int stopTimeoutMs = 1000;
 
   static int startBlock;
   static int endBlock;
@@ -71,10 +78,20 @@ class I2SCamera
     i2sRun();
   }
 
+  // Blocks until the frame in progress ends, the I2S interrupt notifies the
+  // task, so the core is free for others (its idle task) in the meantime
   void stop()
   {
+    // a late notification of an earlier timeout
+    ulTaskNotifyTake(pdTRUE, 0);
+    stopWaiter = xTaskGetCurrentTaskHandle();
     stopSignal = true;
-    while(stopSignal);
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(stopTimeoutMs)) == 0)
+    {
+      // the camera stopped sending frames
+      i2sStop();
+      stopSignal = false;
+    }
   }
 
   void oneFrame()
@@ -86,6 +103,8 @@ class I2SCamera
   static void i2sStop();
   static void i2sRun();
 
+  static void releaseFrame();
+
   static void dmaBufferInit(int bytes);
   static void dmaBufferDeinit();
 
@@ -0,0 +1,70 @@
+#pragma once
+#include "I2CBus.h"
+
+// Host side SCCB backend for tests: records every write instead of driving
+// pins, so register tables can be checked without a camera attached.
+class MockI2C: public I2CBus
+{
+  public:
+  static const int MAX_WRITES = 256;
+
+  struct Write
+  {
+    unsigned char addr;
+    unsigned char reg;
+    unsigned char value;
+  };
+
+  Write writes[MAX_WRITES];
+  int writeCount;
+  // make writes to this register fail (no ack), -1 for none
+  int failRegister;
+  // pause() calls, the write count when the last one came and its length
+  int pauses;
+  int pausedAfter;
+  int pausedMs;
+
+  MockI2C()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    writeCount = 0;
+    failRegister = -1;
+    pauses = 0;
+    pausedAfter = -1;
+    pausedMs = 0;
+  }
+
+  virtual bool writeRegister(unsigned char addr, unsigned char reg, unsigned char data)
+  {
+    if(reg == failRegister)
+      return false;
+    if(writeCount < MAX_WRITES)
+    {
+      writes[writeCount].addr = addr;
+      writes[writeCount].reg = reg;
+      writes[writeCount].value = data;
+      writeCount++;
+    }
+    return true;
+  }
+
+  virtual void pause(int ms)
+  {
+    pauses++;
+    pausedAfter = writeCount;
+    pausedMs = ms;
+  }
+
+  // Last value written to a register, -1 if it was never written
+  int lastValue(unsigned char reg) const
+  {
+    for(int i = writeCount - 1; i >= 0; i--)
+      if(writes[i].reg == reg)
+        return writes[i].value;
+    return -1;
+  }
+};
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "eloquent_tinyml/tensorflow/common/models/person_detection/ImageResize.h"
+
+// Cheap motion gate to run before the person detector.
+// The RGB565 frame is reduced to a luma thumbnail (one averaged sample every
+// cellSize x cellSize pixels), the thumbnail is split into blocks of
+// blockSize x blockSize cells and each block is compared against a running
+// background model with a sum of absolute differences.
+// Motion is reported only when enough blocks changed, so the network is
+// invoked on a small fraction of the frames of a static scene.
+template<uint16_t imageWidth, uint16_t imageHeight, uint8_t cellSize = 4, uint8_t blockSize = 4>
+class MotionDetector
+{
+  public:
+  static const uint16_t thumbWidth = imageWidth / cellSize;
+  static const uint16_t thumbHeight = imageHeight / cellSize;
+  static const uint16_t blocksX = (thumbWidth + blockSize - 1) / blockSize;
+  static const uint16_t blocksY = (thumbHeight + blockSize - 1) / blockSize;
+  static const uint16_t blockCount = blocksX * blocksY;
+
+  MotionDetector() :
+    blockThreshold(12),
+    minChangedBlocks(2),
+    learnShift(3),
+    maxSkippedFrames(0),
+    hasBackground(false),
+    changedBlocks(0),
+    consecutiveSkips(0),
+    framesSeen(0),
+    framesSkipped(0)
+  {
+  }
+
+  /**
+   * Mean absolute luma difference per cell above which a block counts as changed
+   * @param threshold 0-255
+   */
+  void setBlockThreshold(uint8_t threshold)
+  {
+    blockThreshold = threshold;
+  }
+
+  /**
+   * How many blocks must change to report motion
+   * @param blocks
+   */
+  void setMinChangedBlocks(uint16_t blocks)
+  {
+    minChangedBlocks = blocks > 0 ? blocks : 1;
+  }
+
+  /**
+   * Background adaptation speed: every frame moves the model by 1 / 2^shift
+   * of the difference, so higher values forget more slowly
+   * @param shift 0-8
+   */
+  void setLearningShift(uint8_t shift)
+  {
+    learnShift = shift > 8 ? 8 : shift;
+  }
+
+  /**
+   * Force a detection after this many consecutive skipped frames (0 = never)
+   * @param frames
+   */
+  void setMaxSkippedFrames(uint32_t frames)
+  {
+    maxSkippedFrames = frames;
+  }
+
+  /**
+   * Forget the background, the next frame will be reported as motion
+   */
+  void reset()
+  {
+    hasBackground = false;
+    consecutiveSkips = 0;
+  }
+
+  /**
+   * Feed a new RGB565 frame (little endian, as stored by I2SCamera)
+   * @param frame imageWidth * imageHeight * 2 bytes
+   * @return true if the detector should run on this frame
+   */
+  bool update(const uint8_t *frame)
+  {
+    framesSeen++;
+    buildThumbnail(frame);
+
+    if (!hasBackground)
+    {
+      for (uint16_t i = 0; i < thumbWidth * thumbHeight; i++)
+        background[i] = (uint16_t)thumbnail[i] << 8;
+
+      hasBackground = true;
+      changedBlocks = blockCount;
+      consecutiveSkips = 0;
+      return true;
+    }
+
+    changedBlocks = compareBlocks();
+    adaptBackground();
+
+    bool motion = changedBlocks >= minChangedBlocks;
+
+    if (!motion && maxSkippedFrames > 0 && consecutiveSkips >= maxSkippedFrames)
+      motion = true;
+
+    if (motion)
+    {
+      consecutiveSkips = 0;
+      return true;
+    }
+
+    consecutiveSkips++;
+    framesSkipped++;
+    return false;
+  }
+
+  /**
+   * Number of changed blocks in the last frame
+   */
+  uint16_t getChangedBlocks() const
+  {
+    return changedBlocks;
+  }
+
+  uint32_t getFramesSeen() const
+  {
+    return framesSeen;
+  }
+
+  uint32_t getFramesSkipped() const
+  {
+    return framesSkipped;
+  }
+
+  /**
+   * Fraction of frames for which the detector was not invoked
+   */
+  float getSkipRatio() const
+  {
+    return framesSeen == 0 ? 0 : ((float) framesSkipped) / framesSeen;
+  }
+
+  protected:
+  uint8_t blockThreshold;
+  uint16_t minChangedBlocks;
+  uint8_t learnShift;
+  uint32_t maxSkippedFrames;
+  bool hasBackground;
+  uint16_t changedBlocks;
+  uint32_t consecutiveSkips;
+  uint32_t framesSeen;
+  uint32_t framesSkipped;
+  uint8_t thumbnail[thumbWidth * thumbHeight];
+  // background luma in Q8 so that slow adaptation does not round to zero
+  uint16_t background[thumbWidth * thumbHeight];
+
+  // the person detector's conversion, the two see the same gray levels
+  static inline uint8_t luma(const uint8_t *pixel)
+  {
+    return Eloquent::TinyML::TensorFlow::Rgb565::gray(pixel);
+  }
+
+  void buildThumbnail(const uint8_t *frame)
+  {
+    for (uint16_t ty = 0; ty < thumbHeight; ty++)
+    {
+      for (uint16_t tx = 0; tx < thumbWidth; tx++)
+      {
+        uint16_t sum = 0;
+
+        for (uint8_t y = 0; y < cellSize; y++)
+        {
+          const uint8_t *row = frame + ((ty * cellSize + y) * imageWidth + tx * cellSize) * 2;
+
+          for (uint8_t x = 0; x < cellSize; x++)
+            sum += luma(row + x * 2);
+        }
+
+        thumbnail[ty * thumbWidth + tx] = sum / (cellSize * cellSize);
+      }
+    }
+  }
+
+  uint16_t compareBlocks()
+  {
+    uint16_t changed = 0;
+
+    for (uint16_t by = 0; by < blocksY; by++)
+    {
+      const uint16_t yStart = by * blockSize;
+      const uint16_t yEnd = yStart + blockSize < thumbHeight ? yStart + blockSize : thumbHeight;
+
+      for (uint16_t bx = 0; bx < blocksX; bx++)
+      {
+        const uint16_t xStart = bx * blockSize;
+        const uint16_t xEnd = xStart + blockSize < thumbWidth ? xStart + blockSize : thumbWidth;
+        uint32_t sad = 0;
+
+        for (uint16_t y = yStart; y < yEnd; y++)
+        {
+          for (uint16_t x = xStart; x < xEnd; x++)
+          {
+            const uint16_t i = y * thumbWidth + x;
+            const int16_t diff = (int16_t) thumbnail[i] - (int16_t) (background[i] >> 8);
+
+            sad += diff < 0 ? -diff : diff;
+          }
+        }
+
+        // edge blocks may be smaller, so compare against the per-cell mean
+        if (sad > (uint32_t) blockThreshold * (yEnd - yStart) * (xEnd - xStart))
+          changed++;
+      }
+    }
+
+    return changed;
+  }
+
+  void adaptBackground()
+  {
+    for (uint16_t i = 0; i < thumbWidth * thumbHeight; i++)
+    {
+      const int32_t target = (int32_t) thumbnail[i] << 8;
+      const int32_t current = background[i];
+
+      background[i] = current + ((target - current) >> learnShift);
+    }
+  }
+};
@@ -25,9 +25,12 @@ int I2SCamera::dmaBufferCount = 0;
 int I2SCamera::dmaBufferActive = 0;
 DMABuffer **I2SCamera::dmaBuffer = 0;
 unsigned char* I2SCamera::frame = 0;
+unsigned char* I2SCamera::frameAllocation = 0;
+int I2SCamera::frameHeadroom = 0;
 int I2SCamera::framePointer = 0;
 int I2SCamera::frameBytes = 0;
 volatile bool I2SCamera::stopSignal = false;
+TaskHandle_t I2SCamera::stopWaiter = 0;
 
 void IRAM_ATTR I2SCamera::i2sInterrupt(void* arg)
 {
@@ -58,6 +61,10 @@ void IRAM_ATTR I2SCamera::i2sInterrupt(void* arg)
         {
           i2sStop();
           stopSignal = false;
+          BaseType_t woken = pdFALSE;
+          vTaskNotifyGiveFromISR(stopWaiter, &woken);
+          if (woken)
+            portYIELD_FROM_ISR();
         }
     }
    
@@ -132,23 +139,35 @@ bool I2SCamera::init(const int XRES, const int YRES, const int VSYNC, const int
   yres = YRES;
   frameBytes = XRES * blockSlice * 2;
 
-  if (frame) {
-    free (frame);
+  if (frameAllocation) {
+    free (frameAllocation);
+    frame = 0;
     Serial.printf("frame memory freed\n");
   }
   
-  frame = (unsigned char*)malloc(frameBytes);
-  if(!frame)
+  //frameHeadroom bytes are reserved in front of the frame, so senders can
+  //prepend their headers without copying the pixels
+  frameAllocation = (unsigned char*)malloc(frameHeadroom + frameBytes);
+  if(!frameAllocation)
   {
     DEBUG_PRINTLN("Not enough memory for frame buffer!");
     return false;
   }
+  frame = frameAllocation + frameHeadroom;
   i2sInit(VSYNC, HREF, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
   dmaBufferInit(xres * 2 * 2);  //two bytes per dword packing, two bytes per pixel
   initVSync(VSYNC);
   return true;
 }
 
+//for callers that point frame at their own buffers
+void I2SCamera::releaseFrame()
+{
+  free(frameAllocation);
+  frameAllocation = 0;
+  frame = 0;
+}
+
 bool I2SCamera::i2sInit(const int VSYNC, const int HREF, const int PCLK, const int D0, const int D1, const int D2, const int D3, const int D4, const int D5, const int D6, const int D7)
 {    
   int pins[] = {VSYNC, HREF, PCLK, D0, D1, D2, D3, D4, D5, D6, D7};    
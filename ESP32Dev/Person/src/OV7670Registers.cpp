@@ -0,0 +1,202 @@
+#include "OV7670Registers.h"
+
+void OV7670Registers::writeMode(Mode m)
+{
+  failedWrites = 0;
+  switch(m)
+  {
+    case VGA_RGB565:
+      VGARGB565();
+    break;
+
+    case QVGA_RGB565:
+      QVGARGB565();
+    break;
+
+    case QQVGA_RGB565:
+      QQVGARGB565();
+    break;
+
+    case QQQVGA_RGB565:
+      QQQVGARGB565();
+    break;
+  }
+}
+
+void OV7670Registers::testImage()
+{
+  writeRegister(0x71, 0x35 | 0x80);
+}
+  
+void OV7670Registers::saturation(int s)  //-2 to 2
+{
+  //color matrix values
+  const I2CBus::Register regs[] = {
+    {0x4f, (unsigned char)(0x80 + 0x20 * s)},
+    {0x50, (unsigned char)(0x80 + 0x20 * s)},
+    {0x51, 0x00},
+    {0x52, (unsigned char)(0x22 + (0x11 * s) / 2)},
+    {0x53, (unsigned char)(0x5e + (0x2f * s) / 2)},
+    {0x54, (unsigned char)(0x80 + 0x20 * s)},
+    {0x58, 0x9e},  //matrix signs
+  };
+  writeRegisters(regs);
+}
+
+void OV7670Registers::frameControl(int hStart, int hStop, int vStart, int vStop)
+{
+  const I2CBus::Register regs[] = {
+    {REG_HSTART, (unsigned char)(hStart >> 3)},
+    {REG_HSTOP, (unsigned char)(hStop >> 3)},
+    {REG_HREF, (unsigned char)(((hStop & 0b111) << 3) | (hStart & 0b111))},
+
+    {REG_VSTART, (unsigned char)(vStart >> 2)},
+    {REG_VSTOP, (unsigned char)(vStop >> 2)},
+    {REG_VREF, (unsigned char)(((vStop & 0b11) << 2) | (vStart & 0b11))},
+  };
+  writeRegisters(regs);
+}
+
+void OV7670Registers::RGB565()
+{
+  writeRegister(REG_COM7, 0b10000000);  //all registers default
+  bus.pause(1); //the reset takes 1ms, the hardware bus is fast enough to write into it
+
+  static const I2CBus::Register regs[] = {
+    {REG_CLKRC, 0b10000000}, //double clock
+    {REG_COM11, 0b1000 | 0b10}, //enable auto 50/60Hz detect + exposure timing can be less...
+
+    {REG_COM7, 0b100}, //RGB
+    {REG_COM15, 0b11000000 | 0b010000}, //RGB565
+  };
+  writeRegisters(regs);
+}
+
+void OV7670Registers::colors()
+{
+  //writeRegister(REG_COM10, 0x02); //VSYNC negative
+  //writeRegister(REG_MVFP, 0x2b);  //mirror flip
+
+  writeRegister(0xb0, 0x84);// no clue what this is but it's most important for colors
+  saturation(0);
+
+  static const I2CBus::Register regs[] = {
+    {0x13, 0xe7}, //AWB on
+    {0x6f, 0x9f}, // Simple AWB
+  };
+  writeRegisters(regs);
+}
+
+///////////////////////////////////////
+
+
+void OV7670Registers::QVGA()
+{
+  static const I2CBus::Register regs[] = {
+    {REG_COM3, 0x04},  //DCW enable -- done
+    {REG_COM14, 0x19}, //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register  -- done
+    {REG_SCALING_XSC, 0x3a}, // -- done
+    {REG_SCALING_YSC, 0x35}, // -- done
+    {REG_SCALING_DCWCTR, 0x11}, //downsample by 2
+    {REG_SCALING_PCLK_DIV, 0xf1}, //pixel clock divided by 8
+    {REG_SCALING_PCLK_DELAY, 0x02},
+  };
+  writeRegisters(regs);
+}
+
+void OV7670Registers::VGA()
+{
+  static const I2CBus::Register regs[] = {
+    {REG_COM3, 0x0},  //DCW enable -- done
+//    {REG_COM14, 0x19}, //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register  -- done
+    {REG_COM14, 0}, //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register  -- done
+//    {REG_SCALING_XSC, 0x3a}, // -- done
+//    {REG_SCALING_YSC, 0x35}, // -- done
+  //  {REG_SCALING_DCWCTR, 0x11}, //downsample by 2
+  //  {REG_SCALING_PCLK_DIV, 0xf0}, //pixel clock divided by 8
+  //  {REG_SCALING_PCLK_DELAY, 0x02},
+  };
+  writeRegisters(regs);
+}
+
+
+void OV7670Registers::VGARGB565()
+{
+  RGB565();
+  VGA();
+
+  // hstart, hstop, vstart, vstop
+  frameControl(168, 24, 12, 492); //no clue why horizontal needs such strange values, vertical works ok
+  
+  colors();
+}
+
+
+void OV7670Registers::QVGARGB565()
+{
+  RGB565();
+  QVGA();
+
+  // hstart, hstop, vstart, vstop
+  frameControl(168, 24, 12, 492); //no clue why horizontal needs such strange values, vertical works ok
+  
+  colors();
+}
+
+
+
+
+
+
+////////////////////////////////////
+void OV7670Registers::QQQVGA()
+{
+  static const I2CBus::Register regs[] = {
+    {REG_COM3, 0x04},  //DCW enable
+    {REG_COM14, 0x1b}, //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register
+    {REG_SCALING_XSC, 0x3a},
+    {REG_SCALING_YSC, 0x35},
+    {REG_SCALING_DCWCTR, 0x33}, //downsample by 8
+    {REG_SCALING_PCLK_DIV, 0xf3}, //pixel clock divided by 8
+    {REG_SCALING_PCLK_DELAY, 0x02},
+  };
+  writeRegisters(regs);
+}
+
+void OV7670Registers::QQVGA()
+{
+  //160x120 (1/4)
+  static const I2CBus::Register regs[] = {
+    //{REG_CLKRC, 0x01},
+    {REG_COM3, 0x04},  //DCW enable
+  
+    {REG_COM14, 0x1a}, //pixel clock divided by 4, manual scaling enable, DCW and PCLK controlled by register
+    {REG_SCALING_XSC, 0x3a},
+    {REG_SCALING_YSC, 0x35},
+  
+    {REG_SCALING_DCWCTR, 0x22}, //downsample by 4
+    {REG_SCALING_PCLK_DIV, 0xf2}, //pixel clock divided by 4
+    {REG_SCALING_PCLK_DELAY, 0x02},
+  };
+  writeRegisters(regs);
+}
+  
+void OV7670Registers::QQVGARGB565()
+{
+  RGB565();
+  QQVGA();
+
+  frameControl(196, 52, 8, 488); //no clue why horizontal needs such strange values, vertical works ok
+  
+  colors();
+}
+
+void OV7670Registers::QQQVGARGB565()
+{
+  RGB565();
+  QQQVGA();
+  
+  frameControl(196, 52, 8, 488); //no clue why horizontal needs such strange values, vertical works ok
+   
+  colors();
+}
@@ -1,7 +1,10 @@
 #include "OV7670.h"
+#include "MotionDetector.h"
+#include "FramePipeline.h"
 #include <WiFi.h>
 #include "EloquentTinyML.h"
 #include "eloquent_tinyml/tensorflow/person_detection.h"
+#include <LogQueue.h>
 
 const uint8_t SIOD = 21;
 const uint8_t SIOC = 22;
@@ -30,6 +33,33 @@ uint8_t blk_count = 0;
 
 Eloquent::TinyML::TensorFlow::PersonDetection<imageWidth, imageHeight> personDetector;
 
+// Motion gate: the detector only runs when the scene changed
+
+#define MOTION_BLOCK_THRESHOLD 12
+#define MOTION_MIN_CHANGED_BLOCKS 2
+#define MOTION_MAX_SKIPPED_FRAMES 120
+
+// Delay after a skipped frame and after a detection, raise them to trade
+// frame rate for idle time
+
+#define MOTION_POLL_DELAY 0
+#define DETECTION_DELAY 0
+
+MotionDetector<imageWidth, imageHeight> motionDetector;
+
+// Two stage pipeline: a capture task on core 0 fills frame N+1 while the
+// inference task on core 1 processes frame N
+
+#define CAPTURE_CORE 0
+#define INFERENCE_CORE 1
+#define CAPTURE_STACK_SIZE 4096
+#define INFERENCE_STACK_SIZE 8192
+#define STATS_INTERVAL 5000
+
+FramePipeline<imageWidth * imageHeight * 2> framePipeline;
+TaskHandle_t captureTaskHandle;
+TaskHandle_t inferenceTaskHandle;
+
 // // FreeRTOS timers
 
 // extern "C"
@@ -120,93 +150,95 @@ int timeSum = 0;
 //     }
 // }
 
-// Setup method
+// Capture one full frame into the given buffer
 
-void setup()
+void captureFrame(uint8_t *target)
 {
-    Serial.begin(9600);
-    Serial.println();
-
-    // TensorFlow initialization
-
-    camera = new OV7670(OV7670::Mode::QQVGA_RGB565, SIOD, SIOC, VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
+    // Point the I2S interrupt at the pipeline slot, so frames are not copied
+    I2SCamera::frame = target;
 
-    personDetector.setDetectionAbsoluteThreshold(100);
-    personDetector.begin();
-
-    // abort if an error occurred on the detector
-    while (!personDetector.isOk())
+    blk_count = camera->yres / I2SCamera::blockSlice;
+    for (int i = 0; i < blk_count; i++)
     {
-        Serial.print("Detector init error: ");
-        Serial.println(personDetector.getErrorMessage());
-    }
-
-    // mqttReconnectTimer = xTimerCreate("mqttTimer", pdMS_TO_TICKS(2000), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(connectToMqtt));
-    // wifiReconnectTimer = xTimerCreate("wifiTimer", pdMS_TO_TICKS(2000), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(connectToWifi));
 
-    // WiFi.onEvent(WiFiEvent);
+        if (i == 0)
+        {
+            camera->startBlock = 1;
+            camera->endBlock = I2SCamera::blockSlice;
+        }
 
-    // mqttClient.onConnect(onMqttConnect);
-    // mqttClient.onDisconnect(onMqttDisconnect);
-    // mqttClient.setServer(MQTT_HOST, MQTT_PORT);
+        camera->oneFrame();
+        camera->startBlock += I2SCamera::blockSlice;
+        camera->endBlock += I2SCamera::blockSlice;
+    }
 
-    // connectToWifi();
+    I2SCamera::frame = NULL;
 }
 
-// Loop method
+// Capture task, pinned to CAPTURE_CORE
 
-void loop()
+void captureTask(void *parameters)
 {
-    // if (WiFi.isConnected() && mqttClient.connected())
-    // {
-    
-    currentIteration += 1; // To keep track of iterations between loops
+    // The camera allocates its I2S and VSYNC interrupts on the calling core,
+    // creating it here keeps them off the inference core
+    camera = new OV7670(OV7670::Mode::QQVGA_RGB565, SIOD, SIOC, VSYNC, HREF, XCLK, PCLK, D0, D1, D2, D3, D4, D5, D6, D7);
 
-    blk_count = camera->yres / I2SCamera::blockSlice;
-    for (int i = 0; i < blk_count; i++)
+    // Frames go to the pipeline slots, the camera's own frame buffer (38 KB
+    // at QQVGA) is never written
+    I2SCamera::releaseFrame();
+
+    while (true)
     {
+        uint8_t *slot = framePipeline.acquireWrite();
 
-        if (i == 0)
+        // Both slots are waiting for inference
+        if (slot == NULL)
         {
-            camera->startBlock = 1;
-            camera->endBlock = I2SCamera::blockSlice;
+            vTaskDelay(1);
+            continue;
         }
 
-        if (i == blk_count - 1)
-        {
-        }
+        captureFrame(slot);
+        framePipeline.commitWrite();
+    }
+}
 
-        camera->oneFrame();
-        camera->startBlock += I2SCamera::blockSlice;
-        camera->endBlock += I2SCamera::blockSlice;
+// Run the motion gate and the detector on one frame
+
+void processFrame(uint8_t *frame)
+{
+    // Skip inference on static scenes
+
+    if (!motionDetector.update(frame))
+    {
+        delay(MOTION_POLL_DELAY);
+        return;
     }
 
-    bool isPersonInFrame = personDetector.detectPerson(camera->frame);
+    currentIteration += 1; // To keep track of iterations between loops
+
+    bool isPersonInFrame = personDetector.detectPerson(frame);
 
     if (!personDetector.isOk())
     {
-        Serial.print("Person detector detection error: ");
-        Serial.println(personDetector.getErrorMessage());
+        LOG_ERROR("Person detector detection error: %s", personDetector.getErrorMessage());
         delay(1000);
         return;
     }
     
-    Serial.println(isPersonInFrame ? "Person detected" : "No person detected");
-    Serial.print("\t > It took ");
-    Serial.print(personDetector.getElapsedTime());
-    Serial.println("ms to detect");
-    Serial.print("\t > Person score: ");
-    Serial.println(personDetector.getPersonScore());
-    Serial.print("\t > Not person score: ");
-    Serial.println(personDetector.getNotPersonScore());
+    // queued, printed by loop(): the next frame does not wait for the UART
+
+    LOG_DEBUG("%s, %u ms, person score %u, not person score %u", isPersonInFrame ? "Person detected" : "No person detected",
+              personDetector.getElapsedTime(), personDetector.getPersonScore(), personDetector.getNotPersonScore());
 
     //For calculating the average time
 
     timeSum += personDetector.getElapsedTime();
 
-    Serial.println("Elapsed time: " + String(personDetector.getElapsedTime()));
+    LOG_INFO("Average time on %d iterations: %d ms", currentIteration, timeSum / currentIteration);
 
-    Serial.println("Average time on " + String(currentIteration) + " iterations: " + (timeSum / currentIteration));
+    LOG_DEBUG("Changed blocks: %u, skipped %u of %u frames (skip ratio %f)", motionDetector.getChangedBlocks(),
+              motionDetector.getFramesSkipped(), motionDetector.getFramesSeen(), motionDetector.getSkipRatio());
 
     // //{"board": "esp32dev", "model": "person", "result": 1, "iteration": 1, "microseconds": 120}
 
@@ -232,5 +264,85 @@ void loop()
     //     Serial.println("WiFi or MQTT not connected, waiting before running evaluation.");
     // }
 
-    delay(5000);
-}
\ No newline at end of file
+    delay(DETECTION_DELAY);
+}
+
+// Inference task, pinned to INFERENCE_CORE
+
+void inferenceTask(void *parameters)
+{
+    while (true)
+    {
+        uint8_t *frame = framePipeline.acquireRead();
+
+        // Capture still running
+        if (frame == NULL)
+        {
+            vTaskDelay(1);
+            continue;
+        }
+
+        processFrame(frame);
+        framePipeline.releaseRead(millis());
+    }
+}
+
+// Setup method
+
+void setup()
+{
+    Serial.begin(9600);
+    Serial.println();
+
+    // TensorFlow initialization
+
+    motionDetector.setBlockThreshold(MOTION_BLOCK_THRESHOLD);
+    motionDetector.setMinChangedBlocks(MOTION_MIN_CHANGED_BLOCKS);
+    motionDetector.setMaxSkippedFrames(MOTION_MAX_SKIPPED_FRAMES);
+
+    personDetector.setDetectionAbsoluteThreshold(100);
+    // the camera gives RGB565 frames, the detector reads their luma
+    personDetector.setPixelFormat(Eloquent::TinyML::TensorFlow::PERSON_DETECTION_RGB565);
+    personDetector.resizeArea();
+    personDetector.begin();
+
+    // abort if an error occurred on the detector
+    while (!personDetector.isOk())
+    {
+        Serial.print("Detector init error: ");
+        Serial.println(personDetector.getErrorMessage());
+    }
+
+    while (!framePipeline.begin())
+    {
+        Serial.println("Not enough memory for the frame pipeline");
+        delay(1000);
+    }
+
+    xTaskCreatePinnedToCore(captureTask, "capture", CAPTURE_STACK_SIZE, NULL, 1, &captureTaskHandle, CAPTURE_CORE);
+    xTaskCreatePinnedToCore(inferenceTask, "inference", INFERENCE_STACK_SIZE, NULL, 1, &inferenceTaskHandle, INFERENCE_CORE);
+
+    // mqttReconnectTimer = xTimerCreate("mqttTimer", pdMS_TO_TICKS(2000), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(connectToMqtt));
+    // wifiReconnectTimer = xTimerCreate("wifiTimer", pdMS_TO_TICKS(2000), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(connectToWifi));
+
+    // WiFi.onEvent(WiFiEvent);
+
+    // mqttClient.onConnect(onMqttConnect);
+    // mqttClient.onDisconnect(onMqttDisconnect);
+    // mqttClient.setServer(MQTT_HOST, MQTT_PORT);
+
+    // connectToWifi();
+}
+
+// Loop method, the work is done by the pipeline tasks
+
+void loop()
+{
+    LOG_INFO("Pipeline: %f fps, %u frames captured, %u frames processed", framePipeline.getFramesPerSecond(),
+             framePipeline.getFramesProduced(), framePipeline.getFramesConsumed());
+
+    // the Arduino task is the low priority one, it prints for both pipeline tasks
+    LOG_DRAIN(Serial);
+
+    delay(STATS_INTERVAL);
+}
@@ -0,0 +1,387 @@
+#include <WiFi.h>
+#include <ModelRuntime.h>
+#include <Telemetry.h>
+#include <TelemetryBatch.h>
+#include <HeapStats.h>
+#include <Benchmark.h>
+#include <LatencyHistogram.h>
+#include <LogQueue.h>
+#include "sine_model.h"
+#include "digits_model.h"
+#include "wine_model.h"
+#include "wine_scaler.h"
+
+// The three models in one firmware, benchmarked one after the other in every
+// loop. They share one tensor arena, sized for the largest of them (wine):
+// a model is planned again when it takes the arena back, outside the timed
+// runs, and the planning time is reported on its own
+
+#define TENSOR_ARENA_SIZE 16 * 1024
+
+uint8_t tensorArena[TENSOR_ARENA_SIZE];
+SharedArena arena(tensorArena, TENSOR_ARENA_SIZE);
+
+ModelRuntime sine(arena, 1, 1);
+ModelRuntime digits(arena, 64, 10);
+ModelRuntime wine(arena, 13, 3);
+
+// The wine model is trained on standardized features, the scaling is folded
+// into its first layer whenever it is planned (wine_scaler.h)
+
+float wineFirstLayer[WINE_FIRST_LAYER_UNITS * (WINE_FEATURES + 1)];
+FeatureScaler wineScaler(wine_offset, wine_scale, WINE_FEATURES, wineFirstLayer,
+                         WINE_FIRST_LAYER_UNITS * (WINE_FEATURES + 1));
+
+enum Workload
+{
+  SINE,
+  DIGITS,
+  WINE,
+  WORKLOADS
+};
+
+const char *modelNames[WORKLOADS] = {"sin", "digits", "wine"};
+ModelRuntime *runtimes[WORKLOADS] = {&sine, &digits, &wine};
+
+// FreeRTOS timers
+
+extern "C"{
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+}
+#include <AsyncMqttClient.h>
+
+// WiFi SSID and password
+
+#define WIFI_SSID "Berto's iPhone"
+#define WIFI_PASSWORD "fogfogfog"
+
+// MQTT Broker configuration and port
+
+#define MQTT_HOST IPAddress(172, 20, 10, 5)
+#define MQTT_PORT 1883
+
+// Global variables for MQTT and timer for handling the reconnections
+
+AsyncMqttClient mqttClient;
+TimerHandle_t mqttReconnectTimer;
+TimerHandle_t wifiReconnectTimer;
+
+// Iteration number of every model
+
+int currentIterations[WORKLOADS];
+
+// Benchmark: untimed warm-up runs, timed runs per model and loop and whether
+// interrupts are masked while an inference is timed
+
+#define BENCHMARK_WARMUP 3
+#define BENCHMARK_RUNS 10
+#define BENCHMARK_MASK_INTERRUPTS 0
+
+Benchmark<BENCHMARK_RUNS> benchmark(BENCHMARK_WARMUP, BENCHMARK_MASK_INTERRUPTS);
+float results[BENCHMARK_RUNS];
+
+// Histogram of every timed inference per model, published as a summary every
+// STATS_INTERVAL ms. With REPORT_SAMPLES 0 single inferences are neither
+// printed nor sent
+
+#define STATS_INTERVAL 60000
+#define STATS_BUFFER_SIZE 256
+#define REPORT_SAMPLES 1
+#define LOOP_DELAY 5000
+
+LatencyHistogram<> histograms[WORKLOADS];
+char statsBuffer[STATS_BUFFER_SIZE];
+
+// Telemetry: records per binary batch and the longest time a record waits
+// before its batch is flushed, one batch per model
+
+#define TELEMETRY_BATCH_SIZE 50
+#define TELEMETRY_FLUSH_INTERVAL 60000
+
+TelemetryBatch<TELEMETRY_BATCH_SIZE> telemetryBatches[WORKLOADS] = {{"esp32wemos", "sin"}, {"esp32wemos", "digits"}, {"esp32wemos", "wine"}};
+
+// Elements for evaluation
+
+float x_sine[BENCHMARK_RUNS];
+
+float x_digits[64] = {0., 0., 0.625, 0.875, 0.5, 0.0625, 0., 0.,
+                      0., 0.125, 1., 0.875, 0.375, 0.0625, 0., 0.,
+                      0., 0., 0.9375, 0.9375, 0.5, 0.9375, 0., 0.,
+                      0., 0., 0.3125, 1., 1., 0.625, 0., 0.,
+                      0., 0., 0.75, 0.9375, 0.9375, 0.75, 0., 0.,
+                      0., 0.25, 1., 0.375, 0.25, 1., 0.375, 0.,
+                      0., 0.5, 1., 0.625, 0.5, 1., 0.5, 0.,
+                      0., 0.0625, 0.5, 0.75, 0.875, 0.75, 0.0625, 0.};
+float y_digits[10] = {0};
+int expected_digit = 8;
+
+float X_wine[20][13] = {
+    {1.340e+01, 4.600e+00, 2.860e+00, 2.500e+01, 1.120e+02, 1.980e+00,
+     9.600e-01, 2.700e-01, 1.110e+00, 8.500e+00, 6.700e-01, 1.920e+00, 6.300e+02},
+    {1.285e+01, 3.270e+00, 2.580e+00, 2.200e+01, 1.060e+02, 1.650e+00,
+     6.000e-01, 6.000e-01, 9.600e-01, 5.580e+00, 8.700e-01, 2.110e+00, 5.700e+02},
+    {1.334e+01, 9.400e-01, 2.360e+00, 1.700e+01, 1.100e+02, 2.530e+00,
+     1.300e+00, 5.500e-01, 4.200e-01, 3.170e+00, 1.020e+00, 1.930e+00, 7.500e+02},
+    {1.423e+01, 1.710e+00, 2.430e+00, 1.560e+01, 1.270e+02, 2.800e+00,
+     3.060e+00, 2.800e-01, 2.290e+00, 5.640e+00, 1.040e+00, 3.920e+00, 1.065e+03},
+    {1.483e+01, 1.640e+00, 2.170e+00, 1.400e+01, 9.700e+01, 2.800e+00,
+     2.980e+00, 2.900e-01, 1.980e+00, 5.200e+00, 1.080e+00, 2.850e+00, 1.045e+03},
+    {1.245e+01, 3.030e+00, 2.640e+00, 2.700e+01, 9.700e+01, 1.900e+00,
+     5.800e-01, 6.300e-01, 1.140e+00, 7.500e+00, 6.700e-01, 1.730e+00, 8.800e+02},
+    {1.430e+01, 1.920e+00, 2.720e+00, 2.000e+01, 1.200e+02, 2.800e+00,
+     3.140e+00, 3.300e-01, 1.970e+00, 6.200e+00, 1.070e+00, 2.650e+00, 1.280e+03},
+    {1.390e+01, 1.680e+00, 2.120e+00, 1.600e+01, 1.010e+02, 3.100e+00,
+     3.390e+00, 2.100e-01, 2.140e+00, 6.100e+00, 9.100e-01, 3.330e+00, 9.850e+02},
+    {1.165e+01, 1.670e+00, 2.620e+00, 2.600e+01, 8.800e+01, 1.920e+00,
+     1.610e+00, 4.000e-01, 1.340e+00, 2.600e+00, 1.360e+00, 3.210e+00, 5.620e+02},
+    {1.386e+01, 1.510e+00, 2.670e+00, 2.500e+01, 8.600e+01, 2.950e+00,
+     2.860e+00, 2.100e-01, 1.870e+00, 3.380e+00, 1.360e+00, 3.160e+00, 4.100e+02},
+    {1.377e+01, 1.900e+00, 2.680e+00, 1.710e+01, 1.150e+02, 3.000e+00,
+     2.790e+00, 3.900e-01, 1.680e+00, 6.300e+00, 1.130e+00, 2.930e+00, 1.375e+03},
+    {1.296e+01, 3.450e+00, 2.350e+00, 1.850e+01, 1.060e+02, 1.390e+00,
+     7.000e-01, 4.000e-01, 9.400e-01, 5.280e+00, 6.800e-01, 1.750e+00, 6.750e+02},
+    {1.305e+01, 5.800e+00, 2.130e+00, 2.150e+01, 8.600e+01, 2.620e+00,
+     2.650e+00, 3.000e-01, 2.010e+00, 2.600e+00, 7.300e-01, 3.100e+00, 3.800e+02},
+    {1.182e+01, 1.470e+00, 1.990e+00, 2.080e+01, 8.600e+01, 1.980e+00,
+     1.600e+00, 3.000e-01, 1.530e+00, 1.950e+00, 9.500e-01, 3.330e+00, 4.950e+02},
+    {1.164e+01, 2.060e+00, 2.460e+00, 2.160e+01, 8.400e+01, 1.950e+00,
+     1.690e+00, 4.800e-01, 1.350e+00, 2.800e+00, 1.000e+00, 2.750e+00, 6.800e+02},
+    {1.303e+01, 9.000e-01, 1.710e+00, 1.600e+01, 8.600e+01, 1.950e+00,
+     2.030e+00, 2.400e-01, 1.460e+00, 4.600e+00, 1.190e+00, 2.480e+00, 3.920e+02},
+    {1.176e+01, 2.680e+00, 2.920e+00, 2.000e+01, 1.030e+02, 1.750e+00,
+     2.030e+00, 6.000e-01, 1.050e+00, 3.800e+00, 1.230e+00, 2.500e+00, 6.070e+02},
+    {1.439e+01, 1.870e+00, 2.450e+00, 1.460e+01, 9.600e+01, 2.500e+00,
+     2.520e+00, 3.000e-01, 1.980e+00, 5.250e+00, 1.020e+00, 3.580e+00, 1.290e+03},
+    {1.420e+01, 1.760e+00, 2.450e+00, 1.520e+01, 1.120e+02, 3.270e+00,
+     3.390e+00, 3.400e-01, 1.970e+00, 6.750e+00, 1.050e+00, 2.850e+00, 1.450e+03},
+    {1.368e+01, 1.830e+00, 2.360e+00, 1.720e+01, 1.040e+02, 2.420e+00,
+     2.690e+00, 4.200e-01, 1.970e+00, 3.840e+00, 1.230e+00, 2.870e+00, 9.900e+02}};
+
+uint8_t y_wine[20] = {2, 2, 1, 0, 0, 2, 0, 0, 1, 1, 0, 2, 1, 1, 1, 1, 1, 0, 0, 0};
+
+// Method to connect to WiFi
+
+void connectToWifi()
+{
+  WiFi.disconnect();
+  Serial.println("Connecting to Wi-Fi...");
+  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+}
+
+// Method to connect to Mqtt
+
+void connectToMqtt()
+{
+  Serial.println("Connecting to MQTT...");
+  mqttClient.setCredentials("federico", "iotexamdemo");
+  mqttClient.connect();
+}
+
+// Callback for a WiFi event
+
+void WiFiEvent(WiFiEvent_t event) {
+    switch(event) {
+    case SYSTEM_EVENT_STA_GOT_IP:
+        Serial.println("WiFi connected");
+        Serial.println("IP address: ");
+        Serial.println(WiFi.localIP());
+        connectToMqtt();
+        break;
+    case SYSTEM_EVENT_STA_DISCONNECTED:
+        Serial.println("WiFi lost connection");
+        xTimerStop(mqttReconnectTimer, 0); // ensure we don't reconnect to MQTT while reconnecting to Wi-Fi
+        xTimerStart(wifiReconnectTimer, 0);
+        break;
+    }
+}
+
+// Callback for mqtt connection
+
+void onMqttConnect(bool sessionPresent)
+{
+  Serial.println("Connected to MQTT.");
+  Serial.print("Session present: ");
+  Serial.println(sessionPresent);
+}
+
+// Callback for mqtt disconnection
+
+void onMqttDisconnect(AsyncMqttClientDisconnectReason reason)
+{
+  Serial.println("Disconnected from MQTT.");
+
+  if (WiFi.isConnected())
+  {
+    xTimerStart(mqttReconnectTimer, 0);
+  }
+}
+
+// Setup method
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println();
+
+  // TensorFlow initialization, each model is planned once to check it fits the arena
+
+  if (!sine.begin(model_data) || !digits.begin(digits_model) || !wine.begin(wine_model, &wineScaler))
+  {
+    Serial.print("Error initializing TensorFlow");
+    while (true)
+      delay(1000);
+  }
+
+  // pick x from 0 to PI
+  for (uint8_t i = 0; i < BENCHMARK_RUNS; i++)
+    x_sine[i] = 3.14 * i / 10;
+
+  mqttReconnectTimer = xTimerCreate("mqttTimer", pdMS_TO_TICKS(2000), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(connectToMqtt));
+  wifiReconnectTimer = xTimerCreate("wifiTimer", pdMS_TO_TICKS(2000), pdFALSE, (void *)0, reinterpret_cast<TimerCallbackFunction_t>(connectToWifi));
+
+  WiFi.onEvent(WiFiEvent);
+
+  mqttClient.onConnect(onMqttConnect);
+  mqttClient.onDisconnect(onMqttDisconnect);
+  mqttClient.setServer(MQTT_HOST, MQTT_PORT);
+
+  for (uint8_t w = 0; w < WORKLOADS; w++)
+    telemetryBatches[w].setFlush(TELEMETRY_BATCH_SIZE, TELEMETRY_FLUSH_INTERVAL);
+
+  connectToWifi();
+}
+
+// Publish the pending records of a model as one binary batch
+
+void publishBatch(uint8_t w)
+{
+  size_t length;
+  const uint8_t *frame = telemetryBatches[w].encode(millis(), length);
+
+  if (frame == NULL)
+    return;
+
+  uint16_t packetId = mqttClient.publish("iotdemo.esp32wemos.batch", 1, false, (const char *)frame, length);
+  LOG_INFO("Batch of %s sent with packetId: %u, %u bytes", modelNames[w], packetId, length);
+  HeapStats::read().log();
+}
+
+// Publish the latency summary of every model once per window, retained so a
+// late subscriber gets the last one
+
+void publishStats()
+{
+  uint32_t now = millis();
+
+  for (uint8_t w = 0; w < WORKLOADS; w++)
+  {
+    if (histograms[w].count() == 0 || now - histograms[w].getWindowStart() < STATS_INTERVAL)
+      continue;
+
+    if (histograms[w].toJson(statsBuffer, sizeof(statsBuffer), "esp32wemos", modelNames[w], now) == 0)
+      continue;
+
+    mqttClient.publish("iotdemo.esp32wemos.stats", 1, true, statsBuffer);
+    // the queue keeps strings by pointer, statsBuffer is the next model's by then
+    LOG_INFO("%s: %u runs, min %u, mean %.2f, p50 %u, p90 %u, p99 %u, max %u us", modelNames[w],
+             histograms[w].count(), histograms[w].min(), histograms[w].mean(), histograms[w].percentile(50),
+             histograms[w].percentile(90), histograms[w].percentile(99), histograms[w].max());
+    histograms[w].reset(now);
+  }
+}
+
+// Take the arena, run the timed inferences of one model and report them
+
+void runWorkload(uint8_t w)
+{
+  const uint32_t planStart = CycleCounter::now();
+
+  if (!runtimes[w]->activate())
+  {
+    LOG_ERROR("%s: %s", modelNames[w], runtimes[w]->errorMessage());
+    return;
+  }
+
+  const uint32_t planCycles = CycleCounter::now() - planStart;
+
+  // only the inference is inside the timed region
+  switch (w)
+  {
+    case SINE:
+      benchmark.run([](uint16_t i) {
+        results[i] = sine.predict(&x_sine[i]);
+      });
+      break;
+    case DIGITS:
+      benchmark.run([](uint16_t i) {
+        digits.predict(x_digits, y_digits);
+      });
+      for (uint8_t i = 0; i < BENCHMARK_RUNS; i++)
+        results[i] = digits.probaToClass(y_digits);
+      break;
+    case WINE:
+      benchmark.run([](uint16_t i) {
+        results[i] = wine.predictClass(X_wine[i]);
+      });
+      break;
+  }
+
+  for (uint8_t i = 0; i < BENCHMARK_RUNS; i++)
+  {
+    currentIterations[w] += 1;
+
+    histograms[w].record(benchmark.getMicroseconds(i));
+
+#if REPORT_SAMPLES
+    uint32_t end = benchmark.getMicroseconds(i); // Evaluation time
+
+    if (w == SINE)
+      LOG_DEBUG("%s #%u: predicted %f vs %f actual, %u microseconds", modelNames[w], i + 1, results[i], sin(x_sine[i]), end);
+    else
+      LOG_DEBUG("%s #%u: predicted %u vs %u actual, %u microseconds", modelNames[w], i + 1, (uint8_t) results[i], w == DIGITS ? expected_digit : y_wine[i], end);
+
+    // as in the single model sketches, sine reports its input
+    if (w == SINE)
+      telemetryBatches[w].add(x_sine[i], currentIterations[w], end, millis());
+    else
+      telemetryBatches[w].add((int) results[i], currentIterations[w], end, millis());
+#endif
+  }
+
+#if REPORT_SAMPLES
+  LOG_INFO("%s planned in %u microseconds, %u plans so far", modelNames[w], planCycles / CycleCounter::cyclesPerMicrosecond(), arena.getPlans());
+  benchmark.stats().log();
+#endif
+
+  if (telemetryBatches[w].shouldFlush(millis()))
+    publishBatch(w);
+
+  // the next model is timed with the UART idle
+  LOG_DRAIN(Serial);
+}
+
+// Loop method
+
+void loop()
+{
+  if (WiFi.isConnected() && mqttClient.connected())
+  {
+    // Runs BENCHMARK_RUNS timed iterations of every model, then reports them
+    // Waits LOOP_DELAY ms, then restarts
+
+    for (uint8_t w = 0; w < WORKLOADS; w++)
+      runWorkload(w);
+
+    publishStats();
+  }
+  else
+  {
+    LOG_INFO("WiFi or MQTT not connected, waiting before running evaluation.");
+  }
+
+  // print what the loop logged while nothing is measured
+  LOG_DRAIN(Serial);
+
+  delay(LOOP_DELAY);
+}
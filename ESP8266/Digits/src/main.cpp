@@ -3,6 +3,16 @@
 #include <Ticker.h>
 #include <AsyncMqttClient.h>
 #include <EloquentTinyML.h>
+#include <Telemetry.h>
+#include <TelemetryBatch.h>
+#include <HeapStats.h>
+#include <Benchmark.h>
+#include <LatencyHistogram.h>
+#include <LogQueue.h>
+#include <FlashRing.h>
+#include <FileFlash.h>
+#include <TelemetryBacklog.h>
+#include <LittleFS.h>
 #include "digits_model.h"
 
 #define NUMBER_OF_INPUTS 64
@@ -34,6 +44,58 @@ Ticker wifiReconnectTimer;
 
 int currentIteration = 0;
 
+// Benchmark: untimed warm-up runs, timed runs per loop and whether
+// interrupts are masked while an inference is timed
+
+#define BENCHMARK_WARMUP 3
+#define BENCHMARK_RUNS 10
+#define BENCHMARK_MASK_INTERRUPTS 0
+
+Benchmark<BENCHMARK_RUNS> benchmark(BENCHMARK_WARMUP, BENCHMARK_MASK_INTERRUPTS);
+
+// Histogram of every timed inference, published as a summary every
+// STATS_INTERVAL ms. With REPORT_SAMPLES 0 single inferences are neither
+// printed nor sent, so with LOOP_DELAY 0 the benchmark runs back to back
+
+#define STATS_INTERVAL 60000
+#define STATS_BUFFER_SIZE 256
+#define REPORT_SAMPLES 1
+#define LOOP_DELAY 5000
+
+LatencyHistogram<> histogram;
+char statsBuffer[STATS_BUFFER_SIZE];
+
+// Telemetry: records per binary batch and the longest time a record waits
+// before its batch is flushed. With 0 every inference is published as JSON,
+// serialized into a static buffer instead of String temporaries
+
+#define TELEMETRY_BATCH_SIZE 50
+#define TELEMETRY_FLUSH_INTERVAL 60000
+
+#if TELEMETRY_BATCH_SIZE > 0
+TelemetryBatch<TELEMETRY_BATCH_SIZE> telemetryBatch("esp8266", "digits");
+#else
+#define TELEMETRY_BUFFER_SIZE 128
+
+TelemetryRecord<> telemetry("esp8266", "digits");
+char telemetryBuffer[TELEMETRY_BUFFER_SIZE];
+#endif
+
+// Batches kept in a flash ring while MQTT is down (0 sectors disables it)
+// and how many stored batches are sent per loop once it is back
+
+#define TELEMETRY_STORE_SECTORS 16
+#define TELEMETRY_DRAIN_BATCHES 5
+// how long a stored batch waits for its PUBACK before the loop goes on
+#define TELEMETRY_ACK_TIMEOUT 500
+#define TELEMETRY_STORE (TELEMETRY_BATCH_SIZE > 0 && TELEMETRY_STORE_SECTORS > 0)
+
+#if TELEMETRY_STORE
+FileFlash telemetryFile(LittleFS, "/telemetry.bin", TELEMETRY_STORE_SECTORS);
+FlashRing telemetryRing(telemetryFile);
+TelemetryBacklog telemetryStore(telemetryRing);
+#endif
+
 // Elements for evaluation
 
 float x_test[64] = {0., 0., 0.625, 0.875, 0.5, 0.0625, 0., 0.,
@@ -96,12 +158,26 @@ void onMqttDisconnect(AsyncMqttClientDisconnectReason reason)
 {
   Serial.println("Disconnected from MQTT.");
 
+#if TELEMETRY_STORE
+  telemetryStore.disconnected();
+#endif
+
   if (WiFi.isConnected())
   {
     mqttReconnectTimer.once(2, connectToMqtt);
   }
 }
 
+// Callback for a PUBACK, an acknowledged stored batch leaves the store on
+// the next drain
+
+#if TELEMETRY_STORE
+void onMqttPublish(uint16_t packetId)
+{
+  telemetryStore.acknowledged(packetId);
+}
+#endif
+
 // Setup method
 
 void setup()
@@ -126,68 +202,190 @@ void setup()
 
   mqttClient.onConnect(onMqttConnect);
   mqttClient.onDisconnect(onMqttDisconnect);
+#if TELEMETRY_STORE
+  mqttClient.onPublish(onMqttPublish);
+#endif
   mqttClient.setServer(MQTT_HOST, MQTT_PORT);
 
+#if TELEMETRY_BATCH_SIZE > 0
+  telemetryBatch.setFlush(TELEMETRY_BATCH_SIZE, TELEMETRY_FLUSH_INTERVAL);
+#endif
+
+#if TELEMETRY_STORE
+  if (LittleFS.begin() && telemetryFile.begin() && telemetryStore.begin())
+  {
+    Serial.print("Telemetry backlog: ");
+    Serial.print(telemetryStore.pending());
+    Serial.println(" batches");
+  }
+  else
+    Serial.println("Telemetry store not available.");
+#endif
+
   connectToWifi();
 }
 
+// Publish the pending records as one binary batch, retain is off since the
+// reader tells batches apart by their sequence number
+
+#if TELEMETRY_BATCH_SIZE > 0
+void publishBatch()
+{
+  size_t length;
+  const uint8_t *frame = telemetryBatch.encode(millis(), length);
+
+  if (frame == NULL)
+    return;
+
+#if TELEMETRY_STORE
+  // behind the backlog while it drains, so batches reach the reader in order
+  if (!mqttClient.connected() || telemetryStore.pending() > 0)
+  {
+    if (!telemetryStore.store(frame, length))
+      LOG_ERROR("Telemetry store write failed.");
+    LOG_INFO("Batch stored, backlog: %u batches, dropped: %u", telemetryStore.pending(), telemetryStore.dropped());
+    return;
+  }
+#endif
+
+  uint32_t publishStart = micros();
+  uint16_t packetId = mqttClient.publish("iotdemo.esp8266.batch", 1, false, (const char *)frame, length);
+  uint32_t publishTime = micros() - publishStart;
+  LOG_INFO("Batch sent with packetId: %u, %u bytes", packetId, length);
+  LOG_INFO("Publish time: %u microseconds", publishTime);
+  HeapStats::read().log();
+}
+#endif
+
+// Send stored batches oldest first, a few per loop so the broker and the radio
+// are not flooded after a long outage. A batch leaves the store on its PUBACK,
+// one is in flight at a time and the loop waits a little for each.
+
+#if TELEMETRY_STORE
+void drainBacklog()
+{
+  static uint8_t frame[TelemetryBatch<TELEMETRY_BATCH_SIZE>::maxFrameSize];
+
+  for (uint8_t i = 0; i < TELEMETRY_DRAIN_BATCHES && mqttClient.connected(); i++)
+  {
+    uint16_t length = telemetryStore.next(frame, sizeof(frame), millis());
+
+    if (length == 0)
+      return;
+
+    uint16_t packetId = mqttClient.publish("iotdemo.esp8266.batch", 1, false, (const char *)frame, length);
+    if (packetId == 0)
+      return;
+
+    telemetryStore.sent(packetId);
+    for (uint32_t start = millis(); telemetryStore.waiting() && mqttClient.connected() && millis() - start < TELEMETRY_ACK_TIMEOUT;)
+      delay(1);
+  }
+
+  LOG_INFO("Telemetry backlog: %u batches", telemetryStore.pending());
+}
+#endif
+
+// Publish the latency summary once per window, retained so a late subscriber
+// gets the last one. While offline the window keeps growing
+
+void publishStats()
+{
+  uint32_t now = millis();
+
+  if (histogram.count() == 0 || now - histogram.getWindowStart() < STATS_INTERVAL || !mqttClient.connected())
+    return;
+
+  if (histogram.toJson(statsBuffer, sizeof(statsBuffer), "esp8266", "digits", now) == 0)
+    return;
+
+  mqttClient.publish("iotdemo.esp8266.stats", 1, true, statsBuffer);
+  LOG_INFO("%s", statsBuffer);
+  histogram.reset(now);
+}
+
 // Loop method
 
 void loop()
 {
-  if (WiFi.isConnected() && mqttClient.connected())
+  bool online = WiFi.isConnected() && mqttClient.connected();
+
+#if TELEMETRY_STORE
+  // stored batches go first, new ones queue behind them
+  if (online)
+    drainBacklog();
+#endif
+
+  // with the flash store evaluation keeps running while offline
+  if (online || TELEMETRY_STORE)
   {
-    // Runs a loop of 10 iterations, at every one it sends the result (if enabled)
+    // Runs BENCHMARK_RUNS timed iterations, then reports every one (if enabled)
+
+    // Warm-up and timed runs first, only the inference is inside the timed region
+
+    benchmark.run([](uint16_t i) {
+      tf.predict(x_test, y_pred);
+    });
 
-    for (uint8_t i = 0; i < 10; i++)
+    for (uint8_t i = 0; i < BENCHMARK_RUNS; i++)
     {
 
       currentIteration += 1; // To keep track of iterations between loops
 
-      uint32_t start = micros(); // Evaluation start time
-      tf.predict(x_test, y_pred);
-      uint32_t end = micros() - start; // Evaluation end time
-
-      Serial.print("Test output is: ");
-      Serial.println(y_test);
-      Serial.print("Predicted probabilities are: ");
+      histogram.record(benchmark.getMicroseconds(i));
 
-      for (int i = 0; i < 10; i++)
-      {
-        Serial.print(y_pred[i]);
-        Serial.print(i == 9 ? '\n' : ',');
-      }
+#if REPORT_SAMPLES
+      uint32_t end = benchmark.getMicroseconds(i); // Evaluation time
 
-      Serial.print("Predicted class is: ");
       uint8_t prediction = tf.probaToClass(y_pred);
-      Serial.println(prediction);      
-      Serial.print("Sanity check: ");
-      Serial.println(tf.predictClass(x_test));
-      Serial.println("Evaluation time: " + String(end) + " microseconds");
+      LOG_DEBUG("Sample #%u: predicted %u vs %d actual, %u microseconds", i + 1, prediction, y_test, end);
 
-      // DTO to be created
+      // DTO to be created, without heap allocations
       //{"board": "esp8266", "model": "digits", "result": 1, "iteration": 1, "microseconds": 120}
 
-      String startPar = "{";
-      String board = "\"board\":\"esp8266\",";
-      String model = "\"model\":\"digits\",";
-      String result = "\"result\":" + String(prediction) + ",";
-      String iteration = "\"iteration\":" + String(int(currentIteration)) + ",";
-      String time = "\"microseconds\":" + String(int(end));
-      String endPar = "}";
-
-      String resultString = startPar + board + model + result + iteration + time + endPar;
-
-      uint16_t packetId = mqttClient.publish("iotdemo.esp8266", 1, true, (char *)resultString.c_str());
-      Serial.print("Message sent with packetId: ");
-      Serial.println(packetId);
+#if TELEMETRY_BATCH_SIZE > 0
+      telemetryBatch.add(prediction, currentIteration, end, millis());
+#else
+      telemetry.setResult(prediction);
+      telemetry.setIteration(currentIteration);
+      telemetry.setMicroseconds(end);
+
+      uint32_t publishStart = micros();
+      if (telemetry.toJson(telemetryBuffer, sizeof(telemetryBuffer)) == 0)
+        LOG_ERROR("Telemetry record larger than %u bytes, not sent", sizeof(telemetryBuffer));
+      else
+      {
+        uint16_t packetId = mqttClient.publish("iotdemo.esp8266", 1, true, telemetryBuffer);
+        uint32_t publishTime = micros() - publishStart;
+        LOG_INFO("Message sent with packetId: %u", packetId);
+        LOG_INFO("Publish time: %u microseconds", publishTime);
+      }
+      HeapStats::read().log();
       delay(100);
+#endif
+#endif
     }
+
+#if REPORT_SAMPLES
+    LOG_DEBUG("Predicted probabilities are: %f,%f,%f,%f,%f,%f,%f,%f,%f,%f", y_pred[0], y_pred[1], y_pred[2], y_pred[3], y_pred[4],
+              y_pred[5], y_pred[6], y_pred[7], y_pred[8], y_pred[9]);
+    benchmark.stats().log();
+#endif
+
+#if TELEMETRY_BATCH_SIZE > 0
+    if (telemetryBatch.shouldFlush(millis()))
+      publishBatch();
+#endif
+
+    publishStats();
   }
   else
   {
-    Serial.println("WiFi or MQTT not connected, waiting before running evaluation.");
+    LOG_INFO("WiFi or MQTT not connected, waiting before running evaluation.");
   }
 
-  delay(5000);
+  // print what the loop logged while nothing is measured
+  LOG_DRAIN(Serial);
+
+  delay(LOOP_DELAY);
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include <Arduino.h>
+#include <Benchmark.h>
+#include <LogQueue.h>
+#include <SensorFeatures.h>
+#include <BandEnergies.h>
+
+// Windowed sensor features on the ESP8266: times the streaming statistics of
+// lib/SensorFeatures per reading and per feature vector, next to recomputing
+// them from the window at every hop, and the band energies per channel, on
+// the same synthetic accelerometer as sensorBench.cpp on the host. Then
+// computes them live on the ADC (A0).
+
+// An accelerometer at 100 Hz: 1.28 s windows every 0.32 s, three axes
+
+#define CHANNELS 3
+#define WINDOW 128
+#define HOP 32
+#define SAMPLE_RATE 100
+#define FFT_SIZE 64
+#define BANDS 4
+
+SensorFeatures<CHANNELS, WINDOW> features;
+BandEnergies<FFT_SIZE, BANDS> bands;
+float input[SensorFeatures<CHANNELS, WINDOW>::size + CHANNELS * BANDS];
+
+// Timed runs: a push per run, so the occasional one that tables a pass of
+// the ring is in the tail
+
+#define BENCHMARK_WARMUP 3
+#define BENCHMARK_RUNS 256
+#define BENCHMARK_MASK_INTERRUPTS 1
+
+Benchmark<BENCHMARK_RUNS> pushBenchmark(BENCHMARK_WARMUP, BENCHMARK_MASK_INTERRUPTS);
+Benchmark<BENCHMARK_RUNS / 8> writeBenchmark(BENCHMARK_WARMUP, BENCHMARK_MASK_INTERRUPTS);
+Benchmark<BENCHMARK_RUNS / 8> recomputeBenchmark(BENCHMARK_WARMUP, BENCHMARK_MASK_INTERRUPTS);
+Benchmark<BENCHMARK_RUNS / 8> bandsBenchmark(BENCHMARK_WARMUP, BENCHMARK_MASK_INTERRUPTS);
+
+// Live features of the ADC, a sample every SAMPLE_INTERVAL ms
+
+#define SAMPLE_INTERVAL (1000 / SAMPLE_RATE)
+
+SensorFeatures<1, WINDOW> adcFeatures;
+float adcInput[SensorFeatures<1, WINDOW>::size + BANDS];
+uint32_t lastSample = 0;
+
+// Walking on a +-2 g accelerometer: gravity on z, a 2 Hz step, bursts of
+// shaking and sensor noise
+
+int16_t clamp(float value)
+{
+  return value > 32767 ? 32767 : value < -32768 ? -32768 : (int16_t) value;
+}
+
+void reading(uint32_t i, int16_t *axes)
+{
+  const float t = (float) i / SAMPLE_RATE;
+  const float step = sinf(2 * PI * 2 * t);
+  const float shake = fmodf(t, 7.0f) < 1.5f ? sinf(2 * PI * 18 * t) : 0;
+  const int16_t noise = (int16_t) ((i * 2654435761u) >> 23) - 256;
+
+  axes[0] = clamp(3000 * step + 5000 * shake + noise);
+  axes[1] = clamp(1500 * sinf(2 * PI * t) - noise);
+  axes[2] = clamp(16384 + 6000 * step + noise / 2);
+}
+
+// The features recomputed from the window, integer sums as the library
+
+int16_t window[WINDOW];
+
+void recomputeFeatures(float *out)
+{
+  int32_t sum = 0;
+  uint64_t squares = 0;
+  int16_t lowest = window[0], highest = window[0];
+  uint16_t crossings = 0;
+
+  for (uint16_t i = 0; i < WINDOW; i++)
+  {
+    sum += window[i];
+    squares += (int32_t) window[i] * window[i];
+    lowest = window[i] < lowest ? window[i] : lowest;
+    highest = window[i] > highest ? window[i] : highest;
+    if (i > 0)
+      crossings += (window[i - 1] >= 0) != (window[i] >= 0);
+  }
+  out[FEATURE_MEAN] = (float) sum / WINDOW;
+  out[FEATURE_VARIANCE] = (float) ((int64_t) WINDOW * (int64_t) squares - (int64_t) sum * sum) / (WINDOW * WINDOW);
+  out[FEATURE_RMS] = sqrtf((float) squares / WINDOW);
+  out[FEATURE_PEAK_TO_PEAK] = highest - lowest;
+  out[FEATURE_CROSSING_RATE] = (float) crossings / (WINDOW - 1);
+}
+
+// Synthetic readings are made before the timed region, only the library is in it
+
+int16_t readings[BENCHMARK_RUNS][CHANNELS];
+
+void runBenchmark()
+{
+  // a full window first, so every timed push also drops the oldest sample
+  features.reset();
+  features.setHop(HOP);
+  for (uint32_t i = 0; i < WINDOW; i++)
+  {
+    reading(i, readings[0]);
+    features.push(readings[0]);
+  }
+  for (uint32_t i = 0; i < BENCHMARK_RUNS; i++)
+    reading(WINDOW + i, readings[i]);
+
+  pushBenchmark.run([](uint16_t i) {
+    features.push(readings[i]);
+  });
+
+  writeBenchmark.run([](uint16_t i) {
+    features.write(input);
+  });
+
+  // a channel's window, three times per feature vector
+  features.getChannel(0).copyLatest(window, WINDOW);
+  recomputeBenchmark.run([](uint16_t i) {
+    for (uint8_t c = 0; c < CHANNELS; c++)
+      recomputeFeatures(input + c * FEATURES_PER_CHANNEL);
+  });
+
+  bandsBenchmark.run([](uint16_t i) {
+    bands.compute(features.getChannel(i % CHANNELS), input + features.size + (i % CHANNELS) * BANDS);
+  });
+
+  LOG_INFO("Streaming statistics, push of %u channels:", CHANNELS);
+  pushBenchmark.stats().log();
+  LOG_INFO("Write of %u features:", features.size);
+  writeBenchmark.stats().log();
+  LOG_INFO("Recomputing them over %u sample windows:", WINDOW);
+  recomputeBenchmark.stats().log();
+  LOG_INFO("Bands of a channel, %u point FFT:", FFT_SIZE);
+  bandsBenchmark.stats().log();
+
+  const BenchmarkStats push = pushBenchmark.stats();
+  const BenchmarkStats write = writeBenchmark.stats();
+  const BenchmarkStats recompute = recomputeBenchmark.stats();
+  LOG_INFO("Per reading at a hop of %u: streaming %.2f us, recomputing %.2f us", HOP,
+           push.toMicroseconds(push.mean + write.mean / HOP), recompute.toMicroseconds(recompute.mean / HOP));
+}
+
+// Setup method
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println();
+
+  bands.begin();
+  runBenchmark();
+  LOG_DRAIN(Serial);
+
+  // the ADC reads 0 to 1023, crossings are counted around mid scale
+  adcFeatures.setHop(HOP);
+  adcFeatures.getChannel(0).setCrossingLevel(512);
+  adcFeatures.setScale(0, 1.0f / 1024);
+  lastSample = millis();
+}
+
+// Loop method
+
+void loop()
+{
+  if (millis() - lastSample < SAMPLE_INTERVAL)
+    return;
+  lastSample += SAMPLE_INTERVAL;
+
+  const int16_t sample = analogRead(A0);
+
+  if (adcFeatures.push(&sample))
+  {
+    float *adcBands = adcInput + adcFeatures.size;
+
+    adcFeatures.write(adcInput);
+    bands.compute(adcFeatures.getChannel(0), adcBands, adcFeatures.getScale(0));
+    LOG_DEBUG("A0: mean %.3f, variance %.5f, rms %.3f, peak to peak %.3f, crossing rate %.2f, bands %.5f %.5f %.5f "
+              "%.5f",
+              adcInput[FEATURE_MEAN], adcInput[FEATURE_VARIANCE], adcInput[FEATURE_RMS],
+              adcInput[FEATURE_PEAK_TO_PEAK], adcInput[FEATURE_CROSSING_RATE], adcBands[0], adcBands[1], adcBands[2],
+              adcBands[3]);
+  }
+
+  LOG_DRAIN(Serial);
+}
@@ -0,0 +1,67 @@
+import numpy as np
+from tensorflow.keras import layers
+
+# Standardization of a model's inputs, (x - offset) * scale per feature, that
+# the firmware never runs: the model trains on scaled features, then the
+# scaling is folded into the first Dense layer, so the board passes the raw
+# readings (wine: 0.1 to 1680) as they come. For a Dense layer
+# y = W'((x - offset) * scale) + b is y = (W' * scale) x + (b - W'(offset * scale)),
+# the same layer with other weights and no extra op. The firmware folds it at
+# load time (lib/ModelRuntime/FeatureScaler.h) from the arrays of header(),
+# fold() does it here for a model that must take raw features as exported.
+#
+# Float inputs only: an int8 input tensor has one scale for all its features,
+# raw features of such different ranges would round the small ones away.
+
+
+class FeatureScaler:
+    def __init__(self, offset=None, scale=None):
+        self.offset = None if offset is None else np.asarray(offset, dtype=np.float32)
+        self.scale = None if scale is None else np.asarray(scale, dtype=np.float32)
+
+    def fit(self, x):
+        # mean and standard deviation of the training features, a constant
+        # feature keeps a scale of 1
+        x = np.asarray(x, dtype=np.float64).reshape(len(x), -1)
+        std = x.std(axis=0)
+        self.offset = x.mean(axis=0).astype(np.float32)
+        self.scale = (1 / np.where(std > 0, std, 1)).astype(np.float32)
+        return self
+
+    def transform(self, x):
+        x = np.asarray(x, dtype=np.float32)
+        return ((x.reshape(len(x), -1) - self.offset) * self.scale).reshape(x.shape)
+
+    def fold(self, model):
+        # the first layer with weights must be a Dense one on the features
+        first = next(layer for layer in model.layers if layer.get_weights())
+        if not isinstance(first, layers.Dense):
+            raise ValueError('cannot fold the scaling into a %s layer' % type(first).__name__)
+
+        kernel, bias = first.get_weights()
+        if kernel.shape[0] != len(self.scale):
+            raise ValueError('%d features, the first layer takes %d' % (len(self.scale), kernel.shape[0]))
+
+        # in float64, the offsets are large next to the weights they move
+        kernel = kernel.astype(np.float64)
+        folded_kernel = kernel * self.scale[:, None]
+        folded_bias = bias - (self.offset.astype(np.float64) * self.scale) @ kernel
+        first.set_weights([folded_kernel.astype(np.float32), folded_bias.astype(np.float32)])
+        return model
+
+    def header(self, name, units):
+        # offset and scale for the firmware's FeatureScaler, and the sizes of
+        # the first layer it folds: units of the Dense layer on the features
+        def values(array):
+            return ', '.join('%.9g' % value for value in array)
+
+        prefix = name.upper()
+        return ('#pragma once\n\n'
+                '// Standardization the %s model was trained with, folded into its first layer\n'
+                '// at load time by lib/ModelRuntime/FeatureScaler.h. From Models/%s_model.py\n\n'
+                '#define %s_FEATURES %d\n'
+                '#define %s_FIRST_LAYER_UNITS %d\n\n'
+                'const float %s_offset[%s_FEATURES] = {%s};\n'
+                'const float %s_scale[%s_FEATURES] = {%s};\n'
+                % (name, name, prefix, len(self.scale), prefix, units,
+                   name, prefix, values(self.offset), name, prefix, values(self.scale)))
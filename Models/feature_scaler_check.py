@@ -0,0 +1,90 @@
+import sys
+import types
+import numpy as np
+
+# Checks that FeatureScaler.fold() leaves a model's outputs as they were:
+# a network of Dense layers run on scaled features and the same network,
+# folded, run on the raw ones. Needs numpy only: without TensorFlow a
+# stand-in tensorflow.keras.layers.Dense is installed before the import,
+# with the get_weights() / set_weights() fold() uses.
+#
+#   python feature_scaler_check.py
+
+try:
+    from tensorflow.keras import layers
+    stand_in = False
+except ImportError:
+    class Dense:
+        def __init__(self, kernel, bias):
+            self.kernel, self.bias = kernel, bias
+
+        def get_weights(self):
+            return [self.kernel, self.bias]
+
+        def set_weights(self, weights):
+            self.kernel, self.bias = weights
+
+    layers = types.ModuleType('tensorflow.keras.layers')
+    layers.Dense = Dense
+    keras = types.ModuleType('tensorflow.keras')
+    keras.layers = layers
+    tensorflow = types.ModuleType('tensorflow')
+    tensorflow.keras = keras
+    sys.modules.update({'tensorflow': tensorflow, 'tensorflow.keras': keras, 'tensorflow.keras.layers': layers})
+    stand_in = True
+
+from feature_scaler import FeatureScaler
+
+
+def dense(units, inputs, rng):
+    kernel = (rng.standard_normal((inputs, units)) / np.sqrt(inputs)).astype(np.float32)
+    bias = (0.1 * rng.standard_normal(units)).astype(np.float32)
+    if stand_in:
+        return layers.Dense(kernel, bias)
+    layer = layers.Dense(units)
+    layer.build((None, inputs))
+    layer.set_weights([kernel, bias])
+    return layer
+
+
+# relu between the layers, the last one gives the logits
+def predict(model, x):
+    for layer in model.layers:
+        kernel, bias = layer.get_weights()
+        x = x.astype(np.float32) @ kernel + bias
+        if layer is not model.layers[-1]:
+            x = np.maximum(x, 0)
+    return x
+
+
+rng = np.random.default_rng(1)
+
+# the wine features' typical values, 0.36 to 750, spread by 30 %, and a
+# constant one that keeps a scale of 1
+typical = np.array([13, 2.3, 2.4, 19.5, 100, 2.3, 2, 0.36, 1.6, 5, 0.96, 2.6, 750])
+features = (typical * (1 + 0.3 * rng.standard_normal((178, len(typical))))).astype(np.float32)
+features[:, 5] = 2.0
+
+# the wine network: 13 features, 50, 50, 3 classes
+model = types.SimpleNamespace(layers=[dense(50, 13, rng), dense(50, 50, rng), dense(3, 50, rng)])
+
+scaler = FeatureScaler().fit(features)
+scaled = predict(model, scaler.transform(features))
+scaler.fold(model)
+folded = predict(model, features)
+
+difference = np.abs(folded - scaled).max()
+agreement = (folded.argmax(axis=1) == scaled.argmax(axis=1)).mean()
+print('Largest difference: %.2e (outputs up to %.2f), same class for %.1f %% of the samples'
+      % (difference, np.abs(scaled).max(), 100 * agreement))
+
+try:
+    FeatureScaler().fit(features[:, :5]).fold(model)
+    refused = False
+except ValueError as error:
+    refused = True
+    print('Refused:', error)
+
+if difference > 1e-3 * np.abs(scaled).max() or agreement < 1 or not refused:
+    sys.exit('Folding changed the outputs')
+print('OK')
@@ -0,0 +1,69 @@
+import tensorflow as tf
+import tensorflow_datasets as tfds
+from tensorflow.keras import layers
+from tensorflow.lite.experimental.microfrontend.python.ops import audio_microfrontend_op as frontend_op
+from tinymlgen import port
+
+# Keyword model of ESP32Dev/Keyword: "yes" and "no" from the Speech Commands
+# dataset. Features come from the TensorFlow op of the microfrontend the
+# board runs, with the same settings (ESP32Dev/Keyword/include/KeywordConfig.h):
+# 30 ms windows every 10 ms, 40 channels, one second = 98 rows, scaled by 10 / 256.
+
+SAMPLE_RATE = 16000
+FRAMES = 98
+CHANNELS = 40
+LABELS = ['silence', 'unknown', 'yes', 'no']
+
+
+def features(audio):
+    audio = tf.pad(audio, [[0, SAMPLE_RATE - tf.shape(audio)[0]]])
+    spectrogram = frontend_op.audio_microfrontend(tf.cast(audio, tf.int16), sample_rate=SAMPLE_RATE,
+                                                  window_size=30, window_step=10, num_channels=CHANNELS,
+                                                  out_scale=1, out_type=tf.float32)
+    return tf.reshape(spectrogram * (10.0 / 256.0), [FRAMES * CHANNELS])
+
+
+def label(name):
+    # everything but yes, no and silence is unknown
+    return tf.case([(tf.equal(name, 'yes'), lambda: 2), (tf.equal(name, 'no'), lambda: 3),
+                    (tf.equal(name, '_silence_'), lambda: 0)], default=lambda: 1)
+
+
+def get_data(split):
+    dataset, info = tfds.load('speech_commands', split=split, with_info=True, as_supervised=True)
+    names = tf.constant(info.features['label'].names)
+
+    # keep one unknown word in four, it outnumbers the keywords
+    dataset = dataset.map(lambda audio, y: (audio, label(names[y])))
+    dataset = dataset.filter(lambda audio, y: tf.logical_or(y != 1, tf.random.uniform([]) < 0.25))
+    return dataset.map(lambda audio, y: (features(audio), y)).cache().shuffle(10000).batch(100).prefetch(2)
+
+
+def get_model():
+    train = get_data('train')
+    validation = get_data('validation')
+
+    # tiny_conv of the micro_speech example
+    model = tf.keras.Sequential()
+    model.add(layers.Reshape((FRAMES, CHANNELS, 1), input_shape=(FRAMES * CHANNELS,)))
+    model.add(layers.Conv2D(8, (10, 8), strides=(2, 2), padding='same', activation='relu'))
+    model.add(layers.Dropout(0.5))
+    model.add(layers.Flatten())
+    model.add(layers.Dense(len(LABELS), activation='softmax'))
+
+    model.compile(optimizer='adam', loss='sparse_categorical_crossentropy', metrics=['accuracy'])
+    model.fit(train, validation_data=validation, epochs=20)
+    return model
+
+
+def test_model(model):
+    print('ACCURACY', model.evaluate(get_data('test'))[1])
+
+
+if __name__ == '__main__':
+    model = get_model()
+    test_model(model)
+
+    # float: the ESP32 interpreter has no hybrid convolution
+    with open('keyword_model.h', 'w', encoding='utf-8') as file:
+        file.write(port(model, variable_name='keyword_model', pretty_print=True, optimize=False))
@@ -0,0 +1,60 @@
+import argparse
+import re
+import struct
+import zlib
+
+# Packs a model into the image read by lib/ModelStore: a 32 byte header
+# (see ModelImage.h) followed by the flatbuffer, aligned to 16 bytes.
+# The model is either a .tflite file or a header exported by tinymlgen.
+
+MAGIC = b'TFMD'
+FORMAT_VERSION = 1
+HEADER_SIZE = 32
+ALIGNMENT = 16
+
+# Offsets of the model partitions in partitions.csv
+PARTITIONS = {'model0': 0x3C0000, 'model1': 0x3E0000}
+PARTITION_SIZE = 0x20000
+
+
+def read_model(path):
+    if not path.endswith('.h'):
+        with open(path, 'rb') as file:
+            return file.read()
+
+    with open(path, 'r', encoding='utf-8') as file:
+        source = file.read()
+
+    # only the array initializer, the length constant follows it
+    start = source.index('{', source.index('[]'))
+    end = source.index('}', start)
+    return bytes(int(value, 16) for value in re.findall(r'0x([0-9a-fA-F]{2})', source[start:end]))
+
+
+def pack(model, version):
+    offset = (HEADER_SIZE + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+    header = MAGIC + struct.pack('<HHIIIII', FORMAT_VERSION, HEADER_SIZE, version, len(model), zlib.crc32(model), offset, 0)
+    header += struct.pack('<I', zlib.crc32(header))
+    return header + b'\xff' * (offset - HEADER_SIZE) + model
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Pack a model for the model partition')
+    parser.add_argument('model', help='.tflite file or tinymlgen header')
+    parser.add_argument('output', help='image to write')
+    parser.add_argument('--version', type=int, default=1, help='model version stored in the header')
+    parser.add_argument('--partition', default='model0', choices=sorted(PARTITIONS))
+    args = parser.parse_args()
+
+    model = read_model(args.model)
+    image = pack(model, args.version)
+
+    if len(image) > PARTITION_SIZE:
+        raise SystemExit('Image of %d bytes does not fit the %d byte partition' % (len(image), PARTITION_SIZE))
+
+    with open(args.output, 'wb') as file:
+        file.write(image)
+
+    print('Model: %d bytes, CRC-32 %08x, version %d' % (len(model), zlib.crc32(model), args.version))
+    print('Flash it with:')
+    print('  esptool.py write_flash 0x%X %s' % (PARTITIONS[args.partition], args.output))
@@ -4,6 +4,7 @@ from tensorflow.keras.utils import to_categorical
 from sklearn.datasets import load_wine
 from sklearn.model_selection import train_test_split
 from tinymlgen import port
+from feature_scaler import FeatureScaler
 
 # load and split dataset into train, validation, test
 X, y = load_wine(return_X_y=True)
@@ -14,6 +15,9 @@ X_train, X_valid, y_train, y_valid = train_test_split(X_train, y_train, test_siz
 input_dim = X_train.shape[1:]
 output_dim = y.shape[1]
 
+# standardize on the training features: the raw ones span 0.1 to 1680
+scaler = FeatureScaler().fit(X_train)
+
 print('input_dim', input_dim)
 print('output_dim', output_dim)
 
@@ -26,10 +30,21 @@ nn.add(layers.Dense(output_dim, activation='softmax'))
 
 # use categorical_crossentropy for multi-class classification
 nn.compile(loss='categorical_crossentropy', optimizer='adam', metrics=['accuracy'])
-nn.fit(X_train, y_train, validation_data=(X_valid, y_valid), epochs=100, verbose=0)
+nn.fit(scaler.transform(X_train), y_train, validation_data=(scaler.transform(X_valid), y_valid), epochs=100, verbose=0)
 
-print('Accuracy: %.1f' % nn.evaluate(X_test, y_test)[1])
+print('Accuracy: %.1f' % nn.evaluate(scaler.transform(X_test), y_test)[1])
 
-# export to file
+# export the model as trained, the boards fold the scaling in at load time
 with open('wine_model.h', 'w', encoding='utf-8') as file:
-    print(port(nn, variable_name='wine_model', pretty_print=True, optimize=False))
\ No newline at end of file
+    file.write(port(nn, variable_name='wine_model', pretty_print=True, optimize=False))
+with open('wine_scaler.h', 'w', encoding='utf-8') as file:
+    file.write(scaler.header('wine', nn.layers[0].units))
+
+# folded here for the model slots (pack_model.py): a slot model takes raw features
+scaled = nn.predict(scaler.transform(X_test))
+scaler.fold(nn)
+print('Folded, largest difference: %.2e' % np.abs(nn.predict(X_test) - scaled).max())
+print('Accuracy on raw features: %.1f' % nn.evaluate(X_test, y_test)[1])
+
+with open('wine_model_folded.h', 'w', encoding='utf-8') as file:
+    file.write(port(nn, variable_name='wine_model', pretty_print=True, optimize=False))
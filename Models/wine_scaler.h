@@ -0,0 +1,12 @@
+#pragma once
+
+// Standardization the wine model was trained with, folded into its first layer
+// at load time by lib/ModelRuntime/FeatureScaler.h. From Models/wine_model.py
+// The wine_model.h beside it is still the one trained on raw features, so
+// this is the identity until Models/wine_model.py writes both again.
+
+#define WINE_FEATURES 13
+#define WINE_FIRST_LAYER_UNITS 50
+
+const float wine_offset[WINE_FEATURES] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+const float wine_scale[WINE_FEATURES] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
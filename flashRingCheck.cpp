@@ -0,0 +1,265 @@
+// Checks lib/FlashRing on a RAM backed flash (RamFlash) on a laptop: records
+// kept across a ring that wraps, with the oldest sector's unsent records
+// dropped and counted, a power cut at every byte of an append, and the ring
+// found again by begin() after each. The sketches keep their telemetry
+// backlog in the same FlashRing, on a file (FileFlash), through
+// TelemetryBacklog: its batches are restamped, flagged when they are from
+// before a reset, and kept until their PUBACK, checked last. From here:
+//
+//   g++ -std=c++11 -O2 -Ilib/FlashRing -Ilib/Telemetry flashRingCheck.cpp -o flashRingCheck
+//   ./flashRingCheck
+
+#include <FlashRing.h>
+#include <RamFlash.h>
+#include <TelemetryBacklog.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// 248 bytes of records per sector: 15 records of 16 bytes
+#define SECTOR_SIZE 256
+#define SECTORS 4
+#define PAYLOAD 12
+
+typedef RamFlash<SECTOR_SIZE, SECTORS> Flash;
+
+// Record i: its index, then bytes that depend on it
+void makeRecord(uint32_t i, uint8_t *record)
+{
+  memcpy(record, &i, sizeof(i));
+  for (uint8_t b = sizeof(i); b < PAYLOAD; b++)
+    record[b] = (uint8_t) (i * 31 + b);
+}
+
+// Index of the oldest unsent record, -1 if there is none or it is damaged
+long peekIndex(FlashRing &ring)
+{
+  uint8_t record[PAYLOAD];
+  uint8_t expected[PAYLOAD];
+  uint32_t i;
+
+  if (ring.peek(record, sizeof(record)) != PAYLOAD)
+    return -1;
+  memcpy(&i, record, sizeof(i));
+  makeRecord(i, expected);
+  return memcmp(record, expected, PAYLOAD) == 0 ? (long) i : -1;
+}
+
+bool append(FlashRing &ring, uint32_t i)
+{
+  uint8_t record[PAYLOAD];
+
+  makeRecord(i, record);
+  return ring.append(record, PAYLOAD);
+}
+
+// Pop count records, they must be first to first + count - 1
+bool drain(FlashRing &ring, long first, uint32_t count)
+{
+  for (uint32_t n = 0; n < count; n++)
+  {
+    if (peekIndex(ring) != first + (long) n || !ring.pop())
+      return false;
+  }
+  return true;
+}
+
+// Many laps of the ring, reading some records back on the way: every record
+// is either sent once, in order, or counted as dropped, and erases spread
+// over the sectors
+bool checkWraparound()
+{
+  static Flash flash;
+  FlashRing ring(flash);
+  const uint32_t records = 2000;
+  uint32_t sent = 0;
+  long next = 0;
+  bool ok = ring.begin();
+
+  for (uint32_t i = 0; i < records && ok; i++)
+  {
+    ok = append(ring, i);
+
+    // a reader that falls behind, then catches up for a while
+    if (i % 100 < 30)
+    {
+      const long index = peekIndex(ring);
+      ok &= index >= next && ring.pop();
+      next = index + 1;
+      sent++;
+    }
+  }
+
+  const uint32_t dropped = ring.dropped();
+  const uint32_t pending = ring.pending();
+  ok &= sent + dropped + pending == records;
+
+  // the ring after a reset holds the same records
+  FlashRing reopened(flash);
+  ok &= reopened.begin() && reopened.pending() == pending;
+  ok &= drain(reopened, records - pending, pending) && reopened.pending() == 0 && peekIndex(reopened) == -1;
+
+  uint32_t fewest = flash.getEraseCount(0), most = fewest;
+  for (uint16_t s = 1; s < SECTORS; s++)
+  {
+    fewest = flash.getEraseCount(s) < fewest ? flash.getEraseCount(s) : fewest;
+    most = flash.getEraseCount(s) > most ? flash.getEraseCount(s) : most;
+  }
+  ok &= most - fewest <= 1;
+
+  printf("wraparound: %u records, %u sent, %u dropped, %u pending after reopen, %u to %u erases per sector: %s\n",
+         records, sent, dropped, pending, fewest, most, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Cut the power at every byte of one append, after before records (some of
+// them sent), then reopen: the records committed before are all there, the
+// torn one is either missing or whole (its commit byte made it, the rest of
+// the header write failed), and the ring takes new records behind them
+bool checkPowerCut(uint32_t before, uint32_t sentBefore)
+{
+  const long appendBytes = FlashRing::sectorHeaderSize + 2 * FlashRing::recordHeaderSize + PAYLOAD;
+  uint32_t failed = 0;
+  uint32_t whole = 0;
+  bool ok = true;
+
+  for (long cut = 0; cut <= appendBytes && ok; cut++)
+  {
+    static Flash flash;
+    flash = Flash();
+    FlashRing ring(flash);
+
+    ok = ring.begin();
+    for (uint32_t i = 0; i < before && ok; i++)
+      ok = append(ring, i);
+    for (uint32_t i = 0; i < sentBefore && ok; i++)
+      ok = ring.pop();
+
+    flash.cutPowerAfter(cut);
+    const bool appended = append(ring, before);
+    flash.cutPowerAfter(-1);
+    failed += !appended;
+
+    const uint32_t committed = before - sentBefore + appended;
+    FlashRing reopened(flash);
+    ok &= reopened.begin();
+    const uint32_t kept = reopened.pending();
+    ok &= kept == committed || (!appended && kept == committed + 1);
+    ok &= peekIndex(reopened) == (kept > 0 ? (long) sentBefore : -1);
+    whole += kept > committed;
+
+    // written behind the torn record, found after another reset
+    for (uint32_t i = 0; i < 3 && ok; i++)
+      ok = append(reopened, 100 + i);
+
+    FlashRing again(flash);
+    ok &= again.begin() && again.pending() == kept + 3;
+    ok &= drain(again, sentBefore, kept) && drain(again, 100, 3) && again.pending() == 0;
+    ok &= append(again, 200) && peekIndex(again) == 200;
+    if (!ok)
+      printf("power cut after %ld bytes: ", cut);
+  }
+
+  printf("power cut in the append after %u records, %u sent: %ld cut points, %u failed appends, %u of them whole: %s\n",
+         before, sentBefore, appendBytes + 1, failed, whole, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Sequence number and send time of a batch frame
+uint32_t frameLong(const uint8_t *frame, uint8_t offset)
+{
+  return frame[offset] | frame[offset + 1] << 8 | frame[offset + 2] << 16 | (uint32_t) frame[offset + 3] << 24;
+}
+
+// Three batches stored before a reset, two after it and one more while they
+// drain: the first three flagged, all restamped with the drain's millis(),
+// none dropped before its PUBACK, the one in flight at a disconnect sent again
+bool checkBacklog()
+{
+  typedef TelemetryBatch<4> Batch;
+  static Flash flash;
+  Batch batch("board", "model");
+  uint8_t frame[Batch::maxFrameSize];
+  uint32_t now = 1000;
+
+  const auto store = [&](TelemetryBacklog &backlog) {
+    size_t length = 0;
+    batch.add(1, 1, 100, now);
+    const uint8_t *encoded = batch.encode(now, length);
+    return backlog.store(encoded, length);
+  };
+
+  FlashRing before(flash);
+  TelemetryBacklog stored(before);
+  bool ok = stored.begin();
+  for (uint8_t n = 0; n < 3; n++)
+    ok &= store(stored);
+
+  FlashRing ring(flash);
+  TelemetryBacklog backlog(ring);
+  ok &= backlog.begin() && backlog.pending() == 3;
+  ok &= store(backlog) && store(backlog);
+
+  uint32_t sequence = 0;
+  uint16_t packetId = 1;
+  uint8_t flagged = 0;
+  bool dropped = false;
+
+  while (ok && sequence < 6)
+  {
+    now += 5000;
+    ok &= backlog.next(frame, sizeof(frame), now) > 0;
+    ok &= frameLong(frame, 5) == sequence && frameLong(frame, 13) == now;
+    const bool earlier = (frame[1] & Batch::FLAG_EARLIER_BOOT) != 0;
+    ok &= earlier == (sequence < 3);
+
+    // the PUBACK may come before sent() is called
+    if (sequence == 4)
+      backlog.acknowledged(packetId);
+    backlog.sent(packetId);
+
+    if (sequence != 4)
+    {
+      // in flight: nothing more until its ack, another packet's ack doesn't count
+      backlog.acknowledged(packetId + 100);
+      ok &= backlog.waiting() && backlog.next(frame, sizeof(frame), now) == 0;
+
+      // the connection drops once: the same batch goes again
+      if (sequence == 1 && !dropped)
+      {
+        backlog.disconnected();
+        dropped = true;
+        packetId++;
+        continue;
+      }
+      backlog.acknowledged(packetId);
+    }
+
+    ok &= !backlog.waiting();
+    flagged += earlier;
+    packetId++;
+    if (sequence == 2)
+      ok &= store(backlog);
+    sequence++;
+  }
+
+  // the last one leaves on the next call
+  ok &= backlog.pending() == 1 && backlog.next(frame, sizeof(frame), now) == 0 && backlog.pending() == 0;
+
+  printf("telemetry backlog: %u batches sent, %u flagged from before the reset, one sent again: %s\n", sequence,
+         flagged, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main()
+{
+  bool ok = checkWraparound();
+  ok &= checkPowerCut(0, 0);
+  ok &= checkPowerCut(5, 2);
+  // the append opens the next sector
+  ok &= checkPowerCut(15, 0);
+  ok &= checkPowerCut(15, 15);
+  ok &= checkBacklog();
+
+  return ok ? 0 : 1;
+}
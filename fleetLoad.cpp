@@ -0,0 +1,1149 @@
+// Fleet load generator: simulates many boards publishing their telemetry to
+// the MQTT broker, to see how the broker and mqttReader.py cope with a fleet
+// instead of three boards. Every simulated board runs the firmware loop
+// (BENCHMARK_RUNS inferences, then LOOP_DELAY) with the firmware serializers
+// from lib/Telemetry, drawing inference times and results from the measured
+// "Processed results/<board>_<model>.csv". A subscriber on the same broker
+// times every batch from publish to delivery.
+//
+//   g++ -std=c++11 -O2 -Ilib/Telemetry fleetLoad.cpp -o fleetLoad
+//   ./fleetLoad --devices 10000 --host localhost --duration 300
+//
+// Boards are named <board>-<index> inside the batches, so mqttReader.py
+// tracks lost batches per simulated board. Linux only (epoll).
+
+#include <Telemetry.h>
+#include <TelemetryBatch.h>
+#include <LatencyHistogram.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+// Records a board can hold before it must publish, --batch is at most this
+#define MAX_BATCH_SIZE 255
+
+// AsyncMqttClient default, seconds
+#define KEEP_ALIVE 15
+
+// Seconds before a board that lost its connection tries again, as the sketches do
+#define RECONNECT_DELAY 2
+
+// Batches and QoS 1 publishes remembered per board for the latency lookups
+#define SENT_HISTORY 64
+
+// MQTT 3.1.1 packet types
+enum PacketType
+{
+  CONNECT = 1,
+  CONNACK = 2,
+  PUBLISH = 3,
+  PUBACK = 4,
+  SUBSCRIBE = 8,
+  SUBACK = 9,
+  PINGREQ = 12,
+  PINGRESP = 13,
+};
+
+struct Options
+{
+  std::string host = "localhost";
+  int port = 1883;
+  std::string username = "federico";
+  std::string password = "iotexamdemo";
+  uint32_t devices = 3;
+  std::vector<std::string> boards = {"esp32dev", "esp32wemos", "esp8266"};
+  std::vector<std::string> models = {"digits", "sin", "wine"};
+  std::string results = "Processed results";
+  uint32_t duration = 60;
+  uint32_t loopDelay = 5000;
+  uint32_t runs = 10;
+  uint32_t batch = 50;
+  uint32_t flushInterval = 60000;
+  float speedup = 1;
+  uint8_t qos = 1;
+  bool json = false;
+  uint32_t ramp = 500;
+  uint32_t report = 10;
+  uint32_t drain = 10;
+};
+
+// Microseconds on a monotonic clock
+static uint64_t now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Inference results and times measured on one board for one model
+class LatencySamples
+{
+  public:
+  struct Sample
+  {
+    float result;
+    uint32_t microseconds;
+  };
+
+  LatencySamples()
+  {
+    floatResults = false;
+  }
+
+  /**
+   * Read a CSV written by mqttReader.py, ';' or ',' separated
+   * @return false if the file is missing or has no samples
+   */
+  bool load(const std::string &path)
+  {
+    std::ifstream file(path);
+    std::string line;
+
+    if (!file || !std::getline(file, line))
+      return false;
+
+    const char separator = line.find(';') != std::string::npos ? ';' : ',';
+    const std::vector<std::string> header = split(line, separator);
+    int resultColumn = -1;
+    int microsecondsColumn = -1;
+
+    for (size_t i = 0; i < header.size(); i++)
+    {
+      if (header[i] == "result")
+        resultColumn = i;
+      else if (header[i] == "microseconds")
+        microsecondsColumn = i;
+    }
+
+    if (resultColumn < 0 || microsecondsColumn < 0)
+      return false;
+
+    while (std::getline(file, line))
+    {
+      const std::vector<std::string> fields = split(line, separator);
+      if ((int) fields.size() <= std::max(resultColumn, microsecondsColumn))
+        continue;
+
+      Sample sample;
+      sample.result = strtof(fields[resultColumn].c_str(), NULL);
+      sample.microseconds = strtoul(fields[microsecondsColumn].c_str(), NULL, 10);
+      if (fields[resultColumn].find('.') != std::string::npos)
+        floatResults = true;
+      samples.push_back(sample);
+    }
+
+    return !samples.empty();
+  }
+
+  const Sample &pick(std::mt19937 &random) const
+  {
+    return samples[random() % samples.size()];
+  }
+
+  bool isFloat() const
+  {
+    return floatResults;
+  }
+
+  size_t size() const
+  {
+    return samples.size();
+  }
+
+  protected:
+  std::vector<Sample> samples;
+  bool floatResults;
+
+  static std::vector<std::string> split(const std::string &line, char separator)
+  {
+    std::vector<std::string> fields;
+    size_t start = 0;
+
+    while (true)
+    {
+      size_t end = line.find(separator, start);
+      std::string field = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+      if (!field.empty() && field.back() == '\r')
+        field.pop_back();
+      fields.push_back(field);
+      if (end == std::string::npos)
+        return fields;
+      start = end + 1;
+    }
+  }
+};
+
+// Counters over a report window and over the whole run, latencies in
+// microseconds up to ~67 s
+struct Stats
+{
+  typedef LatencyHistogram<4, 26> Histogram;
+
+  uint64_t sent = 0;
+  uint64_t acked = 0;
+  uint64_t delivered = 0;
+  uint64_t records = 0;
+  uint64_t deliveredRecords = 0;
+  uint64_t lost = 0;
+  uint64_t disconnects = 0;
+  Histogram ack;
+  Histogram endToEnd;
+
+  void reset()
+  {
+    *this = Stats();
+  }
+};
+
+Stats window;
+Stats total;
+volatile sig_atomic_t interrupted = 0;
+
+// One MQTT connection on a non-blocking socket, driven by the epoll loop
+class MqttConnection
+{
+  public:
+  enum State
+  {
+    CLOSED,
+    CONNECTING,
+    HANDSHAKE,
+    CONNECTED,
+  };
+
+  MqttConnection()
+  {
+    fd = -1;
+    epoll = -1;
+    state = CLOSED;
+    nextPacketId = 0;
+    lastSent = 0;
+    watchingOutput = false;
+  }
+
+  virtual ~MqttConnection()
+  {
+    close();
+  }
+
+  bool open(int epollFd, const sockaddr_storage &address, socklen_t addressLength, const std::string &clientId, const Options &options)
+  {
+    epoll = epollFd;
+    fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+      return false;
+
+    const int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (connect(fd, (const sockaddr *) &address, addressLength) < 0 && errno != EINPROGRESS)
+    {
+      ::close(fd);
+      fd = -1;
+      return false;
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.ptr = this;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    watchingOutput = true;
+
+    in.clear();
+    out.clear();
+    state = CONNECTING;
+
+    // protocol name, level 4, flags: username, password, clean session
+    std::string body;
+    putString(body, "MQTT");
+    body += (char) 4;
+    body += (char) 0xC2;
+    body += (char) (KEEP_ALIVE >> 8);
+    body += (char) (KEEP_ALIVE & 0xFF);
+    putString(body, clientId);
+    putString(body, options.username);
+    putString(body, options.password);
+    send(CONNECT, 0, body);
+    return true;
+  }
+
+  void close()
+  {
+    if (fd < 0)
+      return;
+    epoll_ctl(epoll, EPOLL_CTL_DEL, fd, NULL);
+    ::close(fd);
+    fd = -1;
+    state = CLOSED;
+  }
+
+  bool connected() const
+  {
+    return state == CONNECTED;
+  }
+
+  State getState() const
+  {
+    return state;
+  }
+
+  /**
+   * @return the packet id for QoS 1, 0 for QoS 0
+   */
+  uint16_t publish(const std::string &topic, const uint8_t *payload, size_t length, uint8_t qos, bool retain)
+  {
+    std::string body;
+    uint16_t packetId = 0;
+
+    putString(body, topic);
+    if (qos > 0)
+    {
+      packetId = nextId();
+      body += (char) (packetId >> 8);
+      body += (char) (packetId & 0xFF);
+    }
+    body.append((const char *) payload, length);
+    send(PUBLISH, (qos << 1) | (retain ? 1 : 0), body);
+    return packetId;
+  }
+
+  void subscribe(const std::string &topic, uint8_t qos)
+  {
+    std::string body;
+    const uint16_t packetId = nextId();
+
+    body += (char) (packetId >> 8);
+    body += (char) (packetId & 0xFF);
+    putString(body, topic);
+    body += (char) qos;
+    send(SUBSCRIBE, 0x02, body);
+  }
+
+  void ping()
+  {
+    send(PINGREQ, 0, std::string());
+  }
+
+  uint64_t getLastSent() const
+  {
+    return lastSent;
+  }
+
+  void onEvent(uint32_t events)
+  {
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+      fail();
+      return;
+    }
+
+    if ((events & EPOLLOUT) && state == CONNECTING)
+    {
+      int error = 0;
+      socklen_t length = sizeof(error);
+      getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+      if (error != 0)
+      {
+        fail();
+        return;
+      }
+      state = HANDSHAKE;
+    }
+
+    if (events & EPOLLOUT)
+      flush();
+
+    if ((events & EPOLLIN) && fd >= 0)
+      receive();
+  }
+
+  protected:
+  int fd;
+  int epoll;
+  State state;
+  std::string in;
+  std::string out;
+  uint16_t nextPacketId;
+  uint64_t lastSent;
+  bool watchingOutput;
+
+  virtual void onConnected() {}
+  virtual void onClosed() {}
+  virtual void onPublish(const std::string &, const uint8_t *, size_t) {}
+  virtual void onAck(uint16_t) {}
+
+  uint16_t nextId()
+  {
+    nextPacketId = nextPacketId % 65535 + 1;
+    return nextPacketId;
+  }
+
+  static void putString(std::string &body, const std::string &value)
+  {
+    body += (char) (value.size() >> 8);
+    body += (char) (value.size() & 0xFF);
+    body += value;
+  }
+
+  void send(uint8_t type, uint8_t flags, const std::string &body)
+  {
+    if (fd < 0)
+      return;
+
+    out += (char) (type << 4 | flags);
+    size_t length = body.size();
+    do
+    {
+      uint8_t byte = length % 128;
+      length /= 128;
+      out += (char) (length > 0 ? byte | 0x80 : byte);
+    } while (length > 0);
+    out += body;
+
+    lastSent = now();
+    if (state != CONNECTING)
+      flush();
+  }
+
+  void flush()
+  {
+    while (!out.empty())
+    {
+      const ssize_t written = ::send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+      if (written < 0)
+      {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        fail();
+        return;
+      }
+      out.erase(0, written);
+    }
+
+    // only wait for the socket to drain when something is pending
+    const bool wantOutput = !out.empty() || state == CONNECTING;
+    if (wantOutput != watchingOutput)
+    {
+      epoll_event event;
+      event.events = wantOutput ? EPOLLIN | EPOLLOUT : EPOLLIN;
+      event.data.ptr = this;
+      epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event);
+      watchingOutput = wantOutput;
+    }
+  }
+
+  void receive()
+  {
+    char buffer[16384];
+
+    while (true)
+    {
+      const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+      if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      if (received <= 0)
+      {
+        fail();
+        return;
+      }
+      in.append(buffer, received);
+    }
+
+    size_t offset = 0;
+    while (fd >= 0 && in.size() - offset >= 2)
+    {
+      size_t length = 0;
+      size_t multiplier = 1;
+      size_t position = offset + 1;
+      bool complete = false;
+
+      while (position < in.size() && position - offset <= 4)
+      {
+        const uint8_t byte = in[position++];
+        length += (byte & 0x7F) * multiplier;
+        multiplier *= 128;
+        if (!(byte & 0x80))
+        {
+          complete = true;
+          break;
+        }
+      }
+
+      if (!complete || in.size() - position < length)
+        break;
+
+      dispatch((uint8_t) in[offset] >> 4, (uint8_t) in[offset] & 0x0F, (const uint8_t *) in.data() + position, length);
+      offset = position + length;
+    }
+
+    if (fd >= 0)
+      in.erase(0, offset);
+  }
+
+  void dispatch(uint8_t type, uint8_t flags, const uint8_t *body, size_t length)
+  {
+    switch (type)
+    {
+      case CONNACK:
+        if (length < 2 || body[1] != 0)
+        {
+          fprintf(stderr, "Connection refused, code %d\n", length < 2 ? -1 : body[1]);
+          fail();
+          return;
+        }
+        state = CONNECTED;
+        onConnected();
+        break;
+      case PUBLISH:
+      {
+        const uint8_t qos = (flags >> 1) & 0x03;
+        const size_t topicLength = body[0] << 8 | body[1];
+        size_t offset = 2 + topicLength;
+        const std::string topic((const char *) body + 2, topicLength);
+
+        if (qos > 0)
+        {
+          std::string ack((const char *) body + offset, 2);
+          offset += 2;
+          send(PUBACK, 0, ack);
+        }
+        onPublish(topic, body + offset, length - offset);
+        break;
+      }
+      case PUBACK:
+        if (length >= 2)
+          onAck(body[0] << 8 | body[1]);
+        break;
+      default:
+        break;
+    }
+  }
+
+  void fail()
+  {
+    const bool wasOpen = fd >= 0;
+    close();
+    if (wasOpen)
+      onClosed();
+  }
+};
+
+// A simulated board: the benchmark loop of the sketches, with the inference
+// times drawn from the measured ones
+class Device: public MqttConnection
+{
+  public:
+  Device(uint32_t index, const std::string &boardType, const std::string &modelName, const LatencySamples &measured, const Options &options)
+  : board(boardType), name(boardType + "-" + pad(index)), model(modelName), batch(name.c_str(), model.c_str()), record(name.c_str(), model.c_str()),
+    samples(measured), settings(options), random(index)
+  {
+    id = index;
+    iteration = 0;
+    boot = now();
+    nextLoop = 0;
+    reconnectAt = 0;
+    batch.setFlush(options.batch, options.flushInterval);
+    for (uint32_t i = 0; i < SENT_HISTORY; i++)
+      sent[i].key = acks[i].key = UINT32_MAX;
+  }
+
+  const std::string &getName() const
+  {
+    return name;
+  }
+
+  /**
+   * Run what is due: the benchmark loop, a keep alive or a reconnection
+   * @return when to wake this board again
+   */
+  uint64_t wake(uint64_t time, std::function<bool(Device &)> reconnect)
+  {
+    if (getState() == CLOSED)
+    {
+      if (time < reconnectAt)
+        return reconnectAt;
+      if (!reconnect(*this))
+      {
+        reconnectAt = time + RECONNECT_DELAY * 1000000ull;
+        return reconnectAt;
+      }
+      nextLoop = std::max(nextLoop, time);
+    }
+
+    if (time >= nextLoop)
+      nextLoop = time + runLoop(time);
+
+    if (connected() && time - getLastSent() >= KEEP_ALIVE * 1000000ull / 2)
+      ping();
+
+    return std::min<uint64_t>(nextLoop, getLastSent() + KEEP_ALIVE * 1000000ull / 2);
+  }
+
+  void startAt(uint64_t time)
+  {
+    nextLoop = time;
+  }
+
+  /**
+   * When a batch (or with --json an iteration) was published, 0 if unknown
+   */
+  uint64_t sentAt(uint32_t key) const
+  {
+    const Sent &entry = sent[key % SENT_HISTORY];
+    return entry.key == key ? entry.time : 0;
+  }
+
+  protected:
+  struct Sent
+  {
+    uint32_t key;
+    uint64_t time;
+  };
+
+  std::string board;
+  std::string name;
+  std::string model;
+  TelemetryBatch<MAX_BATCH_SIZE> batch;
+  TelemetryRecord<> record;
+  const LatencySamples &samples;
+  const Options &settings;
+  std::mt19937 random;
+  uint32_t id;
+  uint32_t iteration;
+  uint64_t boot;
+  uint64_t nextLoop;
+  uint64_t reconnectAt;
+  Sent sent[SENT_HISTORY];
+  Sent acks[SENT_HISTORY];
+
+  static std::string pad(uint32_t index)
+  {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%05u", index);
+    return buffer;
+  }
+
+  // millis() of the board, in simulated time
+  uint32_t millis(uint64_t time) const
+  {
+    return (uint32_t) ((time - boot) * settings.speedup / 1000);
+  }
+
+  // One loop() of a sketch, returns its length in real microseconds
+  uint64_t runLoop(uint64_t time)
+  {
+    if (!connected())
+      return (uint64_t) (settings.loopDelay * 1000 / settings.speedup);
+
+    uint64_t busy = 0;
+
+    for (uint32_t i = 0; i < settings.runs; i++)
+    {
+      const LatencySamples::Sample &sample = samples.pick(random);
+      busy += sample.microseconds;
+      iteration++;
+
+      const uint32_t deviceMillis = millis(time) + busy / 1000;
+
+      if (settings.json)
+      {
+        publishRecord(time, sample);
+        continue;
+      }
+
+      if (samples.isFloat())
+        batch.add(sample.result, iteration, sample.microseconds, deviceMillis);
+      else
+        batch.add((int) sample.result, iteration, sample.microseconds, deviceMillis);
+
+      if (batch.shouldFlush(deviceMillis))
+        publishBatch(time, deviceMillis);
+    }
+
+    return (uint64_t) ((busy + settings.loopDelay * 1000ull) / settings.speedup);
+  }
+
+  void publishBatch(uint64_t time, uint32_t deviceMillis)
+  {
+    size_t length;
+    const uint8_t records = batch.size();
+    const uint8_t *frame = batch.encode(deviceMillis, length);
+
+    if (frame == NULL)
+      return;
+
+    remember(sent, batch.getSequence() - 1, time);
+    track(publish("iotdemo." + board + ".batch", frame, length, settings.qos, false), time);
+    window.records += records;
+    total.records += records;
+  }
+
+  // TELEMETRY_BATCH_SIZE 0: one retained JSON message per inference
+  void publishRecord(uint64_t time, const LatencySamples::Sample &sample)
+  {
+    char buffer[128];
+
+    if (samples.isFloat())
+      record.setResult(sample.result);
+    else
+      record.setResult((int) sample.result);
+    record.setIteration(iteration);
+    record.setMicroseconds(sample.microseconds);
+
+    const size_t length = record.toJson(buffer, sizeof(buffer));
+    if (length == 0)
+      return;
+    remember(sent, iteration, time);
+    track(publish("iotdemo." + board, (const uint8_t *) buffer, length, settings.qos, true), time);
+    window.records++;
+    total.records++;
+  }
+
+  void track(uint16_t packetId, uint64_t time)
+  {
+    window.sent++;
+    total.sent++;
+    if (packetId != 0)
+      remember(acks, packetId, time);
+  }
+
+  static void remember(Sent *history, uint32_t key, uint64_t time)
+  {
+    history[key % SENT_HISTORY].key = key;
+    history[key % SENT_HISTORY].time = time;
+  }
+
+  virtual void onAck(uint16_t packetId)
+  {
+    Sent &entry = acks[packetId % SENT_HISTORY];
+    if (entry.key != packetId)
+      return;
+
+    const uint32_t latency = now() - entry.time;
+    entry.key = UINT32_MAX;
+    window.acked++;
+    total.acked++;
+    window.ack.record(latency);
+    total.ack.record(latency);
+  }
+
+  virtual void onClosed()
+  {
+    window.disconnects++;
+    total.disconnects++;
+    reconnectAt = now() + RECONNECT_DELAY * 1000000ull;
+  }
+};
+
+// Receives what the fleet publishes, like mqttReader.py, and matches every
+// message with the board that sent it
+class Collector: public MqttConnection
+{
+  public:
+  Collector(std::vector<Device *> &fleet, const Options &options)
+  : devices(fleet), settings(options), lastSequences(fleet.size(), -1) {}
+
+  protected:
+  std::vector<Device *> &devices;
+  const Options &settings;
+  std::vector<int64_t> lastSequences;
+
+  virtual void onConnected()
+  {
+    for (size_t i = 0; i < settings.boards.size(); i++)
+      subscribe("iotdemo." + settings.boards[i] + (settings.json ? "" : ".batch"), 1);
+  }
+
+  virtual void onClosed()
+  {
+    fprintf(stderr, "Collector disconnected, end-to-end figures stop here\n");
+  }
+
+  virtual void onPublish(const std::string &, const uint8_t *payload, size_t length)
+  {
+    const uint64_t time = now();
+    uint32_t index;
+    uint32_t key;
+    uint32_t records = 1;
+
+    if (settings.json ? !parseRecord(payload, length, index, key) : !parseBatch(payload, length, index, key, records))
+      return;
+
+    window.delivered++;
+    total.delivered++;
+    window.deliveredRecords += records;
+    total.deliveredRecords += records;
+
+    // a gap in the batch sequence of a board is a lost batch
+    if (!settings.json)
+    {
+      if (lastSequences[index] >= 0 && key > lastSequences[index] + 1)
+      {
+        window.lost += key - lastSequences[index] - 1;
+        total.lost += key - lastSequences[index] - 1;
+      }
+      lastSequences[index] = key;
+    }
+
+    const uint64_t sentAt = devices[index]->sentAt(key);
+    if (sentAt == 0)
+      return;
+
+    window.endToEnd.record(time - sentAt);
+    total.endToEnd.record(time - sentAt);
+  }
+
+  // Board index from a "<board>-<index>" name
+  bool findDevice(const char *name, size_t length, uint32_t &index) const
+  {
+    const char *dash = (const char *) memrchr(name, '-', length);
+    if (dash == NULL)
+      return false;
+
+    index = strtoul(std::string(dash + 1, name + length - dash - 1).c_str(), NULL, 10);
+    return index < devices.size() && devices[index]->getName().compare(0, std::string::npos, name, length) == 0;
+  }
+
+  bool parseBatch(const uint8_t *payload, size_t length, uint32_t &index, uint32_t &sequence, uint32_t &records) const
+  {
+    if (length < TelemetryBatch<MAX_BATCH_SIZE>::headerSize || payload[0] != TelemetryBatch<MAX_BATCH_SIZE>::VERSION)
+      return false;
+
+    const uint8_t boardLength = payload[3];
+    if (length < TelemetryBatch<MAX_BATCH_SIZE>::headerSize + boardLength)
+      return false;
+
+    records = payload[2];
+    sequence = payload[5] | payload[6] << 8 | payload[7] << 16 | (uint32_t) payload[8] << 24;
+    return findDevice((const char *) payload + TelemetryBatch<MAX_BATCH_SIZE>::headerSize, boardLength, index);
+  }
+
+  bool parseRecord(const uint8_t *payload, size_t length, uint32_t &index, uint32_t &iteration) const
+  {
+    const std::string json((const char *) payload, length);
+    const size_t board = json.find("\"board\":\"");
+    const size_t iterationField = json.find("\"iteration\":");
+
+    if (board == std::string::npos || iterationField == std::string::npos)
+      return false;
+
+    const size_t nameStart = board + 9;
+    const size_t nameEnd = json.find('"', nameStart);
+    if (nameEnd == std::string::npos)
+      return false;
+
+    iteration = strtoul(json.c_str() + iterationField + 12, NULL, 10);
+    return findDevice(json.c_str() + nameStart, nameEnd - nameStart, index);
+  }
+};
+
+static void usage()
+{
+  printf("Usage: fleetLoad [options]\n"
+         "  --host HOST            broker (localhost)\n"
+         "  --port PORT            broker port (1883)\n"
+         "  --username NAME        (federico)\n"
+         "  --password PASSWORD    (iotexamdemo)\n"
+         "  --devices N            simulated boards (3)\n"
+         "  --boards A,B           board types, round robin (esp32dev,esp32wemos,esp8266)\n"
+         "  --models A,B           models, round robin per board type (digits,sin,wine)\n"
+         "  --results DIR          measured latencies, <board>_<model>.csv (Processed results)\n"
+         "  --duration S           seconds of load (60)\n"
+         "  --loop-delay MS        LOOP_DELAY of the sketches (5000)\n"
+         "  --runs N               BENCHMARK_RUNS (10)\n"
+         "  --batch N              TELEMETRY_BATCH_SIZE, at most %d (50)\n"
+         "  --flush-interval MS    TELEMETRY_FLUSH_INTERVAL (60000)\n"
+         "  --json                 one JSON message per inference, as TELEMETRY_BATCH_SIZE 0\n"
+         "  --qos N                0 or 1 (1)\n"
+         "  --speedup X            run the board clocks X times faster (1)\n"
+         "  --ramp N               new connections per second (500)\n"
+         "  --report S             seconds between reports (10)\n"
+         "  --drain S              seconds to wait for late deliveries at the end (10)\n",
+         MAX_BATCH_SIZE);
+}
+
+static std::vector<std::string> splitList(const std::string &list)
+{
+  std::vector<std::string> items;
+  size_t start = 0;
+
+  while (start <= list.size())
+  {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos)
+      end = list.size();
+    if (end > start)
+      items.push_back(list.substr(start, end - start));
+    start = end + 1;
+  }
+  return items;
+}
+
+static bool parseOptions(int argc, char **argv, Options &options)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const std::string option = argv[i];
+
+    if (option == "--json")
+    {
+      options.json = true;
+      continue;
+    }
+    if (option == "--help" || i + 1 >= argc)
+      return false;
+
+    const std::string value = argv[++i];
+    if (option == "--host")
+      options.host = value;
+    else if (option == "--port")
+      options.port = atoi(value.c_str());
+    else if (option == "--username")
+      options.username = value;
+    else if (option == "--password")
+      options.password = value;
+    else if (option == "--devices")
+      options.devices = strtoul(value.c_str(), NULL, 10);
+    else if (option == "--boards")
+      options.boards = splitList(value);
+    else if (option == "--models")
+      options.models = splitList(value);
+    else if (option == "--results")
+      options.results = value;
+    else if (option == "--duration")
+      options.duration = strtoul(value.c_str(), NULL, 10);
+    else if (option == "--loop-delay")
+      options.loopDelay = strtoul(value.c_str(), NULL, 10);
+    else if (option == "--runs")
+      options.runs = strtoul(value.c_str(), NULL, 10);
+    else if (option == "--batch")
+      options.batch = strtoul(value.c_str(), NULL, 10);
+    else if (option == "--flush-interval")
+      options.flushInterval = strtoul(value.c_str(), NULL, 10);
+    else if (option == "--qos")
+      options.qos = atoi(value.c_str());
+    else if (option == "--speedup")
+      options.speedup = atof(value.c_str());
+    else if (option == "--ramp")
+      options.ramp = strtoul(value.c_str(), NULL, 10);
+    else if (option == "--report")
+      options.report = strtoul(value.c_str(), NULL, 10);
+    else if (option == "--drain")
+      options.drain = strtoul(value.c_str(), NULL, 10);
+    else
+      return false;
+  }
+
+  return !options.boards.empty() && !options.models.empty() && options.batch >= 1 && options.batch <= MAX_BATCH_SIZE &&
+         options.qos <= 1 && options.speedup > 0 && options.ramp > 0 && options.report > 0;
+}
+
+static void printLatency(const char *label, const Stats::Histogram &histogram)
+{
+  if (histogram.count() == 0)
+  {
+    printf("  %s -", label);
+    return;
+  }
+  printf("  %s p50 %.1f p99 %.1f max %.1f ms", label, histogram.percentile(50) / 1000.0, histogram.percentile(99) / 1000.0,
+         histogram.max() / 1000.0);
+}
+
+static void printWindow(double elapsed, double seconds, uint32_t connected, uint32_t devices)
+{
+  printf("%7.1f s  %u/%u connected  sent %.1f/s  acked %.1f/s  delivered %.1f/s  records %.0f/s  lost %llu", elapsed, connected,
+         devices, window.sent / seconds, window.acked / seconds, window.delivered / seconds, window.deliveredRecords / seconds,
+         (unsigned long long) window.lost);
+  printLatency("puback", window.ack);
+  printLatency("end-to-end", window.endToEnd);
+  printf("\n");
+  fflush(stdout);
+}
+
+static void printTotal(const Stats::Histogram &histogram, const char *label)
+{
+  if (histogram.count() == 0)
+  {
+    printf("%-11s no samples\n", label);
+    return;
+  }
+  printf("%-11s count %u  min %.1f  mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f ms\n", label, histogram.count(),
+         histogram.min() / 1000.0, histogram.mean() / 1000.0, histogram.percentile(50) / 1000.0, histogram.percentile(90) / 1000.0,
+         histogram.percentile(99) / 1000.0, histogram.percentile(99.9f) / 1000.0, histogram.max() / 1000.0);
+}
+
+static void onSignal(int)
+{
+  interrupted = 1;
+}
+
+int main(int argc, char **argv)
+{
+  Options options;
+
+  if (!parseOptions(argc, argv, options))
+  {
+    usage();
+    return 2;
+  }
+
+  // measured latencies of every board and model pair in use
+  std::vector<LatencySamples> samples(options.boards.size() * options.models.size());
+  for (size_t b = 0; b < options.boards.size(); b++)
+  {
+    for (size_t m = 0; m < options.models.size(); m++)
+    {
+      const std::string path = options.results + "/" + options.boards[b] + "_" + options.models[m] + ".csv";
+      if (!samples[b * options.models.size() + m].load(path))
+      {
+        fprintf(stderr, "No latencies in %s\n", path.c_str());
+        return 1;
+      }
+    }
+  }
+
+  // one socket per board
+  rlimit limit;
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  if (limit.rlim_cur < options.devices + 16)
+    fprintf(stderr, "Open file limit %llu is below the fleet size, raise ulimit -n\n", (unsigned long long) limit.rlim_cur);
+
+  addrinfo hints;
+  addrinfo *resolved;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(options.host.c_str(), std::to_string(options.port).c_str(), &hints, &resolved) != 0)
+  {
+    fprintf(stderr, "Cannot resolve %s\n", options.host.c_str());
+    return 1;
+  }
+  sockaddr_storage address;
+  const socklen_t addressLength = resolved->ai_addrlen;
+  memcpy(&address, resolved->ai_addr, resolved->ai_addrlen);
+  freeaddrinfo(resolved);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  const int epoll = epoll_create1(0);
+
+  // boards take the types round robin, and each type the models round robin
+  std::vector<Device *> devices;
+  for (uint32_t i = 0; i < options.devices; i++)
+  {
+    const size_t b = i % options.boards.size();
+    const size_t m = (i / options.boards.size()) % options.models.size();
+    devices.push_back(new Device(i, options.boards[b], options.models[m], samples[b * options.models.size() + m], options));
+  }
+
+  Collector collector(devices, options);
+  if (!collector.open(epoll, address, addressLength, "fleetLoadCollector", options))
+  {
+    fprintf(stderr, "Cannot connect to %s:%d\n", options.host.c_str(), options.port);
+    return 1;
+  }
+
+  std::function<bool(Device &)> reconnect = [&](Device &device) {
+    return device.open(epoll, address, addressLength, "fleetLoad-" + device.getName(), options);
+  };
+
+  typedef std::pair<uint64_t, uint32_t> Wake;
+  std::priority_queue<Wake, std::vector<Wake>, std::greater<Wake> > wakes;
+  std::mt19937 random(1);
+
+  const uint64_t start = now();
+  const uint64_t loadEnd = start + options.duration * 1000000ull;
+  const uint64_t end = loadEnd + options.drain * 1000000ull;
+  const uint64_t loopLength = (uint64_t) (options.loopDelay * 1000ull / options.speedup);
+  uint64_t lastReport = start;
+  uint32_t started = 0;
+
+  printf("%u boards on %s:%d, %s, QoS %u, loop every %u ms (x%.1f), %u runs per loop\n", options.devices, options.host.c_str(),
+         options.port, options.json ? "one JSON message per inference" : "binary batches", options.qos, options.loopDelay,
+         options.speedup, options.runs);
+
+  epoll_event events[256];
+
+  while (!interrupted)
+  {
+    const uint64_t time = now();
+    if (time >= end)
+      break;
+
+    // connections are opened at the ramp rate, then start at a random point of their loop
+    const uint64_t due = std::min<uint64_t>(options.devices, (time - start) * options.ramp / 1000000 + 1);
+    for (; started < due && time < loadEnd; started++)
+    {
+      Device &device = *devices[started];
+      if (!reconnect(device))
+        fprintf(stderr, "Cannot open a socket for %s\n", device.getName().c_str());
+      device.startAt(time + random() % (loopLength + 1));
+      wakes.push(Wake(time, started));
+    }
+
+    // the boards stop their loops at the end of the load, the collector keeps reading
+    while (!wakes.empty() && wakes.top().first <= time && time < loadEnd)
+    {
+      const uint32_t index = wakes.top().second;
+      wakes.pop();
+      wakes.push(Wake(devices[index]->wake(time, reconnect), index));
+    }
+
+    if (time - lastReport >= options.report * 1000000ull)
+    {
+      uint32_t connected = 0;
+      for (size_t i = 0; i < devices.size(); i++)
+        connected += devices[i]->connected();
+      printWindow((time - start) / 1e6, (time - lastReport) / 1e6, connected, options.devices);
+      window.reset();
+      lastReport = time;
+    }
+
+    int timeout = 100;
+    if (!wakes.empty() && time < loadEnd)
+      timeout = std::min<int64_t>(timeout, std::max<int64_t>(0, ((int64_t) wakes.top().first - (int64_t) time) / 1000));
+    if (started < options.devices)
+      timeout = std::min(timeout, 10);
+
+    const int ready = epoll_wait(epoll, events, 256, timeout);
+    for (int i = 0; i < ready; i++)
+      ((MqttConnection *) events[i].data.ptr)->onEvent(events[i].events);
+  }
+
+  const double seconds = std::min(now(), loadEnd) > start ? (std::min(now(), loadEnd) - start) / 1e6 : 1;
+
+  printf("\nSent %llu messages (%llu records), %.1f/s over %.0f s of load\n", (unsigned long long) total.sent,
+         (unsigned long long) total.records, total.sent / seconds, seconds);
+  printf("Acked %llu, delivered %llu (%llu records), lost %llu by sequence, %llu disconnects\n", (unsigned long long) total.acked,
+         (unsigned long long) total.delivered, (unsigned long long) total.deliveredRecords, (unsigned long long) total.lost,
+         (unsigned long long) total.disconnects);
+  printTotal(total.ack, "puback");
+  printTotal(total.endToEnd, "end-to-end");
+
+  for (size_t i = 0; i < devices.size(); i++)
+    delete devices[i];
+  collector.close();
+  ::close(epoll);
+  return 0;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include <LogQueue.h>
+
+#if defined(ESP8266) || defined(ESP32)
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+// Cycle counter and clock of the running CPU. On the Xtensa cores (ESP32 and
+// ESP8266) this is the CCOUNT special register, one tick per CPU cycle; on the
+// host nanoseconds stand in for cycles so the runner can be tried there.
+class CycleCounter
+{
+  public:
+  static inline uint32_t now()
+  {
+#if defined(ESP8266) || defined(ESP32)
+    uint32_t ccount;
+    asm volatile("rsr %0, ccount" : "=r"(ccount));
+    return ccount;
+#else
+    return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  static uint32_t cyclesPerMicrosecond()
+  {
+#if defined(ESP8266) || defined(ESP32)
+    return ESP.getCpuFreqMHz();
+#else
+    return 1000;
+#endif
+  }
+};
+
+// Masks interrupts on the calling core while timing, so WiFi and timer
+// handlers don't land inside a measurement. Keep the masked region short:
+// the interrupt watchdog fires after a few hundred milliseconds.
+class InterruptMask
+{
+  public:
+  void lock()
+  {
+#if defined(ESP8266)
+    savedLevel = xt_rsil(15);
+#elif defined(ESP32)
+    portENTER_CRITICAL(&mux);
+#endif
+  }
+
+  void unlock()
+  {
+#if defined(ESP8266)
+    xt_wsr_ps(savedLevel);
+#elif defined(ESP32)
+    portEXIT_CRITICAL(&mux);
+#endif
+  }
+
+  protected:
+#if defined(ESP8266)
+  uint32_t savedLevel;
+#elif defined(ESP32)
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+};
+
+// Summary of the measured runs, in cycles
+struct BenchmarkStats
+{
+  uint16_t count;
+  uint32_t cyclesPerMicrosecond;
+  uint32_t min;
+  uint32_t median;
+  uint32_t p95;
+  uint32_t p99;
+  uint32_t max;
+  float mean;
+  float stddev;
+
+  float toMicroseconds(float cycles) const
+  {
+    return cycles / cyclesPerMicrosecond;
+  }
+
+  // The summary in microseconds as one deferred log line
+  void log() const
+  {
+    LOG_INFO("Latency over %u runs at %u MHz (us): min %.1f, median %.1f, p95 %.1f, p99 %.1f, max %.1f, mean %.1f, stddev %.1f",
+             count, cyclesPerMicrosecond, toMicroseconds(min), toMicroseconds(median), toMicroseconds(p95),
+             toMicroseconds(p99), toMicroseconds(max), toMicroseconds(mean), toMicroseconds(stddev));
+  }
+
+#ifdef ARDUINO
+  void print(Print &out) const
+  {
+    out.print("Cycles over ");
+    out.print(count);
+    out.print(" runs at ");
+    out.print(cyclesPerMicrosecond);
+    out.println(" MHz:");
+    printLine(out, "  min     ", min);
+    printLine(out, "  median  ", median);
+    printLine(out, "  p95     ", p95);
+    printLine(out, "  p99     ", p99);
+    printLine(out, "  max     ", max);
+    printLine(out, "  mean    ", mean);
+    printLine(out, "  stddev  ", stddev);
+  }
+
+  void printLine(Print &out, const char *label, float cycles) const
+  {
+    out.print(label);
+    out.print((uint32_t) cycles);
+    out.print(" (");
+    out.print(toMicroseconds(cycles));
+    out.println(" us)");
+  }
+#endif
+};
+
+// Runs warmupRuns untimed inferences, then runs timed ones, each timed in CPU
+// cycles. The function gets the run index (0..runs-1, warm-up runs reuse the
+// first indexes) and should contain only the work to measure: prints and
+// publishing belong after run().
+template<uint16_t runs>
+class Benchmark
+{
+  public:
+  Benchmark(uint16_t warmup = 0, bool maskInterrupts = false)
+  {
+    warmupRuns = warmup;
+    masked = maskInterrupts;
+    cyclesPerMicrosecond = 1;
+    for (uint16_t i = 0; i < runs; i++)
+      cycles[i] = 0;
+  }
+
+  template<typename Function>
+  void run(Function function)
+  {
+    cyclesPerMicrosecond = CycleCounter::cyclesPerMicrosecond();
+
+    for (uint16_t i = 0; i < warmupRuns; i++)
+      function(i % runs);
+
+    for (uint16_t i = 0; i < runs; i++)
+    {
+      if (masked)
+        mask.lock();
+
+      const uint32_t start = CycleCounter::now();
+      function(i);
+      cycles[i] = CycleCounter::now() - start;
+
+      if (masked)
+        mask.unlock();
+    }
+  }
+
+  uint32_t getCycles(uint16_t i) const
+  {
+    return cycles[i];
+  }
+
+  uint32_t getMicroseconds(uint16_t i) const
+  {
+    return (cycles[i] + cyclesPerMicrosecond / 2) / cyclesPerMicrosecond;
+  }
+
+  /**
+   * Order statistics use the nearest rank on a sorted copy of the runs
+   */
+  BenchmarkStats stats() const
+  {
+    uint32_t sorted[runs];
+    double sum = 0;
+
+    for (uint16_t i = 0; i < runs; i++)
+    {
+      uint32_t value = cycles[i];
+      uint16_t j = i;
+
+      // insertion sort, runs are few
+      for (; j > 0 && sorted[j - 1] > value; j--)
+        sorted[j] = sorted[j - 1];
+      sorted[j] = value;
+      sum += value;
+    }
+
+    BenchmarkStats stats;
+    stats.count = runs;
+    stats.cyclesPerMicrosecond = cyclesPerMicrosecond;
+    stats.min = sorted[0];
+    stats.median = sorted[rank(50)];
+    stats.p95 = sorted[rank(95)];
+    stats.p99 = sorted[rank(99)];
+    stats.max = sorted[runs - 1];
+    stats.mean = sum / runs;
+
+    double squares = 0;
+    for (uint16_t i = 0; i < runs; i++)
+      squares += (cycles[i] - stats.mean) * (cycles[i] - stats.mean);
+    stats.stddev = runs > 1 ? sqrt(squares / (runs - 1)) : 0;
+
+    return stats;
+  }
+
+  protected:
+  uint32_t cycles[runs];
+  uint16_t warmupRuns;
+  bool masked;
+  uint32_t cyclesPerMicrosecond;
+  InterruptMask mask;
+
+  // nearest rank percentile index
+  static uint16_t rank(uint8_t percentile)
+  {
+    uint16_t r = ((uint32_t) percentile * runs + 99) / 100;
+    return r == 0 ? 0 : r - 1;
+  }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <FS.h>
+#include "FlashDevice.h"
+
+// FlashDevice on a fixed size file in LittleFS / SPIFFS. The file system
+// already spreads its own writes; erase only rewrites the sector with 0xFF.
+class FileFlash: public FlashDevice
+{
+  public:
+  FileFlash(fs::FS &fileSystem, const char *filePath, uint16_t sectors, uint32_t bytesPerSector = 4096)
+    :fs(fileSystem)
+  {
+    path = filePath;
+    count = sectors;
+    size = bytesPerSector;
+  }
+
+  /**
+   * Create the file, blank, if it is missing or has the wrong size
+   */
+  bool begin()
+  {
+    File file = fs.open(path, "r");
+    const bool ready = file && file.size() == (size_t) count * size;
+    if (file)
+      file.close();
+
+    if (ready)
+      return true;
+
+    file = fs.open(path, "w");
+    if (!file)
+      return false;
+    file.close();
+
+    for (uint16_t s = 0; s < count; s++)
+      if (!fill(s))
+        return false;
+
+    return true;
+  }
+
+  virtual uint32_t sectorSize() const
+  {
+    return size;
+  }
+
+  virtual uint16_t sectorCount() const
+  {
+    return count;
+  }
+
+  virtual bool read(uint32_t address, void *data, size_t length)
+  {
+    File file = fs.open(path, "r");
+    if (!file)
+      return false;
+    const bool ok = file.seek(address) && file.read((uint8_t *) data, length) == length;
+    file.close();
+    return ok;
+  }
+
+  virtual bool write(uint32_t address, const void *data, size_t length)
+  {
+    File file = fs.open(path, "r+");
+    if (!file)
+      return false;
+    const bool ok = file.seek(address) && file.write((const uint8_t *) data, length) == length;
+    file.close();
+    return ok;
+  }
+
+  virtual bool erase(uint16_t sector)
+  {
+    return sector < count && fill(sector);
+  }
+
+  protected:
+  fs::FS &fs;
+  const char *path;
+  uint16_t count;
+  uint32_t size;
+
+  bool fill(uint16_t sector)
+  {
+    uint8_t blank[64];
+    memset(blank, 0xFF, sizeof(blank));
+
+    File file = fs.open(path, "r+");
+    if (!file || !file.seek((uint32_t) sector * size))
+      return false;
+
+    bool ok = true;
+    for (uint32_t done = 0; ok && done < size; done += sizeof(blank))
+      ok = file.write(blank, sizeof(blank)) == sizeof(blank);
+
+    file.close();
+    return ok;
+  }
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Sector erasable storage with NOR semantics: erase sets a sector to 0xFF,
+// write may only clear bits. Addresses are relative to the device start.
+class FlashDevice
+{
+  public:
+  virtual ~FlashDevice()
+  {
+  }
+
+  virtual uint32_t sectorSize() const = 0;
+  virtual uint16_t sectorCount() const = 0;
+  virtual bool read(uint32_t address, void *data, size_t length) = 0;
+  virtual bool write(uint32_t address, const void *data, size_t length) = 0;
+  virtual bool erase(uint16_t sector) = 0;
+};
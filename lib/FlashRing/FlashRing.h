@@ -0,0 +1,351 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "FlashDevice.h"
+
+// Append only log of records in a ring of flash sectors, used to keep
+// telemetry while MQTT is down and send it once the broker is back.
+// Sectors are filled and erased in turn, so wear spreads evenly; when the
+// ring is full the oldest sector is erased and its records are dropped.
+//
+// Sector: magic (2), reserved (2), sequence (4), then records
+// Record: state (1), crc8 (1), length (2), payload, padded to 4 bytes
+// The state byte only ever clears bits: 0xFF written, 0x7F committed,
+// 0x3F sent. A record whose commit was cut by a reset is skipped at begin().
+// At least two sectors are needed.
+class FlashRing
+{
+  public:
+  static const uint16_t MAGIC = 0x5452;
+  static const uint32_t sectorHeaderSize = 8;
+  static const uint32_t recordHeaderSize = 4;
+
+  static const uint8_t STATE_WRITTEN = 0xFF;
+  static const uint8_t STATE_COMMITTED = 0x7F;
+  static const uint8_t STATE_SENT = 0x3F;
+
+  FlashRing(FlashDevice &d)
+    :flash(d)
+  {
+    head = 0;
+    headSequence = 0;
+    writeOffset = sectorHeaderSize;
+    tail = 0;
+    tailOffset = 0;
+    pendingRecords = 0;
+    droppedRecords = 0;
+  }
+
+  /**
+   * Find the newest sector and the oldest unsent record, formats an empty device
+   * @return false if the flash can't be read or written
+   */
+  bool begin()
+  {
+    const uint16_t sectors = flash.sectorCount();
+    bool found = false;
+
+    pendingRecords = 0;
+
+    for (uint16_t s = 0; s < sectors; s++)
+    {
+      uint32_t sequence;
+      if (readSectorHeader(s, sequence) && (!found || (int32_t) (sequence - headSequence) > 0))
+      {
+        head = s;
+        headSequence = sequence;
+        found = true;
+      }
+    }
+
+    if (!found)
+    {
+      headSequence = 0;
+      head = sectors - 1;
+      return openSector((head + 1) % sectors);
+    }
+
+    // end of the newest sector, a torn record still takes its space
+    writeOffset = sectorHeaderSize;
+    Record record;
+    while (readRecord(head, writeOffset, record))
+      writeOffset += record.size;
+
+    // a header cut half way can't be overwritten, continue in the next sector
+    if (!isBlank(head, writeOffset))
+      writeOffset = flash.sectorSize();
+
+    // oldest unsent record: sectors after the head are older, in ring order
+    bool haveTail = false;
+    for (uint16_t i = 1; i <= sectors; i++)
+    {
+      const uint16_t s = (head + i) % sectors;
+      if (!isLive(s))
+        continue;
+
+      for (uint32_t offset = sectorHeaderSize; readRecord(s, offset, record); offset += record.size)
+      {
+        if (record.state != STATE_COMMITTED)
+          continue;
+        if (!haveTail)
+        {
+          tail = s;
+          tailOffset = offset;
+          haveTail = true;
+        }
+        pendingRecords++;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Store a record, dropping the oldest sector if the ring is full
+   * @return false if the record can never fit or the flash failed
+   */
+  bool append(const uint8_t *data, uint16_t length)
+  {
+    const uint32_t size = recordSize(length);
+
+    if (length == 0xFFFF || size > flash.sectorSize() - sectorHeaderSize)
+      return false;
+
+    if (writeOffset + size > flash.sectorSize())
+    {
+      const uint16_t next = (head + 1) % flash.sectorCount();
+
+      if (pendingRecords > 0 && tail == next)
+        dropSector(next);
+
+      if (!openSector(next))
+        return false;
+    }
+
+    const uint32_t address = addressOf(head, writeOffset);
+    uint8_t header[recordHeaderSize] = {STATE_WRITTEN, crc8(data, length), (uint8_t) (length & 0xFF), (uint8_t) (length >> 8)};
+
+    // the space is used even if the write fails half way
+    writeOffset += size;
+
+    if (!flash.write(address, header, recordHeaderSize) || !flash.write(address + recordHeaderSize, data, length))
+      return false;
+
+    header[0] = STATE_COMMITTED;
+    if (!flash.write(address, header, recordHeaderSize))
+      return false;
+
+    if (pendingRecords == 0)
+    {
+      tail = head;
+      tailOffset = writeOffset - size;
+    }
+
+    pendingRecords++;
+    return true;
+  }
+
+  /**
+   * Copy the oldest unsent record, records that fail the checksum or don't
+   * fit in the buffer are skipped
+   * @return its length, 0 if there is none or the buffer is too small
+   */
+  uint16_t peek(uint8_t *buffer, uint16_t bufferSize)
+  {
+    while (pendingRecords > 0)
+    {
+      Record record;
+      if (!readRecord(tail, tailOffset, record))
+        return 0;
+
+      if (record.length <= bufferSize && flash.read(addressOf(tail, tailOffset) + recordHeaderSize, buffer, record.length) && crc8(buffer, record.length) == record.crc)
+        return record.length;
+
+      droppedRecords++;
+      pop();
+    }
+
+    return 0;
+  }
+
+  /**
+   * Mark the oldest unsent record as sent
+   */
+  bool pop()
+  {
+    if (pendingRecords == 0)
+      return false;
+
+    Record record;
+    if (!readRecord(tail, tailOffset, record))
+      return false;
+
+    const uint8_t header[recordHeaderSize] = {STATE_SENT, record.crc, (uint8_t) (record.length & 0xFF), (uint8_t) (record.length >> 8)};
+    if (!flash.write(addressOf(tail, tailOffset), header, recordHeaderSize))
+      return false;
+
+    pendingRecords--;
+    tailOffset += record.size;
+    if (pendingRecords > 0)
+      seekCommitted();
+    return true;
+  }
+
+  uint32_t pending() const
+  {
+    return pendingRecords;
+  }
+
+  // Records lost to a full ring or a bad checksum since begin()
+  uint32_t dropped() const
+  {
+    return droppedRecords;
+  }
+
+  protected:
+  struct Record
+  {
+    uint8_t state;
+    uint8_t crc;
+    uint16_t length;
+    uint32_t size;
+  };
+
+  FlashDevice &flash;
+  uint16_t head;
+  uint32_t headSequence;
+  uint32_t writeOffset;
+  uint16_t tail;
+  uint32_t tailOffset;
+  uint32_t pendingRecords;
+  uint32_t droppedRecords;
+
+  static uint32_t recordSize(uint16_t length)
+  {
+    return (recordHeaderSize + length + 3) & ~3u;
+  }
+
+  uint32_t addressOf(uint16_t sector, uint32_t offset) const
+  {
+    return (uint32_t) sector * flash.sectorSize() + offset;
+  }
+
+  bool readSectorHeader(uint16_t sector, uint32_t &sequence)
+  {
+    uint8_t header[sectorHeaderSize];
+    if (!flash.read(addressOf(sector, 0), header, sectorHeaderSize))
+      return false;
+    if ((header[0] | header[1] << 8) != MAGIC)
+      return false;
+    sequence = header[4] | header[5] << 8 | header[6] << 16 | (uint32_t) header[7] << 24;
+    return true;
+  }
+
+  // A sector written in the current lap of the ring
+  bool isLive(uint16_t sector)
+  {
+    uint32_t sequence;
+    if (!readSectorHeader(sector, sequence))
+      return false;
+    return headSequence - sequence < flash.sectorCount();
+  }
+
+  // Read the record header at offset, false at the end of the sector
+  bool readRecord(uint16_t sector, uint32_t offset, Record &record)
+  {
+    uint8_t header[recordHeaderSize];
+
+    if (offset + recordHeaderSize > flash.sectorSize())
+      return false;
+    if (!flash.read(addressOf(sector, offset), header, recordHeaderSize))
+      return false;
+
+    record.state = header[0];
+    record.crc = header[1];
+    record.length = header[2] | header[3] << 8;
+    record.size = recordSize(record.length);
+    return record.length != 0xFFFF && offset + record.size <= flash.sectorSize();
+  }
+
+  bool isBlank(uint16_t sector, uint32_t offset)
+  {
+    uint8_t header[recordHeaderSize];
+
+    if (offset + recordHeaderSize > flash.sectorSize())
+      return true;
+    if (!flash.read(addressOf(sector, offset), header, recordHeaderSize))
+      return false;
+    return (header[0] & header[1] & header[2] & header[3]) == 0xFF;
+  }
+
+  bool openSector(uint16_t sector)
+  {
+    if (!flash.erase(sector))
+      return false;
+
+    headSequence++;
+    const uint8_t header[sectorHeaderSize] = {
+      (uint8_t) (MAGIC & 0xFF), (uint8_t) (MAGIC >> 8), 0xFF, 0xFF,
+      (uint8_t) (headSequence & 0xFF), (uint8_t) ((headSequence >> 8) & 0xFF), (uint8_t) ((headSequence >> 16) & 0xFF), (uint8_t) (headSequence >> 24)
+    };
+
+    head = sector;
+    writeOffset = sectorHeaderSize;
+    return flash.write(addressOf(sector, 0), header, sectorHeaderSize);
+  }
+
+  // The ring is full: forget the unsent records of the sector about to be erased
+  void dropSector(uint16_t sector)
+  {
+    Record record;
+    for (uint32_t offset = tailOffset; readRecord(sector, offset, record); offset += record.size)
+    {
+      if (record.state == STATE_COMMITTED && pendingRecords > 0)
+      {
+        pendingRecords--;
+        droppedRecords++;
+      }
+    }
+
+    tail = (sector + 1) % flash.sectorCount();
+    tailOffset = sectorHeaderSize;
+    if (pendingRecords > 0)
+      seekCommitted();
+  }
+
+  // Move the tail forward to the next committed record
+  void seekCommitted()
+  {
+    Record record;
+    for (uint16_t i = 0; i <= flash.sectorCount(); i++)
+    {
+      while (readRecord(tail, tailOffset, record))
+      {
+        if (record.state == STATE_COMMITTED)
+          return;
+        tailOffset += record.size;
+      }
+
+      if (tail == head)
+        break;
+
+      tail = (tail + 1) % flash.sectorCount();
+      tailOffset = sectorHeaderSize;
+    }
+
+    pendingRecords = 0;
+  }
+
+  static uint8_t crc8(const uint8_t *data, uint16_t length)
+  {
+    uint8_t crc = 0;
+    for (uint16_t i = 0; i < length; i++)
+    {
+      crc ^= data[i];
+      for (uint8_t bit = 0; bit < 8; bit++)
+        crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+  }
+};
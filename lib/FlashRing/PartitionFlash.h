@@ -0,0 +1,56 @@
+#pragma once
+
+#include <esp_partition.h>
+#include "FlashDevice.h"
+
+// FlashDevice on an ESP32 data partition, found by label. Raw flash: erase
+// and write go straight to the chip, with the usual wear of NOR flash.
+class PartitionFlash: public FlashDevice
+{
+  public:
+  PartitionFlash(const char *label, uint8_t subtype = 0x40)
+  {
+    this->label = label;
+    this->subtype = subtype;
+    partition = NULL;
+  }
+
+  /**
+   * Find the partition
+   */
+  bool begin()
+  {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t) subtype, label);
+    return partition != NULL;
+  }
+
+  virtual uint32_t sectorSize() const
+  {
+    return SPI_FLASH_SEC_SIZE;
+  }
+
+  virtual uint16_t sectorCount() const
+  {
+    return partition == NULL ? 0 : partition->size / SPI_FLASH_SEC_SIZE;
+  }
+
+  virtual bool read(uint32_t address, void *data, size_t length)
+  {
+    return partition != NULL && esp_partition_read(partition, address, data, length) == ESP_OK;
+  }
+
+  virtual bool write(uint32_t address, const void *data, size_t length)
+  {
+    return partition != NULL && esp_partition_write(partition, address, data, length) == ESP_OK;
+  }
+
+  virtual bool erase(uint16_t sector)
+  {
+    return sector < sectorCount() && esp_partition_erase_range(partition, (uint32_t) sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+  }
+
+  protected:
+  const char *label;
+  uint8_t subtype;
+  const esp_partition_t *partition;
+};
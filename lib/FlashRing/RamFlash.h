@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string.h>
+#include "FlashDevice.h"
+
+// RAM backed flash simulator for host tests of FlashRing (flashRingCheck.cpp).
+// Enforces NOR semantics (a write that would set a bit fails), counts erases
+// per sector and can cut power after a number of written bytes to simulate
+// torn writes.
+template<uint32_t bytesPerSector, uint16_t sectors>
+class RamFlash: public FlashDevice
+{
+  public:
+  RamFlash()
+  {
+    memset(data, 0xFF, sizeof(data));
+    memset(erases, 0, sizeof(erases));
+    writeBudget = -1;
+  }
+
+  virtual uint32_t sectorSize() const
+  {
+    return bytesPerSector;
+  }
+
+  virtual uint16_t sectorCount() const
+  {
+    return sectors;
+  }
+
+  virtual bool read(uint32_t address, void *out, size_t length)
+  {
+    if (address + length > sizeof(data))
+      return false;
+    memcpy(out, data + address, length);
+    return true;
+  }
+
+  virtual bool write(uint32_t address, const void *in, size_t length)
+  {
+    const uint8_t *bytes = (const uint8_t *) in;
+
+    if (address + length > sizeof(data))
+      return false;
+
+    for (size_t i = 0; i < length; i++)
+    {
+      if (writeBudget == 0)
+        return false;
+      if (writeBudget > 0)
+        writeBudget--;
+      if (bytes[i] & ~data[address + i])
+        return false;
+      data[address + i] &= bytes[i];
+    }
+    return true;
+  }
+
+  virtual bool erase(uint16_t sector)
+  {
+    if (sector >= sectors || writeBudget == 0)
+      return false;
+    memset(data + sector * bytesPerSector, 0xFF, bytesPerSector);
+    erases[sector]++;
+    return true;
+  }
+
+  uint32_t getEraseCount(uint16_t sector) const
+  {
+    return erases[sector];
+  }
+
+  // Fail every write after this many bytes, -1 to restore power
+  void cutPowerAfter(long bytes)
+  {
+    writeBudget = bytes;
+  }
+
+  protected:
+  uint8_t data[bytesPerSector * sectors];
+  uint32_t erases[sectors];
+  long writeBudget;
+};
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <Telemetry.h>
+
+// Verbosity, set with build_flags = -DLOG_LEVEL=LOG_LEVEL_NONE for benchmark
+// builds: the calls above the level, arguments included, are not compiled.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Records waiting to be printed, a power of two
+#ifndef LOG_QUEUE_SIZE
+#define LOG_QUEUE_SIZE 32
+#endif
+
+#define LOG_LINE_SIZE 160
+
+// One printf argument, kept as it is until the record is printed
+struct LogArg
+{
+  enum Type
+  {
+    NONE,
+    INT,
+    UNSIGNED,
+    FLOAT,
+    STRING,
+  };
+
+  union Value
+  {
+    int32_t i;
+    uint32_t u;
+    float f;
+    const char *s;
+  };
+
+  Type type;
+  Value value;
+
+  LogArg(): type(NONE) { value.u = 0; }
+  LogArg(Type t, Value v): type(t), value(v) {}
+  LogArg(char v): type(INT) { value.i = v; }
+  LogArg(int v): type(INT) { value.i = v; }
+  LogArg(long v): type(INT) { value.i = v; }
+  LogArg(unsigned int v): type(UNSIGNED) { value.u = v; }
+  LogArg(unsigned long v): type(UNSIGNED) { value.u = v; }
+  LogArg(float v): type(FLOAT) { value.f = v; }
+  LogArg(double v): type(FLOAT) { value.f = v; }
+  LogArg(const char *v): type(STRING) { value.s = v; }
+};
+
+// A line to print: the format and its arguments, types apart from the values
+// to keep the record small. Strings are kept by pointer, so they must outlive
+// the record: literals, names, static buffers.
+struct LogRecord
+{
+  static const uint8_t maxArgs = 10;
+
+  const char *pattern;
+  uint8_t count;
+  uint8_t types[maxArgs];
+  LogArg::Value values[maxArgs];
+
+  void set(uint8_t index, const LogArg &arg)
+  {
+    types[index] = arg.type;
+    values[index] = arg.value;
+  }
+
+  LogArg get(uint8_t index) const
+  {
+    return index < count ? LogArg((LogArg::Type) types[index], values[index]) : LogArg();
+  }
+
+  /**
+   * Format into buffer: %d %i %u %x %c %s %f (%.Nf, 2 decimals by default)
+   * and %%. Flags, width and length modifiers are accepted and ignored.
+   */
+  size_t format(char *buffer, size_t size) const
+  {
+    TelemetryWriter out(buffer, size);
+    uint8_t next = 0;
+
+    for (const char *c = pattern; *c; c++)
+    {
+      if (*c != '%')
+      {
+        out.append(*c);
+        continue;
+      }
+
+      uint8_t decimals = 2;
+      c++;
+      while (*c == '-' || *c == '+' || *c == ' ' || *c == '#' || *c == '0' || (*c >= '1' && *c <= '9'))
+        c++;
+      if (*c == '.')
+      {
+        decimals = 0;
+        while (*++c >= '0' && *c <= '9')
+          decimals = decimals * 10 + *c - '0';
+      }
+      while (*c == 'l' || *c == 'h' || *c == 'z')
+        c++;
+
+      if (*c == 0)
+        break;
+      if (*c == '%')
+      {
+        out.append('%');
+        continue;
+      }
+
+      const LogArg arg = get(next++);
+      switch (*c)
+      {
+        case 'd':
+        case 'i':
+          appendInteger(out, arg);
+          break;
+        case 'u':
+          arg.type == LogArg::FLOAT ? out.appendUnsigned(arg.value.f) : out.appendUnsigned(arg.value.u);
+          break;
+        case 'x':
+          appendHex(out, arg.value.u);
+          break;
+        case 'c':
+          out.append((char) arg.value.i);
+          break;
+        case 's':
+          out.append(arg.type == LogArg::STRING && arg.value.s != NULL ? arg.value.s : "(null)");
+          break;
+        case 'f':
+          out.appendFloat(arg.type == LogArg::FLOAT ? arg.value.f : arg.type == LogArg::INT ? arg.value.i : arg.value.u, decimals);
+          break;
+        default:
+          out.append('%').append(*c);
+      }
+    }
+
+    return out.size();
+  }
+
+  protected:
+  static void appendInteger(TelemetryWriter &out, const LogArg &arg)
+  {
+    if (arg.type == LogArg::UNSIGNED)
+      out.appendUnsigned(arg.value.u);
+    else if (arg.type == LogArg::FLOAT)
+      out.appendInt(arg.value.f);
+    else
+      out.appendInt(arg.value.i);
+  }
+
+  static void appendHex(TelemetryWriter &out, uint32_t value)
+  {
+    const char *digits = "0123456789abcdef";
+    char reversed[8];
+    uint8_t n = 0;
+
+    do
+    {
+      reversed[n++] = digits[value & 0x0F];
+      value >>= 4;
+    } while (value > 0);
+
+    while (n > 0)
+      out.append(reversed[--n]);
+  }
+};
+
+// Lines logged from the hot path are queued here and formatted later, when
+// the sketch is idle, so a slow UART never blocks a measurement. Any task or
+// callback may log (bounded multi-producer queue, a sequence number per cell
+// tells writers and the reader who owns it); one place drains. A full queue
+// drops the new line and counts it, logging never waits.
+class LogQueue
+{
+  public:
+  static LogQueue &instance()
+  {
+    static LogQueue queue;
+    return queue;
+  }
+
+  LogQueue()
+  {
+    for (uint32_t i = 0; i < LOG_QUEUE_SIZE; i++)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    head.store(0, std::memory_order_relaxed);
+    tail = 0;
+    lost.store(0, std::memory_order_relaxed);
+  }
+
+  template<typename... Args>
+  bool push(const char *format, Args... args)
+  {
+    static_assert(sizeof...(args) <= LogRecord::maxArgs, "Too many log arguments");
+
+    const LogArg values[sizeof...(args) + 1] = {LogArg(args)..., LogArg()};
+    uint32_t position = head.load(std::memory_order_relaxed);
+    Cell *cell;
+
+    while (true)
+    {
+      cell = &cells[position & (LOG_QUEUE_SIZE - 1)];
+      const int32_t difference = (int32_t) (cell->sequence.load(std::memory_order_acquire) - position);
+
+      if (difference == 0 && head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        break;
+
+      if (difference < 0)
+      {
+        lost.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      if (difference > 0)
+        position = head.load(std::memory_order_relaxed);
+    }
+
+    cell->record.pattern = format;
+    cell->record.count = sizeof...(args);
+    for (uint8_t i = 0; i < sizeof...(args); i++)
+      cell->record.set(i, values[i]);
+
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Take the oldest record, from the draining context only
+   */
+  bool pop(LogRecord &record)
+  {
+    Cell &cell = cells[tail & (LOG_QUEUE_SIZE - 1)];
+
+    if ((int32_t) (cell.sequence.load(std::memory_order_acquire) - (tail + 1)) < 0)
+      return false;
+
+    record = cell.record;
+    cell.sequence.store(tail + LOG_QUEUE_SIZE, std::memory_order_release);
+    tail++;
+    return true;
+  }
+
+  /**
+   * Print up to max queued lines, then wait for the output to go out so the
+   * next measurement does not share the CPU with its interrupts
+   * @return lines printed
+   */
+  template<typename Output>
+  uint16_t drain(Output &out, uint16_t max = LOG_QUEUE_SIZE)
+  {
+    LogRecord record;
+    char line[LOG_LINE_SIZE];
+    uint16_t printed = 0;
+
+    while (printed < max && pop(record))
+    {
+      record.format(line, sizeof(line));
+      out.println(line);
+      printed++;
+    }
+
+    const uint32_t dropped = lost.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+      TelemetryWriter(line, sizeof(line)).appendUnsigned(dropped).append(" log lines dropped");
+      out.println(line);
+    }
+
+    out.flush();
+    return printed;
+  }
+
+  protected:
+  static_assert((LOG_QUEUE_SIZE & (LOG_QUEUE_SIZE - 1)) == 0, "LOG_QUEUE_SIZE must be a power of two");
+
+  struct Cell
+  {
+    std::atomic<uint32_t> sequence;
+    LogRecord record;
+  };
+
+  Cell cells[LOG_QUEUE_SIZE];
+  std::atomic<uint32_t> head;
+  uint32_t tail;
+  std::atomic<uint32_t> lost;
+};
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LogQueue::instance().push(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) LogQueue::instance().push(__VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LogQueue::instance().push(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+// Print the queued lines, at idle: before a delay() or between benchmark runs
+#if LOG_LEVEL > LOG_LEVEL_NONE
+#define LOG_DRAIN(out) LogQueue::instance().drain(out)
+#else
+#define LOG_DRAIN(out) do {} while (0)
+#endif
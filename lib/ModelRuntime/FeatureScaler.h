@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string.h>
+#include <EloquentTinyML.h>
+
+// Standardization of a float model's inputs, (x - offset) * scale per
+// feature, folded at load time into the weights and bias of its first fully
+// connected layer: the C++ side of Models/feature_scaler.py. The model is
+// trained on standardized features and exported as it is, the board passes
+// the raw readings. For that layer y = W((x - offset) * scale) + b is
+// y = (W * scale) x + (b - W(offset * scale)), the same layer with other
+// weights and no extra op.
+//
+// The model is not written: it may be read in place from flash. The folded
+// weights and bias go to a RAM buffer of units * (features + 1) floats, and
+// ModelRuntime points the layer's tensors at them every time it plans the
+// model. They are computed once per model.
+class FeatureScaler
+{
+  public:
+  /**
+   * @param offset, scale: per feature, kept by reference
+   * @param storage: room for the folded layer, units * (features + 1) floats
+   */
+  FeatureScaler(const float *offset, const float *scale, size_t features, float *storage, size_t storageSize)
+  {
+    this->offset = offset;
+    this->scale = scale;
+    this->features = features;
+    this->storage = storage;
+    this->storageSize = storageSize;
+    folded = NULL;
+  }
+
+  /**
+   * Point the first layer's weights and bias at their folded values, folding
+   * them first for a model not seen last. The model's first operator must be
+   * a float fully connected layer on the model's input, with a bias and one
+   * weight per feature, that fits the storage
+   * @return false if the scaling can't be folded into the model
+   */
+  bool apply(const tflite::Model *model, tflite::MicroInterpreter &interpreter)
+  {
+    const tflite::SubGraph *subgraph = model->subgraphs()->Get(0);
+
+    if (subgraph->operators()->size() == 0)
+      return false;
+
+    const tflite::Operator *first = subgraph->operators()->Get(0);
+    const tflite::OperatorCode *code = model->operator_codes()->Get(first->opcode_index());
+
+    if (code->builtin_code() != tflite::BuiltinOperator_FULLY_CONNECTED || first->inputs()->size() < 3
+        || first->inputs()->Get(0) != subgraph->inputs()->Get(0))
+      return false;
+
+    TfLiteTensor *weights = interpreter.tensor(first->inputs()->Get(1));
+    const int32_t biasIndex = first->inputs()->Get(2);
+
+    if (biasIndex < 0 || weights->type != kTfLiteFloat32 || weights->dims->size != 2
+        || (size_t) weights->dims->data[1] != features)
+      return false;
+
+    TfLiteTensor *bias = interpreter.tensor(biasIndex);
+    const size_t units = weights->dims->data[0];
+
+    if (bias->type != kTfLiteFloat32 || bias->bytes != units * sizeof(float)
+        || units * (features + 1) > storageSize)
+      return false;
+
+    // the tensors of a new plan point into the model
+    if (folded != model)
+      fold(weights->data.f, bias->data.f, units);
+
+    weights->data.f = storage;
+    bias->data.f = storage + units * features;
+    folded = model;
+    return true;
+  }
+
+  protected:
+  const float *offset;
+  const float *scale;
+  size_t features;
+  float *storage;
+  size_t storageSize;
+  // model whose layer the storage holds
+  const tflite::Model *folded;
+
+  // weights are units rows of features, copied in case they are not aligned
+  void fold(const float *weights, const float *bias, size_t units)
+  {
+    float *foldedWeights = storage;
+    float *foldedBias = storage + units * features;
+
+    for (size_t u = 0; u < units; u++)
+    {
+      double shift = 0;
+      memcpy(&foldedBias[u], &bias[u], sizeof(float));
+
+      for (size_t f = 0; f < features; f++)
+      {
+        float weight;
+        memcpy(&weight, &weights[u * features + f], sizeof(float));
+        foldedWeights[u * features + f] = weight * scale[f];
+        // in double, the offsets are large next to the weights they move
+        shift += (double) weight * scale[f] * offset[f];
+      }
+
+      foldedBias[u] = (float) (foldedBias[u] - shift);
+    }
+  }
+};
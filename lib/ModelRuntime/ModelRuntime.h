@@ -0,0 +1,480 @@
+#pragma once
+
+#include <new>
+#include <EloquentTinyML.h>
+#include "FeatureScaler.h"
+
+// Tensor arena shared by several ModelRuntime. Models never run at the same
+// time, so the arena only has to fit the largest plan instead of the sum of
+// them: a runtime plans its model again when it takes the arena back.
+class SharedArena
+{
+  public:
+  SharedArena(uint8_t *arena, size_t arenaSize)
+  {
+    data = arena;
+    size = arenaSize;
+    owner = NULL;
+    plans = 0;
+  }
+
+  // Times a model was planned in the arena
+  uint32_t getPlans() const
+  {
+    return plans;
+  }
+
+  protected:
+  friend class ModelRuntime;
+
+  uint8_t *data;
+  size_t size;
+  const void *owner;
+  uint32_t plans;
+};
+
+// TensorFlow Lite interpreter that can be pointed at another model while the
+// sketch runs, for models updated over the air. Same calls as
+// Eloquent::TinyML::TfLite, but the arena is passed in and the interpreter is
+// built in place, so load() can replace it: TfLite::begin() keeps a static
+// interpreter bound to the first model for the life of the firmware.
+// The input and output sizes are checked against the model, so a model of
+// another shape is refused instead of reading past the tensors. Float, int8
+// and uint8 tensors are accepted: predict(float *) quantizes the inputs and
+// dequantizes the outputs of a quantized model with its tensors' scale and
+// zero point, so an update may swap a float model for a quantized one.
+// A model trained on standardized features is given its FeatureScaler, folded
+// into its first layer whenever it is planned, and takes the raw ones.
+//
+// Runtimes built on one SharedArena keep their model and interpreter object
+// (a few hundred bytes each) but take turns in the arena: the tensors of the
+// runtime used last are the only valid ones, another is planned again by
+// activate() or its next predict().
+class ModelRuntime
+{
+  public:
+  enum Error
+  {
+    OK,
+    VERSION_MISMATCH,
+    SHAPE_MISMATCH,
+    TYPE_MISMATCH,
+    SCALING_MISMATCH,
+    CANNOT_ALLOCATE_TENSORS,
+    NOT_INITIALIZED,
+    INVOKE_ERROR
+  };
+
+  ModelRuntime(uint8_t *arena, size_t arenaSize, size_t inputSize, size_t outputSize)
+    :ownArena(arena, arenaSize)
+  {
+    this->arena = &ownArena;
+    this->inputSize = inputSize;
+    this->outputSize = outputSize;
+    interpreter = NULL;
+    input = NULL;
+    output = NULL;
+    modelData = NULL;
+    modelScaler = NULL;
+    error = NOT_INITIALIZED;
+  }
+
+  ModelRuntime(SharedArena &shared, size_t inputSize, size_t outputSize)
+    :ownArena(NULL, 0)
+  {
+    arena = &shared;
+    this->inputSize = inputSize;
+    this->outputSize = outputSize;
+    interpreter = NULL;
+    input = NULL;
+    output = NULL;
+    modelData = NULL;
+    modelScaler = NULL;
+    error = NOT_INITIALIZED;
+  }
+
+  ~ModelRuntime()
+  {
+    destroy();
+  }
+
+  bool begin(const unsigned char *model, FeatureScaler *scaler = NULL)
+  {
+    return load(model, scaler);
+  }
+
+  /**
+   * Build the interpreter for a model in the arena, replacing the current one.
+   * Call it between inferences. A model that can't be used leaves the previous
+   * one running, errorMessage() tells why it was refused
+   * @param scaler: the standardization the model was trained with, NULL if it
+   * takes raw inputs
+   * @return false if the model was refused
+   */
+  bool load(const unsigned char *model, FeatureScaler *scaler = NULL)
+  {
+    if (model == modelData && scaler == modelScaler && modelData != NULL)
+      return activate();
+
+    const tflite::Model *parsed = tflite::GetModel(model);
+
+    // checked before the current interpreter is touched
+    if (parsed->version() != TFLITE_SCHEMA_VERSION)
+    {
+      reporter()->Report("Model provided is schema version %d not equal to supported version %d.", parsed->version(), TFLITE_SCHEMA_VERSION);
+      error = VERSION_MISMATCH;
+      return false;
+    }
+
+    const unsigned char *previous = modelData;
+    const Error status = plan(parsed, scaler);
+
+    if (status == OK)
+    {
+      modelData = model;
+      modelScaler = scaler;
+      error = OK;
+      return true;
+    }
+
+    // the arena now holds a partial plan of the refused model, redo the previous one
+    if (previous == NULL || plan(tflite::GetModel(previous), modelScaler) != OK)
+    {
+      destroy();
+      modelData = NULL;
+      modelScaler = NULL;
+    }
+
+    error = status;
+    return false;
+  }
+
+  /**
+   * Test if a model is loaded
+   */
+  bool initialized() const
+  {
+    return modelData != NULL;
+  }
+
+  /**
+   * Take the arena, planning the model again if another runtime used it last.
+   * predict() does it too, call it first to keep planning out of a timing
+   */
+  bool activate()
+  {
+    if (modelData == NULL)
+    {
+      error = NOT_INITIALIZED;
+      return false;
+    }
+
+    if (planned())
+      return true;
+
+    const Error status = plan(tflite::GetModel(modelData), modelScaler);
+    if (status != OK)
+    {
+      error = status;
+      return false;
+    }
+
+    return true;
+  }
+
+  // The model running, NULL if none
+  const unsigned char *model() const
+  {
+    return modelData;
+  }
+
+  /**
+   * Run inference on the raw bytes of an int8 or uint8 model
+   * @return output[0]
+   */
+  uint8_t predict(uint8_t *input, uint8_t *output = NULL)
+  {
+    if (!activate())
+      return 0;
+
+    if (this->input->type == kTfLiteFloat32 || this->output->type == kTfLiteFloat32)
+    {
+      error = TYPE_MISMATCH;
+      return 0;
+    }
+
+    memcpy(this->input->data.uint8, input, inputSize);
+
+    if (interpreter->Invoke() != kTfLiteOk)
+    {
+      error = INVOKE_ERROR;
+      reporter()->Report("Inference failed");
+      return 0;
+    }
+
+    if (output != NULL)
+      memcpy(output, this->output->data.uint8, outputSize);
+
+    return this->output->data.uint8[0];
+  }
+
+  /**
+   * Run inference, quantizing and dequantizing for a quantized model
+   * @return output[0], so you can use it directly if it's the only output
+   */
+  float predict(float *input, float *output = NULL)
+  {
+    if (!activate())
+      return sqrt(-1);
+
+    for (size_t i = 0; i < inputSize; i++)
+      setInput(i, input[i]);
+
+    return invokeFloat(output);
+  }
+
+  /**
+   * The input tensor of a float model, to write the features into before
+   * predictInPlace(). It is in the arena: another runtime on the same arena
+   * planning in between overwrites it
+   * @return NULL if the model is not initialized or its input is not float
+   */
+  float *getFloatInputBuffer()
+  {
+    if (!activate())
+      return NULL;
+
+    if (input->type != kTfLiteFloat32)
+    {
+      error = TYPE_MISMATCH;
+      return NULL;
+    }
+
+    return input->data.f;
+  }
+
+  /**
+   * Run inference on the input already in getFloatInputBuffer()
+   * @return output[0]
+   */
+  float predictInPlace(float *output = NULL)
+  {
+    if (!activate())
+      return sqrt(-1);
+
+    return invokeFloat(output);
+  }
+
+  /**
+   * Predict class
+   */
+  uint8_t predictClass(float *input)
+  {
+    predict(input);
+
+    if (!planned())
+      return 0;
+
+    uint8_t classIdx = 0;
+    float maxProba = getOutput(0);
+
+    for (uint8_t i = 1; i < outputSize; i++)
+    {
+      const float proba = getOutput(i);
+      if (proba > maxProba)
+      {
+        classIdx = i;
+        maxProba = proba;
+      }
+    }
+
+    return classIdx;
+  }
+
+  /**
+   * Get class with highest probability
+   */
+  uint8_t probaToClass(const float *output) const
+  {
+    uint8_t classIdx = 0;
+    float maxProba = output[0];
+
+    for (uint8_t i = 1; i < outputSize; i++)
+    {
+      if (output[i] > maxProba)
+      {
+        classIdx = i;
+        maxProba = output[i];
+      }
+    }
+
+    return classIdx;
+  }
+
+  Error getError() const
+  {
+    return error;
+  }
+
+  const char *errorMessage() const
+  {
+    switch (error)
+    {
+      case OK:
+        return "No error";
+      case VERSION_MISMATCH:
+        return "Version mismatch";
+      case SHAPE_MISMATCH:
+        return "Input or output size mismatch";
+      case TYPE_MISMATCH:
+        return "Input or output type not supported";
+      case SCALING_MISMATCH:
+        return "Input scaling does not fit the first layer";
+      case CANNOT_ALLOCATE_TENSORS:
+        return "Cannot allocate tensors";
+      case NOT_INITIALIZED:
+        return "Interpreter has not been initialized";
+      case INVOKE_ERROR:
+        return "Interpreter invoke() returned an error";
+      default:
+        return "Unknown error";
+    }
+  }
+
+  protected:
+  SharedArena *arena;
+  SharedArena ownArena;
+  size_t inputSize;
+  size_t outputSize;
+  tflite::MicroInterpreter *interpreter;
+  TfLiteTensor *input;
+  TfLiteTensor *output;
+  const unsigned char *modelData;
+  FeatureScaler *modelScaler;
+  Error error;
+  alignas(tflite::MicroInterpreter) uint8_t interpreterStorage[sizeof(tflite::MicroInterpreter)];
+
+  static tflite::ErrorReporter *reporter()
+  {
+    static tflite::MicroErrorReporter microReporter;
+    return &microReporter;
+  }
+
+  static const tflite::OpResolver &resolver()
+  {
+    static tflite::ops::micro::AllOpsResolver allOps;
+    return allOps;
+  }
+
+  bool planned() const
+  {
+    return interpreter != NULL && arena->owner == this;
+  }
+
+  // Plan the tensors of a model in the arena, whoever used it before
+  Error plan(const tflite::Model *parsed, FeatureScaler *scaler)
+  {
+    destroy();
+    arena->owner = NULL;
+    arena->plans++;
+    interpreter = new (interpreterStorage) tflite::MicroInterpreter(parsed, resolver(), arena->data, arena->size, reporter());
+
+    if (interpreter->AllocateTensors() != kTfLiteOk)
+    {
+      destroy();
+      return CANNOT_ALLOCATE_TENSORS;
+    }
+
+    input = interpreter->input(0);
+    output = interpreter->output(0);
+
+    if (!hasType(input) || !hasType(output))
+    {
+      destroy();
+      return TYPE_MISMATCH;
+    }
+
+    if (!hasSize(input, inputSize) || !hasSize(output, outputSize))
+    {
+      destroy();
+      return SHAPE_MISMATCH;
+    }
+
+    if (scaler != NULL && !scaler->apply(parsed, *interpreter))
+    {
+      destroy();
+      return SCALING_MISMATCH;
+    }
+
+    arena->owner = this;
+    return OK;
+  }
+
+  static bool hasType(const TfLiteTensor *tensor)
+  {
+    return tensor->type == kTfLiteFloat32 || tensor->type == kTfLiteInt8 || tensor->type == kTfLiteUInt8;
+  }
+
+  // that many values of the tensor's type
+  static bool hasSize(const TfLiteTensor *tensor, size_t size)
+  {
+    return tensor->bytes == size * (tensor->type == kTfLiteFloat32 ? sizeof(float) : 1);
+  }
+
+  // value / scale + zero point, rounded and clamped to the tensor's type
+  void setInput(size_t i, float value)
+  {
+    if (input->type == kTfLiteFloat32)
+    {
+      input->data.f[i] = value;
+      return;
+    }
+
+    const int32_t low = input->type == kTfLiteInt8 ? -128 : 0;
+    const float q = roundf(value / input->params.scale) + input->params.zero_point;
+    // NaN to the low end too
+    const int32_t clamped = q >= low + 255 ? low + 255 : q >= low ? (int32_t) q : low;
+
+    if (input->type == kTfLiteInt8)
+      input->data.int8[i] = (int8_t) clamped;
+    else
+      input->data.uint8[i] = (uint8_t) clamped;
+  }
+
+  float getOutput(size_t i) const
+  {
+    if (output->type == kTfLiteFloat32)
+      return output->data.f[i];
+
+    const int32_t q = output->type == kTfLiteInt8 ? output->data.int8[i] : output->data.uint8[i];
+    return (q - output->params.zero_point) * output->params.scale;
+  }
+
+  // Invoke on the input in place, dequantizing the outputs
+  float invokeFloat(float *output)
+  {
+    if (interpreter->Invoke() != kTfLiteOk)
+    {
+      error = INVOKE_ERROR;
+      reporter()->Report("Inference failed");
+      return sqrt(-1);
+    }
+
+    if (output != NULL)
+    {
+      for (size_t i = 0; i < outputSize; i++)
+        output[i] = getOutput(i);
+    }
+
+    return getOutput(0);
+  }
+
+  void destroy()
+  {
+    if (interpreter != NULL)
+      interpreter->~MicroInterpreter();
+    interpreter = NULL;
+    input = NULL;
+    output = NULL;
+  }
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Header in front of a model stored outside the firmware (a flash partition
+// or a file), written by Models/pack_model.py. Little endian, 32 bytes:
+//   0..3    magic "TFMD"
+//   4..5    format version
+//   6..7    header size
+//   8..11   model version, chosen by whoever packs the model
+//   12..15  model length in bytes
+//   16..19  CRC-32 of the model (same as zlib.crc32)
+//   20..23  offset of the model from the start of the image, a multiple of 16
+//   24..27  flags, 0 for now
+//   28..31  CRC-32 of bytes 0..27
+// The model offset keeps the flatbuffer aligned as TensorFlow Lite expects
+// when the image itself starts on a sector or page boundary.
+class ModelImage
+{
+  public:
+  static const uint32_t MAGIC = 0x444D4654; // "TFMD"
+  static const uint16_t FORMAT_VERSION = 1;
+  static const uint16_t headerSize = 32;
+  static const uint32_t alignment = 16;
+
+  enum Status
+  {
+    OK,
+    BAD_MAGIC,
+    UNSUPPORTED_FORMAT,
+    BAD_HEADER_CHECKSUM,
+    BAD_LAYOUT,
+    BAD_CHECKSUM,
+  };
+
+  uint16_t format;
+  uint32_t version;
+  uint32_t length;
+  uint32_t crc;
+  uint32_t offset;
+  uint32_t flags;
+
+  ModelImage()
+  {
+    format = FORMAT_VERSION;
+    version = 0;
+    length = 0;
+    crc = 0;
+    offset = headerSize;
+    flags = 0;
+  }
+
+  /**
+   * Parse and check a header, imageSize bounds the model it describes
+   */
+  Status parse(const uint8_t *header, uint32_t imageSize)
+  {
+    if (getLong(header, 0) != MAGIC)
+      return BAD_MAGIC;
+
+    format = getShort(header, 4);
+    if (format != FORMAT_VERSION || getShort(header, 6) != headerSize)
+      return UNSUPPORTED_FORMAT;
+
+    if (getLong(header, 28) != crc32(0, header, 28))
+      return BAD_HEADER_CHECKSUM;
+
+    version = getLong(header, 8);
+    length = getLong(header, 12);
+    crc = getLong(header, 16);
+    offset = getLong(header, 20);
+    flags = getLong(header, 24);
+
+    if (length == 0 || offset < headerSize || offset % alignment != 0 || offset > imageSize || length > imageSize - offset)
+      return BAD_LAYOUT;
+
+    return OK;
+  }
+
+  /**
+   * Check the model against the CRC in the header
+   */
+  Status verify(const uint8_t *model) const
+  {
+    return crc32(0, model, length) == crc ? OK : BAD_CHECKSUM;
+  }
+
+  /**
+   * Write the header for a model of the given version, length and CRC
+   */
+  void encode(uint8_t *header) const
+  {
+    putLong(header, 0, MAGIC);
+    putShort(header, 4, format);
+    putShort(header, 6, headerSize);
+    putLong(header, 8, version);
+    putLong(header, 12, length);
+    putLong(header, 16, crc);
+    putLong(header, 20, offset);
+    putLong(header, 24, flags);
+    putLong(header, 28, crc32(0, header, 28));
+  }
+
+  static const char *statusMessage(Status status)
+  {
+    switch (status)
+    {
+      case OK:
+        return "No error";
+      case BAD_MAGIC:
+        return "No model image";
+      case UNSUPPORTED_FORMAT:
+        return "Unsupported image format";
+      case BAD_HEADER_CHECKSUM:
+        return "Header checksum mismatch";
+      case BAD_LAYOUT:
+        return "Model does not fit the image";
+      case BAD_CHECKSUM:
+        return "Model checksum mismatch";
+      default:
+        return "Unknown error";
+    }
+  }
+
+  /**
+   * CRC-32 (reflected, polynomial 0xEDB88320), chainable: pass the previous
+   * result to continue over the next block
+   */
+  static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t length)
+  {
+    // one table lookup per nibble, 64 bytes of table
+    static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+    {
+      crc ^= data[i];
+      crc = (crc >> 4) ^ table[crc & 0x0F];
+      crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+  }
+
+  protected:
+  static uint16_t getShort(const uint8_t *buffer, int pos)
+  {
+    return buffer[pos] | buffer[pos + 1] << 8;
+  }
+
+  static uint32_t getLong(const uint8_t *buffer, int pos)
+  {
+    return getShort(buffer, pos) | (uint32_t) getShort(buffer, pos + 2) << 16;
+  }
+
+  static void putShort(uint8_t *buffer, int pos, uint16_t s)
+  {
+    buffer[pos] = s & 0xFF;
+    buffer[pos + 1] = s >> 8;
+  }
+
+  static void putLong(uint8_t *buffer, int pos, uint32_t l)
+  {
+    putShort(buffer, pos, l & 0xFFFF);
+    putShort(buffer, pos + 2, l >> 16);
+  }
+};
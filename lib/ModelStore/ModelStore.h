@@ -0,0 +1,198 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ModelImage.h"
+
+#if defined(ESP32)
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Model kept in a flash partition instead of being compiled into the firmware,
+// so a new model only needs the partition to be written (see
+// Models/pack_model.py). The model is mapped into the address space through
+// the flash cache and its pointer given straight to the interpreter: weights
+// are read in place, nothing is copied to RAM. The mapping lasts until close(),
+// keep the store alive as long as the interpreter.
+//
+// On ESP32 the name is the label of a data partition of subtype 0x40, on the
+// host it is the path of a file holding the same image.
+class ModelStore
+{
+  public:
+  static const uint8_t PARTITION_SUBTYPE = 0x40;
+
+  enum Error
+  {
+    OK,
+    NOT_FOUND,
+    READ_FAILED,
+    BAD_IMAGE,
+    NOT_MAPPED,
+  };
+
+  ModelStore(const char *name)
+  {
+    this->name = name;
+    data = NULL;
+    error = OK;
+    imageStatus = ModelImage::OK;
+#if defined(ESP32)
+    partition = NULL;
+#else
+    mapped = NULL;
+    mappedSize = 0;
+#endif
+  }
+
+  ~ModelStore()
+  {
+    close();
+  }
+
+  /**
+   * Find the image and map its model
+   * @param verify check the model CRC, reads the whole model once
+   * @return false if there is no valid model, see errorMessage()
+   */
+  bool open(bool verify = true)
+  {
+    close();
+
+#if defined(ESP32)
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t) PARTITION_SUBTYPE, name);
+    if (partition == NULL)
+      return fail(NOT_FOUND);
+
+    uint8_t header[ModelImage::headerSize];
+    if (esp_partition_read(partition, 0, header, sizeof(header)) != ESP_OK)
+      return fail(READ_FAILED);
+
+    if ((imageStatus = image.parse(header, partition->size)) != ModelImage::OK)
+      return fail(BAD_IMAGE);
+
+    // the partition starts on a 64 KB boundary, so the model keeps the image alignment
+    const void *pointer;
+    if (esp_partition_mmap(partition, image.offset, image.length, SPI_FLASH_MMAP_DATA, &pointer, &handle) != ESP_OK)
+      return fail(NOT_MAPPED);
+    data = (const unsigned char *) pointer;
+#else
+    int fd = ::open(name, O_RDONLY);
+    if (fd < 0)
+      return fail(NOT_FOUND);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < ModelImage::headerSize)
+    {
+      ::close(fd);
+      return fail(READ_FAILED);
+    }
+
+    // page aligned, so the model keeps the image alignment
+    void *pointer = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (pointer == MAP_FAILED)
+      return fail(NOT_MAPPED);
+
+    mapped = pointer;
+    mappedSize = st.st_size;
+
+    if ((imageStatus = image.parse((const uint8_t *) mapped, mappedSize)) != ModelImage::OK)
+      return fail(BAD_IMAGE);
+    data = (const unsigned char *) mapped + image.offset;
+#endif
+
+    if (verify && (imageStatus = image.verify(data)) != ModelImage::OK)
+      return fail(BAD_IMAGE);
+
+    error = OK;
+    return true;
+  }
+
+  void close()
+  {
+#if defined(ESP32)
+    if (data != NULL)
+      spi_flash_munmap(handle);
+    partition = NULL;
+#else
+    if (mapped != NULL)
+      munmap(mapped, mappedSize);
+    mapped = NULL;
+    mappedSize = 0;
+#endif
+    data = NULL;
+  }
+
+  bool isOpen() const
+  {
+    return data != NULL;
+  }
+
+  // The model, NULL if open() failed
+  const unsigned char *model() const
+  {
+    return data;
+  }
+
+  uint32_t modelSize() const
+  {
+    return isOpen() ? image.length : 0;
+  }
+
+  uint32_t version() const
+  {
+    return isOpen() ? image.version : 0;
+  }
+
+  Error getError() const
+  {
+    return error;
+  }
+
+  const char *errorMessage() const
+  {
+    switch (error)
+    {
+      case OK:
+        return "No error";
+      case NOT_FOUND:
+        return "Model partition not found";
+      case READ_FAILED:
+        return "Cannot read the model partition";
+      case BAD_IMAGE:
+        return ModelImage::statusMessage(imageStatus);
+      case NOT_MAPPED:
+        return "Cannot map the model";
+      default:
+        return "Unknown error";
+    }
+  }
+
+  protected:
+  const char *name;
+  const unsigned char *data;
+  ModelImage image;
+  Error error;
+  ModelImage::Status imageStatus;
+#if defined(ESP32)
+  const esp_partition_t *partition;
+  spi_flash_mmap_handle_t handle;
+#else
+  void *mapped;
+  size_t mappedSize;
+#endif
+
+  bool fail(Error e)
+  {
+    close();
+    error = e;
+    return false;
+  }
+};
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <FlashDevice.h>
+#include <Telemetry.h>
+#include "ModelImage.h"
+
+// Receives a model image published over MQTT in chunks (see modelPublisher.py)
+// and streams it into a model slot the interpreter is not using, so only the
+// current chunk fragment is ever in RAM. Messages, little endian:
+//   BEGIN  type 1, then the 32 byte image header (ModelImage)
+//   CHUNK  type 2, reserved (3), offset of the data in the model (4), data
+// Chunks must come in order, a chunk sent again is ignored. The old image is
+// invalidated by BEGIN, the model is written behind the header space with its
+// CRC computed on the fly, and the header goes last once the CRC matches: a
+// slot holds a complete image or none, whatever happens half way.
+//
+// Messages may be handed over in fragments, as AsyncMqttClient does for
+// payloads bigger than a TCP segment. onMessage() runs in the MQTT task and
+// the swap in loop(): the state is the only thing they share, and READY is
+// set last, when the slot can be opened. The erases and writes run in the
+// MQTT task too and stall both cores while they last; getFlashOperations()
+// counts them, for latencies measured meanwhile to be told apart.
+class ModelUpdate
+{
+  public:
+  static const uint8_t BEGIN = 1;
+  static const uint8_t CHUNK = 2;
+  static const uint8_t chunkHeaderSize = 8;
+
+  enum State
+  {
+    IDLE,
+    RECEIVING,
+    READY,
+    ACTIVE,
+    FAILED,
+  };
+
+  enum Error
+  {
+    OK,
+    BAD_MESSAGE,
+    BAD_IMAGE,
+    NOT_STARTED,
+    OUT_OF_ORDER,
+    BAD_CHECKSUM,
+    FLASH_FAILED,
+    NOT_ACTIVATED,
+  };
+
+  ModelUpdate()
+  {
+    slot = NULL;
+    state = IDLE;
+    changes = 0;
+    error = OK;
+    imageStatus = ModelImage::OK;
+    received = 0;
+    crc = 0;
+    erasedEnd = 0;
+    flashOperations = 0;
+    staged = 0;
+    skip = false;
+  }
+
+  /**
+   * Slot the next image is written to, only while no update is pending
+   */
+  void setTarget(FlashDevice &target)
+  {
+    slot = &target;
+  }
+
+  /**
+   * Feed an MQTT message, or a fragment of one
+   * @param index position of the fragment in the message
+   * @param total length of the whole message
+   */
+  void onMessage(const uint8_t *payload, size_t length, size_t index, size_t total)
+  {
+    if (index == 0)
+    {
+      staged = 0;
+      skip = false;
+    }
+
+    // a finished image waits for the swap, nothing may touch the slot
+    if (state == READY)
+      return;
+
+    size_t i = 0;
+    if (staged < messageHeaderSize())
+    {
+      // the message header may be split across fragments too
+      while (i < length && staged < messageHeaderSize())
+        messageHeader[staged++] = payload[i++];
+
+      if (staged < messageHeaderSize() || !startMessage(total))
+        return;
+    }
+
+    if (i < length && !skip)
+      writeModel(payload + i, length - i);
+  }
+
+  /**
+   * Report the outcome of the swap to a READY image
+   */
+  void activate(bool ok)
+  {
+    if (state != READY)
+      return;
+    if (ok)
+      setState(ACTIVE);
+    else
+      fail(NOT_ACTIVATED);
+  }
+
+  State getState() const
+  {
+    return state;
+  }
+
+  // Counts state changes, to tell a new outcome from an older one in the same state
+  uint16_t getChanges() const
+  {
+    return changes;
+  }
+
+  Error getError() const
+  {
+    return error;
+  }
+
+  uint32_t getVersion() const
+  {
+    return image.version;
+  }
+
+  uint32_t getReceived() const
+  {
+    return received;
+  }
+
+  // Erases and writes of the slot so far, successful or not
+  uint32_t getFlashOperations() const
+  {
+    return flashOperations;
+  }
+
+  const char *stateName() const
+  {
+    switch (state)
+    {
+      case IDLE:
+        return "idle";
+      case RECEIVING:
+        return "receiving";
+      case READY:
+        return "ready";
+      case ACTIVE:
+        return "active";
+      default:
+        return "failed";
+    }
+  }
+
+  const char *errorMessage() const
+  {
+    switch (error)
+    {
+      case OK:
+        return "No error";
+      case BAD_MESSAGE:
+        return "Malformed message";
+      case BAD_IMAGE:
+        return ModelImage::statusMessage(imageStatus);
+      case NOT_STARTED:
+        return "Chunk without an update";
+      case OUT_OF_ORDER:
+        return "Chunk out of order";
+      case BAD_CHECKSUM:
+        return "Model checksum mismatch";
+      case FLASH_FAILED:
+        return "Cannot write the model slot";
+      case NOT_ACTIVATED:
+        return "Model refused by the interpreter";
+      default:
+        return "Unknown error";
+    }
+  }
+
+  /**
+   * Status as JSON:
+   * {"board":"esp32dev","model":"wine","state":"receiving","version":3,
+   *  "received":4096,"length":15704,"error":"No error"}
+   * @return length, 0 if the buffer is too small
+   */
+  size_t toJson(char *buffer, size_t size, const char *board, const char *model) const
+  {
+    TelemetryWriter out(buffer, size);
+
+    out.append("{\"board\":\"").append(board);
+    out.append("\",\"model\":\"").append(model);
+    out.append("\",\"state\":\"").append(stateName());
+    out.append("\",\"version\":").appendUnsigned(image.version);
+    out.append(",\"received\":").appendUnsigned(received);
+    out.append(",\"length\":").appendUnsigned(image.length);
+    out.append(",\"error\":\"").append(errorMessage());
+    out.append("\"}");
+
+    return out.overflow() ? 0 : out.size();
+  }
+
+  protected:
+  FlashDevice *slot;
+  volatile State state;
+  volatile uint16_t changes;
+  Error error;
+  ModelImage image;
+  ModelImage::Status imageStatus;
+  uint32_t received;
+  uint32_t crc;
+  uint32_t erasedEnd;
+  volatile uint32_t flashOperations;
+  uint8_t messageHeader[1 + ModelImage::headerSize];
+  uint8_t staged;
+  bool skip;
+
+  uint8_t messageHeaderSize() const
+  {
+    if (staged == 0)
+      return 1;
+    if (messageHeader[0] == BEGIN)
+      return 1 + ModelImage::headerSize;
+    if (messageHeader[0] == CHUNK)
+      return chunkHeaderSize;
+    return 1;
+  }
+
+  bool startMessage(size_t total)
+  {
+    if (messageHeader[0] == BEGIN)
+      return total == sizeof(messageHeader) ? startImage() : fail(BAD_MESSAGE);
+
+    if (messageHeader[0] != CHUNK)
+      return fail(BAD_MESSAGE);
+
+    // the rest of a failed image keeps the first error, a chunk sent again
+    // after the swap changes nothing
+    if (state == FAILED || state == ACTIVE)
+    {
+      skip = true;
+      return false;
+    }
+
+    if (state != RECEIVING)
+      return fail(NOT_STARTED);
+
+    const uint32_t offset = messageHeader[4] | messageHeader[5] << 8 | messageHeader[6] << 16 | (uint32_t) messageHeader[7] << 24;
+    const uint32_t length = total - chunkHeaderSize;
+
+    // sent again after a reconnect, already written
+    if (offset + length <= received)
+    {
+      skip = true;
+      return true;
+    }
+
+    if (offset != received || length > image.length - received)
+      return fail(OUT_OF_ORDER);
+
+    return true;
+  }
+
+  bool startImage()
+  {
+    if (slot == NULL || slot->sectorCount() == 0)
+      return fail(FLASH_FAILED);
+
+    const uint32_t slotSize = slot->sectorSize() * slot->sectorCount();
+    if ((imageStatus = image.parse(messageHeader + 1, slotSize)) != ModelImage::OK)
+      return fail(BAD_IMAGE);
+
+    // a slot without a valid header is never opened
+    flashOperations++;
+    if (!slot->erase(0))
+      return fail(FLASH_FAILED);
+
+    received = 0;
+    crc = 0;
+    erasedEnd = slot->sectorSize();
+    error = OK;
+    setState(RECEIVING);
+
+    // BEGIN has no model data
+    skip = true;
+    return true;
+  }
+
+  void writeModel(const uint8_t *data, size_t length)
+  {
+    if (state != RECEIVING)
+      return;
+
+    if (length > image.length - received)
+    {
+      fail(OUT_OF_ORDER);
+      return;
+    }
+
+    const uint32_t address = image.offset + received;
+
+    // erase sector by sector as the data reaches them, a whole slot at once
+    // would hold the MQTT task for a second
+    while (erasedEnd < address + length)
+    {
+      flashOperations++;
+      if (!slot->erase(erasedEnd / slot->sectorSize()))
+      {
+        fail(FLASH_FAILED);
+        return;
+      }
+      erasedEnd += slot->sectorSize();
+    }
+
+    flashOperations++;
+    if (!slot->write(address, data, length))
+    {
+      fail(FLASH_FAILED);
+      return;
+    }
+
+    crc = ModelImage::crc32(crc, data, length);
+    received += length;
+
+    if (received < image.length)
+      return;
+
+    if (crc != image.crc)
+    {
+      fail(BAD_CHECKSUM);
+      return;
+    }
+
+    uint8_t header[ModelImage::headerSize];
+    image.encode(header);
+    flashOperations++;
+    if (!slot->write(0, header, sizeof(header)))
+    {
+      fail(FLASH_FAILED);
+      return;
+    }
+
+    setState(READY);
+  }
+
+  void setState(State next)
+  {
+    state = next;
+    changes++;
+  }
+
+  bool fail(Error e)
+  {
+    error = e;
+    skip = true;
+    setState(FAILED);
+    return false;
+  }
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include "SensorFeatures.h"
+
+// Energy in frequency bands of the last fftSize samples of a channel. Unlike
+// the window statistics this is a transform per feature vector, not an update
+// per sample: a 64 point one every hop. The FFT is here, in 32 bit integers
+// with 16 bit twiddles, so the ESP8266 (whose EloquentTinyML has no kissfft
+// sources) and the ESP32 compute the same bands.
+//
+// The window's mean is removed and the samples scaled up to 2^14 before the
+// FFT (it halves at every stage, small signals would round away), then a Hann
+// taper. The bins from 1 to fftSize / 2 are split into bands of equal width,
+// and each band's energy is its share of the variance: over the bands they
+// add up to about getVariance(), in the same units.
+template<uint16_t fftSize, uint8_t bands>
+class BandEnergies
+{
+  public:
+  static_assert(fftSize >= 4 && fftSize <= 4096 && (fftSize & (fftSize - 1)) == 0,
+                "fftSize must be a power of two, 4 to 4096");
+  static_assert(bands >= 1 && bands <= fftSize / 2, "bands must be 1 to fftSize / 2");
+
+  BandEnergies() :
+    ready(false)
+  {
+  }
+
+  /**
+   * Table the taper and the twiddles, once
+   * @return true
+   */
+  bool begin()
+  {
+    if (ready)
+      return true;
+
+    for (uint16_t i = 0; i < fftSize; i++)
+      taper[i] = (int16_t) lrintf(32767 * (0.5f - 0.5f * cosf(2 * (float) M_PI * i / fftSize)));
+
+    // e^(-2 pi i k / fftSize) in Q15
+    for (uint16_t k = 0; k < fftSize / 2; k++)
+    {
+      twiddleReal[k] = (int16_t) lrintf(32767 * cosf(2 * (float) M_PI * k / fftSize));
+      twiddleImag[k] = (int16_t) lrintf(-32767 * sinf(2 * (float) M_PI * k / fftSize));
+    }
+
+    ready = true;
+    return true;
+  }
+
+  /**
+   * Write the bands energies of a channel
+   * @param stats window of at least fftSize samples
+   * @param energies bands floats, lowest band first
+   * @param scale units per raw count, as SensorFeatures::setScale()
+   * @return false before begin() or while the window is shorter than fftSize
+   */
+  template<uint16_t windowSize>
+  bool compute(const WindowStats<windowSize> &stats, float *energies, float scale = 1)
+  {
+    static_assert(fftSize <= windowSize, "fftSize must fit in the window");
+
+    if (!ready || !stats.copyLatest(time, fftSize))
+      return false;
+
+    // centre on the window mean, then shift the largest sample to 2^13 to 2^14
+    const int32_t mean = lrintf(stats.getMean());
+    int32_t largest = 0;
+    for (uint16_t i = 0; i < fftSize; i++)
+    {
+      const int32_t centred = time[i] - mean;
+      const int32_t magnitude = centred < 0 ? -centred : centred;
+
+      real[i] = centred;
+      if (magnitude > largest)
+        largest = magnitude;
+    }
+    int8_t shift = 0;
+    while (shift < 15 && (largest << (shift + 1)) < 16384)
+      shift++;
+    while ((largest >> -shift) >= 16384)
+      shift--;
+
+    // tapered, into bit reversed order for the FFT
+    for (uint16_t i = 0, j = 0; i < fftSize; i++)
+    {
+      if (j >= i)
+      {
+        const int32_t a = scaled(real[i], shift) * taper[i] >> 15;
+        const int32_t b = scaled(real[j], shift) * taper[j] >> 15;
+        real[i] = b;
+        real[j] = a;
+      }
+      imag[i] = 0;
+
+      uint16_t bit = fftSize >> 1;
+      for (; j & bit; bit >>= 1)
+        j ^= bit;
+      j |= bit;
+    }
+    transform();
+
+    // the FFT gives X / fftSize: a bin k holds 2 |X_k|^2 / fftSize^2 of the
+    // variance (the Nyquist bin once), the Hann taper keeps 3 / 8 of it
+    const float unshift = ldexpf(1, -shift);
+    const float gain = 8.0f / 3 * unshift * unshift * scale * scale;
+    const uint16_t bins = fftSize / 2;
+    for (uint8_t b = 0; b < bands; b++)
+    {
+      const uint16_t first = 1 + (uint32_t) b * bins / bands;
+      const uint16_t last = (uint32_t) (b + 1) * bins / bands;
+      float energy = 0;
+
+      for (uint16_t k = first; k <= last; k++)
+      {
+        const float power = (float) real[k] * real[k] + (float) imag[k] * imag[k];
+        energy += k == bins ? power : 2 * power;
+      }
+      energies[b] = energy * gain;
+    }
+    return true;
+  }
+
+  protected:
+  bool ready;
+  int16_t taper[fftSize];
+  int16_t twiddleReal[fftSize / 2];
+  int16_t twiddleImag[fftSize / 2];
+  int16_t time[fftSize];
+  int32_t real[fftSize];
+  int32_t imag[fftSize];
+
+  static int32_t scaled(int32_t value, int8_t shift)
+  {
+    return shift >= 0 ? value * ((int32_t) 1 << shift) : value >> -shift;
+  }
+
+  // Radix 2, in place on bit reversed input, halving after every stage. The
+  // values stay within 2^14 in magnitude, so a product with a Q15 twiddle and
+  // the sum of two fit in 32 bits: the ESP8266 has no fast 64 bit multiply
+  void transform()
+  {
+    for (uint16_t half = 1; half < fftSize; half <<= 1)
+    {
+      const uint16_t step = fftSize / (2 * half);
+
+      for (uint16_t k = 0; k < half; k++)
+      {
+        const int32_t wr = twiddleReal[k * step];
+        const int32_t wi = twiddleImag[k * step];
+
+        for (uint16_t i = k; i < fftSize; i += 2 * half)
+        {
+          const uint16_t j = i + half;
+          const int32_t tr = (real[j] * wr - imag[j] * wi + (1 << 14)) >> 15;
+          const int32_t ti = (real[j] * wi + imag[j] * wr + (1 << 14)) >> 15;
+
+          real[j] = (real[i] - tr + 1) >> 1;
+          imag[j] = (imag[i] - ti + 1) >> 1;
+          real[i] = (real[i] + tr + 1) >> 1;
+          imag[i] = (imag[i] + ti + 1) >> 1;
+        }
+      }
+    }
+  }
+};
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+// Statistics of the last windowSize samples of one sensor channel, updated as
+// each sample arrives instead of recomputed over the window: the sum and the
+// sum of squares gain the new sample and lose the one leaving, the zero
+// crossings the pair that leaves. The extremes come from the ring's passes
+// (van Herk / Gil-Werman): the window is the end of the previous pass, whose
+// extremes from every position to its end are tabled once when it ends, plus
+// the start of the current one, whose extremes are running ones. That is a
+// table of windowSize every windowSize samples, O(1) amortized and without
+// the data dependent branches of a monotonic queue.
+// Sums are integer and exact, the variance does not drift over hours of
+// samples nor cancel against a large mean, as gravity on an accelerometer.
+// Samples are raw int16 readings, scaled into units when written out.
+template<uint16_t windowSize>
+class WindowStats
+{
+  public:
+  static_assert(windowSize >= 2 && windowSize <= 32768, "windowSize must be 2 to 32768");
+
+  WindowStats() :
+    crossingLevel(0)
+  {
+    reset();
+  }
+
+  /**
+   * Empty the window
+   */
+  void reset()
+  {
+    count = 0;
+    next = 0;
+    sum = 0;
+    squares = 0;
+    crossings = 0;
+    passMax = 0;
+    passMin = 0;
+  }
+
+  /**
+   * Level the crossings are counted around, a sensor's zero or its resting value
+   * @param level in raw units
+   */
+  void setCrossingLevel(int16_t level)
+  {
+    crossingLevel = level;
+    crossings = 0;
+    for (uint16_t i = 1; i < count; i++)
+      crossings += crossed(at(i - 1), at(i));
+  }
+
+  void push(int16_t sample)
+  {
+    const int16_t newest = count > 0 ? samples[(next + windowSize - 1) % windowSize] : sample;
+
+    if (count == windowSize)
+    {
+      const int16_t oldest = samples[next];
+
+      sum -= oldest;
+      squares -= (int32_t) oldest * oldest;
+      crossings -= crossed(oldest, samples[(next + 1) % windowSize]);
+    }
+    else
+      count++;
+
+    samples[next] = sample;
+    sum += sample;
+    squares += (int32_t) sample * sample;
+    crossings += count > 1 && crossed(newest, sample);
+
+    if (next == 0)
+    {
+      passMax = sample;
+      passMin = sample;
+    }
+    else
+    {
+      passMax = sample > passMax ? sample : passMax;
+      passMin = sample < passMin ? sample : passMin;
+    }
+
+    if (next == windowSize - 1)
+    {
+      tableOldPass();
+      next = 0;
+    }
+    else
+      next++;
+  }
+
+  uint16_t getCount() const
+  {
+    return count;
+  }
+
+  bool isFull() const
+  {
+    return count == windowSize;
+  }
+
+  float getMean() const
+  {
+    return count == 0 ? 0 : (float) sum / count;
+  }
+
+  /**
+   * Population variance, in raw units squared
+   */
+  float getVariance() const
+  {
+    if (count == 0)
+      return 0;
+
+    // n * sum(x^2) - sum(x)^2 is exact in 64 bits for 2^15 samples of 2^15
+    const int64_t spread = (int64_t) count * (int64_t) squares - (int64_t) sum * sum;
+    return (float) spread / ((float) count * count);
+  }
+
+  float getRms() const
+  {
+    return count == 0 ? 0 : sqrtf((float) squares / count);
+  }
+
+  int16_t getMax() const
+  {
+    // the previous pass from next on, while there is one
+    if (count < windowSize || next == 0)
+      return passMax;
+    return oldMax[next] > passMax ? oldMax[next] : passMax;
+  }
+
+  int16_t getMin() const
+  {
+    if (count < windowSize || next == 0)
+      return passMin;
+    return oldMin[next] < passMin ? oldMin[next] : passMin;
+  }
+
+  int32_t getPeakToPeak() const
+  {
+    return (int32_t) getMax() - getMin();
+  }
+
+  /**
+   * Crossings of the crossing level between consecutive samples
+   */
+  uint16_t getCrossings() const
+  {
+    return crossings;
+  }
+
+  /**
+   * Crossings per pair of samples, 0 to 1
+   */
+  float getCrossingRate() const
+  {
+    return count < 2 ? 0 : (float) crossings / (count - 1);
+  }
+
+  /**
+   * Copy the last n samples, oldest first
+   * @return false if fewer than n have arrived
+   */
+  bool copyLatest(int16_t *destination, uint16_t n) const
+  {
+    if (n > count)
+      return false;
+
+    for (uint16_t i = 0; i < n; i++)
+      destination[i] = at(count - n + i);
+    return true;
+  }
+
+  protected:
+  int16_t samples[windowSize];
+  // extremes of the previous pass from each position to its end
+  int16_t oldMax[windowSize];
+  int16_t oldMin[windowSize];
+  // extremes of the current pass so far
+  int16_t passMax;
+  int16_t passMin;
+  uint16_t count;
+  uint16_t next;
+  int32_t sum;
+  uint64_t squares;
+  uint16_t crossings;
+  int16_t crossingLevel;
+
+  // i-th sample of the window, oldest first
+  int16_t at(uint16_t i) const
+  {
+    return samples[(next + windowSize - count + i) % windowSize];
+  }
+
+  bool crossed(int16_t a, int16_t b) const
+  {
+    return (a >= crossingLevel) != (b >= crossingLevel);
+  }
+
+  // the pass that just ended becomes the previous one
+  void tableOldPass()
+  {
+    oldMax[windowSize - 1] = samples[windowSize - 1];
+    oldMin[windowSize - 1] = samples[windowSize - 1];
+    for (int32_t i = windowSize - 2; i >= 0; i--)
+    {
+      oldMax[i] = samples[i] > oldMax[i + 1] ? samples[i] : oldMax[i + 1];
+      oldMin[i] = samples[i] < oldMin[i + 1] ? samples[i] : oldMin[i + 1];
+    }
+  }
+};
+
+// Feature order within a channel
+enum SensorFeature
+{
+  FEATURE_MEAN,
+  FEATURE_VARIANCE,
+  FEATURE_RMS,
+  FEATURE_PEAK_TO_PEAK,
+  FEATURE_CROSSING_RATE,
+  FEATURES_PER_CHANNEL
+};
+
+// Windowed features of a multi-channel sensor (accelerometer axes, or
+// temperature, humidity and pressure) for a tabular model: a reading of every
+// channel is pushed as it is sampled, and every hop samples, once the window
+// is full, the features are written channel by channel straight into the
+// model's input tensor. Readings are raw counts; the scale of a channel turns
+// them into the units the model was trained on (g, degrees), the variance
+// takes its square and the crossing rate none.
+template<uint8_t channels, uint16_t windowSize>
+class SensorFeatures
+{
+  public:
+  static const uint16_t size = channels * FEATURES_PER_CHANNEL;
+
+  SensorFeatures() :
+    hop(windowSize),
+    sinceWrite(0)
+  {
+    for (uint8_t c = 0; c < channels; c++)
+      scales[c] = 1;
+  }
+
+  /**
+   * Samples between two feature vectors, windowSize for windows that do not overlap
+   * @param samples 1 to windowSize
+   */
+  void setHop(uint16_t samples)
+  {
+    hop = samples == 0 ? 1 : samples > windowSize ? windowSize : samples;
+  }
+
+  /**
+   * Units per raw count of a channel
+   * @param channel
+   * @param unitsPerCount e.g. 1 / 16384.0 for g from a +-2 g accelerometer
+   */
+  void setScale(uint8_t channel, float unitsPerCount)
+  {
+    if (channel < channels)
+      scales[channel] = unitsPerCount;
+  }
+
+  void reset()
+  {
+    for (uint8_t c = 0; c < channels; c++)
+      stats[c].reset();
+    sinceWrite = 0;
+  }
+
+  /**
+   * Push one reading of every channel
+   * @return true if a feature vector is due
+   */
+  bool push(const int16_t *reading)
+  {
+    for (uint8_t c = 0; c < channels; c++)
+      stats[c].push(reading[c]);
+    if (sinceWrite < hop)
+      sinceWrite++;
+    return isReady();
+  }
+
+  bool isReady() const
+  {
+    return sinceWrite >= hop && stats[0].isFull();
+  }
+
+  /**
+   * Write the size features, channel after channel in SensorFeature order
+   */
+  void write(float *features)
+  {
+    for (uint8_t c = 0; c < channels; c++)
+    {
+      const WindowStats<windowSize> &s = stats[c];
+      const float scale = scales[c];
+      float *out = features + c * FEATURES_PER_CHANNEL;
+
+      out[FEATURE_MEAN] = s.getMean() * scale;
+      out[FEATURE_VARIANCE] = s.getVariance() * scale * scale;
+      out[FEATURE_RMS] = s.getRms() * scale;
+      out[FEATURE_PEAK_TO_PEAK] = s.getPeakToPeak() * scale;
+      out[FEATURE_CROSSING_RATE] = s.getCrossingRate();
+    }
+    sinceWrite = 0;
+  }
+
+  /**
+   * Write the features into the input tensor of a float model, to run
+   * predictInPlace() on: a ModelRuntime on any board, or the
+   * Eloquent::TinyML::TensorFlow of CameraDemo/lib. The TfLite of
+   * EloquentTinyML 0.0.10 has no input buffer, there write() into a float
+   * array and pass it to predict()
+   * @param offset features already in the input before these
+   * @return false if the model is not initialized
+   */
+  template<class Model>
+  bool writeInput(Model &model, uint16_t offset = 0)
+  {
+    float *input = model.getFloatInputBuffer();
+
+    if (input == NULL)
+      return false;
+
+    write(input + offset);
+    return true;
+  }
+
+  const WindowStats<windowSize> &getChannel(uint8_t channel) const
+  {
+    return stats[channel];
+  }
+
+  WindowStats<windowSize> &getChannel(uint8_t channel)
+  {
+    return stats[channel];
+  }
+
+  float getScale(uint8_t channel) const
+  {
+    return scales[channel];
+  }
+
+  protected:
+  WindowStats<windowSize> stats[channels];
+  float scales[channels];
+  uint16_t hop;
+  uint16_t sinceWrite;
+};
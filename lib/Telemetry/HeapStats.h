@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LogQueue.h>
+
+// Heap state after a publish, to compare allocation patterns between builds.
+// fragmentation is 0 when the largest free block is the whole free heap.
+struct HeapStats
+{
+  uint32_t freeBytes;
+  uint32_t largestBlock;
+  uint8_t fragmentation;
+
+  static HeapStats read()
+  {
+    HeapStats stats;
+#if defined(ESP8266)
+    stats.freeBytes = ESP.getFreeHeap();
+    stats.largestBlock = ESP.getMaxFreeBlockSize();
+#elif defined(ESP32)
+    stats.freeBytes = ESP.getFreeHeap();
+    stats.largestBlock = ESP.getMaxAllocHeap();
+#else
+    stats.freeBytes = 0;
+    stats.largestBlock = 0;
+#endif
+    stats.fragmentation = stats.freeBytes == 0 ? 0 : 100 - (uint32_t) stats.largestBlock * 100 / stats.freeBytes;
+    return stats;
+  }
+
+  void print(Print &out) const
+  {
+    out.print("Free heap: ");
+    out.print(freeBytes);
+    out.print(" bytes, largest block: ");
+    out.print(largestBlock);
+    out.print(" bytes, fragmentation: ");
+    out.print(fragmentation);
+    out.println("%");
+  }
+
+  void log() const
+  {
+    LOG_INFO("Free heap: %u bytes, largest block: %u bytes, fragmentation: %u%%", freeBytes, largestBlock, fragmentation);
+  }
+};
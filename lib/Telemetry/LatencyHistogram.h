@@ -0,0 +1,173 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Telemetry.h"
+
+// Fixed memory log-linear histogram of latencies (HDR style): values below
+// 2^subBucketBits get a bucket each, above that every power of two is split
+// into 2^(subBucketBits - 1) buckets, so the relative error is bounded
+// (about 6% with the default 4 bits) whatever the magnitude. Values of
+// 2^maxBits and above land in the last bucket; min, max and the mean are exact.
+// The defaults take 144 buckets (576 bytes) for up to ~1 s in microseconds.
+template<uint8_t subBucketBits = 4, uint8_t maxBits = 20>
+class LatencyHistogram
+{
+  public:
+  static const uint32_t subBuckets = 1ul << subBucketBits;
+  static const uint32_t halfSubBuckets = subBuckets / 2;
+  static const uint16_t bucketCount = (maxBits - subBucketBits + 1) * halfSubBuckets + halfSubBuckets;
+
+  LatencyHistogram()
+  {
+    reset(0);
+  }
+
+  // Start a new window at nowMs
+  void reset(uint32_t nowMs)
+  {
+    for (uint16_t i = 0; i < bucketCount; i++)
+      counts[i] = 0;
+    total = 0;
+    sum = 0;
+    minValue = 0;
+    maxValue = 0;
+    windowStart = nowMs;
+  }
+
+  void record(uint32_t value)
+  {
+    counts[indexOf(value)]++;
+    if (total == 0 || value < minValue)
+      minValue = value;
+    if (value > maxValue)
+      maxValue = value;
+    total++;
+    sum += value;
+  }
+
+  uint32_t count() const
+  {
+    return total;
+  }
+
+  uint32_t min() const
+  {
+    return minValue;
+  }
+
+  uint32_t max() const
+  {
+    return maxValue;
+  }
+
+  float mean() const
+  {
+    return total == 0 ? 0 : (float) sum / total;
+  }
+
+  uint32_t getWindowStart() const
+  {
+    return windowStart;
+  }
+
+  /**
+   * Value at a percentile (nearest rank), the middle of its bucket
+   * @param percentile 0 to 100
+   */
+  uint32_t percentile(float percentile) const
+  {
+    if (total == 0)
+      return 0;
+
+    uint32_t rank = (uint32_t) (percentile / 100 * total + 0.999999f);
+    if (rank == 0)
+      rank = 1;
+    if (rank > total)
+      rank = total;
+
+    uint32_t seen = 0;
+    for (uint16_t i = 0; i < bucketCount; i++)
+    {
+      seen += counts[i];
+      if (seen >= rank)
+      {
+        if (i == bucketCount - 1)
+          return maxValue;
+
+        const uint32_t value = lowerBound(i) + (width(i) - 1) / 2;
+        return value < minValue ? minValue : (value > maxValue ? maxValue : value);
+      }
+    }
+
+    return maxValue;
+  }
+
+  /**
+   * Snapshot as JSON:
+   * {"board":"esp32dev","model":"wine","window":60000,"count":600,"min":760,
+   *  "mean":781.20,"p50":776,"p90":800,"p95":808,"p99":824,"p999":832,"max":840}
+   * @return length, 0 if the buffer is too small
+   */
+  size_t toJson(char *buffer, size_t size, const char *board, const char *model, uint32_t nowMs) const
+  {
+    TelemetryWriter out(buffer, size);
+
+    out.append("{\"board\":\"").append(board);
+    out.append("\",\"model\":\"").append(model);
+    out.append("\",\"window\":").appendUnsigned(nowMs - windowStart);
+    out.append(",\"count\":").appendUnsigned(total);
+    out.append(",\"min\":").appendUnsigned(minValue);
+    out.append(",\"mean\":").appendFloat(mean(), 2);
+    out.append(",\"p50\":").appendUnsigned(percentile(50));
+    out.append(",\"p90\":").appendUnsigned(percentile(90));
+    out.append(",\"p95\":").appendUnsigned(percentile(95));
+    out.append(",\"p99\":").appendUnsigned(percentile(99));
+    out.append(",\"p999\":").appendUnsigned(percentile(99.9f));
+    out.append(",\"max\":").appendUnsigned(maxValue);
+    out.append('}');
+
+    return out.overflow() ? 0 : out.size();
+  }
+
+  protected:
+  uint32_t counts[bucketCount];
+  uint32_t total;
+  uint64_t sum;
+  uint32_t minValue;
+  uint32_t maxValue;
+  uint32_t windowStart;
+
+  static uint16_t indexOf(uint32_t value)
+  {
+    if (value < subBuckets)
+      return value;
+
+    uint8_t msb = 31;
+    while (!(value & (1ul << msb)))
+      msb--;
+
+    if (msb >= maxBits)
+      return bucketCount - 1;
+
+    const uint8_t shift = msb - subBucketBits + 1;
+    return shift * halfSubBuckets + (value >> shift);
+  }
+
+  static uint32_t lowerBound(uint16_t index)
+  {
+    if (index < subBuckets)
+      return index;
+
+    const uint8_t shift = index / halfSubBuckets - 1;
+    return (index - shift * halfSubBuckets) << shift;
+  }
+
+  static uint32_t width(uint16_t index)
+  {
+    if (index < subBuckets)
+      return 1;
+
+    return 1ul << (index / halfSubBuckets - 1);
+  }
+};
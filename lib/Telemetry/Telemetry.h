@@ -0,0 +1,227 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Writes text into a caller provided buffer, never allocates.
+// Output is always NUL terminated; overflow() tells if anything was cut.
+class TelemetryWriter
+{
+  public:
+  TelemetryWriter(char *buffer, size_t size)
+  {
+    start = buffer;
+    capacity = size;
+    length = 0;
+    truncated = size == 0;
+    if (size > 0)
+      start[0] = 0;
+  }
+
+  TelemetryWriter &append(char c)
+  {
+    if (length + 1 < capacity)
+    {
+      start[length++] = c;
+      start[length] = 0;
+    }
+    else
+      truncated = true;
+    return *this;
+  }
+
+  TelemetryWriter &append(const char *s)
+  {
+    while (*s)
+      append(*s++);
+    return *this;
+  }
+
+  TelemetryWriter &appendUnsigned(uint32_t value)
+  {
+    char digits[10];
+    int n = 0;
+    do
+    {
+      digits[n++] = '0' + value % 10;
+      value /= 10;
+    } while (value > 0);
+    while (n > 0)
+      append(digits[--n]);
+    return *this;
+  }
+
+  TelemetryWriter &appendInt(int32_t value)
+  {
+    if (value < 0)
+    {
+      append('-');
+      return appendUnsigned(0u - (uint32_t) value);
+    }
+    return appendUnsigned(value);
+  }
+
+  // Fixed point, rounded like Arduino's String(float, decimals)
+  TelemetryWriter &appendFloat(float value, uint8_t decimals)
+  {
+    if (value != value)
+      return append("null");
+
+    if (value < 0)
+    {
+      append('-');
+      value = -value;
+    }
+
+    float rounding = 0.5f;
+    for (uint8_t i = 0; i < decimals; i++)
+      rounding /= 10;
+    value += rounding;
+
+    if (value >= 4294967040.0f)
+      return append("null");
+
+    uint32_t integer = (uint32_t) value;
+    float fraction = value - integer;
+    appendUnsigned(integer);
+
+    if (decimals > 0)
+      append('.');
+    for (uint8_t i = 0; i < decimals; i++)
+    {
+      fraction *= 10;
+      uint8_t digit = (uint8_t) fraction;
+      append('0' + digit);
+      fraction -= digit;
+    }
+    return *this;
+  }
+
+  size_t size() const
+  {
+    return length;
+  }
+
+  bool overflow() const
+  {
+    return truncated;
+  }
+
+  protected:
+  char *start;
+  size_t capacity;
+  size_t length;
+  bool truncated;
+};
+
+// One inference result, serialized without heap traffic:
+// {"board":"esp32dev","model":"wine","result":1,"iteration":1,"microseconds":120}
+// maxOps reserves room for optional per operator timings, sent as "ops":[...]
+// only when some were added. board and model must outlive the record.
+template<uint8_t maxOps = 0>
+class TelemetryRecord
+{
+  public:
+  TelemetryRecord(const char *boardName, const char *modelName)
+  {
+    board = boardName;
+    model = modelName;
+    resultIsFloat = false;
+    resultDecimals = 0;
+    resultInt = 0;
+    resultFloat = 0;
+    iteration = 0;
+    microseconds = 0;
+    opCount = 0;
+  }
+
+  // Class predictions
+  void setResult(int value)
+  {
+    resultInt = value;
+    resultIsFloat = false;
+  }
+
+  // Regression outputs, 2 decimals like String(float), 0 rounds to an integer
+  void setResult(float value, uint8_t decimals = 2)
+  {
+    resultFloat = value;
+    resultIsFloat = true;
+    resultDecimals = decimals;
+  }
+
+  void setIteration(uint32_t value)
+  {
+    iteration = value;
+  }
+
+  void setMicroseconds(uint32_t value)
+  {
+    microseconds = value;
+  }
+
+  void clearOps()
+  {
+    opCount = 0;
+  }
+
+  // @return false if the record has no room left
+  bool addOp(uint32_t opMicroseconds)
+  {
+    if (opCount >= maxOps)
+      return false;
+    ops[opCount++] = opMicroseconds;
+    return true;
+  }
+
+  uint8_t getOpCount() const
+  {
+    return opCount;
+  }
+
+  /**
+   * Serialize as JSON
+   * @return length without the terminator, 0 if the buffer is too small
+   */
+  size_t toJson(char *buffer, size_t size) const
+  {
+    TelemetryWriter out(buffer, size);
+
+    out.append("{\"board\":\"").append(board);
+    out.append("\",\"model\":\"").append(model);
+    out.append("\",\"result\":");
+    if (resultIsFloat)
+      out.appendFloat(resultFloat, resultDecimals);
+    else
+      out.appendInt(resultInt);
+    out.append(",\"iteration\":").appendUnsigned(iteration);
+    out.append(",\"microseconds\":").appendUnsigned(microseconds);
+
+    if (opCount > 0)
+    {
+      out.append(",\"ops\":[");
+      for (uint8_t i = 0; i < opCount; i++)
+      {
+        if (i > 0)
+          out.append(',');
+        out.appendUnsigned(ops[i]);
+      }
+      out.append(']');
+    }
+    out.append('}');
+
+    return out.overflow() ? 0 : out.size();
+  }
+
+  protected:
+  const char *board;
+  const char *model;
+  int32_t resultInt;
+  float resultFloat;
+  bool resultIsFloat;
+  uint8_t resultDecimals;
+  uint32_t iteration;
+  uint32_t microseconds;
+  uint8_t opCount;
+  uint32_t ops[maxOps > 0 ? maxOps : 1];
+};
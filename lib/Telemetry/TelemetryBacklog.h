@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <FlashRing.h>
+#include "TelemetryBatch.h"
+
+// Batches kept in a FlashRing while MQTT is down, sent oldest first once it is
+// back, one in flight at a time. A batch leaves the ring when the broker
+// acknowledges it (QoS 1 PUBACK), not when it is queued: a batch in flight
+// when the connection drops is sent again, so it may arrive twice but is
+// never lost.
+//
+// A stored batch is restamped with the millis() of its send before it goes,
+// so the receiver's clock offset is right for it too. Batches stored before
+// the last reset are flagged instead: their millis() count from a boot the
+// receiver can't place. They are the ones pending at begin(), the ring is
+// first in first out and drops its oldest records first.
+class TelemetryBacklog
+{
+  public:
+  TelemetryBacklog(FlashRing &flashRing)
+    :ring(flashRing)
+  {
+    stored = 0;
+    inFlight = 0;
+    acked = false;
+    lastAcked = 0;
+  }
+
+  bool begin()
+  {
+    stored = 0;
+    return ring.begin();
+  }
+
+  bool store(const uint8_t *frame, uint16_t length)
+  {
+    if (!ring.append(frame, length))
+      return false;
+
+    stored++;
+    return true;
+  }
+
+  // Batches not acknowledged yet, the one in flight included
+  uint32_t pending() const
+  {
+    return ring.pending();
+  }
+
+  uint32_t dropped() const
+  {
+    return ring.dropped();
+  }
+
+  /**
+   * Drop the batch sent last if it was acknowledged, then read the next one,
+   * restamped with nowMs and flagged if it is from an earlier boot
+   * @return its length, 0 if the backlog is empty or a batch is still in flight
+   */
+  uint16_t next(uint8_t *frame, uint16_t size, uint32_t nowMs)
+  {
+    if (inFlight != 0)
+    {
+      if (waiting())
+        return 0;
+
+      ring.pop();
+      inFlight = 0;
+    }
+
+    const uint16_t length = ring.peek(frame, size);
+
+    if (length == 0)
+      return 0;
+
+    // more pending than stored since begin(): the oldest are from before it
+    TelemetryBatch<1>::restamp(frame, nowMs, ring.pending() > stored);
+    acked = false;
+    return length;
+  }
+
+  // The batch next() read was published with this packet id
+  void sent(uint16_t packetId)
+  {
+    inFlight = packetId;
+  }
+
+  // From the MQTT client's publish callback, on its own task
+  void acknowledged(uint16_t packetId)
+  {
+    lastAcked = packetId;
+    if (packetId == inFlight)
+      acked = true;
+  }
+
+  // The batch in flight when the connection dropped goes again
+  void disconnected()
+  {
+    if (waiting())
+      inFlight = 0;
+  }
+
+  // A batch was sent and its PUBACK has not come yet
+  bool waiting() const
+  {
+    return inFlight != 0 && !acked && lastAcked != inFlight;
+  }
+
+  protected:
+  FlashRing &ring;
+  // batches stored since begin()
+  uint32_t stored;
+  volatile uint16_t inFlight;
+  volatile bool acked;
+  // the ack may come before sent() is called
+  volatile uint16_t lastAcked;
+};
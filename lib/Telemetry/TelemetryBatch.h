@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Many inference records in one MQTT message, packed little endian:
+//
+// Header (18 bytes + names)
+//   0      version (1)
+//   1      flags, bit 0: results are float32 instead of int32
+//                 bit 1: stored before the device's last reset, the millis()
+//                        below are from an earlier boot
+//   2      record count
+//   3      board name length
+//   4      model name length
+//   5..8   sequence number, +1 per batch, gaps mean lost batches
+//   9..12  millis() of the first record
+//   13..16 millis() when the batch was sent (encoded, or restamped when it
+//          is sent from the flash backlog), the receiver subtracts it from
+//          its own clock to get the device clock offset
+//   17     reserved
+//   board name, model name (no terminator)
+// Record (14 bytes)
+//   0..1   milliseconds since the first record (saturates at 65535)
+//   2..5   iteration
+//   6..9   microseconds
+//   10..13 result, int32 or float32
+//
+// mqttReader.py decodes it back into the JSON rows.
+template<uint8_t capacity>
+class TelemetryBatch
+{
+  public:
+  static const uint8_t VERSION = 1;
+  static const uint8_t FLAG_FLOAT_RESULT = 0x01;
+  static const uint8_t FLAG_EARLIER_BOOT = 0x02;
+  static const size_t headerSize = 18;
+  static const size_t recordSize = 14;
+  // room for board + model names
+  static const size_t namesSize = 32;
+  // largest frame encode() returns
+  static const size_t maxFrameSize = headerSize + namesSize + (size_t) capacity * recordSize;
+
+  TelemetryBatch(const char *boardName, const char *modelName)
+  {
+    board = boardName;
+    model = modelName;
+    boardLength = strlen(board);
+    modelLength = strlen(model);
+    if (boardLength + modelLength > namesSize)
+      boardLength = modelLength = 0;
+    flushCount = capacity;
+    flushInterval = 0;
+    floatResults = false;
+    sequence = 0;
+    count = 0;
+    firstMillis = 0;
+  }
+
+  // Flush on count (at most capacity) and/or when the oldest record is older than intervalMs (0 disables)
+  void setFlush(uint8_t records, uint32_t intervalMs)
+  {
+    flushCount = records == 0 || records > capacity ? capacity : records;
+    flushInterval = intervalMs;
+  }
+
+  uint8_t size() const
+  {
+    return count;
+  }
+
+  uint32_t getSequence() const
+  {
+    return sequence;
+  }
+
+  // @return false if the batch is full, encode() it first
+  bool add(int result, uint32_t iteration, uint32_t microseconds, uint32_t nowMs)
+  {
+    uint32_t bits = (uint32_t) (int32_t) result;
+    return push(bits, false, iteration, microseconds, nowMs);
+  }
+
+  bool add(float result, uint32_t iteration, uint32_t microseconds, uint32_t nowMs)
+  {
+    uint32_t bits;
+    memcpy(&bits, &result, sizeof(bits));
+    return push(bits, true, iteration, microseconds, nowMs);
+  }
+
+  bool shouldFlush(uint32_t nowMs) const
+  {
+    if (count == 0)
+      return false;
+    if (count >= flushCount)
+      return true;
+    return flushInterval > 0 && nowMs - firstMillis >= flushInterval;
+  }
+
+  /**
+   * Finish the batch and start a new one. The frame is built in place, so
+   * the returned pointer stays valid until the next add()
+   * @return NULL if the batch is empty
+   */
+  const uint8_t *encode(uint32_t nowMs, size_t &length)
+  {
+    if (count == 0)
+      return NULL;
+
+    frame[0] = VERSION;
+    frame[1] = floatResults ? FLAG_FLOAT_RESULT : 0;
+    frame[2] = count;
+    frame[3] = boardLength;
+    frame[4] = modelLength;
+    putLong(frame + 5, sequence);
+    putLong(frame + 9, firstMillis);
+    putLong(frame + 13, nowMs);
+    frame[17] = 0;
+    memcpy(frame + headerSize, board, boardLength);
+    memcpy(frame + headerSize + boardLength, model, modelLength);
+
+    length = headerSize + boardLength + modelLength + (size_t) count * recordSize;
+    sequence++;
+    count = 0;
+    return frame;
+  }
+
+  /**
+   * Set the send time of an encoded frame read back from storage, and flag it
+   * if it was stored before the last reset
+   */
+  static void restamp(uint8_t *frame, uint32_t nowMs, bool earlierBoot)
+  {
+    putLong(frame + 13, nowMs);
+    if (earlierBoot)
+      frame[1] |= FLAG_EARLIER_BOOT;
+  }
+
+  protected:
+  const char *board;
+  const char *model;
+  uint8_t boardLength;
+  uint8_t modelLength;
+  uint8_t flushCount;
+  uint32_t flushInterval;
+  bool floatResults;
+  uint32_t sequence;
+  uint8_t count;
+  uint32_t firstMillis;
+  // records are packed behind the header as they arrive, encode() only fills the header
+  uint8_t frame[maxFrameSize];
+
+  bool push(uint32_t resultBits, bool isFloat, uint32_t iteration, uint32_t microseconds, uint32_t nowMs)
+  {
+    if (count >= capacity)
+      return false;
+
+    if (count == 0)
+    {
+      firstMillis = nowMs;
+      floatResults = isFloat;
+    }
+
+    uint32_t offset = nowMs - firstMillis;
+    uint8_t *record = frame + headerSize + boardLength + modelLength + (size_t) count * recordSize;
+    putShort(record, offset > 0xFFFF ? 0xFFFF : offset);
+    putLong(record + 2, iteration);
+    putLong(record + 6, microseconds);
+    putLong(record + 10, resultBits);
+    count++;
+    return true;
+  }
+
+  static void putShort(uint8_t *buffer, uint16_t s)
+  {
+    buffer[0] = s & 0xFF;
+    buffer[1] = s >> 8;
+  }
+
+  static void putLong(uint8_t *buffer, uint32_t l)
+  {
+    buffer[0] = l & 0xFF;
+    buffer[1] = (l >> 8) & 0xFF;
+    buffer[2] = (l >> 16) & 0xFF;
+    buffer[3] = l >> 24;
+  }
+};
@@ -0,0 +1,75 @@
+import paho.mqtt.client as mqtt
+import argparse
+import json
+import struct
+import sys
+import threading
+
+# Sends a model image, packed with Models/pack_model.py, to a board over MQTT.
+# The board writes it to its spare model slot and swaps it in between two
+# benchmark runs, see lib/ModelStore/ModelUpdate.h for the message layout.
+#
+#   python modelPublisher.py esp32dev wine_model.bin --host 172.20.10.5
+
+BEGIN = 1
+CHUNK = 2
+IMAGE_HEADER_SIZE = 32
+
+done = threading.Event()
+status = {}
+
+def messages(image, chunkSize):
+  length, crc, offset = struct.unpack_from("<III", image, 12)
+  model = image[offset:offset + length]
+
+  yield bytes([BEGIN]) + image[:IMAGE_HEADER_SIZE]
+  for position in range(0, length, chunkSize):
+    yield struct.pack("<BxxxI", CHUNK, position) + model[position:position + chunkSize]
+
+def on_message(client, userdata, msg):
+  # a retained status is from an earlier update
+  if (msg.retain):
+    return
+
+  received = json.loads(msg.payload.decode())
+  print("Board " + received['state'] + ": " + str(received['received']) + "/" + str(received['length']) + " bytes, " + received['error'])
+
+  if (received['state'] in ("active", "failed") and received['version'] == userdata):
+    status.update(received)
+    done.set()
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='Publish a model image to a board')
+  parser.add_argument('board', help='esp32dev or esp32wemos')
+  parser.add_argument('image', help='image written by Models/pack_model.py')
+  parser.add_argument('--host', default='localhost')
+  parser.add_argument('--port', type=int, default=1883)
+  parser.add_argument('--username', default='federico')
+  parser.add_argument('--password', default='iotexamdemo')
+  parser.add_argument('--chunk', type=int, default=1024, help='model bytes per message')
+  parser.add_argument('--timeout', type=int, default=120, help='seconds to wait for the board')
+  args = parser.parse_args()
+
+  with open(args.image, 'rb') as file:
+    image = file.read()
+  version = struct.unpack_from("<I", image, 8)[0]
+
+  client = mqtt.Client(userdata=version)
+  client.username_pw_set(args.username, args.password)
+  client.on_message = on_message
+  client.connect(args.host, args.port, 60)
+  client.loop_start()
+
+  client.subscribe("iotdemo." + args.board + ".model.status", 1)
+
+  # one chunk in flight at a time, the board writes each one to flash
+  for message in messages(image, args.chunk):
+    client.publish("iotdemo." + args.board + ".model", message, qos=1).wait_for_publish()
+  print("Model version " + str(version) + " sent, waiting for the board")
+
+  if (not done.wait(args.timeout)):
+    print("No answer from the board")
+  client.loop_stop()
+  client.disconnect()
+
+  sys.exit(0 if status.get('state') == "active" else 1)
@@ -0,0 +1,324 @@
+// Checks lib/ModelRuntime with models of every tensor type it takes, built
+// here with flatbuffers: one fully connected layer of 4 inputs and 3 outputs,
+// as a float model, then swapped by load() for an int8 and a uint8 model of
+// the same weights, the way an update replaces a float model with a quantized
+// one. predict(float *) must give the float model's outputs to within the
+// quantization steps and the same class. A model with int32 tensors, of the
+// byte size of the float one, must be refused and leave the previous model
+// running. The float model's input tensor, written in place, must give the
+// outputs of predict(), and a quantized one has none. Last, a FeatureScaler folded into the float model at load time
+// must give, on raw inputs, the outputs of the model on standardized ones,
+// leave the model's bytes alone and survive a SharedArena planning the model
+// again. Against EloquentTinyML 0.0.10, with an empty Arduino.h, from here:
+//
+//   T=$(mktemp -d) && unzip -q EloquentTinyML-0.0.10.zip -d $T && E=$T/EloquentTinyML-0.0.10/src && touch $T/Arduino.h
+//   gcc -O2 -I$E -c $E/tensorflow/lite/c/common.c -o $T/common.o
+//   S="$(find $E -name '*.cpp') $T/common.o"
+//   g++ -std=c++11 -O2 -I$T -I$E -Ilib/ModelRuntime modelRuntimeCheck.cpp $S -o modelRuntimeCheck
+//   ./modelRuntimeCheck
+
+#include <ModelRuntime.h>
+#include "tensorflow/lite/schema/schema_generated.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define INPUTS 4
+#define OUTPUTS 3
+#define SAMPLES 1000
+#define ARENA_SIZE 4096
+
+// inputs in -2..2, outputs in -6..6
+#define INPUT_RANGE 2.0f
+#define OUTPUT_RANGE 6.0f
+#define WEIGHTS_RANGE 1.0f
+
+struct Quantization
+{
+  float scale;
+  int zeroPoint;
+};
+
+// -range..range on the whole int8 or uint8 scale
+Quantization quantization(float range, tflite::TensorType type)
+{
+  if (type == tflite::TensorType_UINT8)
+    return {2 * range / 255, 128};
+  return {range / 127, 0};
+}
+
+flatbuffers::Offset<tflite::QuantizationParameters> parameters(flatbuffers::FlatBufferBuilder &builder,
+                                                               Quantization q)
+{
+  return tflite::CreateQuantizationParameters(builder, 0, 0, builder.CreateVector<float>({q.scale}),
+                                              builder.CreateVector<int64_t>({q.zeroPoint}));
+}
+
+template<typename T>
+flatbuffers::Offset<tflite::Buffer> constant(flatbuffers::FlatBufferBuilder &builder, const std::vector<T> &values)
+{
+  return tflite::CreateBuffer(builder,
+                              builder.CreateVector((const uint8_t *) values.data(), values.size() * sizeof(T)));
+}
+
+long quantize(float value, Quantization q)
+{
+  return lroundf(value / q.scale) + q.zeroPoint;
+}
+
+// One FULLY_CONNECTED op: input, weights, bias in, output out. Float32, int8
+// (op version 4) or uint8, int32 makes a model no kernel would run, only its
+// tensors matter
+std::vector<uint8_t> buildModel(const std::vector<float> &weights, const std::vector<float> &bias,
+                                tflite::TensorType type)
+{
+  using namespace tflite;
+  flatbuffers::FlatBufferBuilder builder;
+  std::vector<flatbuffers::Offset<Buffer>> buffers;
+  std::vector<flatbuffers::Offset<Tensor>> tensors;
+  const bool quantized = type == TensorType_INT8 || type == TensorType_UINT8;
+  const Quantization input = quantization(INPUT_RANGE, type);
+  const Quantization filter = quantization(WEIGHTS_RANGE, type);
+  const Quantization output = quantization(OUTPUT_RANGE, type);
+  const Quantization biasQuantization = {input.scale * filter.scale, 0};
+
+  buffers.push_back(CreateBuffer(builder, builder.CreateVector<uint8_t>({})));
+  if (type == TensorType_INT8)
+  {
+    std::vector<int8_t> q;
+    for (float w : weights)
+      q.push_back(quantize(w, filter));
+    buffers.push_back(constant(builder, q));
+  }
+  else if (type == TensorType_UINT8)
+  {
+    std::vector<uint8_t> q;
+    for (float w : weights)
+      q.push_back(quantize(w, filter));
+    buffers.push_back(constant(builder, q));
+  }
+  else
+    buffers.push_back(constant(builder, weights));
+
+  if (quantized)
+  {
+    std::vector<int32_t> q;
+    for (float b : bias)
+      q.push_back(quantize(b, biasQuantization));
+    buffers.push_back(constant(builder, q));
+  }
+  else
+    buffers.push_back(constant(builder, bias));
+
+  const auto tensor = [&](std::vector<int> dims, TensorType tensorType, int buffer, const char *name,
+                          Quantization q) {
+    tensors.push_back(CreateTensor(builder, builder.CreateVector(dims), tensorType, buffer,
+                                   builder.CreateString(name), quantized ? parameters(builder, q) : 0));
+  };
+  tensor({1, INPUTS}, type, 0, "input", input);
+  tensor({OUTPUTS, INPUTS}, type, 1, "weights", filter);
+  tensor({OUTPUTS}, quantized ? TensorType_INT32 : type, 2, "bias", biasQuantization);
+  tensor({1, OUTPUTS}, type, 0, "output", output);
+
+  std::vector<flatbuffers::Offset<Operator>> operators = {
+    CreateOperator(builder, 0, builder.CreateVector<int>({0, 1, 2}), builder.CreateVector<int>({3}),
+                   BuiltinOptions_FullyConnectedOptions, CreateFullyConnectedOptions(builder).Union())};
+  const auto subgraph =
+    CreateSubGraph(builder, builder.CreateVector(tensors), builder.CreateVector<int>({0}),
+                   builder.CreateVector<int>({3}), builder.CreateVector(operators), builder.CreateString("main"));
+
+  std::vector<flatbuffers::Offset<OperatorCode>> codes = {
+    CreateOperatorCode(builder, BuiltinOperator_FULLY_CONNECTED, 0, type == TensorType_INT8 ? 4 : 1)};
+  std::vector<flatbuffers::Offset<SubGraph>> subgraphs = {subgraph};
+  const auto model = CreateModel(builder, TFLITE_SCHEMA_VERSION, builder.CreateVector(codes),
+                                 builder.CreateVector(subgraphs), builder.CreateString("modelRuntimeCheck"),
+                                 builder.CreateVector(buffers));
+  FinishModelBuffer(builder, model);
+
+  return std::vector<uint8_t>(builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
+}
+
+float uniform(float range)
+{
+  return range * (2.0f * rand() / RAND_MAX - 1);
+}
+
+// The model's outputs against the float layer, on the same random inputs
+bool checkOutputs(ModelRuntime &runtime, const std::vector<float> &weights, const std::vector<float> &bias,
+                  const char *name, float tolerance)
+{
+  float largest = 0;
+  uint32_t sameClass = 0;
+  bool ok = true;
+
+  srand(1);
+  for (uint32_t n = 0; n < SAMPLES && ok; n++)
+  {
+    float input[INPUTS];
+    float expected[OUTPUTS];
+    float output[OUTPUTS];
+
+    for (uint8_t i = 0; i < INPUTS; i++)
+      input[i] = uniform(INPUT_RANGE);
+    for (uint8_t o = 0; o < OUTPUTS; o++)
+    {
+      expected[o] = bias[o];
+      for (uint8_t i = 0; i < INPUTS; i++)
+        expected[o] += weights[o * INPUTS + i] * input[i];
+    }
+
+    const float first = runtime.predict(input, output);
+    // NaN on an error
+    ok = first == output[0];
+    for (uint8_t o = 0; o < OUTPUTS; o++)
+      largest = fabsf(output[o] - expected[o]) > largest ? fabsf(output[o] - expected[o]) : largest;
+
+    // a tie within the tolerance may go either way
+    const uint8_t predicted = runtime.predictClass(input);
+    const uint8_t reference = runtime.probaToClass(expected);
+    sameClass += predicted == reference || fabsf(expected[predicted] - expected[reference]) < 2 * tolerance;
+  }
+
+  ok &= largest <= tolerance && sameClass == SAMPLES;
+  printf("%s: %u samples, largest difference %.4f (bound %.4f), same class for %u: %s\n", name, SAMPLES, largest,
+         tolerance, sameClass, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Wine like features: offsets and spreads far apart
+const float featureOffset[INPUTS] = {13.0f, 100.0f, 2.4f, 750.0f};
+const float featureSpread[INPUTS] = {0.8f, 14.0f, 0.27f, 315.0f};
+
+// The float model on standardized inputs, without then with the scaling
+// folded in and raw inputs
+bool checkScaling(const std::vector<uint8_t> &floatModel, const std::vector<uint8_t> &int8Model)
+{
+  static uint8_t arena[ARENA_SIZE];
+  static uint8_t sharedArena[ARENA_SIZE];
+  float scale[INPUTS];
+  float folded[OUTPUTS * (INPUTS + 1)];
+  const std::vector<uint8_t> modelBefore = floatModel;
+
+  for (uint8_t i = 0; i < INPUTS; i++)
+    scale[i] = 1 / featureSpread[i];
+
+  FeatureScaler scaler(featureOffset, scale, INPUTS, folded, OUTPUTS * (INPUTS + 1));
+  ModelRuntime standardized(arena, ARENA_SIZE, INPUTS, OUTPUTS);
+  SharedArena shared(sharedArena, ARENA_SIZE);
+  ModelRuntime raw(shared, INPUTS, OUTPUTS);
+  ModelRuntime other(shared, INPUTS, OUTPUTS);
+
+  bool ok = standardized.begin(floatModel.data()) && raw.begin(floatModel.data(), &scaler);
+  ok &= other.begin(int8Model.data());
+  float largest = 0;
+  uint32_t sameClass = 0;
+
+  srand(3);
+  for (uint32_t n = 0; n < SAMPLES && ok; n++)
+  {
+    float input[INPUTS];
+    float scaled[INPUTS];
+    float expected[OUTPUTS];
+    float output[OUTPUTS];
+
+    for (uint8_t i = 0; i < INPUTS; i++)
+    {
+      input[i] = featureOffset[i] + featureSpread[i] * uniform(INPUT_RANGE);
+      scaled[i] = (input[i] - featureOffset[i]) * scale[i];
+    }
+
+    // the other runtime takes the arena every few samples
+    if (n % 7 == 0)
+      other.predict(scaled);
+
+    standardized.predict(scaled, expected);
+    const float first = raw.predict(input, output);
+    ok = first == output[0];
+    for (uint8_t o = 0; o < OUTPUTS; o++)
+      largest = fabsf(output[o] - expected[o]) > largest ? fabsf(output[o] - expected[o]) : largest;
+    sameClass += raw.probaToClass(output) == raw.probaToClass(expected);
+  }
+
+  // a scaler of another width is refused, the folded model stays
+  float wider[OUTPUTS * (INPUTS + 2)];
+  FeatureScaler mismatched(featureOffset, scale, INPUTS + 1, wider, OUTPUTS * (INPUTS + 2));
+  const bool refused = !raw.load(floatModel.data(), &mismatched) && raw.getError() == ModelRuntime::SCALING_MISMATCH;
+  ok &= refused && raw.activate();
+
+  ok &= largest <= 1e-4f && sameClass == SAMPLES && modelBefore == floatModel;
+  printf("scaling folded at load time: %u samples, largest difference %.2e against standardized inputs, same class "
+         "for %u, %u plans, model unchanged, %u feature scaler %s: %s\n", SAMPLES, largest, sameClass, shared.getPlans(),
+         INPUTS + 1, refused ? "refused" : "loaded", ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main()
+{
+  static uint8_t arena[ARENA_SIZE];
+  ModelRuntime runtime(arena, ARENA_SIZE, INPUTS, OUTPUTS);
+  std::vector<float> weights;
+  std::vector<float> bias;
+
+  srand(2);
+  for (uint8_t i = 0; i < INPUTS * OUTPUTS; i++)
+    weights.push_back(uniform(WEIGHTS_RANGE));
+  for (uint8_t o = 0; o < OUTPUTS; o++)
+    bias.push_back(uniform(1));
+
+  const std::vector<uint8_t> floatModel = buildModel(weights, bias, tflite::TensorType_FLOAT32);
+  const std::vector<uint8_t> int8Model = buildModel(weights, bias, tflite::TensorType_INT8);
+  const std::vector<uint8_t> uint8Model = buildModel(weights, bias, tflite::TensorType_UINT8);
+  const std::vector<uint8_t> int32Model = buildModel(weights, bias, tflite::TensorType_INT32);
+
+  // a step of each input and weight times 4 inputs, and half an output step
+  const float int8Bound = INPUTS * (INPUT_RANGE / 127 * WEIGHTS_RANGE + INPUT_RANGE * WEIGHTS_RANGE / 127) / 2
+                          + OUTPUT_RANGE / 127;
+  const float uint8Bound = INPUTS * (INPUT_RANGE / 127.5f * WEIGHTS_RANGE + INPUT_RANGE * WEIGHTS_RANGE / 127.5f) / 2
+                           + OUTPUT_RANGE / 127.5f;
+
+  bool ok = runtime.begin(floatModel.data());
+  ok &= checkOutputs(runtime, weights, bias, "float", 1e-5f);
+
+  // raw bytes make no sense to a float model
+  uint8_t raw[INPUTS] = {0};
+  runtime.predict(raw);
+  ok &= runtime.getError() == ModelRuntime::TYPE_MISMATCH;
+  printf("uint8 predict() on the float model: %s\n", runtime.errorMessage());
+
+  ok &= runtime.load(int8Model.data());
+  ok &= checkOutputs(runtime, weights, bias, "float model swapped for int8", int8Bound);
+
+  ok &= runtime.load(uint8Model.data());
+  ok &= checkOutputs(runtime, weights, bias, "int8 model swapped for uint8", uint8Bound);
+
+  const bool refused = !runtime.load(int32Model.data()) && runtime.getError() == ModelRuntime::TYPE_MISMATCH;
+  printf("int32 model: %s, %s\n", refused ? "refused" : "loaded", runtime.errorMessage());
+  ok &= refused && runtime.model() == uint8Model.data();
+  ok &= checkOutputs(runtime, weights, bias, "uint8 model kept", uint8Bound);
+
+  ok &= runtime.load(floatModel.data());
+  ok &= checkOutputs(runtime, weights, bias, "back to float", 1e-5f);
+
+  // in place, as SensorFeatures::writeInput()
+  float features[INPUTS] = {0.5f, -1.25f, 2.0f, 0.75f};
+  float expected[OUTPUTS], output[OUTPUTS];
+  runtime.predict(features, expected);
+  float *tensor = runtime.getFloatInputBuffer();
+  bool inPlace = tensor != NULL;
+  for (uint8_t i = 0; i < INPUTS && inPlace; i++)
+    tensor[i] = features[i];
+  inPlace &= runtime.predictInPlace(output) == expected[0] && memcmp(output, expected, sizeof(output)) == 0;
+  static uint8_t quantizedArena[ARENA_SIZE];
+  ModelRuntime quantized(quantizedArena, ARENA_SIZE, INPUTS, OUTPUTS);
+  inPlace &= quantized.begin(int8Model.data()) && quantized.getFloatInputBuffer() == NULL
+             && quantized.getError() == ModelRuntime::TYPE_MISMATCH;
+  printf("float input in place: same outputs as predict(), none on the int8 model: %s\n", inPlace ? "ok" : "FAILED");
+  ok &= inPlace;
+
+  ok &= checkScaling(floatModel, int8Model);
+
+  printf(ok ? "OK\n" : "FAILED\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+import argparse
+import asyncio
+import struct
+
+# Stand-in for mosquitto to try the boards, mqttReader.py and modelPublisher.py
+# on a laptop: MQTT 3.1.1 with QoS 0 and 1, retained messages and + / #
+# wildcards. No authentication, no persistence, no QoS 2.
+#
+# The boards and fleetLoad publish iotdemo.<board>.batch, mqttReader.py
+# subscribes to iotdemo/<board>/batch: as the MQTT plugin of RabbitMQ, '.' and
+# '/' both separate levels here, topics and filters are kept with '/'.
+#
+#   python mqttBroker.py --port 1883
+
+CONNECT = 1
+CONNACK = 2
+PUBLISH = 3
+PUBACK = 4
+SUBSCRIBE = 8
+SUBACK = 9
+UNSUBSCRIBE = 10
+UNSUBACK = 11
+PINGREQ = 12
+PINGRESP = 13
+DISCONNECT = 14
+
+clients = set()
+retained = {}
+
+def levels(name):
+  return name.decode().replace('.', '/')
+
+def matches(pattern, topic):
+  patternLevels = pattern.split('/')
+  topicLevels = topic.split('/')
+
+  for i, level in enumerate(patternLevels):
+    if (level == '#'):
+      return True
+    if (i >= len(topicLevels) or (level != '+' and level != topicLevels[i])):
+      return False
+
+  return len(patternLevels) == len(topicLevels)
+
+def packet(packetType, flags, body):
+  length = len(body)
+  header = bytearray([packetType << 4 | flags])
+  while True:
+    byte = length % 128
+    length //= 128
+    header.append(byte | 0x80 if length > 0 else byte)
+    if (length == 0):
+      return bytes(header) + body
+
+def encodeString(value):
+  return struct.pack(">H", len(value)) + value
+
+def decodeString(body, offset):
+  length = struct.unpack_from(">H", body, offset)[0]
+  return body[offset + 2:offset + 2 + length], offset + 2 + length
+
+class Client:
+  def __init__(self, writer):
+    self.writer = writer
+    self.subscriptions = {}
+    self.packetId = 0
+    self.name = "?"
+
+  def send(self, topic, payload, qos, retain):
+    flags = qos << 1 | (1 if retain else 0)
+    body = encodeString(topic.encode())
+    if (qos > 0):
+      self.packetId = self.packetId % 65535 + 1
+      body += struct.pack(">H", self.packetId)
+    self.writer.write(packet(PUBLISH, flags, body + payload))
+
+  def deliver(self, topic, payload, qos, retain):
+    granted = [q for pattern, q in self.subscriptions.items() if matches(pattern, topic)]
+    if (granted):
+      self.send(topic, payload, min(qos, max(granted)), retain)
+
+async def readPacket(reader):
+  first = (await reader.readexactly(1))[0]
+  length = 0
+  multiplier = 1
+  while True:
+    byte = (await reader.readexactly(1))[0]
+    length += (byte & 0x7F) * multiplier
+    multiplier *= 128
+    if (not byte & 0x80):
+      break
+  return first >> 4, first & 0x0F, await reader.readexactly(length)
+
+def onPublish(client, flags, body):
+  qos = (flags >> 1) & 0x03
+  retain = flags & 0x01
+  topic, offset = decodeString(body, 0)
+  topic = levels(topic)
+
+  if (qos > 0):
+    packetId = body[offset:offset + 2]
+    offset += 2
+    client.writer.write(packet(PUBACK, 0, packetId))
+  payload = body[offset:]
+
+  if (retain):
+    if (payload):
+      retained[topic] = (payload, qos)
+    else:
+      retained.pop(topic, None)
+
+  for other in clients:
+    other.deliver(topic, payload, qos, False)
+
+def onSubscribe(client, body):
+  packetId = body[:2]
+  offset = 2
+  granted = bytearray()
+  patterns = []
+
+  while offset < len(body):
+    pattern, offset = decodeString(body, offset)
+    qos = min(body[offset], 1)
+    offset += 1
+    client.subscriptions[levels(pattern)] = qos
+    patterns.append(levels(pattern))
+    granted.append(qos)
+
+  client.writer.write(packet(SUBACK, 0, packetId + bytes(granted)))
+
+  for topic, (payload, qos) in retained.items():
+    if (any(matches(pattern, topic) for pattern in patterns)):
+      client.deliver(topic, payload, qos, True)
+
+def onUnsubscribe(client, body):
+  offset = 2
+  while offset < len(body):
+    pattern, offset = decodeString(body, offset)
+    client.subscriptions.pop(levels(pattern), None)
+  client.writer.write(packet(UNSUBACK, 0, body[:2]))
+
+async def serve(reader, writer):
+  client = Client(writer)
+
+  try:
+    packetType, flags, body = await readPacket(reader)
+    if (packetType != CONNECT):
+      return
+
+    # client id after protocol name, level, flags and keep alive
+    protocol, offset = decodeString(body, 0)
+    clientId, offset = decodeString(body, offset + 4)
+    client.name = clientId.decode() or str(writer.get_extra_info('peername'))
+    writer.write(packet(CONNACK, 0, b"\x00\x00"))
+    clients.add(client)
+    print("Connected " + client.name)
+
+    while True:
+      packetType, flags, body = await readPacket(reader)
+      if (packetType == PUBLISH):
+        onPublish(client, flags, body)
+      elif (packetType == SUBSCRIBE):
+        onSubscribe(client, body)
+      elif (packetType == UNSUBSCRIBE):
+        onUnsubscribe(client, body)
+      elif (packetType == PINGREQ):
+        writer.write(packet(PINGRESP, 0, b""))
+      elif (packetType == DISCONNECT):
+        break
+      await writer.drain()
+  except (asyncio.IncompleteReadError, ConnectionError):
+    pass
+  finally:
+    clients.discard(client)
+    writer.close()
+    print("Disconnected " + client.name)
+
+async def main(port):
+  server = await asyncio.start_server(serve, '0.0.0.0', port)
+  print("Broker listening on port " + str(port))
+  async with server:
+    await server.serve_forever()
+
+if __name__ == '__main__':
+  parser = argparse.ArgumentParser(description='Minimal MQTT broker for local tests')
+  parser.add_argument('--port', type=int, default=1883)
+  asyncio.run(main(parser.parse_args().port))
@@ -1,5 +1,8 @@
 import paho.mqtt.client as mqtt
 import json
+import os
+import struct
+import time
 import pandas as pd
 
 esp32dev = {}
@@ -8,14 +11,89 @@ esp8266 = {}
 
 messagesCounter = 0
 
+# Last batch sequence number per board and model, to report lost batches
+batchSequences = {}
+
+# Binary batch layout, see lib/Telemetry/TelemetryBatch.h
+
+BATCH_HEADER = struct.Struct("<BBBBBIII")
+BATCH_HEADER_SIZE = 18
+BATCH_RECORD = struct.Struct("<HII4s")
+BATCH_FLOAT_RESULT = 0x01
+BATCH_EARLIER_BOOT = 0x02
+
+def decode_batch(payload):
+  version, flags, count, boardLength, modelLength, sequence, firstMillis, sentMillis = BATCH_HEADER.unpack_from(payload, 0)
+  if (version != 1):
+    raise ValueError("Unsupported batch version " + str(version))
+
+  offset = BATCH_HEADER_SIZE
+  board = payload[offset:offset + boardLength].decode()
+  offset += boardLength
+  model = payload[offset:offset + modelLength].decode()
+  offset += modelLength
+
+  # device clock offset: host time when the batch was sent minus device millis()
+  clockOffset = time.time() - sentMillis / 1000.0
+  resultFormat = "<f" if flags & BATCH_FLOAT_RESULT else "<i"
+
+  records = []
+  for i in range(count):
+    delta, iteration, microseconds, resultBytes = BATCH_RECORD.unpack_from(payload, offset)
+    offset += BATCH_RECORD.size
+    result = struct.unpack(resultFormat, resultBytes)[0]
+    if (flags & BATCH_FLOAT_RESULT):
+      result = round(result, 2)
+    records.append({"board": board, "model": model, "result": result, "iteration": iteration, "microseconds": microseconds})
+
+  # stored before the device's last reset: its millis() can't be placed
+  if (flags & BATCH_EARLIER_BOOT):
+    return sequence, None, records
+
+  timestamp = clockOffset + firstMillis / 1000.0
+  return sequence, timestamp, records
+
 def on_connect(client, userdata, flags, rc):
   print("Connected with result code "+str(rc))
   client.subscribe("iotdemo/esp32dev")
   client.subscribe("iotdemo/esp32wemos")
   client.subscribe("iotdemo/esp8266")
+  client.subscribe("iotdemo/esp32dev/batch")
+  client.subscribe("iotdemo/esp32wemos/batch")
+  client.subscribe("iotdemo/esp8266/batch")
+  client.subscribe("iotdemo/esp32dev/stats")
+  client.subscribe("iotdemo/esp32wemos/stats")
+  client.subscribe("iotdemo/esp8266/stats")
+
+# Latency summaries computed on the device, one row per window
+
+def store_stats(received):
+  filename = received['board'] + "_" + received['model'] + "_stats.csv"
+  df = pd.DataFrame([received])
+  df.to_csv(filename, mode='a', index=False, header=not os.path.exists(filename))
+  print("Stats " + received['board'] + " " + received['model'] + ": " + str(received['count']) + " inferences, p50 " + str(received['p50']) + ", p99 " + str(received['p99']) + ", max " + str(received['max']) + " microseconds")
 
 def on_message(client, userdata, msg):
 
+  if (msg.topic.endswith("/stats")):
+    store_stats(json.loads(msg.payload.decode()))
+  elif (msg.topic.endswith("/batch")):
+    sequence, timestamp, records = decode_batch(msg.payload)
+    if (len(records) == 0):
+      return
+    key = records[0]['board'] + "_" + records[0]['model']
+    if (key in batchSequences and sequence > batchSequences[key] + 1):
+      print("Lost " + str(sequence - batchSequences[key] - 1) + " batches of " + key)
+    batchSequences[key] = sequence
+    when = "stored before a reset, time unknown" if timestamp is None else "first at " + time.ctime(timestamp)
+    print("Batch " + str(sequence) + " of " + key + ": " + str(len(records)) + " records, " + when)
+    for received in records:
+      store(received)
+  else:
+    store(json.loads(msg.payload.decode()))
+
+def store(received):
+
   global messagesCounter
 
   if (messagesCounter % 10 == 0):
@@ -23,9 +101,10 @@ def on_message(client, userdata, msg):
 
   messagesCounter = messagesCounter + 1
 
-  received = json.loads(msg.payload.decode())
   modelName = received['model']
-  if (received['board'] == 'esp8266'):
+  # fleetLoad names its simulated boards <board>-<index>
+  board = received['board'].split('-')[0]
+  if (board == 'esp8266'):
     if (modelName in esp8266):
       esp8266[modelName].append(received)
       if (len(esp8266[modelName]) == 50):
@@ -37,7 +116,7 @@ def on_message(client, userdata, msg):
     else:
       esp8266[modelName] = []
       esp8266[modelName].append(received)
-  elif (received['board'] == 'esp32dev'):
+  elif (board == 'esp32dev'):
     if (modelName in esp32dev):
       esp32dev[modelName].append(received)
       if (len(esp32dev[modelName]) == 50):
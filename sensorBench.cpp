@@ -0,0 +1,342 @@
+// Checks and times lib/SensorFeatures on a laptop: the streaming window
+// statistics against the same statistics recomputed over the window after
+// every sample, the band energies against the variance they split, and the
+// cost of each per sample and per feature vector next to the recomputation
+// the streaming update replaces. The band energies are also checked against
+// a DFT in double of the same tapered samples. The ESP8266/Sensor sketch
+// times the same work on the board. From here:
+//
+//   g++ -std=c++11 -O2 -Ilib/SensorFeatures sensorBench.cpp -o sensorBench
+//   ./sensorBench
+
+#include <SensorFeatures.h>
+#include <BandEnergies.h>
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+// An accelerometer at 100 Hz: 1.28 s windows every 0.32 s, three axes
+#define CHANNELS 3
+#define WINDOW 128
+#define HOP 32
+#define FFT_SIZE 64
+#define BANDS 4
+#define SAMPLE_RATE 100
+#define PASSES 5
+#define TIMED_SAMPLES 200000
+
+typedef std::chrono::steady_clock Clock;
+
+// Deterministic on every platform, unlike rand()
+double noise(uint32_t i)
+{
+  uint32_t x = i * 2654435761u + 12345;
+
+  x ^= x >> 15;
+  x *= 2246822519u;
+  x ^= x >> 13;
+  return (x & 0xffff) / 32768.0 - 1;
+}
+
+int16_t clamp(double value)
+{
+  return value > 32767 ? 32767 : value < -32768 ? -32768 : (int16_t) lrint(value);
+}
+
+// Walking on a +-2 g accelerometer: gravity on z, a 2 Hz step, bursts of
+// shaking, sensor noise and the odd saturated sample
+void reading(uint32_t i, int16_t *axes)
+{
+  const double t = (double) i / SAMPLE_RATE;
+  const double step = sin(2 * M_PI * 2 * t);
+  const double shake = fmod(t, 7.0) < 1.5 ? sin(2 * M_PI * 18 * t) : 0;
+
+  axes[0] = clamp(3000 * step + 5000 * shake + 200 * noise(i));
+  axes[1] = clamp(1500 * sin(2 * M_PI * 1 * t) + 200 * noise(i + 7777));
+  axes[2] = clamp(16384 + 6000 * step + 200 * noise(i + 99991) + (i % 997 == 0 ? 40000 : 0));
+}
+
+// The statistics recomputed from the samples, oldest first
+struct Reference
+{
+  double mean;
+  double variance;
+  double rms;
+  int32_t peakToPeak;
+  uint32_t crossings;
+};
+
+Reference recompute(const int16_t *window, size_t count, int16_t level)
+{
+  Reference r = {0, 0, 0, 0, 0};
+  double sum = 0, squares = 0;
+  int16_t lowest = window[0], highest = window[0];
+
+  for (size_t i = 0; i < count; i++)
+  {
+    sum += window[i];
+    squares += (double) window[i] * window[i];
+    lowest = window[i] < lowest ? window[i] : lowest;
+    highest = window[i] > highest ? window[i] : highest;
+    if (i > 0)
+      r.crossings += (window[i - 1] >= level) != (window[i] >= level);
+  }
+  r.mean = sum / count;
+  r.variance = squares / count - r.mean * r.mean;
+  r.rms = sqrt(squares / count);
+  r.peakToPeak = highest - lowest;
+  return r;
+}
+
+// The features SensorFeatures::write() gives, recomputed from the window as a
+// sketch without the library would at every hop: integer sums as the library
+int16_t recomputeFeatures(const int16_t *window, float *out)
+{
+  int32_t sum = 0;
+  uint64_t squares = 0;
+  int16_t lowest = window[0], highest = window[0];
+  uint16_t crossings = 0;
+
+  for (uint16_t i = 0; i < WINDOW; i++)
+  {
+    sum += window[i];
+    squares += (int32_t) window[i] * window[i];
+    lowest = window[i] < lowest ? window[i] : lowest;
+    highest = window[i] > highest ? window[i] : highest;
+    if (i > 0)
+      crossings += (window[i - 1] >= 0) != (window[i] >= 0);
+  }
+  out[FEATURE_MEAN] = (float) sum / WINDOW;
+  out[FEATURE_VARIANCE] = (float) ((int64_t) WINDOW * (int64_t) squares - (int64_t) sum * sum) / (WINDOW * WINDOW);
+  out[FEATURE_RMS] = sqrtf((float) squares / WINDOW);
+  out[FEATURE_PEAK_TO_PEAK] = highest - lowest;
+  out[FEATURE_CROSSING_RATE] = (float) crossings / (WINDOW - 1);
+  return highest;
+}
+
+double relative(double value, double reference)
+{
+  return fabs(value - reference) / (fabs(reference) > 1 ? fabs(reference) : 1);
+}
+
+// Every sample of a long run, on each axis, with the window still filling too
+template<uint16_t window>
+bool checkStats(uint32_t samples, int16_t level)
+{
+  WindowStats<window> stats[CHANNELS];
+  double worstMean = 0, worstVariance = 0, worstRms = 0;
+  uint32_t wrongExtremes = 0, wrongCrossings = 0, checks = 0;
+  int16_t latest[window];
+
+  for (uint8_t c = 0; c < CHANNELS; c++)
+    stats[c].setCrossingLevel(c == 2 ? 16384 + level : level);
+
+  for (uint32_t i = 0; i < samples; i++)
+  {
+    int16_t axes[CHANNELS];
+
+    reading(i, axes);
+    for (uint8_t c = 0; c < CHANNELS; c++)
+    {
+      stats[c].push(axes[c]);
+      stats[c].copyLatest(latest, stats[c].getCount());
+
+      const Reference r = recompute(latest, stats[c].getCount(), c == 2 ? 16384 + level : level);
+      const double mean = stats[c].getMean(), variance = stats[c].getVariance(), rms = stats[c].getRms();
+
+      checks++;
+      worstMean = fmax(worstMean, relative(mean, r.mean));
+      worstVariance = fmax(worstVariance, relative(variance, r.variance));
+      worstRms = fmax(worstRms, relative(rms, r.rms));
+      wrongExtremes += stats[c].getPeakToPeak() != r.peakToPeak;
+      wrongCrossings += stats[c].getCrossings() != r.crossings;
+    }
+  }
+
+  // float results of exact sums: a few float epsilons at most
+  const bool ok = worstMean < 1e-6 && worstVariance < 1e-5 && worstRms < 1e-6 && wrongExtremes == 0 &&
+                  wrongCrossings == 0;
+  printf("window %3u: %u checks, worst relative error mean %.1e, variance %.1e, rms %.1e, %u wrong peak to peak, "
+         "%u wrong crossings%s\n",
+         window, checks, worstMean, worstVariance, worstRms, wrongExtremes, wrongCrossings, ok ? "" : ": DIFFERENT");
+  return ok;
+}
+
+// The bands of BandEnergies in double: the samples less the rounded window
+// mean, a Hann taper and a DFT
+void referenceBands(const int16_t *samples, double mean, double *energies)
+{
+  double tapered[FFT_SIZE];
+
+  for (uint16_t i = 0; i < FFT_SIZE; i++)
+    tapered[i] = (samples[i] - lrint(mean)) * (0.5 - 0.5 * cos(2 * M_PI * i / FFT_SIZE));
+
+  for (uint8_t b = 0; b < BANDS; b++)
+  {
+    energies[b] = 0;
+    for (uint16_t k = 1 + b * (FFT_SIZE / 2) / BANDS; k <= (b + 1) * (FFT_SIZE / 2) / BANDS; k++)
+    {
+      double re = 0, im = 0;
+      for (uint16_t i = 0; i < FFT_SIZE; i++)
+      {
+        re += tapered[i] * cos(2 * M_PI * k * i / FFT_SIZE);
+        im -= tapered[i] * sin(2 * M_PI * k * i / FFT_SIZE);
+      }
+      energies[b] += (k == FFT_SIZE / 2 ? 1 : 2) * (re * re + im * im) * 8 / 3 / FFT_SIZE / FFT_SIZE;
+    }
+  }
+}
+
+// Tones of every bin, from quiet to clipped, on noise: the bands should match
+// the DFT, add up to the variance and the loudest band should hold the tone
+bool checkBands()
+{
+  BandEnergies<FFT_SIZE, BANDS> bands;
+  double worstSum = 0, worstBand = 0;
+  uint32_t misplaced = 0, tones = 0;
+
+  if (!bands.begin())
+  {
+    printf("Cannot table the FFT\n");
+    return false;
+  }
+
+  for (double amplitude = 50; amplitude <= 60000; amplitude *= 4)
+  {
+    for (uint16_t bin = 2; bin < FFT_SIZE / 2 - 1; bin++)
+    {
+      WindowStats<WINDOW> stats;
+      float energies[BANDS];
+      double expected[BANDS];
+
+      for (uint32_t i = 0; i < WINDOW; i++)
+        stats.push(clamp(1000 + amplitude * sin(2 * M_PI * bin * i / FFT_SIZE + 0.3) + 4 * noise(i + bin)));
+      bands.compute(stats, energies);
+
+      // the variance of the FFT's samples, not the whole window's
+      WindowStats<FFT_SIZE> last;
+      int16_t latest[FFT_SIZE];
+      stats.copyLatest(latest, FFT_SIZE);
+      for (uint16_t i = 0; i < FFT_SIZE; i++)
+        last.push(latest[i]);
+      referenceBands(latest, stats.getMean(), expected);
+
+      double total = 0, expectedTotal = 0;
+      uint8_t loudest = 0;
+      for (uint8_t b = 0; b < BANDS; b++)
+      {
+        total += energies[b];
+        expectedTotal += expected[b];
+        loudest = energies[b] > energies[loudest] ? b : loudest;
+      }
+      for (uint8_t b = 0; b < BANDS; b++)
+        worstBand = fmax(worstBand, fabs(energies[b] - expected[b]) / expectedTotal);
+      worstSum = fmax(worstSum, relative(total, last.getVariance()));
+      misplaced += loudest != (bin - 1) * BANDS / (FFT_SIZE / 2);
+      tones++;
+    }
+  }
+
+  const bool ok = worstBand < 0.01 && worstSum < 0.05 && misplaced == 0;
+  printf("bands: %u tones, worst band off the DFT by %.2f%% of the total, sum of bands off the variance by %.1f%%, "
+         "%u in the wrong band%s\n",
+         tones, 100 * worstBand, 100 * worstSum, misplaced, ok ? "" : ": DIFFERENT");
+  return ok;
+}
+
+// Best of PASSES, the slower ones were interrupted
+template<typename Function>
+double bestNanos(uint32_t calls, Function function)
+{
+  double best = 0;
+
+  for (int p = 0; p < PASSES; p++)
+  {
+    const Clock::time_point start = Clock::now();
+    function();
+    const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+
+    if (p == 0 || ns < best)
+      best = ns;
+  }
+  return best;
+}
+
+int main()
+{
+  bool ok = checkStats<2>(20000, 0);
+  ok &= checkStats<32>(100000, 100);
+  ok &= checkStats<WINDOW>(50000, 0);
+  ok &= checkBands();
+
+  std::vector<int16_t> readings(TIMED_SAMPLES * CHANNELS);
+  for (uint32_t i = 0; i < TIMED_SAMPLES; i++)
+    reading(i, &readings[i * CHANNELS]);
+
+  static SensorFeatures<CHANNELS, WINDOW> features;
+  static BandEnergies<FFT_SIZE, BANDS> bands;
+  float input[SensorFeatures<CHANNELS, WINDOW>::size + CHANNELS * BANDS];
+  volatile float sink = 0;
+  uint32_t vectors = 0;
+
+  features.setHop(HOP);
+  bands.begin();
+
+  const double pushNs = bestNanos(TIMED_SAMPLES, [&]() {
+    features.reset();
+    for (uint32_t i = 0; i < TIMED_SAMPLES; i++)
+      features.push(&readings[i * CHANNELS]);
+    sink = sink + features.getChannel(0).getVariance();
+  });
+
+  const double writeNs = bestNanos(TIMED_SAMPLES, [&]() {
+    for (uint32_t i = 0; i < TIMED_SAMPLES; i++)
+      features.write(input);
+    sink = sink + input[0];
+  });
+
+  const double bandsNs = bestNanos(TIMED_SAMPLES / 10, [&]() {
+    for (uint32_t i = 0; i < TIMED_SAMPLES / 10; i++)
+      bands.compute(features.getChannel(i % CHANNELS), input + features.size);
+    sink = sink + input[features.size];
+  });
+
+  // what a sketch would do without the library: keep the window, recompute
+  // every feature from it at every hop
+  const double recomputeNs = bestNanos(TIMED_SAMPLES / HOP, [&]() {
+    for (uint32_t i = WINDOW; i + HOP <= TIMED_SAMPLES; i += HOP)
+    {
+      for (uint8_t c = 0; c < CHANNELS; c++)
+      {
+        int16_t window[WINDOW];
+
+        for (uint16_t s = 0; s < WINDOW; s++)
+          window[s] = readings[(i - WINDOW + s) * CHANNELS + c];
+        sink = sink + recomputeFeatures(window, input + c * FEATURES_PER_CHANNEL);
+      }
+    }
+  });
+
+  // a real run, for the features' sake
+  features.reset();
+  for (uint32_t i = 0; i < TIMED_SAMPLES; i++)
+  {
+    if (!features.push(&readings[i * CHANNELS]))
+      continue;
+    features.write(input);
+    for (uint8_t c = 0; c < CHANNELS; c++)
+      bands.compute(features.getChannel(c), input + features.size + c * BANDS);
+    vectors++;
+  }
+
+  printf("%u channels, %u sample windows every %u samples: %u feature vectors of %u + %u bands\n", CHANNELS, WINDOW,
+         HOP, vectors, features.size, CHANNELS * BANDS);
+  printf("Streaming statistics %.1f ns per reading, write %.1f ns per vector\n", pushNs, writeNs);
+  printf("Bands %.0f ns per channel (%u point FFT)\n", bandsNs, FFT_SIZE);
+  printf("Recomputing the statistics over the window %.0f ns per vector: %.1f ns per reading at this hop, %.0f ns at "
+         "a hop of 1\n",
+         recomputeNs, recomputeNs / HOP, recomputeNs);
+  return ok ? 0 : 1;
+}